@@ -30,7 +30,10 @@ static const spinlock_t SPIN_LOCK_UNLOCKED = 0;
 
 #define atomic_cmp_set(a,b,c) __sync_bool_compare_and_swap(a,b,c)
 #define atomic_add_fetch(a,b,c) __sync_add_and_fetch(a,b,c)
-#define HAVE_SPINLOCKS 1
+#define atomic_fetch_add(a,b) __sync_fetch_and_add(a,b)
+#define atomic_set_mask(a,b) __sync_fetch_and_or(a,b)
+#define atomic_clear_mask(a,b) __sync_fetch_and_and(a,~(b))
+#define atomic_swap(a,b) __sync_lock_test_and_set(a,b)
 
 
 class SpinLock
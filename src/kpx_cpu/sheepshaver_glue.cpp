@@ -44,6 +44,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <signal.h>
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
 #endif
@@ -82,6 +83,18 @@ static uint32 macos_exec_count = 0;
 static clock_t macos_exec_time = 0;
 #endif
 
+// Runtime profile dump on request
+#if PPC_ENABLE_JIT && PPC_RUNTIME_PROFILER && defined(SIGUSR1) && !defined(__BEOS__) && !defined(__HAIKU__)
+#define PROFILE_DUMP_SIGNAL SIGUSR1
+static volatile sig_atomic_t profile_dump_requested = 0;
+
+static void profile_dump_handler(int sig)
+{
+	// The profile is written from the emulator thread, at the next interrupt
+	profile_dump_requested = 1;
+}
+#endif
+
 static void enter_mon(void)
 {
 	// Start up mon in real-mode
@@ -187,8 +200,44 @@ sheepshaver_cpu::sheepshaver_cpu()
 	init_decoder();
 
 #if PPC_ENABLE_JIT
-	if (PrefsFindBool("jit"))
+	if (PrefsFindBool("jit")) {
+#if PPC_PERSISTENT_JIT_CACHE
+		if (PrefsFindString("jitcache"))
+			enable_translation_cache_persistence();
+#endif
 		enable_jit();
+#if PPC_ENABLE_NATIVE_JIT
+		enable_native_jit(PrefsFindBool("jitnative"));
+		enable_jit_optimizer(PrefsFindBool("jitoptimize"));
+#endif
+#if PPC_PERF_JIT_MAP
+		int perf_modes = 0;
+		if (PrefsFindBool("jitperfmap"))
+			perf_modes |= PERF_MAP;
+		if (PrefsFindBool("jitdump"))
+			perf_modes |= PERF_JITDUMP;
+		if (perf_modes)
+			enable_perf_map(perf_modes);
+#endif
+#if PPC_RUNTIME_PROFILER
+		if (PrefsFindString("jitprofile")) {
+			enable_profiler();
+#ifdef PROFILE_DUMP_SIGNAL
+			signal(PROFILE_DUMP_SIGNAL, profile_dump_handler);
+#endif
+		}
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+		const char *cache_file = PrefsFindString("jitcache");
+		if (cache_file)
+			load_translation_cache(cache_file);
+#endif
+#if PPC_ASYNC_JIT
+		// Start the compiler thread once the translation cache is set up
+		if (PrefsFindBool("jitasync"))
+			enable_async_jit();
+#endif
+	}
 #endif
 }
 
@@ -236,7 +285,9 @@ void sheepshaver_cpu::execute_emul_op(uint32 emul_op)
 	r68.a[7] = gpr(1);
 	uint32 saved_cr = get_cr() & 0xff9fffff; // mask_operand::compute(11, 8)
 	uint32 saved_xer = get_xer();
+	enter_host_code();
 	EmulOp(&r68, gpr(24), emul_op);
+	leave_host_code();
 	set_cr(saved_cr);
 	set_xer(saved_xer);
 	for (int i = 0; i < 8; i++)
@@ -532,6 +583,9 @@ void sheepshaver_cpu::execute_68k(uint32 entry, M68kRegisters *r)
 	exec68k_count++;
 	const clock_t exec68k_start = clock();
 #endif
+#if PPC_ENABLE_JIT && PPC_RUNTIME_PROFILER
+	profile_event(PROFILE_EXECUTE_68K);
+#endif
 
 #if SAFE_EXEC_68K
 	if (ReadMacInt32(XLM_RUN_MODE) != MODE_EMUL_OP)
@@ -914,6 +968,20 @@ void exit_emul_ppc(void)
 	printf("\n");
 #endif
 
+#if PPC_ENABLE_JIT && PPC_PERSISTENT_JIT_CACHE
+	// Save translated blocks for the next run
+	const char *cache_file = PrefsFindString("jitcache");
+	if (cache_file && PrefsFindBool("jit"))
+		ppc_cpu->save_translation_cache(cache_file);
+#endif
+
+#if PPC_ENABLE_JIT && PPC_RUNTIME_PROFILER
+	// Write the final runtime profile
+	const char *profile_file = PrefsFindString("jitprofile");
+	if (profile_file && ppc_cpu->use_profiler())
+		ppc_cpu->dump_profile(profile_file);
+#endif
+
 	delete ppc_cpu;
 	ppc_cpu = NULL;
 }
@@ -984,6 +1052,14 @@ void HandleInterrupt(powerpc_registers *r)
 	SDL_PumpEvents();
 #endif
 
+#ifdef PROFILE_DUMP_SIGNAL
+	// Write the runtime profile requested by signal
+	if (profile_dump_requested) {
+		profile_dump_requested = 0;
+		ppc_cpu->dump_profile(PrefsFindString("jitprofile"));
+	}
+#endif
+
 	// Do nothing if interrupts are disabled
 	if (int32(ReadMacInt32(XLM_IRQ_NEST)) > 0)
 		return;
@@ -992,6 +1068,9 @@ void HandleInterrupt(powerpc_registers *r)
 #if EMUL_TIME_STATS
 	interrupt_count++;
 #endif
+#if PPC_ENABLE_JIT && PPC_RUNTIME_PROFILER
+	ppc_cpu->profile_event(powerpc_cpu::PROFILE_INTERRUPT);
+#endif
 
 	// Interrupt action depends on current run mode
 	switch (ReadMacInt32(XLM_RUN_MODE)) {
@@ -1072,6 +1151,7 @@ void sheepshaver_cpu::execute_native_op(uint32 selector)
 	native_exec_count++;
 	const clock_t native_exec_start = clock();
 #endif
+	enter_host_code();
 
 	switch (selector) {
 	case NATIVE_PATCH_NAME_REGISTRY:
@@ -1194,6 +1274,7 @@ void sheepshaver_cpu::execute_native_op(uint32 selector)
 		QuitEmulator();
 		break;
 	}
+	leave_host_code();
 
 #if EMUL_TIME_STATS
 	native_exec_time += (clock() - native_exec_start);
@@ -72,6 +72,9 @@ public:
 
 	void add_to_active_list(block_info *bi);
 	void add_to_dormant_list(block_info *bi);
+
+	template< class Visitor >
+	void for_each(Visitor & visitor);
 };
 
 template< class block_info, template<class T> class block_allocator >
@@ -274,4 +277,399 @@ inline void block_cache< block_info, block_allocator >::remove_from_lists(block_
 	remove_from_list(bi);
 }
 
+template< class block_info, template<class T> class block_allocator >
+template< class Visitor >
+void block_cache< block_info, block_allocator >::for_each(Visitor & visitor)
+{
+	for (entry *p = active; p; p = p->next)
+		visitor(p);
+	for (entry *p = dormant; p; p = p->next)
+		visitor(p);
+}
+
+
+/**
+ *		Page-indexed basic block cache
+ *
+ *		Guest pages are looked up through a two-level table, each page
+ *		holding a direct-mapped table of the blocks starting in it.
+ *		Lookups take constant time whatever the number of blocks, and
+ *		range invalidation only visits the affected pages plus the few
+ *		blocks that span several pages.
+ **/
+
+template< class block_info, template<class T> class block_allocator = slow_allocator >
+class page_block_cache
+{
+private:
+	static const uint32 PAGE_BITS = 12;
+	static const uint32 PAGE_SIZE = 1 << PAGE_BITS;
+	static const uint32 SLOT_BITS = PAGE_BITS - 2;
+	static const uint32 SLOT_COUNT = 1 << SLOT_BITS;
+	static const uint32 L2_BITS = 10;
+	static const uint32 L2_SIZE = 1 << L2_BITS;
+	static const uint32 L2_MASK = L2_SIZE - 1;
+	static const uint32 L1_BITS = 32 - L2_BITS - PAGE_BITS;
+	static const uint32 L1_SIZE = 1 << L1_BITS;
+
+	struct entry
+		: public block_info
+	{
+		entry *					next_same_page;
+		entry **				prev_same_page_p;
+		entry *					next_span;
+		entry **				prev_span_p;
+		entry *					next;
+		entry **				prev_p;
+		uint32					lo_pc;
+		uint32					hi_pc;
+	};
+
+	struct page_info {
+		entry *					slots[SLOT_COUNT];	// Blocks starting in this page, indexed by pc
+		entry *					blocks;				// List of blocks starting in this page
+	};
+
+	block_allocator<entry>		allocator;
+	page_info **				page_tables[L1_SIZE];
+	entry *						spanning;			// Blocks covering more than one page
+	entry *						active;
+	entry *						dormant;
+
+	static uint32 page_of(uint32 addr) {
+		return addr >> PAGE_BITS;
+	}
+
+	static uint32 slot_of(uint32 addr) {
+		return (addr & (PAGE_SIZE - 1)) >> 2;
+	}
+
+	page_info *find_page(uint32 page) const {
+		page_info **l2 = page_tables[page >> L2_BITS];
+		return l2 ? l2[page & L2_MASK] : NULL;
+	}
+
+	page_info *get_page(uint32 page);
+	void kill_pages();
+	void clear_page_range(page_info *pi, uintptr start, uintptr end);
+	void clear_block(entry *bce);
+
+public:
+
+	page_block_cache();
+	~page_block_cache();
+
+	block_info *new_blockinfo();
+	void delete_blockinfo(block_info *bi);
+
+	void initialize();
+	void clear();
+	void clear_range(uintptr start, uintptr end);
+	block_info *fast_find(uintptr pc);
+	block_info *find(uintptr pc);
+
+	void remove_from_cl_list(block_info *bi);
+	void remove_from_list(block_info *bi);
+	void remove_from_lists(block_info *bi);
+
+	void add_to_cl_list(block_info *bi);
+	void raise_in_cl_list(block_info *bi);
+
+	void add_to_active_list(block_info *bi);
+	void add_to_dormant_list(block_info *bi);
+
+	template< class Visitor >
+	void for_each(Visitor & visitor);
+};
+
+template< class block_info, template<class T> class block_allocator >
+page_block_cache< block_info, block_allocator >::page_block_cache()
+	: active(NULL), dormant(NULL)
+{
+	for (uint32 i = 0; i < L1_SIZE; i++)
+		page_tables[i] = NULL;
+	initialize();
+}
+
+template< class block_info, template<class T> class block_allocator >
+page_block_cache< block_info, block_allocator >::~page_block_cache()
+{
+	clear();
+	kill_pages();
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::kill_pages()
+{
+	for (uint32 i = 0; i < L1_SIZE; i++) {
+		page_info **l2 = page_tables[i];
+		if (l2 == NULL)
+			continue;
+		for (uint32 j = 0; j < L2_SIZE; j++)
+			delete l2[j];
+		delete[] l2;
+		page_tables[i] = NULL;
+	}
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::initialize()
+{
+	// Page tables are kept around, only reset their contents
+	for (uint32 i = 0; i < L1_SIZE; i++) {
+		page_info **l2 = page_tables[i];
+		if (l2 == NULL)
+			continue;
+		for (uint32 j = 0; j < L2_SIZE; j++) {
+			if (l2[j])
+				memset(l2[j], 0, sizeof(page_info));
+		}
+	}
+	spanning = NULL;
+}
+
+template< class block_info, template<class T> class block_allocator >
+typename page_block_cache< block_info, block_allocator >::page_info *
+page_block_cache< block_info, block_allocator >::get_page(uint32 page)
+{
+	page_info **l2 = page_tables[page >> L2_BITS];
+	if (l2 == NULL) {
+		l2 = new page_info *[L2_SIZE];
+		memset(l2, 0, L2_SIZE * sizeof(l2[0]));
+		page_tables[page >> L2_BITS] = l2;
+	}
+	page_info *pi = l2[page & L2_MASK];
+	if (pi == NULL) {
+		pi = new page_info;
+		memset(pi, 0, sizeof(*pi));
+		l2[page & L2_MASK] = pi;
+	}
+	return pi;
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::clear()
+{
+	entry *p;
+
+	p = active;
+	while (p) {
+		entry *d = p;
+		p = p->next;
+		delete_blockinfo(d);
+	}
+	active = NULL;
+
+	p = dormant;
+	while (p) {
+		entry *d = p;
+		p = p->next;
+		delete_blockinfo(d);
+	}
+	dormant = NULL;
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline void page_block_cache< block_info, block_allocator >::clear_block(entry *bce)
+{
+	bce->invalidate();
+	remove_from_cl_list(bce);
+	remove_from_list(bce);
+	delete_blockinfo(bce);
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::clear_page_range(page_info *pi, uintptr start, uintptr end)
+{
+	entry *p = pi->blocks;
+	while (p) {
+		entry *q = p;
+		p = p->next_same_page;
+		if (q->lo_pc < end && q->hi_pc >= start)
+			clear_block(q);
+	}
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::clear_range(uintptr start, uintptr end)
+{
+	if (start >= end)
+		return;
+
+	// Blocks starting in the range
+	const uint32 end_page = page_of(end - 1);
+	for (uint32 page = page_of(start); page <= end_page; page++) {
+		if (page_tables[page >> L2_BITS] == NULL) {
+			// Skip the whole second-level table
+			page |= L2_MASK;
+			continue;
+		}
+		page_info *pi = find_page(page);
+		if (pi && pi->blocks)
+			clear_page_range(pi, start, end);
+	}
+
+	// Blocks starting elsewhere but covering part of the range
+	entry *p = spanning;
+	while (p) {
+		entry *q = p;
+		p = p->next_span;
+		if (q->lo_pc < end && q->hi_pc >= start)
+			clear_block(q);
+	}
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline block_info *page_block_cache< block_info, block_allocator >::new_blockinfo()
+{
+	entry * bce = allocator.acquire();
+	return bce;
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline void page_block_cache< block_info, block_allocator >::delete_blockinfo(block_info *bi)
+{
+	entry * bce = (entry *)bi;
+	allocator.release(bce);
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline block_info *page_block_cache< block_info, block_allocator >::fast_find(uintptr pc)
+{
+	page_info *pi = find_page(page_of(pc));
+	if (pi) {
+		entry * bce = pi->slots[slot_of(pc)];
+		if (bce && bce->pc == pc)
+			return bce;
+	}
+	return NULL;
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline block_info *page_block_cache< block_info, block_allocator >::find(uintptr pc)
+{
+	return fast_find(pc);
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::remove_from_cl_list(block_info *bi)
+{
+	entry * bce = (entry *)bi;
+	page_info *pi = find_page(page_of(bi->pc));
+	if (pi && pi->slots[slot_of(bi->pc)] == bce)
+		pi->slots[slot_of(bi->pc)] = NULL;
+	if (bce->prev_same_page_p)
+		*bce->prev_same_page_p = bce->next_same_page;
+	if (bce->next_same_page)
+		bce->next_same_page->prev_same_page_p = bce->prev_same_page_p;
+	bce->prev_same_page_p = NULL;
+	bce->next_same_page = NULL;
+	if (bce->prev_span_p)
+		*bce->prev_span_p = bce->next_span;
+	if (bce->next_span)
+		bce->next_span->prev_span_p = bce->prev_span_p;
+	bce->prev_span_p = NULL;
+	bce->next_span = NULL;
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::add_to_cl_list(block_info *bi)
+{
+	entry * bce = (entry *)bi;
+	page_info *pi = get_page(page_of(bi->pc));
+	pi->slots[slot_of(bi->pc)] = bce;
+
+	if (pi->blocks)
+		pi->blocks->prev_same_page_p = &bce->next_same_page;
+	bce->next_same_page = pi->blocks;
+	pi->blocks = bce;
+	bce->prev_same_page_p = &pi->blocks;
+
+	// Record the guest code range covered by this block
+	uint32 lo = bi->pc, hi = bi->end_pc;
+	if (lo > hi)
+		lo = bi->end_pc, hi = bi->pc;
+	if (bi->min_pc < lo)
+		lo = bi->min_pc;
+	if (bi->max_pc < lo)
+		lo = bi->max_pc;
+	if (bi->min_pc > hi)
+		hi = bi->min_pc;
+	if (bi->max_pc > hi)
+		hi = bi->max_pc;
+	bce->lo_pc = lo;
+	bce->hi_pc = hi + 3;
+
+	if (page_of(lo) != page_of(bi->pc) || page_of(bce->hi_pc) != page_of(bi->pc)) {
+		if (spanning)
+			spanning->prev_span_p = &bce->next_span;
+		bce->next_span = spanning;
+		spanning = bce;
+		bce->prev_span_p = &spanning;
+	}
+	else {
+		bce->next_span = NULL;
+		bce->prev_span_p = NULL;
+	}
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline void page_block_cache< block_info, block_allocator >::raise_in_cl_list(block_info *bi)
+{
+	// Nothing to do, lookups are direct-mapped
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::remove_from_list(block_info *bi)
+{
+	entry * bce = (entry *)bi;
+	if (bce->prev_p)
+		*bce->prev_p = bce->next;
+	if (bce->next)
+		bce->next->prev_p = bce->prev_p;
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::add_to_active_list(block_info *bi)
+{
+	entry * bce = (entry *)bi;
+
+	if (active)
+		active->prev_p = &bce->next;
+	bce->next = active;
+
+	active = bce;
+	bce->prev_p = &active;
+}
+
+template< class block_info, template<class T> class block_allocator >
+void page_block_cache< block_info, block_allocator >::add_to_dormant_list(block_info *bi)
+{
+	entry * bce = (entry *)bi;
+
+	if (dormant)
+		dormant->prev_p = &bce->next;
+	bce->next = dormant;
+
+	dormant = bce;
+	bce->prev_p = &dormant;
+}
+
+template< class block_info, template<class T> class block_allocator >
+inline void page_block_cache< block_info, block_allocator >::remove_from_lists(block_info *bi)
+{
+	remove_from_cl_list(bi);
+	remove_from_list(bi);
+}
+
+template< class block_info, template<class T> class block_allocator >
+template< class Visitor >
+void page_block_cache< block_info, block_allocator >::for_each(Visitor & visitor)
+{
+	for (entry *p = active; p; p = p->next)
+		visitor(p);
+	for (entry *p = dormant; p; p = p->next)
+		visitor(p);
+}
+
 #endif /* BLOCK_CACHE_H */
@@ -70,6 +70,14 @@ public:
 		{ GEN_CODE(MOVQir(imm.value, d)); }
 	void gen_mov_64(x86_immediate_operand const & imm, x86_memory_operand const & mem)
 		{ GEN_CODE(MOVQim(imm.value, mem.MD, mem.MB, mem.MI, mem.MS)); }
+	void gen_movq_qx(int s, int d)
+		{ GEN_CODE(MOVQXDrr(s, d)); }
+	void gen_movq_qx(x86_memory_operand const & mem, int d)
+		{ GEN_CODE(MOVQXDmr(mem.MD, mem.MB, mem.MI, mem.MS, d)); }
+	void gen_movq_xq(int s, int d)
+		{ GEN_CODE(MOVQXSrr(s, d)); }
+	void gen_movq_xq(int s, x86_memory_operand const & mem)
+		{ GEN_CODE(MOVQXSrm(s, mem.MD, mem.MB, mem.MI, mem.MS)); }
 
 private:
 
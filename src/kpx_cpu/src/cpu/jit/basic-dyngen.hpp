@@ -107,6 +107,10 @@ public:
 	// Return from compiled code
 	void gen_exec_return();
 
+	// Address of the code returning from compiled code
+	uint8 *exec_return_address() const
+		{ return execute_func + op_exec_return_offset; }
+
 	// Function calls
 	void gen_jmp(const uint8 *target);
 	void gen_invoke(void (*func)(void));
@@ -34,9 +34,13 @@ const int JIT_CACHE_SIZE = 4 * 1024;
 const int JIT_CACHE_SIZE = 8 * 1024;
 #endif
 const int JIT_CACHE_SIZE_GUARD = 4096;
+const int JIT_CACHE_DATA_SIZE = 16 * 1024;
+const int JIT_CACHE_REGION_MIN_SIZE = 256 * 1024;
 
 basic_jit_cache::basic_jit_cache()
-	: cache_size(0), tcode_start(NULL), code_start(NULL), code_p(NULL), code_end(NULL), data(NULL)
+	: cache_size(0), cache_address(NULL), tcode_start(NULL), code_start(NULL), code_p(NULL), code_end(NULL), data(NULL),
+	  region_count(1), region(0), region_end(NULL),
+	  tdata_start(NULL), tdata_p(NULL), tdata_end(NULL)
 {
 }
 
@@ -61,13 +65,23 @@ basic_jit_cache::init_translation_cache(uint32 size)
 
 	// Round up translation cache size to 16 KB boundaries
 	const uint32 roundup = 16 * 1024;
-	cache_size = (size + JIT_CACHE_SIZE_GUARD + roundup - 1) & -roundup;
+	cache_size = (size + JIT_CACHE_SIZE_GUARD + JIT_CACHE_DATA_SIZE + roundup - 1) & -roundup;
 	assert(cache_size > 0);
 
-	tcode_start = (uint8 *)vm_acquire(cache_size, VM_MAP_PRIVATE | VM_MAP_32BIT);
-	if (tcode_start == VM_MAP_FAILED) {
-		tcode_start = NULL;
-		return false;
+	tcode_start = NULL;
+	if (cache_address) {
+		// Requested address, don't take it over from another mapping
+		if (vm_acquire_fixed(cache_address, cache_size, VM_MAP_PRIVATE | VM_MAP_NOREPLACE) == 0)
+			tcode_start = cache_address;
+		else
+			fprintf(stderr, "WARNING: address %p is in use, translation cache mapped elsewhere\n", cache_address);
+	}
+	if (tcode_start == NULL) {
+		tcode_start = (uint8 *)vm_acquire(cache_size, VM_MAP_PRIVATE | VM_MAP_32BIT);
+		if (tcode_start == VM_MAP_FAILED) {
+			tcode_start = NULL;
+			return false;
+		}
 	}
 
 	if (vm_protect(tcode_start, cache_size,
@@ -82,6 +96,15 @@ basic_jit_cache::init_translation_cache(uint32 size)
 	code_start = tcode_start;
 	code_p = code_start;
 	code_end = code_p + size;
+	tdata_start = tdata_p = code_end + JIT_CACHE_SIZE_GUARD;
+	tdata_end = tcode_start + cache_size;
+
+	region_count = size / JIT_CACHE_REGION_MIN_SIZE;
+	if (region_count > MAX_REGIONS)
+		region_count = MAX_REGIONS;
+	else if (region_count < 1)
+		region_count = 1;
+	set_region(code_p);
 	return true;
 }
 
@@ -93,6 +116,7 @@ basic_jit_cache::kill_translation_cache()
 		vm_release(tcode_start, cache_size);
 		cache_size = 0;
 		tcode_start = NULL;
+		tdata_start = tdata_p = tdata_end = NULL;
 	}
 }
 
@@ -118,6 +142,15 @@ basic_jit_cache::copy_data(const uint8 *block, uint32 size)
 	const int ALIGN = 16;
 	uint8 *ptr;
 
+	// Use the in-cache data pool first
+	if (tdata_p && (tdata_p + size) <= tdata_end) {
+		ptr = tdata_p;
+		memcpy(ptr, block, size);
+		tdata_p += (size + ALIGN - 1) & -ALIGN;
+		D(bug("basic_jit_cache: DATA %p, %d bytes [in-cache]\n", ptr, size));
+		return ptr;
+	}
+
 	if (data && (data->offs + size) < data->size)
 		ptr = (uint8 *)data + data->offs;
 	else {
@@ -147,3 +180,42 @@ basic_jit_cache::copy_data(const uint8 *block, uint32 size)
 	D(bug("basic_jit_cache: DATA %p, %d bytes [data=%p, offs=%u]\n", ptr, size, data, data->offs));
 	return ptr;
 }
+
+bool
+basic_jit_cache::restore_image(uint8 *code_end_p, uint8 *data_end_p)
+{
+	// The image contents were copied in place by the caller, just
+	// make sure the current allocations are not overwriting them
+	if (code_end_p < code_p || code_end_p > code_end + JIT_CACHE_SIZE_GUARD)
+		return false;
+	if (data_end_p < tdata_p || data_end_p > tdata_end)
+		return false;
+
+	code_p = code_end_p;
+	tdata_p = data_end_p;
+	set_region(code_p);
+	return true;
+}
+
+void
+basic_jit_cache::set_region(uint8 *ptr)
+{
+	region = 0;
+	while (region < region_count - 1 && ptr >= region_limit(region))
+		region++;
+	region_end = region_limit(region);
+}
+
+void
+basic_jit_cache::next_region(uint8 * & start, uint8 * & end)
+{
+	// The previous region may overflow into this one, by no more than
+	// the guard size, so start right after its code
+	region = (region + 1) % region_count;
+	if (region == 0)
+		code_p = code_start;
+	region_end = region_limit(region);
+	start = code_p;
+	end = region_end + JIT_CACHE_SIZE_GUARD;
+	D(bug("basic_jit_cache: Recycle region %d [%p - %p]\n", region, start, end));
+}
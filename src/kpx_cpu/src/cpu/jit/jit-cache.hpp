@@ -32,6 +32,7 @@ class basic_jit_cache
 {
 	// Translation cache (allocated base, current pointer, end pointer)
 	uint32 cache_size;
+	uint8 *cache_address;
 	uint8 *tcode_start;
 	uint8 *code_start;
 	uint8 *code_p;
@@ -45,6 +46,22 @@ class basic_jit_cache
 	};
 	data_chunk_t *data;
 
+	// Translation cache regions, recycled round-robin once the cache is
+	// full. Only blocks from the region being reused are flushed
+	static const int MAX_REGIONS = 8;
+	int region_count;
+	int region;
+	uint8 *region_end;
+	uint8 *region_limit(int n) const
+		{ return code_start + (uintptr)(code_end - code_start) * (n + 1) / region_count; }
+	void set_region(uint8 *ptr);
+
+	// In-cache data pool, placed right after the translation cache guard
+	// area so that a saved cache image also covers constants
+	uint8 *tdata_start;
+	uint8 *tdata_p;
+	uint8 *tdata_end;
+
 protected:
 
 	// Initialize translation cache
@@ -68,11 +85,15 @@ public:
 
 	bool initialize(void);
 	void set_cache_size(uint32 size);
+	void set_cache_address(uint8 *addr)	{ cache_address = addr; }
 
 	// Invalidate translation cache
 	void invalidate_cache();
 	bool full_translation_cache() const
-		{ return code_p >= code_end; }
+		{ return code_p >= region_end; }
+
+	// Move on to the next region, returns the range of code to flush
+	void next_region(uint8 * & start, uint8 * & end);
 
 	// Emit code to translation cache
 	template< typename T >
@@ -87,6 +108,15 @@ public:
 
 	// Emit data to constant pool
 	uint8 *copy_data(const uint8 *block, uint32 size);
+
+	// Translation cache image, for persistent translation cache support
+	uint8 *cache_base() const		{ return tcode_start; }
+	uint32 get_cache_size() const	{ return cache_size; }
+	uint8 *code_start_ptr() const	{ return code_start; }
+	uint8 *data_start_ptr() const	{ return tdata_start; }
+	uint8 *data_ptr() const			{ return tdata_p; }
+	bool has_external_data() const	{ return data != NULL; }
+	bool restore_image(uint8 *code_end_p, uint8 *data_end_p);
 };
 
 inline void
@@ -94,12 +124,14 @@ basic_jit_cache::set_code_start(uint8 *ptr)
 {
 	assert(ptr >= tcode_start && ptr < code_end);
 	code_start = ptr;
+	set_region(code_p);
 }
 
 inline void
 basic_jit_cache::invalidate_cache()
 {
 	code_p = code_start;
+	set_region(code_p);
 }
 
 template< class T >
@@ -2049,8 +2049,28 @@ enum {
   X86_SSE_PUNPCKLWD	= 0x61,
   X86_SSE_PXOR		= 0xef,
   X86_SSSE3_PSHUFB	= 0x00,
+  X86_SSE41_PACKUSDW	= 0x2b,
+  X86_SSE41_PMAXSB	= 0x3c,
+  X86_SSE41_PMAXSD	= 0x3d,
+  X86_SSE41_PMAXUD	= 0x3f,
+  X86_SSE41_PMAXUW	= 0x3e,
+  X86_SSE41_PMINSB	= 0x38,
+  X86_SSE41_PMINSD	= 0x39,
+  X86_SSE41_PMINUD	= 0x3b,
+  X86_SSE41_PMINUW	= 0x3a,
+  X86_SSE41_ROUNDPS	= 0x08, // 3A
+  X86_AVX2_PSRLVD	= 0x45,
+  X86_AVX2_PSRAVD	= 0x46,
+  X86_AVX2_PSLLVD	= 0x47,
 };
 
+/* VEX prefixed instructions, 3-byte form, register operands only:
+   RD <- RV op RS, with MM the opcode map (1: 0F, 2: 0F38, 3: 0F3A)
+   and PP the implied prefix (1: 66, 2: F3, 3: F2) */
+#define _VEXLrrr(MM,PP,W,L,OP,RS,RV,RD)	(_B(0xc4), _B(((!_rXP(RD))<<7)|(1<<6)|((!_rXP(RS))<<5)|(MM)), \
+					 _B(((W)<<7)|((~_rR(RV)&0x0f)<<3)|((L)<<2)|(PP)), \
+					 _O_Mrm		(OP		,_b11,_rX(RD),_rX(RS)				))
+
 /*									_format		Opcd		,Mod ,r	     ,m		,mem=dsp+sib	,imm... */
 
 #define _SSSE3Lrr(OP1,OP2,RS,RSA,RD,RDA)	(_B(0x66), _REXLrr(RD,RD),	_B(0x0f), _OO_Mrm	(((OP1)<<8)|(OP2)	,_b11,RDA(RD),RSA(RS)				))
@@ -511,6 +511,16 @@ public:
 #undef DEFINE_OP_PS
 #undef DEFINE_OP_PD
 
+	// CVTTPS2DQ shares the F3 prefix with scalar ops
+	void gen_cvtdq2ps(x86_memory_operand const & mem, int d)
+		{ gen_sse_arith_ps(X86_SSE_CVTDQ2PS, mem, d); }
+	void gen_cvtdq2ps(int s, int d)
+		{ gen_sse_arith_ps(X86_SSE_CVTDQ2PS, s, d); }
+	void gen_cvttps2dq(x86_memory_operand const & mem, int d)
+		{ gen_sse_arith_ss(X86_SSE_CVTTPS2DQ, mem, d); }
+	void gen_cvttps2dq(int s, int d)
+		{ gen_sse_arith_ss(X86_SSE_CVTTPS2DQ, s, d); }
+
 public:
 
 #define DEFINE_OP(NAME, OP)											\
@@ -537,6 +547,8 @@ public:
 		{ GEN_CODE(OP##mr(mem.MD, mem.MB, mem.MI, mem.MS, d)); }
 
 	DEFINE_OP(movd_lx, MOVDXD);
+	DEFINE_OP(cvtsd2ss, CVTSD2SS);
+	DEFINE_OP(cvtss2sd, CVTSS2SD);
 
 #undef DEFINE_OP
 
@@ -676,6 +688,25 @@ private:
 	void gen_ssse3_arith(int op1, int op2, x86_immediate_operand const & imm, x86_memory_operand const & mem, int d)
 		{ GEN_CODE(_SSSE3Limr(op1, op2, imm.value, mem.MD, mem.MB, mem.MI, mem.MS, d)); }
 
+public:
+
+	// SSE4.1 round packed single, imm bits 0-1 select the mode
+	void gen_roundps(x86_immediate_operand const & imm, int s, int d)
+		{ gen_ssse3_arith(0x3a, X86_SSE41_ROUNDPS, imm, s, d); }
+	void gen_roundps(x86_immediate_operand const & imm, x86_memory_operand const & mem, int d)
+		{ gen_ssse3_arith(0x3a, X86_SSE41_ROUNDPS, imm, mem, d); }
+
+#define DEFINE_OP(NAME, OP)									\
+	void gen_##NAME(int c, int s, int d)					\
+		{ GEN_CODE(_VEXLrrr(0x02, 0x01, 0, 0, OP, c, s, d)); }
+
+	// AVX2 per-element shifts, d = s shifted by the counts in c
+	DEFINE_OP(vpsllvd, X86_AVX2_PSLLVD);
+	DEFINE_OP(vpsrlvd, X86_AVX2_PSRLVD);
+	DEFINE_OP(vpsravd, X86_AVX2_PSRAVD);
+
+#undef DEFINE_OP
+
 };
 
 enum {
@@ -36,6 +36,13 @@ struct powerpc_block_info
 	{
 		execute_fn		execute;
 		uint32			opcode;
+#if PPC_THREADED_INTERPRETER
+		const void *	handler;						// Threaded code handler
+		uint32			pc;								// Address of the instruction
+		uint32			imm;							// Immediate, mask or branch target
+		uint8			rD, rA, rB;						// Predecoded register operands
+		uint8			aux;							// CR field or BO
+#endif
 	};
 
 #if PPC_DECODE_CACHE
@@ -43,15 +50,30 @@ struct powerpc_block_info
 #endif
 #if PPC_ENABLE_JIT
 	uint8 *				entry_point;
+	uint32				ic_pc;							// Indirect branch target cache
+	uint32				ic_epoch;
+	uint8 *				ic_entry;
+	uint32				ret_pc;							// Return target cache, for blocks ending with a call
+	uint32				ret_epoch;
+	uint8 *				ret_entry;
 #if DYNGEN_DIRECT_BLOCK_CHAINING
 	struct link_info {
 		uint8 *			jmp_resolve_addr;				// Address of default code to resolve target addr
 		uint8 *			jmp_addr;						// Address of target native branch offset to patch
 		uint32			jmp_pc;							// Target jump addresses in emulated address space
+		uint8 *			jmp_target;						// Native address the jump is currently patched to
 	};
 	static const uint32	INVALID_PC = 0xffffffff;		// An invalid PC address to mark jmp_pc[] as stale
 	link_info			li[MAX_TARGETS];
 #endif
+#if PPC_PERSISTENT_JIT_CACHE
+	static const uint32	INVALID_REF = 0;				// No reference to this block_info in the generated code
+	static const uint32	BROKEN_REF = 0xffffffff;		// Reference not found, the block cannot be saved
+	static const int	SELF_REF_CALL = MAX_TARGETS;	// Return stack push
+	static const int	SELF_REF_COUNTER = MAX_TARGETS + 1;	// Execution counter, in the prologue
+	static const int	MAX_SELF_REFS = MAX_TARGETS + 2;
+	uint32				self_refs[MAX_SELF_REFS];		// Offsets to block_info addresses, from entry_point
+#endif
 #endif
 	uintptr				min_pc, max_pc;
 
@@ -68,9 +90,16 @@ powerpc_block_info::init(uintptr start_pc)
 	di = NULL;
 #endif
 #if PPC_ENABLE_JIT
+	ic_epoch = ret_epoch = 0;
 #if DYNGEN_DIRECT_BLOCK_CHAINING
-	for (int i = 0; i < MAX_TARGETS; i++)
+	for (int i = 0; i < MAX_TARGETS; i++) {
 		li[i].jmp_pc = INVALID_PC;
+		li[i].jmp_target = NULL;
+	}
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+	for (int i = 0; i < MAX_SELF_REFS; i++)
+		self_refs[i] = INVALID_REF;
 #endif
 #endif
 }
@@ -62,6 +62,39 @@
 #endif
 
 
+/**
+ *	PPC_THREADED_INTERPRETER
+ *
+ *		Define to execute predecoded blocks as threaded code. Common
+ *		instructions get a handler with their operands extracted at
+ *		decode time, and frequent pairs like cmpwi+bc are fused into
+ *		a single handler. Handlers are chained with computed gotos,
+ *		so this requires the GNU C labels as values extension.
+ **/
+
+#ifndef PPC_THREADED_INTERPRETER
+#if PPC_DECODE_CACHE && defined(__GNUC__)
+#define PPC_THREADED_INTERPRETER 1
+#else
+#define PPC_THREADED_INTERPRETER 0
+#endif
+#endif
+
+
+/**
+ *	PPC_PAGE_BLOCK_CACHE
+ *
+ *		Define to 1 to look up blocks through page-indexed tables
+ *		instead of a hash table with collision chains. This keeps
+ *		lookups constant-time with large code footprints and limits
+ *		range invalidation to the affected pages.
+ **/
+
+#ifndef PPC_PAGE_BLOCK_CACHE
+#define PPC_PAGE_BLOCK_CACHE 1
+#endif
+
+
 /**
  *	PPC_ENABLE_JIT
  *
@@ -74,6 +107,104 @@
 #endif
 
 
+/**
+ *	PPC_ENABLE_NATIVE_JIT
+ *
+ *		Define to 1 to build the native x86-64 code generator. It
+ *		emits integer instructions directly, as well as scalar SSE2
+ *		floating-point arithmetic unless PPC_ENABLE_FPU_EXCEPTIONS is
+ *		set, and keeps PowerPC GPRs and FPRs in host registers within
+ *		a block. Instructions it does not handle still go through
+ *		dyngen. The generator is selected at runtime with
+ *		powerpc_cpu::enable_native_jit().
+ **/
+
+#ifndef PPC_ENABLE_NATIVE_JIT
+#if PPC_ENABLE_JIT && defined(__x86_64__)
+#define PPC_ENABLE_NATIVE_JIT 1
+#else
+#define PPC_ENABLE_NATIVE_JIT 0
+#endif
+#endif
+
+
+/**
+ *	PPC_PERSISTENT_JIT_CACHE
+ *
+ *		Define to 1 to support saving translated blocks to a file and
+ *		reusing them on the next run. Generated code contains absolute
+ *		host addresses and calls into the executable, which are not
+ *		relocated. A saved cache is only accepted by the same executable,
+ *		linked as position dependent code, with the translation cache
+ *		mapped at PPC_PERSISTENT_JIT_CACHE_ADDRESS. Each block is checked
+ *		against the current guest code before it is reused.
+ **/
+
+#ifndef PPC_PERSISTENT_JIT_CACHE
+#define PPC_PERSISTENT_JIT_CACHE PPC_ENABLE_JIT
+#endif
+
+// Past the MacOS data areas and within 2 GB of the executable
+#ifndef PPC_PERSISTENT_JIT_CACHE_ADDRESS
+#define PPC_PERSISTENT_JIT_CACHE_ADDRESS 0x70000000
+#endif
+
+
+/**
+ *	PPC_TRACE_JIT
+ *
+ *		Define to 1 to retranslate frequently executed blocks into
+ *		traces. New blocks count their executions and, once hot, are
+ *		translated again following unconditional branches and the
+ *		statically predicted side of conditional branches. The other
+ *		side of each followed branch becomes a side exit.
+ **/
+
+#ifndef PPC_TRACE_JIT
+#define PPC_TRACE_JIT PPC_ENABLE_JIT
+#endif
+
+
+/**
+ *	PPC_ASYNC_JIT
+ *
+ *		Define to 1 to support translating blocks in a worker thread.
+ *		Blocks that are not translated yet are run from the decode
+ *		cache meanwhile, so that the emulation thread never waits for
+ *		the compiler. This is enabled at runtime with
+ *		powerpc_cpu::enable_async_jit().
+ **/
+
+#ifndef PPC_ASYNC_JIT
+#if PPC_ENABLE_JIT && PPC_DECODE_CACHE && defined(HAVE_PTHREADS)
+#define PPC_ASYNC_JIT 1
+#else
+#define PPC_ASYNC_JIT 0
+#endif
+#endif
+
+
+/**
+ *	PPC_PERF_JIT_MAP
+ *
+ *		Define to 1 to support describing translated blocks to the
+ *		Linux perf profiler, either through /tmp/perf-<pid>.map or a
+ *		jitdump file that perf inject merges into a recorded profile.
+ *		Blocks are named after their guest address, and after the
+ *		function found in the traceback table that follows PowerPC
+ *		code, if any. This is enabled at runtime with
+ *		powerpc_cpu::enable_perf_map().
+ **/
+
+#ifndef PPC_PERF_JIT_MAP
+#if PPC_ENABLE_JIT && defined(__linux__)
+#define PPC_PERF_JIT_MAP 1
+#else
+#define PPC_PERF_JIT_MAP 0
+#endif
+#endif
+
+
 /**
  *	PPC_REENTRANT_JIT
  *
@@ -137,6 +268,21 @@
 #endif
 
 
+/**
+ *	PPC_RUNTIME_PROFILER
+ *
+ *		Define to 1 to support counting block executions, calls to
+ *		generic instruction handlers, returns to the block dispatcher
+ *		and indirect branch cache misses while the emulator runs. This
+ *		is toggled at runtime with powerpc_cpu::enable_profiler() and
+ *		written out with powerpc_cpu::dump_profile().
+ **/
+
+#ifndef PPC_RUNTIME_PROFILER
+#define PPC_RUNTIME_PROFILER PPC_ENABLE_JIT
+#endif
+
+
 /**
  *	PPC_PROFILE_REGS_USE
  *
@@ -24,6 +24,7 @@
 #include "vm_alloc.h"
 #include "cpu/vm.hpp"
 #include "cpu/ppc/ppc-cpu.hpp"
+#include "cpu/ppc/ppc-operands.hpp"
 #ifndef SHEEPSHAVER
 #include "basic-kernel.hpp"
 #endif
@@ -123,6 +124,9 @@ uint32 powerpc_registers::reserve_data = 0;
 void powerpc_cpu::init_registers()
 {
 	assert((((uintptr)&vr(0)) % 16) == 0);
+	// The register file is realigned within _regs, so its constructor
+	// did not run at this address
+	spcflags().init(0);
 	for (int i = 0; i < 32; i++) {
 		gpr(i) = 0;
 		fpr(i) = 0;
@@ -272,6 +276,12 @@ void powerpc_cpu::initialize()
 	// Init cache range invalidate recorder
 	cache_range.start = cache_range.end = 0;
 
+#if PPC_ENABLE_JIT
+	// Init indirect branch caches
+	block_epoch = 0;
+	invalidate_branch_caches();
+#endif
+
 	// Init syscalls handler
 	execute_do_syscall = NULL;
 
@@ -298,6 +308,7 @@ void powerpc_cpu::initialize()
 #if PPC_PROFILE_COMPILE_TIME
 	compile_count = 0;
 	compile_time = 0;
+	compile_size = 0;
 	emul_start_time = clock();
 #endif
 }
@@ -312,6 +323,85 @@ void powerpc_cpu::enable_jit(uint32 cache_size)
 }
 #endif
 
+#if PPC_ASYNC_JIT
+bool powerpc_cpu::enable_async_jit(bool enable)
+{
+	if (enable == use_async_jit)
+		return true;
+
+	if (!enable) {
+		pthread_mutex_lock(&async_jit_queue_lock);
+		async_jit_quit = true;
+		pthread_cond_signal(&async_jit_queue_cond);
+		pthread_mutex_unlock(&async_jit_queue_lock);
+		pthread_join(async_jit_thread, NULL);
+		use_async_jit = false;
+		return true;
+	}
+
+	if (!use_jit)
+		return false;
+	async_jit_quit = false;
+	async_jit_pending = 0;
+	async_jit_queue.clear();
+	for (int i = 0; i < ASYNC_JIT_QUEUED_SIZE; i++)
+		async_jit_queued[i] = ASYNC_JIT_NO_ENTRY;
+	if (pthread_create(&async_jit_thread, NULL, async_jit_thread_func, this) != 0) {
+		fprintf(stderr, "WARNING: Could not start the JIT compiler thread\n");
+		return false;
+	}
+	use_async_jit = true;
+	return true;
+}
+
+void *powerpc_cpu::async_jit_thread_func(void *arg)
+{
+	powerpc_cpu *cpu = (powerpc_cpu *)arg;
+	for (;;) {
+		pthread_mutex_lock(&cpu->async_jit_queue_lock);
+		while (cpu->async_jit_queue.empty() && !cpu->async_jit_quit)
+			pthread_cond_wait(&cpu->async_jit_queue_cond, &cpu->async_jit_queue_lock);
+		if (cpu->async_jit_quit) {
+			pthread_mutex_unlock(&cpu->async_jit_queue_lock);
+			break;
+		}
+		const uint32 entry = cpu->async_jit_queue.front();
+		cpu->async_jit_queue.pop_front();
+		pthread_mutex_unlock(&cpu->async_jit_queue_lock);
+
+		// The block may have been queued again, or translated
+		// through another entry point meanwhile
+		pthread_mutex_lock(&cpu->jit_state_lock);
+		if (cpu->my_block_cache.find(entry) == NULL)
+			cpu->compile_block(entry);
+		pthread_mutex_unlock(&cpu->jit_state_lock);
+
+		pthread_mutex_lock(&cpu->async_jit_queue_lock);
+		uint32 & queued = cpu->async_jit_queued[(entry >> 2) % ASYNC_JIT_QUEUED_SIZE];
+		if (queued == entry)
+			queued = ASYNC_JIT_NO_ENTRY;
+		cpu->async_jit_pending--;
+		pthread_mutex_unlock(&cpu->async_jit_queue_lock);
+	}
+	return NULL;
+}
+
+void powerpc_cpu::queue_translation(uint32 entry)
+{
+	// Entry points already waiting for the worker are remembered in a
+	// direct-mapped table, other duplicates are dropped by the worker
+	pthread_mutex_lock(&async_jit_queue_lock);
+	uint32 & queued = async_jit_queued[(entry >> 2) % ASYNC_JIT_QUEUED_SIZE];
+	if (queued != entry) {
+		queued = entry;
+		async_jit_queue.push_back(entry);
+		async_jit_pending++;
+		pthread_cond_signal(&async_jit_queue_cond);
+	}
+	pthread_mutex_unlock(&async_jit_queue_lock);
+}
+#endif
+
 // Memory allocator returning powerpc_cpu objects aligned on 16-byte boundaries
 // FORMAT: [ alignment ] magic identifier, offset to malloc'ed data, powerpc_cpu data
 void *powerpc_cpu::operator new(size_t size)
@@ -365,6 +455,29 @@ powerpc_cpu::powerpc_cpu(task_struct *parent_task)
 {
 #if PPC_ENABLE_JIT
 	use_jit = false;
+#endif
+#if PPC_ASYNC_JIT
+	// The emulation thread locks the translation cache again when
+	// translated code invalidates it
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&jit_state_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_init(&async_jit_queue_lock, NULL);
+	pthread_cond_init(&async_jit_queue_cond, NULL);
+	use_async_jit = false;
+#endif
+#if PPC_PERF_JIT_MAP
+	perf_map_file = NULL;
+	perf_dump_fd = -1;
+	perf_dump_marker = NULL;
+	perf_dump_index = 0;
+	perf_name_start = perf_name_end = 0;
+#endif
+#if PPC_RUNTIME_PROFILER
+	profiling = false;
+	reset_profile();
 #endif
 	++ppc_refcount;
 	initialize();
@@ -373,6 +486,15 @@ powerpc_cpu::powerpc_cpu(task_struct *parent_task)
 powerpc_cpu::~powerpc_cpu()
 {
 	--ppc_refcount;
+#if PPC_ASYNC_JIT
+	enable_async_jit(false);
+	pthread_cond_destroy(&async_jit_queue_cond);
+	pthread_mutex_destroy(&async_jit_queue_lock);
+	pthread_mutex_destroy(&jit_state_lock);
+#endif
+#if PPC_PERF_JIT_MAP
+	disable_perf_map();
+#endif
 #if PPC_PROFILE_COMPILE_TIME
 	clock_t emul_end_time = clock();
 
@@ -513,7 +635,9 @@ bool powerpc_cpu::check_spcflags()
 			processing_interrupt = true;
 			powerpc_registers r;
 			powerpc_registers::interrupt_copy(r, regs());
+			enter_host_code();
 			HandleInterrupt(&r);
+			leave_host_code();
 			powerpc_registers::interrupt_copy(regs(), r);
 			processing_interrupt = false;
 		}
@@ -551,12 +675,29 @@ void *powerpc_cpu::compile_chain_block(block_info *sbi)
 	const uint32 bpc = sbi->pc;
 
 	const uint32 tpc = sbi->li[n].jmp_pc;
+	const uint32 epoch = block_epoch;
+#if PPC_RUNTIME_PROFILER
+	profile_event(PROFILE_CHAIN);
+#endif
 	block_info *tbi = my_block_cache.find(tpc);
+#if PPC_ASYNC_JIT
+	if (tbi == NULL && use_async_jit) {
+		// Return to the dispatcher, the target block is interpreted
+		// until the worker translated it
+		queue_translation(tpc);
+		pc() = tpc;
+		return codegen.exec_return_address();
+	}
+#endif
 	if (tbi == NULL)
 		tbi = compile_block(tpc);
 	assert(tbi && tbi->pc == tpc);
 
-	dg_set_jmp_target(sbi->li[n].jmp_addr, tbi->entry_point);
+	// The source block may have been flushed while translating
+	if (block_epoch == epoch) {
+		dg_set_jmp_target(sbi->li[n].jmp_addr, tbi->entry_point);
+		sbi->li[n].jmp_target = tbi->entry_point;
+	}
 	return tbi->entry_point;
 }
 #endif
@@ -570,8 +711,56 @@ void powerpc_cpu::execute(uint32 entry)
 	const bool dump_state = true;
 #endif
 	execute_depth++;
+	leave_host_code();
 #if PPC_DECODE_CACHE || PPC_ENABLE_JIT
 	if (execute_depth == 1 || (PPC_ENABLE_JIT && (PPC_REENTRANT_JIT == 1))) {
+#if PPC_ASYNC_JIT
+		if (use_jit && use_async_jit) {
+			for (;;) {
+				// Run translated blocks as long as there are any, without
+				// waiting for the worker to release the translation cache
+				block_info *bi = NULL;
+				if (pthread_mutex_trylock(&jit_state_lock) == 0) {
+					while ((bi = my_block_cache.find(pc())) != NULL) {
+#if PPC_TRACE_JIT
+						if (bi->count < 0)
+							bi = compile_trace(bi);
+#endif
+						codegen.execute(bi->entry_point);
+#if PPC_RUNTIME_PROFILER
+						profile_event(PROFILE_DISPATCH);
+#endif
+						if (!spcflags().empty())
+							break;
+					}
+					if (bi == NULL)
+						queue_translation(pc());
+					pthread_mutex_unlock(&jit_state_lock);
+				}
+
+				// Meanwhile, run predecoded blocks until the pending
+				// translations are done
+				if (bi == NULL) {
+					for (;;) {
+						if ((bi = interp_block_cache.find(pc())) == NULL)
+							bi = predecode_block(interp_block_cache, pc());
+						execute_predecoded(bi);
+						if (!spcflags().empty() || async_jit_pending == 0)
+							break;
+					}
+				}
+
+				if (!spcflags().empty()) {
+					if (!check_spcflags())
+						goto return_site;
+					if (spcflags().test(SPCFLAG_JIT_EXEC_RETURN)) {
+						spcflags().clear(SPCFLAG_JIT_EXEC_RETURN);
+						invalidated_cache = true;
+					}
+				}
+			}
+		}
+#endif
 #if PPC_ENABLE_JIT
 		if (use_jit) {
 			block_info *bi = my_block_cache.find(pc());
@@ -581,6 +770,9 @@ void powerpc_cpu::execute(uint32 entry)
 				// Execute all cached blocks
 				for (;;) {
 					codegen.execute(bi->entry_point);
+#if PPC_RUNTIME_PROFILER
+					profile_event(PROFILE_DISPATCH);
+#endif
 
 					if (!spcflags().empty()) {
 						if (!check_spcflags())
@@ -599,6 +791,11 @@ void powerpc_cpu::execute(uint32 entry)
 					// get here if the fast cache lookup failed too.
 					if ((bi = my_block_cache.find(pc())) == NULL)
 						break;
+#if PPC_TRACE_JIT
+					// The block counter expired, retranslate it as a trace
+					if (bi->count < 0)
+						bi = compile_trace(bi);
+#endif
 				}
 
 				// Compile new block
@@ -608,87 +805,16 @@ void powerpc_cpu::execute(uint32 entry)
 		}
 #endif
 #if PPC_DECODE_CACHE
+		if (!use_decode_cache)
+			goto do_interpret;
 		for (;;) {
 			block_info *bi = my_block_cache.find(pc());
-			if (bi != NULL)
-				goto pdi_execute;
-
-#if PPC_PROFILE_COMPILE_TIME
-			compile_count++;
-			clock_t start_time;
-			start_time = clock();
-#endif
-			bi = my_block_cache.new_blockinfo();
-			bi->init(pc());
-
-			// Predecode a new block
-			block_info::decode_info *di;
-			const instr_info_t *ii;
-			uint32 dpc;
-			di = bi->di = decode_cache_p;
-			dpc = pc() - 4;
-			do {
-				uint32 opcode = vm_read_memory_4(dpc += 4);
-				ii = decode(opcode);
-#if PPC_EXECUTE_DUMP_STATE
-				if (dump_state) {
-					di->opcode = opcode;
-					di->execute = nv_mem_fun(&powerpc_cpu::dump_instruction);
-					di++;
-				}
-#endif
-#if PPC_FLIGHT_RECORDER
-				if (is_logging()) {
-					di->opcode = opcode;
-					di->execute = nv_mem_fun(&powerpc_cpu::record_step);
-					di++;
-				}
-#endif
-				di->opcode = opcode;
-				di->execute = ii->execute;
-				di++;
-#if PPC_EXECUTE_DUMP_STATE
-				if (dump_state) {
-					di->opcode = 0;
-					di->execute = nv_mem_fun(&powerpc_cpu::fake_dump_registers);
-					di++;
-				}
-#endif
-				if (di >= decode_cache_end_p) {
-					// Invalidate cache and move current code to start
-					invalidate_cache();
-					const int blocklen = di - bi->di;
-					memmove(decode_cache_p, bi->di, blocklen * sizeof(*di));
-					bi->di = decode_cache_p;
-					di = bi->di + blocklen;
-				}
-			} while ((ii->cflow & CFLOW_END_BLOCK) == 0);
-			bi->end_pc = dpc;
-			bi->min_pc = dpc;
-			bi->max_pc = entry;
-			bi->size = di - bi->di;
-			my_block_cache.add_to_cl_list(bi);
-			my_block_cache.add_to_active_list(bi);
-			decode_cache_p += bi->size;
-#if PPC_PROFILE_COMPILE_TIME
-			compile_time += (clock() - start_time);
-#endif
+			if (bi == NULL)
+				bi = predecode_block(my_block_cache, pc());
 
 			// Execute all cached blocks
-			pdi_execute:
 			for (;;) {
-				const int r = bi->size % 4;
-				di = bi->di + r;
-				int n = (bi->size + 3) / 4;
-				switch (r) {
-				case 0: do {
-						di += 4;
-						di[-4].execute(this, di[-4].opcode);
-				case 3: di[-3].execute(this, di[-3].opcode);
-				case 2: di[-2].execute(this, di[-2].opcode);
-				case 1: di[-1].execute(this, di[-1].opcode);
-					} while (--n > 0);
-				}
+				execute_predecoded(bi);
 
 				if (!spcflags().empty()) {
 					if (!check_spcflags())
@@ -736,6 +862,7 @@ void powerpc_cpu::execute(uint32 entry)
 	// Tell upper level we invalidated cache?
 	if (invalidated_cache)
 		spcflags().set(SPCFLAG_JIT_EXEC_RETURN);
+	enter_host_code();
 	--execute_depth;
 }
 
@@ -744,6 +871,123 @@ void powerpc_cpu::execute()
 	execute(pc());
 }
 
+#if PPC_DECODE_CACHE
+powerpc_cpu::block_info *powerpc_cpu::predecode_block(block_cache_t & cache, uint32 entry)
+{
+#if PPC_EXECUTE_DUMP_STATE
+	const bool dump_state = true;
+#endif
+#if PPC_PROFILE_COMPILE_TIME
+	clock_t start_time = clock();
+#endif
+	block_info *bi = cache.new_blockinfo();
+	bi->init(entry);
+
+	// Predecode a new block
+	block_info::decode_info *di;
+	const instr_info_t *ii;
+	uint32 dpc;
+	di = bi->di = decode_cache_p;
+	dpc = entry - 4;
+	do {
+		uint32 opcode = vm_read_memory_4(dpc += 4);
+		ii = decode(opcode);
+#if PPC_EXECUTE_DUMP_STATE
+		if (dump_state) {
+			di->opcode = opcode;
+			di->execute = nv_mem_fun(&powerpc_cpu::dump_instruction);
+			di++;
+		}
+#endif
+#if PPC_FLIGHT_RECORDER
+		if (is_logging()) {
+			di->opcode = opcode;
+			di->execute = nv_mem_fun(&powerpc_cpu::record_step);
+			di++;
+		}
+#endif
+		di->opcode = opcode;
+		di->execute = ii->execute;
+		di++;
+#if PPC_EXECUTE_DUMP_STATE
+		if (dump_state) {
+			di->opcode = 0;
+			di->execute = nv_mem_fun(&powerpc_cpu::fake_dump_registers);
+			di++;
+		}
+#endif
+		if (di >= decode_cache_end_p) {
+			// Invalidate cache and move current code to start
+#if PPC_ASYNC_JIT
+			// Translated blocks don't use the decode cache
+			if (&cache == &interp_block_cache) {
+				interp_block_cache.clear();
+				interp_block_cache.initialize();
+				decode_cache_p = decode_cache;
+			}
+			else
+#endif
+			invalidate_cache();
+			const int blocklen = di - bi->di;
+			memmove(decode_cache_p, bi->di, blocklen * sizeof(*di));
+			bi->di = decode_cache_p;
+			di = bi->di + blocklen;
+		}
+	} while ((ii->cflow & CFLOW_END_BLOCK) == 0);
+#if PPC_THREADED_INTERPRETER
+	// Threaded code leaves the block through an extra handler
+	if (use_threaded_code) {
+		di->opcode = 0;
+		di->execute = nv_mem_fun(&powerpc_cpu::execute_nop);
+		di++;
+	}
+#endif
+	bi->end_pc = dpc;
+	bi->min_pc = dpc;
+	bi->max_pc = entry;
+	bi->size = di - bi->di;
+#if PPC_THREADED_INTERPRETER
+	if (use_threaded_code)
+		predecode_threaded(bi);
+#endif
+	cache.add_to_cl_list(bi);
+	cache.add_to_active_list(bi);
+	decode_cache_p += bi->size;
+#if PPC_PROFILE_COMPILE_TIME
+	// Blocks waiting for their translation are not accounted for,
+	// the translator updates the statistics concurrently
+	if (&cache == &my_block_cache) {
+		compile_count++;
+		compile_time += (clock() - start_time);
+		compile_size += bi->size * sizeof(*di);
+	}
+#endif
+	return bi;
+}
+
+inline void powerpc_cpu::execute_predecoded(block_info *bi)
+{
+#if PPC_THREADED_INTERPRETER
+	if (use_threaded_code) {
+		execute_threaded(bi->di);
+		return;
+	}
+#endif
+	const int r = bi->size % 4;
+	block_info::decode_info *di = bi->di + r;
+	int n = (bi->size + 3) / 4;
+	switch (r) {
+	case 0: do {
+			di += 4;
+			di[-4].execute(this, di[-4].opcode);
+	case 3: di[-3].execute(this, di[-3].opcode);
+	case 2: di[-2].execute(this, di[-2].opcode);
+	case 1: di[-1].execute(this, di[-1].opcode);
+		} while (--n > 0);
+	}
+}
+#endif
+
 void powerpc_cpu::init_decode_cache()
 {
 #if PPC_DECODE_CACHE
@@ -756,6 +1000,13 @@ void powerpc_cpu::init_decode_cache()
 	D(bug("powerpc_cpu: Allocated decode cache: %d KB at %p\n", DECODE_CACHE_SIZE / 1024, decode_cache));
 	decode_cache_p = decode_cache;
 	decode_cache_end_p = decode_cache + DECODE_CACHE_MAX_ENTRIES;
+	use_decode_cache = true;
+#if PPC_THREADED_INTERPRETER
+	// Leave enough room to the block end handler
+	decode_cache_end_p -= 1;
+	use_threaded_code = true;
+	execute_threaded(NULL);
+#endif
 #if FLIGHT_RECORDER
 	// Leave enough room to last call to record_step()
 	decode_cache_end_p -= 2;
@@ -767,6 +1018,374 @@ void powerpc_cpu::init_decode_cache()
 #endif
 }
 
+#if PPC_THREADED_INTERPRETER
+void powerpc_cpu::enable_threaded_code(bool enable)
+{
+	// Predecoded blocks can only run the way they were decoded
+	if (use_threaded_code != enable) {
+		use_threaded_code = enable;
+		invalidate_cache();
+	}
+}
+
+void powerpc_cpu::predecode_threaded(block_info *bi)
+{
+	block_info::decode_info * const start = bi->di;
+	block_info::decode_info * const end = start + bi->size - 1;
+	block_info::decode_info *di;
+
+	// Fast handlers keep the PC up-to-date lazily, from the address
+	// of each entry. Blocks with flight recorder or state dump entries
+	// don't map entries to instructions, so they get plain calls only
+	const bool fast = (uint32)(end - start) == (bi->end_pc - bi->pc) / 4 + 1;
+
+	uint32 dpc = bi->pc;
+	for (di = start; di < end; di++, dpc += 4) {
+		const uint32 opcode = di->opcode;
+		int handler = fast ? THREADED_GENERIC : THREADED_CALL;
+		di->pc = dpc;
+		di->rD = rD_field::extract(opcode);
+		di->rA = rA_field::extract(opcode);
+		di->rB = rB_field::extract(opcode);
+		di->aux = crfD_field::extract(opcode);
+		di->imm = (int32)(int16)opcode;
+		if (!fast) {
+			di->handler = threaded_handlers[handler];
+			continue;
+		}
+
+		const int mnemo = decode(opcode)->mnemo;
+		switch (mnemo) {
+		case PPC_I(ADDIS):
+			di->imm <<= 16;
+			// fall-through
+		case PPC_I(ADDI):
+			handler = di->rA ? THREADED_ADDI : THREADED_LI;
+			break;
+		case PPC_I(ORI):
+		case PPC_I(ORIS):
+		case PPC_I(XORI):
+		case PPC_I(XORIS):
+			di->rD = rA_field::extract(opcode);
+			di->rA = rS_field::extract(opcode);
+			di->imm = (uint16)opcode;
+			if (mnemo == PPC_I(ORIS) || mnemo == PPC_I(XORIS))
+				di->imm <<= 16;
+			handler = (mnemo == PPC_I(ORI) || mnemo == PPC_I(ORIS)) ? THREADED_ORI : THREADED_XORI;
+			break;
+		case PPC_I(ADD):
+		case PPC_I(SUBF):
+			if (!OE_field::test(opcode) && !Rc_field::test(opcode))
+				handler = mnemo == PPC_I(ADD) ? THREADED_ADD : THREADED_SUBF;
+			break;
+		case PPC_I(AND):
+		case PPC_I(OR):
+		case PPC_I(XOR):
+			di->rD = rA_field::extract(opcode);
+			di->rA = rS_field::extract(opcode);
+			if (!Rc_field::test(opcode))
+				handler = mnemo == PPC_I(AND) ? THREADED_AND : (mnemo == PPC_I(OR) ? THREADED_OR : THREADED_XOR);
+			break;
+		case PPC_I(RLWINM):
+			di->rD = rA_field::extract(opcode);
+			di->rA = rS_field::extract(opcode);
+			di->rB = SH_field::extract(opcode);
+			di->imm = mask_operand::get(this, opcode);
+			handler = Rc_field::test(opcode) ? THREADED_RLWINM_RC : THREADED_RLWINM;
+			break;
+		case PPC_I(CMPLI):
+			di->imm = (uint16)opcode;
+			handler = THREADED_CMPLI;
+			break;
+		case PPC_I(CMPI):
+			handler = THREADED_CMPI;
+			break;
+		case PPC_I(CMP):
+			handler = THREADED_CMP;
+			break;
+		case PPC_I(CMPL):
+			handler = THREADED_CMPL;
+			break;
+		case PPC_I(LWZ):
+			if (di->rA)
+				handler = THREADED_LWZ;
+			break;
+		case PPC_I(LWZU):
+			if (di->rA && di->rA != di->rD)
+				handler = THREADED_LWZU;
+			break;
+		case PPC_I(LBZ):
+			if (di->rA)
+				handler = THREADED_LBZ;
+			break;
+		case PPC_I(LBZU):
+			if (di->rA && di->rA != di->rD)
+				handler = THREADED_LBZU;
+			break;
+		case PPC_I(STW):
+			if (di->rA)
+				handler = THREADED_STW;
+			break;
+		case PPC_I(STWU):
+			if (di->rA)
+				handler = THREADED_STWU;
+			break;
+		case PPC_I(STB):
+			if (di->rA)
+				handler = THREADED_STB;
+			break;
+		case PPC_I(STBU):
+			if (di->rA)
+				handler = THREADED_STBU;
+			break;
+		case PPC_I(B):
+			if (!AA_field::test(opcode)) {
+				di->imm = dpc + (((int32)(opcode << 6) >> 6) & -4);
+				handler = LK_field::test(opcode) ? THREADED_BL : THREADED_B;
+			}
+			break;
+		case PPC_I(BC):
+			if (!AA_field::test(opcode) && !LK_field::test(opcode)) {
+				di->imm = dpc + ((int32)(int16)opcode & -4);
+				di->aux = BO_field::extract(opcode);
+				di->rB = BI_field::extract(opcode);
+				handler = THREADED_BC;
+			}
+			break;
+		}
+		di->handler = threaded_handlers[handler];
+	}
+	end->handler = threaded_handlers[THREADED_BLOCK_END];
+	if (!fast)
+		return;
+
+	// Fuse frequent pairs into superinstructions
+	for (di = start; di + 1 < end; di++) {
+		const void *h = di[0].handler;
+		const void *n = di[1].handler;
+		int handler = -1;
+		if (n == threaded_handlers[THREADED_BC]) {
+			if (h == threaded_handlers[THREADED_CMPI])
+				handler = THREADED_CMPI_BC;
+			else if (h == threaded_handlers[THREADED_CMPLI])
+				handler = THREADED_CMPLI_BC;
+			else if (h == threaded_handlers[THREADED_CMP])
+				handler = THREADED_CMP_BC;
+			else if (h == threaded_handlers[THREADED_CMPL])
+				handler = THREADED_CMPL_BC;
+		}
+		else if (h == threaded_handlers[THREADED_LWZ] && n == threaded_handlers[THREADED_ADDI])
+			handler = THREADED_LWZ_ADDI;
+		else if (h == threaded_handlers[THREADED_RLWINM] && n == threaded_handlers[THREADED_CMPI])
+			handler = THREADED_RLWINM_CMPI;
+		if (handler >= 0) {
+			di->handler = threaded_handlers[handler];
+			di++;
+		}
+	}
+}
+
+inline bool powerpc_cpu::threaded_branch(const block_info::decode_info *di)
+{
+	const int bo = di->aux;
+	bool ctr_ok = true;
+	bool cond_ok = true;
+
+	if (BO_CONDITIONAL_BRANCH(bo))
+		cond_ok = cr().test(di->rB) == BO_BRANCH_IF_TRUE(bo);
+
+	if (BO_DECREMENT_CTR(bo))
+		ctr_ok = ((ctr() -= 1) == 0) == BO_BRANCH_IF_CTR_ZERO(bo);
+
+	return ctr_ok && cond_ok;
+}
+
+void powerpc_cpu::execute_threaded(const block_info::decode_info *di)
+{
+	static const void * const handlers[THREADED_MAX] = {
+		&&do_call, &&do_generic, &&do_block_end,
+		&&do_li, &&do_addi, &&do_ori, &&do_xori,
+		&&do_add, &&do_subf, &&do_and, &&do_or, &&do_xor,
+		&&do_rlwinm, &&do_rlwinm_rc,
+		&&do_cmpi, &&do_cmpli, &&do_cmp, &&do_cmpl,
+		&&do_lwz, &&do_lwzu, &&do_lbz, &&do_lbzu,
+		&&do_stw, &&do_stwu, &&do_stb, &&do_stbu,
+		&&do_b, &&do_bl, &&do_bc,
+		&&do_cmpi_bc, &&do_cmpli_bc, &&do_cmp_bc, &&do_cmpl_bc,
+		&&do_lwz_addi, &&do_rlwinm_cmpi
+	};
+
+	// Export the labels table to the predecoder
+	if (di == NULL) {
+		threaded_handlers = handlers;
+		return;
+	}
+
+#define NEXT(N)				do { di += (N); goto *di->handler; } while (0)
+#define COMPARE(D, A, B, T)	record_cr((D)->aux, (T)(A) < (T)(B) ? -1 : ((T)(A) > (T)(B) ? +1 : 0))
+#define ROTATE(V, SH)		(((V) << (SH)) | ((V) >> ((32 - (SH)) & 31)))
+
+	goto *di->handler;
+
+  do_call:
+	di->execute(this, di->opcode);
+	NEXT(1);
+  do_generic:
+	pc() = di->pc;
+	di->execute(this, di->opcode);
+	NEXT(1);
+  do_block_end:
+	return;
+
+	// Integer arithmetic and logical instructions
+  do_li:
+	gpr(di->rD) = di->imm;
+	NEXT(1);
+  do_addi:
+	gpr(di->rD) = gpr(di->rA) + di->imm;
+	NEXT(1);
+  do_ori:
+	gpr(di->rD) = gpr(di->rA) | di->imm;
+	NEXT(1);
+  do_xori:
+	gpr(di->rD) = gpr(di->rA) ^ di->imm;
+	NEXT(1);
+  do_add:
+	gpr(di->rD) = gpr(di->rA) + gpr(di->rB);
+	NEXT(1);
+  do_subf:
+	gpr(di->rD) = gpr(di->rB) - gpr(di->rA);
+	NEXT(1);
+  do_and:
+	gpr(di->rD) = gpr(di->rA) & gpr(di->rB);
+	NEXT(1);
+  do_or:
+	gpr(di->rD) = gpr(di->rA) | gpr(di->rB);
+	NEXT(1);
+  do_xor:
+	gpr(di->rD) = gpr(di->rA) ^ gpr(di->rB);
+	NEXT(1);
+  do_rlwinm: {
+	const uint32 v = gpr(di->rA);
+	gpr(di->rD) = ROTATE(v, di->rB) & di->imm;
+	NEXT(1);
+  }
+  do_rlwinm_rc: {
+	const uint32 v = gpr(di->rA);
+	const uint32 d = ROTATE(v, di->rB) & di->imm;
+	gpr(di->rD) = d;
+	record_cr0((int32)d);
+	NEXT(1);
+  }
+
+	// Compare instructions
+  do_cmpi:
+	COMPARE(di, gpr(di->rA), di->imm, int32);
+	NEXT(1);
+  do_cmpli:
+	COMPARE(di, gpr(di->rA), di->imm, uint32);
+	NEXT(1);
+  do_cmp:
+	COMPARE(di, gpr(di->rA), gpr(di->rB), int32);
+	NEXT(1);
+  do_cmpl:
+	COMPARE(di, gpr(di->rA), gpr(di->rB), uint32);
+	NEXT(1);
+
+	// Load and store instructions. The PC is synchronized first for
+	// the SIGSEGV handler to know which instruction faulted
+  do_lwz:
+	pc() = di->pc;
+	gpr(di->rD) = vm_read_memory_4(gpr(di->rA) + di->imm);
+	NEXT(1);
+  do_lwzu: {
+	pc() = di->pc;
+	const uint32 ea = gpr(di->rA) + di->imm;
+	gpr(di->rD) = vm_read_memory_4(ea);
+	gpr(di->rA) = ea;
+	NEXT(1);
+  }
+  do_lbz:
+	pc() = di->pc;
+	gpr(di->rD) = vm_read_memory_1(gpr(di->rA) + di->imm);
+	NEXT(1);
+  do_lbzu: {
+	pc() = di->pc;
+	const uint32 ea = gpr(di->rA) + di->imm;
+	gpr(di->rD) = vm_read_memory_1(ea);
+	gpr(di->rA) = ea;
+	NEXT(1);
+  }
+  do_stw:
+	pc() = di->pc;
+	vm_write_memory_4(gpr(di->rA) + di->imm, gpr(di->rD));
+	NEXT(1);
+  do_stwu: {
+	pc() = di->pc;
+	const uint32 ea = gpr(di->rA) + di->imm;
+	vm_write_memory_4(ea, gpr(di->rD));
+	gpr(di->rA) = ea;
+	NEXT(1);
+  }
+  do_stb:
+	pc() = di->pc;
+	vm_write_memory_1(gpr(di->rA) + di->imm, gpr(di->rD));
+	NEXT(1);
+  do_stbu: {
+	pc() = di->pc;
+	const uint32 ea = gpr(di->rA) + di->imm;
+	vm_write_memory_1(ea, gpr(di->rD));
+	gpr(di->rA) = ea;
+	NEXT(1);
+  }
+
+	// Branch instructions
+  do_b:
+	pc() = di->imm;
+	NEXT(1);
+  do_bl:
+	lr() = di->pc + 4;
+	pc() = di->imm;
+	NEXT(1);
+  do_bc:
+	pc() = threaded_branch(di) ? di->imm : di->pc + 4;
+	NEXT(1);
+
+	// Superinstructions
+  do_cmpi_bc:
+	COMPARE(di, gpr(di->rA), di->imm, int32);
+	di++;
+	goto do_bc;
+  do_cmpli_bc:
+	COMPARE(di, gpr(di->rA), di->imm, uint32);
+	di++;
+	goto do_bc;
+  do_cmp_bc:
+	COMPARE(di, gpr(di->rA), gpr(di->rB), int32);
+	di++;
+	goto do_bc;
+  do_cmpl_bc:
+	COMPARE(di, gpr(di->rA), gpr(di->rB), uint32);
+	di++;
+	goto do_bc;
+  do_lwz_addi:
+	pc() = di->pc;
+	gpr(di->rD) = vm_read_memory_4(gpr(di->rA) + di->imm);
+	gpr(di[1].rD) = gpr(di[1].rA) + di[1].imm;
+	NEXT(2);
+  do_rlwinm_cmpi: {
+	const uint32 v = gpr(di->rA);
+	gpr(di->rD) = ROTATE(v, di->rB) & di->imm;
+	COMPARE(&di[1], gpr(di[1].rA), di[1].imm, int32);
+	NEXT(2);
+  }
+
+#undef ROTATE
+#undef COMPARE
+#undef NEXT
+}
+#endif
+
 void powerpc_cpu::kill_decode_cache()
 {
 #if PPC_DECODE_CACHE
@@ -777,6 +1396,11 @@ void powerpc_cpu::kill_decode_cache()
 void powerpc_cpu::invalidate_cache()
 {
 	D(bug("Invalidate all cache blocks\n"));
+#if PPC_ASYNC_JIT
+	jit_state_locker lock(this);
+	interp_block_cache.clear();
+	interp_block_cache.initialize();
+#endif
 #if PPC_DECODE_CACHE || PPC_ENABLE_JIT
 	my_block_cache.clear();
 	my_block_cache.initialize();
@@ -784,6 +1408,10 @@ void powerpc_cpu::invalidate_cache()
 #endif
 #if PPC_ENABLE_JIT
 	codegen.invalidate_cache();
+	invalidate_branch_caches();
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+	saved_blocks.clear();
 #endif
 #if PPC_DECODE_CACHE
 	decode_cache_p = decode_cache;
@@ -822,6 +1450,96 @@ void powerpc_cpu::invalidate_cache_range(uintptr start, uintptr end)
 	}
 #endif
 	spcflags().set(SPCFLAG_JIT_EXEC_RETURN);
+#if PPC_ASYNC_JIT
+	jit_state_locker lock(this);
+	interp_block_cache.clear_range(start, end);
+#endif
 	my_block_cache.clear_range(start, end);
 #endif
+#if PPC_ENABLE_JIT
+	invalidate_branch_caches();
+#endif
+}
+
+#if PPC_ENABLE_JIT
+struct translation_region_flusher {
+	typedef powerpc_cpu::block_info block_info;
+	uint8 * start;
+	uint8 * end;
+	std::vector<block_info *> blocks;
+
+	translation_region_flusher(uint8 *start_init, uint8 *end_init)
+		: start(start_init), end(end_init)
+		{ }
+
+	void operator()(block_info *bi);
+};
+
+void translation_region_flusher::operator()(block_info *bi)
+{
+	if (bi->entry_point < end && bi->entry_point + bi->size > start) {
+		blocks.push_back(bi);
+		return;
+	}
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+	// Reset jumps from surviving blocks into the region to their resolver
+	for (int i = 0; i < block_info::MAX_TARGETS; i++) {
+		block_info::link_info * const li = &bi->li[i];
+		if (li->jmp_pc != block_info::INVALID_PC && li->jmp_target >= start && li->jmp_target < end) {
+			dg_set_jmp_target(li->jmp_addr, li->jmp_resolve_addr);
+			li->jmp_target = NULL;
+		}
+	}
+#endif
+}
+
+void powerpc_cpu::flush_translation_region()
+{
+	uint8 *start, *end;
+	codegen.next_region(start, end);
+	flush_translation_range(start, end);
+	spcflags().set(SPCFLAG_JIT_EXEC_RETURN);
+}
+
+void powerpc_cpu::flush_translation_range(uint8 *start, uint8 *end)
+{
+	translation_region_flusher flusher(start, end);
+	my_block_cache.for_each(flusher);
+	D(bug("Flush %d blocks from translation cache range [%p - %p]\n", (int)flusher.blocks.size(), start, end));
+	for (size_t i = 0; i < flusher.blocks.size(); i++) {
+		block_info *bi = flusher.blocks[i];
+		my_block_cache.remove_from_lists(bi);
+		my_block_cache.delete_blockinfo(bi);
+	}
+#if PPC_PERSISTENT_JIT_CACHE
+	for (size_t i = 0; i < saved_blocks.size(); i++) {
+		uint8 *entry_point = codegen.cache_base() + saved_blocks[i].entry_offset;
+		if (entry_point < end && entry_point + saved_blocks[i].size > start)
+			saved_blocks[i].size = 0;
+	}
+#endif
+
+	invalidate_branch_caches();
+}
+
+#if PPC_TRACE_JIT
+powerpc_cpu::block_info *powerpc_cpu::compile_trace(block_info *bi)
+{
+	// Retire the block first, jumps into it are reset to their resolver
+	// and will pick the trace up
+	const uint32 entry = bi->pc;
+	flush_translation_range(bi->entry_point, bi->entry_point + bi->size);
+	return compile_block(entry, true);
 }
+#endif
+
+void powerpc_cpu::invalidate_branch_caches()
+{
+	// Epoch 0 is used to mark block caches as invalid
+	if (++block_epoch == 0)
+		block_epoch = 1;
+	return_stack_top = 0;
+	for (int i = 0; i < RETURN_STACK_SIZE; i++)
+		return_stack[i] = NULL;
+}
+#endif
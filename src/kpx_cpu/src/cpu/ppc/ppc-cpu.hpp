@@ -34,6 +34,10 @@
 #endif
 #include "cpu/ppc/ppc-instructions.hpp"
 #include <vector>
+#include <map>
+#if PPC_ASYNC_JIT
+#include <deque>
+#endif
 
 class powerpc_cpu
 #ifndef SHEEPSHAVER
@@ -123,9 +127,12 @@ protected:
 		{ cr().compute(crfd, value); cr().set_so(crfd, xer().get_so()); }
 	void record_cr0(int32 value)
 		{ record_cr(0, value); }
-	void record_cr1()
-		{ cr().set((cr().get() & ~CR_field<1>::mask()) | ((fpscr() >> 4) & 0x0f000000)); }
 	void record_fpscr(int exceptions);
+	void sync_fpscr();
+	void record_cr1()
+		{ sync_fpscr(); cr().set((cr().get() & ~CR_field<1>::mask()) | ((fpscr() >> 4) & 0x0f000000)); }
+	void enter_host_code();
+	void leave_host_code();
 	void record_cr6(powerpc_vr const & vS, bool check_one) {
 		if (check_one && (vS.j[0] == UVAL64(0xffffffffffffffff) &&
 						  vS.j[1] == UVAL64(0xffffffffffffffff)))
@@ -204,6 +211,7 @@ private:
 #if PPC_PROFILE_COMPILE_TIME
 	uint32 compile_count;
 	clock_t compile_time;
+	uint32 compile_size;
 	clock_t emul_start_time;
 #endif
 
@@ -286,6 +294,30 @@ public:
 	void execute(uint32 entry);
 	void execute();
 
+	// Predecode blocks when the JIT is not used, or interpret every
+	// instruction instead
+#if PPC_DECODE_CACHE
+	void enable_decode_cache(bool enable = true) { use_decode_cache = enable; }
+#else
+	void enable_decode_cache(bool enable = true) { }
+#endif
+
+	// Run predecoded blocks as threaded code, or through the plain
+	// dispatch loop
+#if PPC_THREADED_INTERPRETER
+	void enable_threaded_code(bool enable = true);
+#else
+	void enable_threaded_code(bool enable = true) { }
+#endif
+
+	// Compile time statistics: blocks translated or predecoded, time
+	// spent and bytes of translated code or decode cache
+#if PPC_PROFILE_COMPILE_TIME
+	uint32 get_compile_count() const { return compile_count; }
+	clock_t get_compile_time() const { return compile_time; }
+	uint32 get_compile_size() const { return compile_size; }
+#endif
+
 	// Interrupts handling
 	void trigger_interrupt();
 	
@@ -335,6 +367,42 @@ protected:
 	bool use_jit;
 public:
 	void enable_jit(uint32 cache_size = 0);
+#if PPC_ENABLE_NATIVE_JIT
+	void enable_native_jit(bool enable = true) { codegen.set_native_codegen(enable); }
+	void enable_jit_optimizer(bool enable = true) { codegen.set_native_optimizer(enable); }
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+	// Saved translations are only valid at a fixed address, call before enable_jit()
+	void enable_translation_cache_persistence()
+		{ codegen.set_cache_address((uint8 *)PPC_PERSISTENT_JIT_CACHE_ADDRESS); }
+	bool load_translation_cache(const char *filename);
+	bool save_translation_cache(const char *filename);
+#endif
+#if PPC_PERF_JIT_MAP
+	enum { PERF_MAP = 1, PERF_JITDUMP = 2 };
+	bool enable_perf_map(int modes);
+#endif
+#if PPC_ASYNC_JIT
+	bool enable_async_jit(bool enable = true);
+#endif
+#if PPC_RUNTIME_PROFILER
+	// Events counted by the runtime profiler, besides block executions
+	enum {
+		PROFILE_DISPATCH,				// Returns to the block dispatcher
+		PROFILE_CHAIN,					// Direct block chains resolved
+		PROFILE_INDIRECT,				// Indirect branches
+		PROFILE_INDIRECT_MISS,			// ... not found in the per-site cache
+		PROFILE_RETURN,					// Returns from calls
+		PROFILE_RETURN_MISS,			// ... not found in the return stack
+		PROFILE_INTERRUPT,				// Interrupts handled
+		PROFILE_EXECUTE_68K,			// Calls to 68k routines
+		PROFILE_MAX
+	};
+	void enable_profiler(bool enable = true);
+	bool use_profiler() const { return profiling; }
+	void profile_event(int event) { if (profiling) profile_events[event]++; }
+	bool dump_profile(const char *filename);
+#endif
 #endif
 
 private:
@@ -353,7 +421,12 @@ private:
 
 	// Block lookup table
 	typedef powerpc_block_info block_info;
-	block_cache< block_info, lazy_allocator > my_block_cache;
+#if PPC_PAGE_BLOCK_CACHE
+	typedef page_block_cache< block_info, lazy_allocator > block_cache_t;
+#else
+	typedef block_cache< block_info, lazy_allocator > block_cache_t;
+#endif
+	block_cache_t my_block_cache;
 
 #if PPC_DECODE_CACHE
 	// Decode Cache
@@ -362,6 +435,57 @@ private:
 	block_info::decode_info * decode_cache;
 	block_info::decode_info * decode_cache_p;
 	block_info::decode_info * decode_cache_end_p;
+	bool use_decode_cache;
+	block_info *predecode_block(block_cache_t & cache, uint32 entry);
+	void execute_predecoded(block_info *bi);
+#endif
+
+#if PPC_THREADED_INTERPRETER
+	// Threaded code handlers, in the order of the labels table
+	enum {
+		THREADED_CALL,			// Call the generic execute function
+		THREADED_GENERIC,		// Same, after synchronizing the PC
+		THREADED_BLOCK_END,
+		THREADED_LI,
+		THREADED_ADDI,
+		THREADED_ORI,
+		THREADED_XORI,
+		THREADED_ADD,
+		THREADED_SUBF,
+		THREADED_AND,
+		THREADED_OR,
+		THREADED_XOR,
+		THREADED_RLWINM,
+		THREADED_RLWINM_RC,
+		THREADED_CMPI,
+		THREADED_CMPLI,
+		THREADED_CMP,
+		THREADED_CMPL,
+		THREADED_LWZ,
+		THREADED_LWZU,
+		THREADED_LBZ,
+		THREADED_LBZU,
+		THREADED_STW,
+		THREADED_STWU,
+		THREADED_STB,
+		THREADED_STBU,
+		THREADED_B,
+		THREADED_BL,
+		THREADED_BC,
+		// Superinstructions
+		THREADED_CMPI_BC,
+		THREADED_CMPLI_BC,
+		THREADED_CMP_BC,
+		THREADED_CMPL_BC,
+		THREADED_LWZ_ADDI,
+		THREADED_RLWINM_CMPI,
+		THREADED_MAX
+	};
+	const void * const * threaded_handlers;
+	bool use_threaded_code;
+	void predecode_threaded(block_info *bi);
+	void execute_threaded(const block_info::decode_info *di);
+	bool threaded_branch(const block_info::decode_info *di);
 #endif
 
 #if PPC_ENABLE_JIT
@@ -369,11 +493,105 @@ private:
 	friend class powerpc_dyngen_helper;
 	friend class powerpc_dyngen;
 	friend class powerpc_jit;
+
+	// Indirect branch caches are valid for one block epoch, i.e. until
+	// the next block invalidation. Blocks ending with a call are pushed
+	// to the shadow return stack
+	static const int RETURN_STACK_SIZE = 16;
+	uint32 block_epoch;
+	uint32 return_stack_top;
+	block_info *return_stack[RETURN_STACK_SIZE];
+	void invalidate_branch_caches();
+
 	powerpc_jit codegen;
-	block_info *compile_block(uint32 entry);
+	block_info *compile_block(uint32 entry, bool trace = false);
+	void gen_push_return(block_info *bi);
+	void gen_record_cr1();
+
+#if PPC_TRACE_JIT
+	// Blocks are retranslated as traces after this many executions
+	static const int32 TRACE_THRESHOLD = 256;
+	block_info *compile_trace(block_info *bi);
+#endif
+
+	// Flush the next translation cache region to make room for new blocks
+	void flush_translation_region();
+	void flush_translation_range(uint8 *start, uint8 *end);
+	friend struct translation_region_flusher;
 #if DYNGEN_DIRECT_BLOCK_CHAINING
 	void *compile_chain_block(block_info *sbi);
 #endif
+#if PPC_ASYNC_JIT
+	// The translation cache and code generator belong to the thread
+	// holding jit_state_lock. The emulation thread holds it to run
+	// translated code, and runs blocks from interp_block_cache while
+	// the worker holds it to translate the queued entry points
+	static const int ASYNC_JIT_QUEUED_SIZE = 256;
+	static const uint32 ASYNC_JIT_NO_ENTRY = 0xffffffff;
+	bool use_async_jit;
+	volatile bool async_jit_quit;
+	volatile int async_jit_pending;
+	pthread_t async_jit_thread;
+	pthread_mutex_t jit_state_lock;
+	pthread_mutex_t async_jit_queue_lock;
+	pthread_cond_t async_jit_queue_cond;
+	std::deque<uint32> async_jit_queue;
+	uint32 async_jit_queued[ASYNC_JIT_QUEUED_SIZE];
+	block_cache_t interp_block_cache;
+	static void *async_jit_thread_func(void *arg);
+	void queue_translation(uint32 entry);
+	friend class jit_state_locker;
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+	// Blocks loaded from a translation cache file, sorted by pc
+	struct saved_block_info {
+		uint32 pc, end_pc;
+		uint32 min_pc, max_pc;
+		uint32 entry_offset;				// Offset to entry point, from cache base
+		uint32 size;
+		uint32 checksum;					// Checksum of guest code [min_pc, max_pc + 4)
+		uint32 self_refs[block_info::MAX_SELF_REFS];
+		struct {
+			uint32 jmp_pc;
+			uint32 jmp_offset;				// Offsets from entry point
+			uint32 jmp_resolve_offset;
+		} li[block_info::MAX_TARGETS];
+
+		bool operator < (const saved_block_info & other) const
+			{ return pc < other.pc; }
+	};
+	std::vector<saved_block_info> saved_blocks;
+	uint32 translation_cache_config();
+	block_info *restore_block(uint32 entry);
+	void record_self_ref(block_info *bi, int n, uint8 *start, uintptr value);
+	friend struct saved_block_collector;
+#endif
+#if PPC_PERF_JIT_MAP
+	// Host profiler maps, and the function the last name lookup found
+	FILE *perf_map_file;
+	int perf_dump_fd;
+	void *perf_dump_marker;
+	uint64 perf_dump_index;
+	uint32 perf_name_start, perf_name_end;
+	char perf_name[64];
+	void perf_map_block(block_info *bi, bool trace);
+	bool perf_function_name(uint32 pc);
+	void disable_perf_map();
+#endif
+#if PPC_RUNTIME_PROFILER
+	// Execution counts, kept per entry point across retranslations.
+	// Generic handler calls are counted per mnemonic, the last slot
+	// gathers instructions the emulator adds to the decoder
+	struct profile_block {
+		uint64 count;
+		uint32 end_pc;
+	};
+	std::map<uint32, profile_block> profile_blocks;
+	uint64 profile_fallbacks[PPC_I(MAX) + 1];
+	uint64 profile_events[PROFILE_MAX];
+	bool profiling;
+	void reset_profile();
+#endif
 #endif
 
 	// Semantic action templates
@@ -503,7 +721,8 @@ private:
 inline void powerpc_cpu::trigger_interrupt()
 {
 #if PPC_CHECK_INTERRUPTS
-	spcflags().set(SPCFLAG_CPU_TRIGGER_INTERRUPT);
+	// Redundant triggers coalesce into the one already pending
+	spcflags().post(SPCFLAG_CPU_TRIGGER_INTERRUPT);
 #endif
 }
 
@@ -511,4 +730,23 @@ inline void powerpc_cpu::trigger_interrupt()
 extern void HandleInterrupt(powerpc_registers *r);
 #endif
 
+#if PPC_ASYNC_JIT
+/**
+ *	Translation cache ownership, for code running outside of the
+ *	execution loop or that may run while the worker translates
+ **/
+
+class jit_state_locker
+{
+	powerpc_cpu * const cpu;
+
+public:
+	jit_state_locker(powerpc_cpu *cpu_init)
+		: cpu(cpu_init)
+		{ pthread_mutex_lock(&cpu->jit_state_lock); }
+	~jit_state_locker()
+		{ pthread_mutex_unlock(&cpu->jit_state_lock); }
+};
+#endif
+
 #endif /* PPC_CPU_H */
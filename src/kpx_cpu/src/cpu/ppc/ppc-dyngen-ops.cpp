@@ -116,6 +116,14 @@ struct powerpc_dyngen_helper {
 //#endif
 
 	static INLINE powerpc_block_info *find_block(uint32 pc) { return CPU->my_block_cache.fast_find(pc); }
+	static INLINE uint32 get_block_epoch()		{ return CPU->block_epoch; }
+	static INLINE void push_return(powerpc_block_info *bi)
+		{ CPU->return_stack[CPU->return_stack_top++ % powerpc_cpu::RETURN_STACK_SIZE] = bi; }
+	static INLINE powerpc_block_info *pop_return()
+		{ return CPU->return_stack[--CPU->return_stack_top % powerpc_cpu::RETURN_STACK_SIZE]; }
+#if PPC_RUNTIME_PROFILER
+	static INLINE void profile_event(int event)	{ CPU->profile_event(event); }
+#endif
 };
 
 // Semantic action templates
@@ -302,6 +310,7 @@ void OPPROTO op_lwarx_T0_T1(void)
 	T0 = vm_read_memory_4(T1);
 	powerpc_dyngen_helper::regs()->reserve_valid = 1;
 	powerpc_dyngen_helper::regs()->reserve_addr = T1;
+	powerpc_dyngen_helper::regs()->reserve_data = T0;
 }
 
 void OPPROTO op_stwcx_T0_T1(void)
@@ -310,7 +319,8 @@ void OPPROTO op_stwcx_T0_T1(void)
 	cr |= powerpc_dyngen_helper::xer().get_so() << 28;
 	if (powerpc_dyngen_helper::regs()->reserve_valid) {
 		powerpc_dyngen_helper::regs()->reserve_valid = 0;
-		if (powerpc_dyngen_helper::regs()->reserve_addr == T1 /* physical_addr(EA) */) {
+		if (powerpc_dyngen_helper::regs()->reserve_addr == T1 /* physical_addr(EA) */
+			&& powerpc_dyngen_helper::regs()->reserve_data == vm_read_memory_4(T1)) {
 			vm_write_memory_4(T1, T0);
 			cr |= CR_EQ_field<0>::mask();
 		}
@@ -632,6 +642,22 @@ void OPPROTO op_spcflags_check(void)
 	FAST_COMPARE_SPECFLAGS_DISPATCH(powerpc_dyngen_helper::spcflags().get(), __op_jmp0);
 }
 
+#if defined(__x86_64__)
+#define FAST_CONDITIONAL_DISPATCH(COND, TARGET) \
+		asm volatile ("test %0,%0 ; jnz " #TARGET : : "r" (COND))
+#endif
+#ifndef FAST_CONDITIONAL_DISPATCH
+#define FAST_CONDITIONAL_DISPATCH(COND, TARGET) \
+		if (COND) DYNGEN_FAST_DISPATCH(TARGET)
+#endif
+
+void OPPROTO op_count_block_A0(void)
+{
+	powerpc_block_info *bi = (powerpc_block_info *)A0;
+	const bool expired = --bi->count < 0;
+	FAST_CONDITIONAL_DISPATCH(expired, __op_jmp0);
+}
+
 
 /**
  *		Branch instructions
@@ -698,6 +724,19 @@ void OPPROTO op_branch_chain_2(void)
 	dyngen_barrier();
 }
 
+// Side exits of traces, the block continues if the branch is not taken
+void OPPROTO op_branch_exit_T1(void)
+{
+	const bool cond = T1;
+	FAST_CONDITIONAL_DISPATCH(cond, __op_jmp0);
+}
+
+void OPPROTO op_branch_exit_not_T1(void)
+{
+	const bool cond = !T1;
+	FAST_CONDITIONAL_DISPATCH(cond, __op_jmp0);
+}
+
 static INLINE void do_execute_branch_1(uint32 tpc)
 {
 	powerpc_dyngen_helper::set_pc(tpc);
@@ -748,12 +787,6 @@ void OPPROTO op_record_cr0_T0(void)
 	dyngen_barrier();
 }
 
-void OPPROTO op_record_cr1(void)
-{
-	powerpc_dyngen_helper::set_cr((powerpc_dyngen_helper::get_cr() & ~CR_field<1>::mask()) |
-								  ((powerpc_dyngen_helper::get_fpscr() >> 4) & 0x0f000000));
-}
-
 #define im PARAM1
 
 #if DYNGEN_ASM_OPTS && defined(__powerpc__) && 0
@@ -1355,6 +1388,12 @@ void OPPROTO op_inc_32_mem(void)
 	*m += 1;
 }
 
+void OPPROTO op_inc_64_A0(void)
+{
+	uint64 *m = (uint64 *)A0;
+	*m += 1;
+}
+
 void OPPROTO op_nego_T0(void)
 {
 	powerpc_dyngen_helper::xer().set_ov(T0 == 0x80000000);
@@ -1382,6 +1421,73 @@ void OPPROTO op_jump_next_A0(void)
 	dyngen_barrier();
 }
 
+void OPPROTO op_jump_exit_A0(void)
+{
+	powerpc_exit_cache *ec = (powerpc_exit_cache *)A0;
+	const uint32 epoch = powerpc_dyngen_helper::get_block_epoch();
+	if (likely(ec->epoch == epoch))
+		goto *(ec->entry);
+	powerpc_block_info *tbi = powerpc_dyngen_helper::find_block(powerpc_dyngen_helper::get_pc());
+	if (likely(tbi != NULL)) {
+		ec->epoch = epoch;
+		ec->entry = tbi->entry_point;
+		goto *(tbi->entry_point);
+	}
+	dyngen_barrier();
+}
+
+/**
+ *		Indirect branches: try the per-site target cache, or the block
+ *		pushed by the matching call for returns, before the full lookup
+ **/
+
+void OPPROTO op_push_return_A0(void)
+{
+	powerpc_dyngen_helper::push_return((powerpc_block_info *)A0);
+}
+
+void OPPROTO op_jump_indirect_A0(void)
+{
+	powerpc_block_info *bi = (powerpc_block_info *)A0;
+	const uint32 pc = powerpc_dyngen_helper::get_pc();
+	const uint32 epoch = powerpc_dyngen_helper::get_block_epoch();
+	if (likely(bi->ic_pc == pc && bi->ic_epoch == epoch))
+		goto *(bi->ic_entry);
+#if PPC_RUNTIME_PROFILER
+	powerpc_dyngen_helper::profile_event(powerpc_cpu::PROFILE_INDIRECT_MISS);
+#endif
+	powerpc_block_info *tbi = powerpc_dyngen_helper::find_block(pc);
+	if (likely(tbi != NULL)) {
+		bi->ic_pc = pc;
+		bi->ic_epoch = epoch;
+		bi->ic_entry = tbi->entry_point;
+		goto *(tbi->entry_point);
+	}
+	dyngen_barrier();
+}
+
+void OPPROTO op_jump_return_A0(void)
+{
+	powerpc_block_info *cbi = powerpc_dyngen_helper::pop_return();
+	const uint32 pc = powerpc_dyngen_helper::get_pc();
+	const uint32 epoch = powerpc_dyngen_helper::get_block_epoch();
+	if (likely(cbi != NULL && cbi->ret_pc == pc && cbi->ret_epoch == epoch))
+		goto *(cbi->ret_entry);
+#if PPC_RUNTIME_PROFILER
+	powerpc_dyngen_helper::profile_event(powerpc_cpu::PROFILE_RETURN_MISS);
+#endif
+	powerpc_block_info *tbi = powerpc_dyngen_helper::find_block(pc);
+	if (likely(tbi != NULL)) {
+		if (cbi != NULL) {
+			cbi->ret_pc = pc;
+			cbi->ret_epoch = epoch;
+			cbi->ret_entry = tbi->entry_point;
+		}
+		goto *(tbi->entry_point);
+	}
+	dyngen_barrier();
+}
+
 /**
  *		Load/store multiple
  **/
@@ -46,20 +46,34 @@ powerpc_dyngen::powerpc_dyngen(dyngen_cpu_base cpu)
 		printf(" SSE3");
 	if (cpuinfo_check_ssse3())
 		printf(" SSSE3");
+	if (cpuinfo_check_sse4_1())
+		printf(" SSE4.1");
+	if (cpuinfo_check_avx2())
+		printf(" AVX2");
 	if (cpuinfo_check_altivec())
 		printf(" VMX");
 	printf("\n");
 #endif
 }
 
-uint8 *powerpc_dyngen::gen_start(uint32 pc)
+uint8 *powerpc_dyngen::gen_start(uint32 pc, uintptr counter)
 {
-	// Generate exit if there are pending spcflags
+	// Generate exit if there are pending spcflags, or if the execution
+	// counter of the block expired
 	uint8 *p = basic_dyngen::gen_start();
+	uint8 *counter_jmp_addr = NULL;
+	if (counter) {
+		gen_mov_ad_A0_im(counter);
+		gen_op_count_block_A0();
+		counter_jmp_addr = jmp_addr[0];
+	}
 	gen_op_spcflags_check();
+	uint8 *exit_addr = code_ptr();
 	gen_op_set_PC_im(pc);
 	gen_exec_return();
 	dg_set_jmp_target_noflush(jmp_addr[0], gen_align());
+	if (counter_jmp_addr)
+		dg_set_jmp_target_noflush(counter_jmp_addr, exit_addr);
 	jmp_addr[0] = NULL;
 	return p;
 }
@@ -233,7 +247,7 @@ DEFINE_INSN(store, T0);
 
 #undef DEFINE_INSN
 
-void powerpc_dyngen::gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_chaining)
+void powerpc_dyngen::gen_prep_branch(int bo, int bi)
 {
 	if (BO_CONDITIONAL_BRANCH(bo))
 		gen_load_T1_crb(bi);
@@ -259,7 +273,12 @@ void powerpc_dyngen::gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_
 #undef _
 	default: abort();
 	}
-	
+}
+
+void powerpc_dyngen::gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_chaining)
+{
+	gen_prep_branch(bo, bi);
+
 	if (BO_CONDITIONAL_BRANCH(bo) || BO_DECREMENT_CTR(bo)) {
 		// two-way branches
 		if (direct_chaining)
@@ -284,6 +303,35 @@ void powerpc_dyngen::gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_
 	}
 }
 
+uint8 *powerpc_dyngen::gen_bc_exit(int bo, int bi, bool taken)
+{
+	// Jump out of line if the branch goes the other way than predicted
+	gen_prep_branch(bo, bi);
+	if (taken)
+		gen_op_branch_exit_not_T1();
+	else
+		gen_op_branch_exit_T1();
+	uint8 *p = jmp_addr[0];
+	jmp_addr[0] = NULL;
+	return p;
+}
+
+uint8 *powerpc_dyngen::gen_side_exit(uint32 pc)
+{
+	// The target cache lives right before the exit code
+	powerpc_exit_cache *ec = (powerpc_exit_cache *)gen_align(16);
+	ec->epoch = 0;
+	ec->entry = NULL;
+	inc_code_ptr(sizeof(*ec));
+
+	uint8 *p = gen_align(16);
+	gen_op_set_PC_im(pc);
+	gen_mov_ad_A0_im((uintptr)ec);
+	gen_op_jump_exit_A0();
+	gen_exec_return();
+	return p;
+}
+
 /**
  *		Vector instructions
  **/
@@ -30,12 +30,19 @@
 #include "cpu/jit/jit-config.hpp"
 #include "cpu/jit/basic-dyngen.hpp"
 
+// Target block of a trace side exit, valid for one block epoch
+struct powerpc_exit_cache
+{
+	uint32 epoch;
+	uint8 *entry;
+};
+
 class powerpc_dyngen
 	: public basic_dyngen
 {
-#ifndef REG_T3
+	// Always present so that the layout does not depend on whether
+	// dyngen-exec.h was included first, e.g. in ppc-jit.cpp
 	uintptr reg_T3;
-#endif
 
 //#ifndef REG_F3
 	powerpc_fpr reg_F3;
@@ -57,8 +64,8 @@ public:
 	// Default constructor
 	powerpc_dyngen(dyngen_cpu_base cpu);
 
-	// Generate prologue
-	uint8 *gen_start(uint32 pc);
+	// Generate prologue, optionally counting executions of block_info COUNTER
+	uint8 *gen_start(uint32 pc, uintptr counter = 0);
 
 	// Load/store registers
 	void gen_load_T0_GPR(int i);
@@ -99,6 +106,7 @@ public:
 	DEFINE_ALIAS(stwcx_T0_T1,0);
 #endif
 	DEFINE_ALIAS(inc_32_mem,1);
+	DEFINE_ALIAS(inc_64_A0,0);
 	DEFINE_ALIAS(nego_T0,0);
 	DEFINE_ALIAS(dcbz_T0,0);
 
@@ -137,10 +145,13 @@ public:
 
 	// Control Flow
 	DEFINE_ALIAS(jump_next_A0,0);
+	DEFINE_ALIAS(jump_indirect_A0,0);
+	DEFINE_ALIAS(jump_return_A0,0);
+	DEFINE_ALIAS(push_return_A0,0);
+	DEFINE_ALIAS(jump_exit_A0,0);
 
 	// Compare & Record instructions
 	DEFINE_ALIAS(record_cr0_T0,0);
-	DEFINE_ALIAS(record_cr1,0);
 	void gen_compare_T0_T1(int crf);
 	void gen_compare_T0_im(int crf, int32 value);
 	void gen_compare_logical_T0_T1(int crf);
@@ -232,7 +243,10 @@ public:
 	void gen_store_single_F0_T1_im(int32 offset);
 
 	// Branch instructions
+	void gen_prep_branch(int bo, int bi);
 	void gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_chaining);
+	uint8 *gen_bc_exit(int bo, int bi, bool taken);
+	uint8 *gen_side_exit(uint32 pc);
 
 	// Vector instructions
 	void gen_load_ad_VD_VR(int i);
@@ -487,6 +487,59 @@ void powerpc_cpu::record_fpscr(int exceptions)
 #endif
 }
 
+/**
+ *  Sync FPSCR
+ *
+ *		Without precise FPU exceptions, FP instructions leave their
+ *		exceptions in the host accrued flags. They are folded into the
+ *		FPSCR sticky bits only when the FPSCR is read or written
+ **/
+
+void powerpc_cpu::sync_fpscr()
+{
+#if !PPC_ENABLE_FPU_EXCEPTIONS
+	const int raised = fetestexcept(FE_INEXACT | FE_DIVBYZERO | FE_UNDERFLOW | FE_OVERFLOW);
+	if (raised == 0)
+		return;
+	feclearexcept(raised);
+
+	uint32 exceptions = 0;
+	if (raised & FE_INEXACT)
+		exceptions |= FPSCR_XX_field::mask();
+	if (raised & FE_DIVBYZERO)
+		exceptions |= FPSCR_ZX_field::mask();
+	if (raised & FE_UNDERFLOW)
+		exceptions |= FPSCR_UX_field::mask();
+	if (raised & FE_OVERFLOW)
+		exceptions |= FPSCR_OX_field::mask();
+
+	// FX is set when any exception bit changes from 0 to 1
+	if (exceptions & ~fpscr())
+		fpscr() |= FPSCR_FX_field::mask() | exceptions;
+#endif
+}
+
+/**
+ *  Host code boundaries
+ *
+ *		Emulator code called from the guest (EmulOps, NativeOps,
+ *		interrupts) shares the host accrued flags. Pending guest
+ *		exceptions are collected before it runs, and whatever it
+ *		raised is dropped before guest code resumes
+ **/
+
+void powerpc_cpu::enter_host_code()
+{
+	sync_fpscr();
+}
+
+void powerpc_cpu::leave_host_code()
+{
+#if !PPC_ENABLE_FPU_EXCEPTIONS
+	feclearexcept(FE_INEXACT | FE_DIVBYZERO | FE_UNDERFLOW | FE_OVERFLOW);
+#endif
+}
+
 /**
  *	Floating-point arithmetics
  *
@@ -738,6 +791,23 @@ void powerpc_cpu::execute_store_string(uint32 opcode)
 		nb = 32;
 
 	int rs = rS_field::extract(opcode);
+#if 1
+	int i;
+	for (i = 0; nb - i >= 4; i += 4, rs = (rs + 1) & 0x1f)
+		vm_write_memory_4(ea + i, gpr(rs));
+	switch (nb - i) {
+	case 1:
+		vm_write_memory_1(ea + i, gpr(rs) >> 24);
+		break;
+	case 2:
+		vm_write_memory_2(ea + i, gpr(rs) >> 16);
+		break;
+	case 3:
+		vm_write_memory_2(ea + i, gpr(rs) >> 16);
+		vm_write_memory_1(ea + i + 2, gpr(rs) >> 8);
+		break;
+	}
+#else
 	int sh = 24;
 	for (int i = 0; i < nb; i++) {
 		vm_write_memory_1(ea + i, gpr(rs) >> sh);
@@ -747,6 +817,7 @@ void powerpc_cpu::execute_store_string(uint32 opcode)
 			rs = (rs + 1) & 0x1f;
 		}
 	}
+#endif
 
 	increment_pc(4);
 }
@@ -764,9 +835,7 @@ void powerpc_cpu::execute_lwarx(uint32 opcode)
 	uint32 reserve_data = vm_read_memory_4(ea);
 	regs().reserve_valid = 1;
 	regs().reserve_addr = ea;
-#if KPX_MAX_CPUS != 1
 	regs().reserve_data = reserve_data;
-#endif
 	operand_RD::set(this, opcode, reserve_data);
 	increment_pc(4);
 }
@@ -778,11 +847,9 @@ void powerpc_cpu::execute_stwcx(uint32 opcode)
 	cr().clear(0);
 	if (regs().reserve_valid) {
 		if (regs().reserve_addr == ea /* physical_addr(EA) */
-#if KPX_MAX_CPUS != 1
-			/* HACK: if another processor wrote to the reserved block,
-			   nothing happens, i.e. we should operate as if reserve == 0 */
+			/* HACK: if another processor, or host thread, wrote to the
+			   reserved block, we should operate as if reserve == 0 */
 			&& regs().reserve_data == vm_read_memory_4(ea)
-#endif
 			) {
 			vm_write_memory_4(ea, operand_RS::get(this, opcode));
 			cr().set(0, standalone_CR_EQ_field::mask());
@@ -866,10 +933,19 @@ void powerpc_cpu::execute_fp_int_convert(uint32 opcode)
 	// Convert to integer word if operand fits bounds
 	if (b >= -(double)0x80000000 && b <= (double)0x7fffffff) {
 #if defined mathlib_lrint
-		int old_round = fegetround();
-		fesetround(ppc_to_native_rounding_mode(r));
-		d.j = (int32)mathlib_lrint(b);
-		fesetround(old_round);
+		// The native rounding mode follows FPSCR[RN], so fctiw does
+		// not change it, and fctiwz simply truncates
+		if (r == 1)
+			d.j = (int32)b;
+		else {
+			const int round = ppc_to_native_rounding_mode(r);
+			const int old_round = fegetround();
+			if (round != old_round)
+				fesetround(round);
+			d.j = (int32)mathlib_lrint(b);
+			if (round != old_round)
+				fesetround(old_round);
+		}
 #else
 		switch (r) {
 		case 0: d.j = (int32)op_frin::apply(b); break; // near
@@ -1017,6 +1093,7 @@ void powerpc_cpu::execute_mcrfs(uint32 opcode)
 	const int crfD = crfD_field::extract(opcode);
 
 	// The contents of FPSCR field crfS are copied to CR field crfD
+	sync_fpscr();
 	const uint32 m = 0xf << (28 - 4 * crfS);
 	cr().set(crfD, (fpscr() & m) >> (28 - 4 * crfS));
 
@@ -1064,6 +1141,7 @@ void powerpc_cpu::execute_mtfsf(uint32 opcode)
 	exceptions &= ~(FPSCR_FEX_field::mask() | FPSCR_VX_field::mask());
 
 	// Move frB bits to FPSCR according to field mask
+	sync_fpscr();
 	fpscr() = (fpscr() & ~m) | exceptions;
 
 	// Update FPSCR exception bits (don't implicitly update FX)
@@ -1095,6 +1173,7 @@ void powerpc_cpu::execute_mtfsfi(uint32 opcode)
 	exceptions &= ~(FPSCR_FEX_field::mask() | FPSCR_VX_field::mask());
 
 	// Move immediate to FPSCR according to field crfD
+	sync_fpscr();
 	fpscr() = (fpscr() & ~m) | exceptions;
 
 	// Update native FP control word
@@ -1121,7 +1200,10 @@ void powerpc_cpu::execute_mtfsb(uint32 opcode)
 	m &= ~(FPSCR_FEX_field::mask() | FPSCR_VX_field::mask());
 
 	// Bit crbD of the FPSCR is set or clear
+	sync_fpscr();
 	fpscr() &= ~m;
+	if (set_bit)
+		fpscr() |= m;
 
 	// Update FPSCR exception bits
 	record_fpscr(set_bit ? m : 0);
@@ -1141,6 +1223,7 @@ template< class Rc >
 void powerpc_cpu::execute_mffs(uint32 opcode)
 {
 	// Move FPSCR to FPR(FRD)
+	sync_fpscr();
 	operand_fp_dw_RD::set(this, opcode, fpscr());
 
 	// Set CR1 (FX, FEX, VX, VOX) if instruction has Rc set
@@ -1491,8 +1574,9 @@ void powerpc_cpu::execute_vector_arith_odd(uint32 opcode)
 template< class VD, class VA, class VB, int LO >
 void powerpc_cpu::execute_vector_merge(uint32 opcode)
 {
-	typename VA::type const & vA = VA::const_ref(this, opcode);
-	typename VB::type const & vB = VB::const_ref(this, opcode);
+	// NOTE: sources are copied since vD may alias vA or vB
+	typename VA::type const vA = VA::const_ref(this, opcode);
+	typename VB::type const vB = VB::const_ref(this, opcode);
 	typename VD::type & vD = VD::ref(this, opcode);
 	const int n_elements = 16 / VD::element_size;
 
@@ -1518,8 +1602,9 @@ void powerpc_cpu::execute_vector_merge(uint32 opcode)
 template< class VD, class VA, class VB >
 void powerpc_cpu::execute_vector_pack(uint32 opcode)
 {
-	typename VA::type const & vA = VA::const_ref(this, opcode);
-	typename VB::type const & vB = VB::const_ref(this, opcode);
+	// NOTE: sources are copied since vD may alias vA or vB
+	typename VA::type const vA = VA::const_ref(this, opcode);
+	typename VB::type const vB = VB::const_ref(this, opcode);
 	typename VD::type & vD = VD::ref(this, opcode);
 	const int n_elements = 16 / VD::element_size;
 	const int n_pivot = n_elements / 2;
@@ -1541,7 +1626,8 @@ void powerpc_cpu::execute_vector_pack(uint32 opcode)
 template< int LO, class VD, class VA >
 void powerpc_cpu::execute_vector_unpack(uint32 opcode)
 {
-	typename VA::type const & vA = VA::const_ref(this, opcode);
+	// NOTE: the source is copied since vD may alias it
+	typename VA::type const vA = VA::const_ref(this, opcode);
 	typename VD::type & vD = VD::ref(this, opcode);
 	const int n_elements = 16 / VD::element_size;
 
@@ -1553,8 +1639,9 @@ void powerpc_cpu::execute_vector_unpack(uint32 opcode)
 
 void powerpc_cpu::execute_vector_pack_pixel(uint32 opcode)
 {
-	powerpc_vr const & vA = vr(vA_field::extract(opcode));
-	powerpc_vr const & vB = vr(vB_field::extract(opcode));
+	// NOTE: sources are copied since vD may alias vA or vB
+	powerpc_vr const vA = vr(vA_field::extract(opcode));
+	powerpc_vr const vB = vr(vB_field::extract(opcode));
 	powerpc_vr & vD = vr(vD_field::extract(opcode));
 
 	for (int i = 0; i < 4; i++) {
@@ -1570,7 +1657,8 @@ void powerpc_cpu::execute_vector_pack_pixel(uint32 opcode)
 template< int LO >
 void powerpc_cpu::execute_vector_unpack_pixel(uint32 opcode)
 {
-	powerpc_vr const & vB = vr(vB_field::extract(opcode));
+	// NOTE: the source is copied since vD may alias it
+	powerpc_vr const vB = vr(vB_field::extract(opcode));
 	powerpc_vr & vD = vr(vD_field::extract(opcode));
 
 	for (int i = 0; i < 4; i++) {
@@ -1635,8 +1723,9 @@ void powerpc_cpu::execute_vector_shift(uint32 opcode)
 template< int SD, class VD, class VA, class VB, class SH >
 void powerpc_cpu::execute_vector_shift_octet(uint32 opcode)
 {
-	typename VA::type const & vA = VA::const_ref(this, opcode);
-	typename VB::type const & vB = VB::const_ref(this, opcode);
+	// NOTE: sources are copied since vD may alias vA or vB
+	typename VA::type const vA = VA::const_ref(this, opcode);
+	typename VB::type const vB = VB::const_ref(this, opcode);
 	typename VD::type & vD = VD::ref(this, opcode);
 
 	const int sh = SH::get(this, opcode);
@@ -1755,9 +1844,10 @@ void powerpc_cpu::execute_vector_sum(uint32 opcode)
 
 void powerpc_cpu::execute_vector_permute(uint32 opcode)
 {
-	powerpc_vr const & vA = vr(vA_field::extract(opcode));
-	powerpc_vr const & vB = vr(vB_field::extract(opcode));
-	powerpc_vr const & vC = vr(vC_field::extract(opcode));
+	// NOTE: sources are copied since vD may alias vA, vB or vC
+	powerpc_vr const vA = vr(vA_field::extract(opcode));
+	powerpc_vr const vB = vr(vB_field::extract(opcode));
+	powerpc_vr const vC = vr(vC_field::extract(opcode));
 	powerpc_vr & vD = vr(vD_field::extract(opcode));
 
 	for (int i = 0; i < 16; i++) {
@@ -30,10 +30,28 @@
 // Mid-level code generator info
 const powerpc_jit::jit_info_t *powerpc_jit::jit_info[PPC_I(MAX)];
 
+#if PPC_ENABLE_NATIVE_JIT
+// Native code generator info
+const powerpc_jit::native_info_t *powerpc_jit::native_info[PPC_I(MAX)];
+#endif
+
+// Native load/stores require guest addresses that translate to host
+// addresses with a plain 32-bit addition
+#if DYNAMIC_ADDRESSING || (DIRECT_ADDRESSING && defined(SHEEPSHAVER))
+#define NATIVE_MEMORY_ACCESS 1
+#else
+#define NATIVE_MEMORY_ACCESS 0
+#endif
+
 // PowerPC JIT initializer
 powerpc_jit::powerpc_jit(dyngen_cpu_base cpu)
 	: powerpc_dyngen(cpu)
 {
+#if PPC_ENABLE_NATIVE_JIT
+	native_codegen = false;
+	native_optimizer = false;
+	gen_native_start();
+#endif
 }
 
 bool powerpc_jit::initialize(void)
@@ -196,6 +214,35 @@ bool powerpc_jit::initialize(void)
 			DEFINE_OP(VREFP,	2, PS,RCP),
 			DEFINE_OP(VRSQRTEFP,2, PS,RSQRT),
 #undef DEFINE_OP
+#define DEFINE_OP(MNEMO, SAT_OP, MOD_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_arith_sat, (X86_SSE_##MOD_OP << 8) | X86_SSE_##SAT_OP }
+			DEFINE_OP(VADDUBS,	PADDUSB, PADDB),
+			DEFINE_OP(VADDSBS,	PADDSB,  PADDB),
+			DEFINE_OP(VADDUHS,	PADDUSW, PADDW),
+			DEFINE_OP(VADDSHS,	PADDSW,  PADDW),
+			DEFINE_OP(VSUBUBS,	PSUBUSB, PSUBB),
+			DEFINE_OP(VSUBSBS,	PSUBSB,  PSUBB),
+			DEFINE_OP(VSUBUHS,	PSUBUSW, PSUBW),
+			DEFINE_OP(VSUBSHS,	PSUBSW,  PSUBW),
+#undef DEFINE_OP
+#define DEFINE_OP(MNEMO, GEN_OP, OPTION) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_##GEN_OP, OPTION }
+			DEFINE_OP(VCMPGTUB,	vcmpgtu, X86_SSE_PCMPGTB),
+			DEFINE_OP(VCMPGTUH,	vcmpgtu, X86_SSE_PCMPGTW),
+			DEFINE_OP(VCMPGTUW,	vcmpgtu, X86_SSE_PCMPGTD),
+			DEFINE_OP(VMAXSB,	vmaxmin, X86_SSE_PCMPGTB),
+			DEFINE_OP(VMAXSW,	vmaxmin, X86_SSE_PCMPGTD),
+			DEFINE_OP(VMAXUW,	vmaxmin, X86_SSE_PCMPGTD | 0x200),
+			DEFINE_OP(VMINSB,	vmaxmin, X86_SSE_PCMPGTB | 0x100),
+			DEFINE_OP(VMINSW,	vmaxmin, X86_SSE_PCMPGTD | 0x100),
+			DEFINE_OP(VMINUW,	vmaxmin, X86_SSE_PCMPGTD | 0x300),
+			DEFINE_OP(VMRGHB,	vmerge, X86_SSE_PUNPCKLBW),
+			DEFINE_OP(VMRGHH,	vmerge, X86_SSE_PUNPCKLWD),
+			DEFINE_OP(VMRGHW,	vmerge, X86_SSE_PUNPCKLDQ),
+			DEFINE_OP(VMRGLB,	vmerge, X86_SSE_PUNPCKHBW),
+			DEFINE_OP(VMRGLH,	vmerge, X86_SSE_PUNPCKHWD),
+			DEFINE_OP(VMRGLW,	vmerge, X86_SSE_PUNPCKHDQ),
+#undef DEFINE_OP
 #define DEFINE_OP(MNEMO, GEN_OP) \
 			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_##GEN_OP, }
 			DEFINE_OP(VSEL,		vsel),
@@ -205,7 +252,52 @@ bool powerpc_jit::initialize(void)
 			DEFINE_OP(VSPLTW,	vspltw),
 			DEFINE_OP(VSPLTISB,	vspltisb),
 			DEFINE_OP(VSPLTISH,	vspltish),
-			DEFINE_OP(VSPLTISW,	vspltisw)
+			DEFINE_OP(VSPLTISW,	vspltisw),
+			DEFINE_OP(VADDUWS,	arith_uw),
+			DEFINE_OP(VSUBUWS,	arith_uw),
+			DEFINE_OP(VADDSWS,	arith_sw),
+			DEFINE_OP(VSUBSWS,	arith_sw),
+			DEFINE_OP(VADDCUW,	vaddcuw),
+			DEFINE_OP(VSUBCUW,	vsubcuw),
+			DEFINE_OP(VNOR,		vnor),
+			DEFINE_OP(VAVGSB,	vavg),
+			DEFINE_OP(VAVGSH,	vavg),
+			DEFINE_OP(VAVGSW,	vavg),
+			DEFINE_OP(VAVGUW,	vavg),
+			DEFINE_OP(VMAXUH,	vmaxuh),
+			DEFINE_OP(VMINUH,	vminuh),
+			DEFINE_OP(VPKUHUM,	vpack),
+			DEFINE_OP(VPKUWUM,	vpack),
+			DEFINE_OP(VPKSHSS,	vpack),
+			DEFINE_OP(VPKSHUS,	vpack),
+			DEFINE_OP(VPKSWSS,	vpack),
+			DEFINE_OP(VPKUHUS,	vpack),
+			DEFINE_OP(VUPKHSB,	vunpack),
+			DEFINE_OP(VUPKHSH,	vunpack),
+			DEFINE_OP(VUPKLSB,	vunpack),
+			DEFINE_OP(VUPKLSH,	vunpack),
+			DEFINE_OP(VMULEUB,	vmul),
+			DEFINE_OP(VMULESB,	vmul),
+			DEFINE_OP(VMULEUH,	vmul),
+			DEFINE_OP(VMULESH,	vmul),
+			DEFINE_OP(VMULOUB,	vmul),
+			DEFINE_OP(VMULOSB,	vmul),
+			DEFINE_OP(VMULOUH,	vmul),
+			DEFINE_OP(VMULOSH,	vmul),
+			DEFINE_OP(VMLADDUHM,vmladduhm),
+			DEFINE_OP(VMSUMUBM,	vmsum),
+			DEFINE_OP(VMSUMMBM,	vmsum),
+			DEFINE_OP(VMSUMSHM,	vmsum),
+			DEFINE_OP(VMSUMUHM,	vmsum),
+			DEFINE_OP(VSUM4UBS,	vsum4),
+			DEFINE_OP(VSUM4SBS,	vsum4),
+			DEFINE_OP(VSUM4SHS,	vsum4),
+			DEFINE_OP(VSL,		vshift),
+			DEFINE_OP(VSR,		vshift),
+			DEFINE_OP(VCFSX,	vcfx),
+			DEFINE_OP(VCFUX,	vcfx),
+			DEFINE_OP(VCTSXS,	vctsxs),
+			DEFINE_OP(VCTUXS,	vctuxs)
 #undef DEFINE_OP
 		};
 
@@ -222,7 +314,9 @@ bool powerpc_jit::initialize(void)
 			DEFINE_OP(LVXL,		lvx),
 			DEFINE_OP(STVX,		stvx),
 			DEFINE_OP(STVXL,	stvx),
-			DEFINE_OP(VPERM,	vperm)
+			DEFINE_OP(VPERM,	vperm),
+			DEFINE_OP(VSLO,		vshift_octet),
+			DEFINE_OP(VSRO,		vshift_octet)
 #undef DEFINE_OP
 		};
 
@@ -230,6 +324,251 @@ bool powerpc_jit::initialize(void)
 			for (int i = 0; i < sizeof(ssse3_vector) / sizeof(ssse3_vector[0]); i++)
 				jit_info[ssse3_vector[i].mnemo] = &ssse3_vector[i];
 		}
+
+		// SSE4.1 optimized handlers
+		static const jit_info_t sse41_vector[] = {
+#define DEFINE_OP(MNEMO, SSE_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse2_arith_2, (X86_INSN_SSE_3P << 8) | X86_SSE41_##SSE_OP }
+			DEFINE_OP(VMAXSB,	PMAXSB),
+			DEFINE_OP(VMAXSW,	PMAXSD),
+			DEFINE_OP(VMAXUH,	PMAXUW),
+			DEFINE_OP(VMAXUW,	PMAXUD),
+			DEFINE_OP(VMINSB,	PMINSB),
+			DEFINE_OP(VMINSW,	PMINSD),
+			DEFINE_OP(VMINUH,	PMINUW),
+			DEFINE_OP(VMINUW,	PMINUD),
+#undef DEFINE_OP
+#define DEFINE_OP(MNEMO, GEN_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse41_##GEN_OP, }
+			DEFINE_OP(VPKSWUS,	vpack),
+			DEFINE_OP(VPKUWUS,	vpack),
+#undef DEFINE_OP
+#define DEFINE_OP(MNEMO, MODE) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_sse41_vrfi, MODE }
+			DEFINE_OP(VRFIM,	0x9),
+			DEFINE_OP(VRFIP,	0xa),
+			DEFINE_OP(VRFIZ,	0xb)
+#undef DEFINE_OP
+		};
+
+		if (cpuinfo_check_sse4_1()) {
+			for (int i = 0; i < sizeof(sse41_vector) / sizeof(sse41_vector[0]); i++)
+				jit_info[sse41_vector[i].mnemo] = &sse41_vector[i];
+		}
+
+		// AVX2 optimized handlers
+		static const jit_info_t avx2_vector[] = {
+#define DEFINE_OP(MNEMO, GEN_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_avx2_##GEN_OP, }
+			DEFINE_OP(VSLW,		vshw),
+			DEFINE_OP(VSRW,		vshw),
+			DEFINE_OP(VSRAW,	vshw),
+			DEFINE_OP(VSLH,		vshh),
+			DEFINE_OP(VSRH,		vshh),
+			DEFINE_OP(VSRAH,	vshh),
+			DEFINE_OP(VRLW,		vrlw)
+#undef DEFINE_OP
+		};
+
+		if (cpuinfo_check_avx2()) {
+			for (int i = 0; i < sizeof(avx2_vector) / sizeof(avx2_vector[0]); i++)
+				jit_info[avx2_vector[i].mnemo] = &avx2_vector[i];
+		}
+
+#if NATIVE_MEMORY_ACCESS
+		// SSSE3 optimized load/store multiple and string handlers
+		static const jit_info_t ssse3_multiple[] = {
+#define DEFINE_OP(MNEMO, GEN_OP) \
+			{ PPC_I(MNEMO), (gen_handler_t)&powerpc_jit::gen_ssse3_##GEN_OP, }
+			DEFINE_OP(LMW,		load_multiple),
+			DEFINE_OP(LSWI,		load_multiple),
+			DEFINE_OP(STMW,		store_multiple),
+			DEFINE_OP(STSWI,	store_multiple)
+#undef DEFINE_OP
+		};
+
+		if (cpuinfo_check_ssse3()) {
+			for (int i = 0; i < sizeof(ssse3_multiple) / sizeof(ssse3_multiple[0]); i++)
+				jit_info[ssse3_multiple[i].mnemo] = &ssse3_multiple[i];
+		}
+#endif
+#endif
+
+#if PPC_ENABLE_NATIVE_JIT
+		// default to no native handler
+		static const native_info_t native_not_available = {
+			-1,
+			&powerpc_jit::gen_native_not_available,
+			0,
+			0
+		};
+		for (int i = 0; i < PPC_I(MAX); i++)
+			native_info[i] = &native_not_available;
+
+		// native integer handlers
+		static const native_info_t native_integer[] = {
+#define DEFINE_OP(MNEMO, GEN_OP, OPTION, FLAGS) \
+			{ PPC_I(MNEMO), &powerpc_jit::gen_native_##GEN_OP, OPTION, FLAGS }
+#define D_RD	NATIVE_DEF_RD
+#define D_RA	NATIVE_DEF_RA
+#define D_CR0	NATIVE_DEF_CR0
+#define D_RC	NATIVE_DEF_RC
+#define D_CRFD	NATIVE_DEF_CRFD
+#define D_CA	NATIVE_DEF_CA
+#define U_RA	NATIVE_USE_RA
+#define U_RA0	NATIVE_USE_RA0
+#define U_RB	NATIVE_USE_RB
+#define U_RS	NATIVE_USE_RS
+#define N_OE	NATIVE_OE
+			DEFINE_OP(ADDI,		addi,		0,			D_RD|U_RA0),
+			DEFINE_OP(ADDIS,	addi,		16,			D_RD|U_RA0),
+			DEFINE_OP(ADD,		arith,		X86_ADD,	D_RD|D_RC|U_RA|U_RB|N_OE),
+			DEFINE_OP(SUBF,		arith,		X86_SUB,	D_RD|D_RC|U_RA|U_RB|N_OE),
+			DEFINE_OP(MULLW,	arith,		-1,			D_RD|D_RC|U_RA|U_RB|N_OE),
+			DEFINE_OP(NEG,		arith,		-1,			D_RD|D_RC|U_RA|N_OE),
+			DEFINE_OP(MULLI,	arith,		-1,			D_RD|U_RA),
+			DEFINE_OP(ADDC,		carry,		0,			D_RD|D_RC|D_CA|U_RA|U_RB|N_OE),
+			DEFINE_OP(ADDE,		carry,		0,			D_RD|D_RC|D_CA|U_RA|U_RB|N_OE),
+			DEFINE_OP(ADDME,	carry,		0,			D_RD|D_RC|D_CA|U_RA|N_OE),
+			DEFINE_OP(ADDZE,	carry,		0,			D_RD|D_RC|D_CA|U_RA|N_OE),
+			DEFINE_OP(SUBFC,	carry,		0,			D_RD|D_RC|D_CA|U_RA|U_RB|N_OE),
+			DEFINE_OP(SUBFE,	carry,		0,			D_RD|D_RC|D_CA|U_RA|U_RB|N_OE),
+			DEFINE_OP(SUBFME,	carry,		0,			D_RD|D_RC|D_CA|U_RA|N_OE),
+			DEFINE_OP(SUBFZE,	carry,		0,			D_RD|D_RC|D_CA|U_RA|N_OE),
+			DEFINE_OP(ADDIC,	carry,		0,			D_RD|D_CA|U_RA),
+			DEFINE_OP(ADDIC_,	carry,		0,			D_RD|D_CA|D_CR0|U_RA),
+			DEFINE_OP(SUBFIC,	carry,		0,			D_RD|D_CA|U_RA),
+			DEFINE_OP(AND,		logical,	X86_AND,	D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(ANDC,		logical,	X86_AND,	D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(NAND,		logical,	X86_AND,	D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(OR,		logical,	X86_OR,		D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(ORC,		logical,	X86_OR,		D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(NOR,		logical,	X86_OR,		D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(XOR,		logical,	X86_XOR,	D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(EQV,		logical,	X86_XOR,	D_RA|D_RC|U_RS|U_RB),
+			DEFINE_OP(ANDI,		logical_im,	X86_AND,	D_RA|D_CR0|U_RS),
+			DEFINE_OP(ANDIS,	logical_im,	X86_AND,	D_RA|D_CR0|U_RS),
+			DEFINE_OP(ORI,		logical_im,	X86_OR,		D_RA|U_RS),
+			DEFINE_OP(ORIS,		logical_im,	X86_OR,		D_RA|U_RS),
+			DEFINE_OP(XORI,		logical_im,	X86_XOR,	D_RA|U_RS),
+			DEFINE_OP(XORIS,	logical_im,	X86_XOR,	D_RA|U_RS),
+			DEFINE_OP(EXTSB,	extend,		1,			D_RA|D_RC|U_RS),
+			DEFINE_OP(EXTSH,	extend,		2,			D_RA|D_RC|U_RS),
+			DEFINE_OP(RLWINM,	rlwinm,		0,			D_RA|D_RC|U_RS),
+			DEFINE_OP(CMP,		compare,	1,			D_CRFD|U_RA|U_RB),
+			DEFINE_OP(CMPI,		compare,	1,			D_CRFD|U_RA),
+			DEFINE_OP(CMPL,		compare,	0,			D_CRFD|U_RA|U_RB),
+			DEFINE_OP(CMPLI,	compare,	0,			D_CRFD|U_RA),
+			DEFINE_OP(MFCR,		mfcr,		0,			D_RD),
+			DEFINE_OP(MTCRF,	mtcrf,		0,			U_RS),
+#undef D_RD
+#undef D_RA
+#undef D_CR0
+#undef D_RC
+#undef D_CRFD
+#undef D_CA
+#undef U_RA
+#undef U_RA0
+#undef U_RB
+#undef U_RS
+#undef N_OE
+#undef DEFINE_OP
+		};
+		for (int i = 0; i < sizeof(native_integer) / sizeof(native_integer[0]); i++)
+			native_info[native_integer[i].mnemo] = &native_integer[i];
+
+#if PPC_ENABLE_FPU_EXCEPTIONS == 0
+		// native scalar SSE2 floating-point handlers, option is
+		// (SSE2 operation | negate << 8 | single << 9)
+		static const native_info_t native_fp[] = {
+#define DEFINE_OP(MNEMO, GEN_OP, OP, NEG, SINGLE) \
+			{ PPC_I(MNEMO), &powerpc_jit::gen_native_fp_##GEN_OP, (OP) | ((NEG) << 8) | ((SINGLE) << 9), NATIVE_DEF_FPR | NATIVE_RC }
+			DEFINE_OP(FADD,		arith,	X86_SSE_ADD, 0, 0),
+			DEFINE_OP(FSUB,		arith,	X86_SSE_SUB, 0, 0),
+			DEFINE_OP(FMUL,		arith,	X86_SSE_MUL, 0, 0),
+			DEFINE_OP(FDIV,		arith,	X86_SSE_DIV, 0, 0),
+			DEFINE_OP(FADDS,	arith,	X86_SSE_ADD, 0, 1),
+			DEFINE_OP(FSUBS,	arith,	X86_SSE_SUB, 0, 1),
+			DEFINE_OP(FMULS,	arith,	X86_SSE_MUL, 0, 1),
+			DEFINE_OP(FDIVS,	arith,	X86_SSE_DIV, 0, 1),
+			DEFINE_OP(FMADD,	madd,	X86_SSE_ADD, 0, 0),
+			DEFINE_OP(FMSUB,	madd,	X86_SSE_SUB, 0, 0),
+			DEFINE_OP(FNMADD,	madd,	X86_SSE_ADD, 1, 0),
+			DEFINE_OP(FNMSUB,	madd,	X86_SSE_SUB, 1, 0),
+			DEFINE_OP(FMADDS,	madd,	X86_SSE_ADD, 0, 1),
+			DEFINE_OP(FMSUBS,	madd,	X86_SSE_SUB, 0, 1),
+			DEFINE_OP(FNMADDS,	madd,	X86_SSE_ADD, 1, 1),
+			DEFINE_OP(FNMSUBS,	madd,	X86_SSE_SUB, 1, 1),
+			DEFINE_OP(FMR,		move,	0, 0, 0),
+			DEFINE_OP(FNEG,		move,	X86_SSE_XOR, 0, 0),
+			DEFINE_OP(FABS,		move,	X86_SSE_ANDN, 0, 0),
+			DEFINE_OP(FNABS,	move,	X86_SSE_OR, 0, 0),
+#undef DEFINE_OP
+		};
+		for (int i = 0; i < sizeof(native_fp) / sizeof(native_fp[0]); i++)
+			native_info[native_fp[i].mnemo] = &native_fp[i];
+#endif
+
+#if NATIVE_MEMORY_ACCESS
+		// native load/store handlers, option is (size | sign << 4 | update << 5 | indexed << 6)
+		static const native_info_t native_memory[] = {
+#define DEFINE_OP(MNEMO, GEN_OP, SIZE, SIGN, UPDATE, INDEXED) \
+			{ PPC_I(MNEMO), &powerpc_jit::gen_native_##GEN_OP, (SIZE) | ((SIGN) << 4) | ((UPDATE) << 5) | ((INDEXED) << 6), \
+			  DEF_##GEN_OP | ((UPDATE) ? NATIVE_DEF_RA | NATIVE_USE_RA : NATIVE_USE_RA0) | ((INDEXED) ? NATIVE_USE_RB : 0) }
+#define DEF_load	NATIVE_DEF_RD
+#define DEF_store	(NATIVE_DEF_MEM | NATIVE_USE_RS)
+#define DEF_load_fpr	NATIVE_DEF_FPR
+#define DEF_store_fpr	NATIVE_DEF_MEM
+			DEFINE_OP(LBZ,		load,	1, 0, 0, 0),
+			DEFINE_OP(LBZU,		load,	1, 0, 1, 0),
+			DEFINE_OP(LBZUX,	load,	1, 0, 1, 1),
+			DEFINE_OP(LBZX,		load,	1, 0, 0, 1),
+			DEFINE_OP(LHA,		load,	2, 1, 0, 0),
+			DEFINE_OP(LHAU,		load,	2, 1, 1, 0),
+			DEFINE_OP(LHAUX,	load,	2, 1, 1, 1),
+			DEFINE_OP(LHAX,		load,	2, 1, 0, 1),
+			DEFINE_OP(LHZ,		load,	2, 0, 0, 0),
+			DEFINE_OP(LHZU,		load,	2, 0, 1, 0),
+			DEFINE_OP(LHZUX,	load,	2, 0, 1, 1),
+			DEFINE_OP(LHZX,		load,	2, 0, 0, 1),
+			DEFINE_OP(LWZ,		load,	4, 0, 0, 0),
+			DEFINE_OP(LWZU,		load,	4, 0, 1, 0),
+			DEFINE_OP(LWZUX,	load,	4, 0, 1, 1),
+			DEFINE_OP(LWZX,		load,	4, 0, 0, 1),
+			DEFINE_OP(STB,		store,	1, 0, 0, 0),
+			DEFINE_OP(STBU,		store,	1, 0, 1, 0),
+			DEFINE_OP(STBUX,	store,	1, 0, 1, 1),
+			DEFINE_OP(STBX,		store,	1, 0, 0, 1),
+			DEFINE_OP(STH,		store,	2, 0, 0, 0),
+			DEFINE_OP(STHU,		store,	2, 0, 1, 0),
+			DEFINE_OP(STHUX,	store,	2, 0, 1, 1),
+			DEFINE_OP(STHX,		store,	2, 0, 0, 1),
+			DEFINE_OP(STW,		store,	4, 0, 0, 0),
+			DEFINE_OP(STWU,		store,	4, 0, 1, 0),
+			DEFINE_OP(STWUX,	store,	4, 0, 1, 1),
+			DEFINE_OP(STWX,		store,	4, 0, 0, 1),
+			DEFINE_OP(LFD,		load_fpr,	8, 0, 0, 0),
+			DEFINE_OP(LFDU,		load_fpr,	8, 0, 1, 0),
+			DEFINE_OP(LFDUX,	load_fpr,	8, 0, 1, 1),
+			DEFINE_OP(LFDX,		load_fpr,	8, 0, 0, 1),
+			DEFINE_OP(STFD,		store_fpr,	8, 0, 0, 0),
+			DEFINE_OP(STFDU,	store_fpr,	8, 0, 1, 0),
+			DEFINE_OP(STFDUX,	store_fpr,	8, 0, 1, 1),
+			DEFINE_OP(STFDX,	store_fpr,	8, 0, 0, 1),
+#if KPX_MAX_CPUS == 1
+			// the reservation is a side effect of lwarx, even if rD is dead
+			{ PPC_I(LWARX),  &powerpc_jit::gen_native_lwarx, 0, NATIVE_DEF_RD | NATIVE_DEF_MEM | NATIVE_USE_RA0 | NATIVE_USE_RB },
+			{ PPC_I(STWCX),  &powerpc_jit::gen_native_stwcx, 0, NATIVE_DEF_CR0 | NATIVE_DEF_MEM | NATIVE_USE_RS | NATIVE_USE_RA0 | NATIVE_USE_RB },
+#endif
+#undef DEF_load
+#undef DEF_store
+#undef DEF_load_fpr
+#undef DEF_store_fpr
+#undef DEFINE_OP
+		};
+		for (int i = 0; i < sizeof(native_memory) / sizeof(native_memory[0]); i++)
+			native_info[native_memory[i].mnemo] = &native_memory[i];
+#endif
 #endif
 	}
 
@@ -257,6 +596,11 @@ bool powerpc_jit::gen_vector_compare(int mnemo, int vD, int vA, int vB, bool Rc)
 	return (this->*((bool (powerpc_jit::*)(int, int, int, int, bool))jit_info[mnemo]->handler))(mnemo, vD, vA, vB, Rc);
 }
 
+bool powerpc_jit::gen_multiple(int mnemo, int r, int rA, int32 d, int nb)
+{
+	return (this->*((bool (powerpc_jit::*)(int, int, int, int32, int))jit_info[mnemo]->handler))(mnemo, r, rA, d, nb);
+}
+
 
 bool powerpc_jit::gen_not_available(int mnemo)
 {
@@ -838,105 +1182,2103 @@ bool powerpc_jit::gen_sse2_vspltw(int mnemo, int vD, int UIMM, int vB)
 }
 
 /*
- *	SSSE3 optimizations
+ *	Saturating and widening integer operations
+ *
+ *	VSCR[SAT] is accumulated from element masks with a pmovmskb/sbb pair,
+ *	so that no branch is emitted in the common non saturating case.
  */
 
-uintptr powerpc_jit::gen_ssse3_vswap_mask(void)
+// Splat a 32-bit constant into vR
+void powerpc_jit::gen_sse2_vconst(int vR, uint32 value)
 {
-	// We must get the following bytes in memory
-	// 0x3 0x2 0x1 0x0 0x7 0x6 0x5 0x4 0xb 0xa 0x9 0x8 0xf 0xe 0xd 0xc
-	static uintptr control_mask = 0;
-	if (control_mask == 0) {
-		static const uint8 value[16] = {
-			0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04,
-			0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c
-		};
-		control_mask = (uintptr)copy_data(value, sizeof(value));
-		assert(control_mask <= 0xffffffff);
+	if (value == 0)
+		gen_pxor(vR, vR);
+	else if (value == 0xffffffff)
+		gen_pcmpeqd(vR, vR);
+	else {
+		gen_mov_32(x86_immediate_operand(value), REG_T0_ID);
+		gen_movd_lx(REG_T0_ID, vR);
+		gen_pshufd(x86_immediate_operand(0), vR, vR);
 	}
-	return control_mask;
 }
 
-// lvx, lvxl
-bool powerpc_jit::gen_ssse3_lvx(int mnemo, int vD, int rA, int rB)
+// Set VSCR[SAT] if any element of the mask vM is set
+void powerpc_jit::gen_sse2_record_sat(int vM)
 {
-	gen_mov_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), REG_T0_ID);
-	if (rA != 0)
-		gen_add_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), REG_T0_ID);
-	gen_and_32(x86_immediate_operand(-16), REG_T0_ID);
+	gen_pmovmskb(vM, REG_T0_ID);										// pmovmskb %vM,%t0
+	gen_neg_32(REG_T0_ID);												// CF = (%t0 != 0)
+	gen_sbb_32(REG_T0_ID, REG_T0_ID);									// %t0 = -CF
+	gen_and_32(x86_immediate_operand(1), REG_T0_ID);					// VSCR[SAT] mask
+	gen_or_32(REG_T0_ID, x86_memory_operand(xPPC_VSCR, REG_CPU_ID));
+}
 
-	x86_memory_operand vswapmask(gen_ssse3_vswap_mask(), X86_NOREG);
-	gen_movdqa(x86_memory_operand(0, REG_T0_ID), REG_V0_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, vswapmask, REG_V0_ID);
+// Set VSCR[SAT] if vR and vS differ, vR is clobbered
+void powerpc_jit::gen_sse2_record_sat_diff(int vR, int vS)
+{
+	gen_pcmpeqb(vS, vR);												// pcmpeqb %vS,%vR
+	gen_pmovmskb(vR, REG_T0_ID);										// pmovmskb %vR,%t0
+	gen_cmp_32(x86_immediate_operand(0xffff), REG_T0_ID);				// CF = (%t0 != 0xffff)
+	gen_sbb_32(REG_T0_ID, REG_T0_ID);									// %t0 = -CF
+	gen_and_32(x86_immediate_operand(1), REG_T0_ID);					// VSCR[SAT] mask
+	gen_or_32(REG_T0_ID, x86_memory_operand(xPPC_VSCR, REG_CPU_ID));
+}
+
+// Set VSCR[SAT] if any element of V0 or V1, once biased, does not fit
+// in its lower half. Clobbers V2 and V3
+void powerpc_jit::gen_sse2_record_pack_sat(int shift, uint32 bias)
+{
+	gen_movdqa(REG_V0_ID, REG_V2_ID);
+	if (bias) {
+		gen_sse2_vconst(REG_V3_ID, bias);
+		if (shift == 8) {
+			gen_paddw(REG_V3_ID, REG_V2_ID);
+			gen_paddw(REG_V1_ID, REG_V3_ID);
+		}
+		else {
+			gen_paddd(REG_V3_ID, REG_V2_ID);
+			gen_paddd(REG_V1_ID, REG_V3_ID);
+		}
+		gen_por(REG_V3_ID, REG_V2_ID);
+	}
+	else
+		gen_por(REG_V1_ID, REG_V2_ID);
+	if (shift == 8)
+		gen_psrlw(x86_immediate_operand(8), REG_V2_ID);
+	else
+		gen_psrld(x86_immediate_operand(16), REG_V2_ID);
+	gen_pxor(REG_V3_ID, REG_V3_ID);
+	gen_sse2_record_sat_diff(REG_V2_ID, REG_V3_ID);
+}
+
+// V0 = V0 + V1 with unsigned 32-bit saturation, clobbers V1-V3
+void powerpc_jit::gen_sse2_adduws(void)
+{
+	// An unsigned add overflowed if the result is below either operand
+	gen_sse2_vconst(REG_V2_ID, 0x80000000);
+	gen_movdqa(REG_V0_ID, REG_V3_ID);
+	gen_pxor(REG_V2_ID, REG_V3_ID);
+	gen_paddd(REG_V1_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V1_ID);
+	gen_pxor(REG_V2_ID, REG_V1_ID);
+	gen_pcmpgtd(REG_V1_ID, REG_V3_ID);
+	gen_sse2_record_sat(REG_V3_ID);
+	gen_por(REG_V3_ID, REG_V0_ID);
+}
+
+// V0 = V0 +/- V1 with signed 32-bit saturation, clobbers V1-V3
+void powerpc_jit::gen_sse2_addsws(bool sub)
+{
+	// Overflow occured if the sign of the result differs from the sign
+	// of both operands (add), or from the sign of vA when vA and vB
+	// have opposite signs (sub)
+	gen_movdqa(REG_V0_ID, REG_V2_ID);
+	if (sub)
+		gen_psubd(REG_V1_ID, REG_V0_ID);
+	else
+		gen_paddd(REG_V1_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V3_ID);
+	gen_pxor(REG_V2_ID, REG_V3_ID);
+	gen_pxor(sub ? REG_V2_ID : REG_V0_ID, REG_V1_ID);
+	gen_pand(REG_V1_ID, REG_V3_ID);
+	gen_psrad(x86_immediate_operand(31), REG_V3_ID);
+	gen_sse2_record_sat(REG_V3_ID);
+
+	// Saturated value is 0x7fffffff or 0x80000000 depending on sign(vA)
+	gen_psrad(x86_immediate_operand(31), REG_V2_ID);
+	gen_sse2_vconst(REG_V1_ID, 0x7fffffff);
+	gen_pxor(REG_V1_ID, REG_V2_ID);
+	gen_pand(REG_V3_ID, REG_V2_ID);
+	gen_pandn(REG_V0_ID, REG_V3_ID);
+	gen_por(REG_V2_ID, REG_V3_ID);
+	gen_movdqa(REG_V3_ID, REG_V0_ID);
+}
+
+// Byte and halfword saturating arith (PADDUS, PADDS, PSUBUS, PSUBS)
+bool powerpc_jit::gen_sse2_arith_sat(int mnemo, int vD, int vA, int vB)
+{
+	// NOTE: VSCR[SAT] is set if the modular result differs
+	const uint16 insn = jit_info[mnemo]->o.value;
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V1_ID);
+	gen_insn(X86_INSN_SSE_PI, insn & 0xff, x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_insn(X86_INSN_SSE_PI, insn >> 8, x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
 	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	gen_sse2_record_sat_diff(REG_V1_ID, REG_V0_ID);
 	return true;
 }
 
-// stvx, stvxl
-bool powerpc_jit::gen_ssse3_stvx(int mnemo, int vS, int rA, int rB)
+// vadduws, vsubuws
+bool powerpc_jit::gen_sse2_arith_uw(int mnemo, int vD, int vA, int vB)
 {
-	gen_mov_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), REG_T0_ID);
-	if (rA != 0)
-		gen_add_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), REG_T0_ID);
-	gen_and_32(x86_immediate_operand(-16), REG_T0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	if (mnemo == PPC_I(VADDUWS))
+		gen_sse2_adduws();
+	else {
+		// Clamp to zero where vB > vA
+		gen_sse2_vconst(REG_V2_ID, 0x80000000);
+		gen_movdqa(REG_V1_ID, REG_V3_ID);
+		gen_pxor(REG_V2_ID, REG_V3_ID);
+		gen_pxor(REG_V0_ID, REG_V2_ID);
+		gen_psubd(REG_V1_ID, REG_V0_ID);
+		gen_pcmpgtd(REG_V2_ID, REG_V3_ID);
+		gen_sse2_record_sat(REG_V3_ID);
+		gen_pandn(REG_V0_ID, REG_V3_ID);
+		gen_movdqa(REG_V3_ID, REG_V0_ID);
+	}
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
 
-	x86_memory_operand vswapmask(gen_ssse3_vswap_mask(), X86_NOREG);
-	gen_movdqa(x86_memory_operand(xPPC_VR(vS), REG_CPU_ID), REG_V0_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, vswapmask, REG_V0_ID);
-	gen_movdqa(REG_V0_ID, x86_memory_operand(0, REG_T0_ID));
+// vaddsws, vsubsws
+bool powerpc_jit::gen_sse2_arith_sw(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_sse2_addsws(mnemo == PPC_I(VSUBSWS));
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
 	return true;
 }
 
-// vperm
-bool powerpc_jit::gen_ssse3_vperm(int mnemo, int vD, int vA, int vB, int vC)
+// vaddcuw
+bool powerpc_jit::gen_sse2_vaddcuw(int mnemo, int vD, int vA, int vB)
 {
-	static uintptr zero_mask = 0;
-	if (zero_mask == 0) {
-		static const uint8 value[16] = {
-			0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
-			0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
-		};
-		zero_mask = (uintptr)copy_data(value, sizeof(value));
-		assert(zero_mask <= 0xffffffff);
+	// Carry out is set if (vA + vB) < vA
+	gen_sse2_vconst(REG_V2_ID, 0x80000000);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V1_ID);
+	gen_paddd(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pxor(REG_V2_ID, REG_V0_ID);
+	gen_pxor(REG_V2_ID, REG_V1_ID);
+	gen_pcmpgtd(REG_V1_ID, REG_V0_ID);
+	gen_psrld(x86_immediate_operand(31), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vsubcuw
+bool powerpc_jit::gen_sse2_vsubcuw(int mnemo, int vD, int vA, int vB)
+{
+	// Carry out is clear if vB > vA
+	gen_sse2_vconst(REG_V2_ID, 0x80000000);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V1_ID);
+	gen_pxor(REG_V2_ID, REG_V0_ID);
+	gen_pxor(REG_V2_ID, REG_V1_ID);
+	gen_pcmpgtd(REG_V1_ID, REG_V0_ID);
+	gen_pcmpeqd(REG_V1_ID, REG_V1_ID);
+	gen_pxor(REG_V1_ID, REG_V0_ID);
+	gen_psrld(x86_immediate_operand(31), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vnor
+bool powerpc_jit::gen_sse2_vnor(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_pcmpeqd(REG_V1_ID, REG_V1_ID);
+	gen_por(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_pxor(REG_V1_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// Sign bit of each element for the given PCMPGT instruction
+static inline uint32 sse2_sign_bias(int op)
+{
+	switch (op) {
+	case X86_SSE_PCMPGTB: return 0x80808080;
+	case X86_SSE_PCMPGTW: return 0x80008000;
 	}
+	return 0x80000000;
+}
 
-	static uintptr index_mask = 0;
-	if (index_mask == 0) {
-		static const uint8 value[16] = {
-			0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f,
-			0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f
-		};
-		index_mask = (uintptr)copy_data(value, sizeof(value));
-		assert(index_mask <= 0xffffffff);
-	};
+// vcmpgtub, vcmpgtuh, vcmpgtuw
+bool powerpc_jit::gen_sse2_vcmpgtu(int mnemo, int vD, int vA, int vB, bool Rc)
+{
+	// Unsigned compares are signed compares with flipped sign bits
+	const int op = jit_info[mnemo]->o.value;
+	gen_sse2_vconst(REG_V2_ID, sse2_sign_bias(op));
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pxor(REG_V2_ID, REG_V0_ID);
+	gen_pxor(REG_V2_ID, REG_V1_ID);
+	gen_insn(X86_INSN_SSE_PI, op, REG_V1_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	if (Rc)
+		gen_sse2_record_cr6(REG_V0_ID);
+	return true;
+}
 
-	/*
-	 * PROP_IMSB(T) = T.index|most significant bit of T.index (T.bit0 = T.bit3)
-	 * --> used to handle one vector at a time
-	 *
-	 * T.A = PSHUFB(PROP_IMSB(vC & IndexMask), vA);
-	 * T.B = PSHUFB(PROP_IMSB(vC & IndexMaxk) ^ ZeroMask, vB);
-	 * vD = T.A | T.B
-	 */
-	x86_memory_operand swap_mask(gen_ssse3_vswap_mask(), X86_NOREG);
-	gen_movdqa(x86_memory_operand(xPPC_VR(vC), REG_CPU_ID), REG_V2_ID);
-	gen_movdqa(swap_mask, REG_V3_ID);
+// vavgsb, vavgsh, vavgsw, vavguw
+bool powerpc_jit::gen_sse2_vavg(int mnemo, int vD, int vA, int vB)
+{
 	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
-	gen_pand(x86_memory_operand(index_mask, X86_NOREG), REG_V2_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V0_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V2_ID);
-	gen_movdqa(REG_V2_ID, REG_V1_ID);
-	gen_psllq(x86_immediate_operand(3), REG_V2_ID);
-	gen_pand(x86_memory_operand(zero_mask, X86_NOREG), REG_V2_ID);
-	gen_por(REG_V2_ID, REG_V1_ID);
-	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V2_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V1_ID, REG_V0_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V2_ID);
-	gen_pxor(x86_memory_operand(zero_mask, X86_NOREG), REG_V1_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V1_ID, REG_V2_ID);
-	gen_por(REG_V2_ID, REG_V0_ID);
-	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	switch (mnemo) {
+	case PPC_I(VAVGSB):
+	case PPC_I(VAVGSH):
+		// Signed averages are unsigned averages with flipped sign bits
+		gen_sse2_vconst(REG_V2_ID, mnemo == PPC_I(VAVGSB) ? 0x80808080 : 0x80008000);
+		gen_pxor(REG_V2_ID, REG_V0_ID);
+		gen_pxor(REG_V2_ID, REG_V1_ID);
+		if (mnemo == PPC_I(VAVGSB))
+			gen_pavgb(REG_V1_ID, REG_V0_ID);
+		else
+			gen_pavgw(REG_V1_ID, REG_V0_ID);
+		gen_pxor(REG_V2_ID, REG_V0_ID);
+		break;
+	default:
+		// (vA + vB + 1) >> 1 == (vA | vB) - ((vA ^ vB) >> 1)
+		gen_movdqa(REG_V0_ID, REG_V2_ID);
+		gen_por(REG_V1_ID, REG_V0_ID);
+		gen_pxor(REG_V1_ID, REG_V2_ID);
+		if (mnemo == PPC_I(VAVGSW))
+			gen_psrad(x86_immediate_operand(1), REG_V2_ID);
+		else
+			gen_psrld(x86_immediate_operand(1), REG_V2_ID);
+		gen_psubd(REG_V2_ID, REG_V0_ID);
+		break;
+	}
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vmaxsb, vmaxsw, vmaxuw, vminsb, vminsw, vminuw
+bool powerpc_jit::gen_sse2_vmaxmin(int mnemo, int vD, int vA, int vB)
+{
+	// Option holds the PCMPGT instruction, bit 8 selects min, bit 9 unsigned
+	const int o = jit_info[mnemo]->o.value;
+	const int op = o & 0xff;
+	const int vHi = (o & 0x100) ? REG_V1_ID : REG_V0_ID;
+	const int vLo = (o & 0x100) ? REG_V0_ID : REG_V1_ID;
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V2_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V3_ID);
+	if (o & 0x200) {
+		gen_sse2_vconst(REG_V0_ID, sse2_sign_bias(op));
+		gen_pxor(REG_V0_ID, REG_V2_ID);
+		gen_pxor(REG_V0_ID, REG_V3_ID);
+	}
+	gen_insn(X86_INSN_SSE_PI, op, REG_V3_ID, REG_V2_ID);				// %v2 = vA > vB
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_pand(REG_V2_ID, vHi);
+	gen_pandn(vLo, REG_V2_ID);
+	gen_por(REG_V2_ID, vHi);
+	gen_movdqa(vHi, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vmaxuh
+bool powerpc_jit::gen_sse2_vmaxuh(int mnemo, int vD, int vA, int vB)
+{
+	// max(vA, vB) == sat(vA - vB) + vB
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_psubusw(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_paddw(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vminuh
+bool powerpc_jit::gen_sse2_vminuh(int mnemo, int vD, int vA, int vB)
+{
+	// min(vA, vB) == vA - sat(vA - vB)
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V1_ID);
+	gen_psubusw(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_psubw(REG_V1_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vmrghb, vmrghh, vmrghw, vmrglb, vmrglh, vmrglw
+bool powerpc_jit::gen_sse2_vmerge(int mnemo, int vD, int vA, int vB)
+{
+	// NOTE: bytes and halfwords are stored swapped within each word, so
+	// interleave vB with vA and swap the words of each quadword back
+	const int op = jit_info[mnemo]->o.value;
+	if (op == X86_SSE_PUNPCKLDQ || op == X86_SSE_PUNPCKHDQ) {
+		gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+		gen_insn(X86_INSN_SSE_PI, op, x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	}
+	else {
+		gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+		gen_insn(X86_INSN_SSE_PI, op, x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+		gen_pshufd(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+	}
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vpkuhum, vpkuwum, vpkshss, vpkshus, vpkswss, vpkuhus
+bool powerpc_jit::gen_sse2_vpack(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	switch (mnemo) {
+	case PPC_I(VPKUHUM):
+		gen_psllw(x86_immediate_operand(8), REG_V0_ID);
+		gen_psllw(x86_immediate_operand(8), REG_V1_ID);
+		gen_psrlw(x86_immediate_operand(8), REG_V0_ID);
+		gen_psrlw(x86_immediate_operand(8), REG_V1_ID);
+		gen_packuswb(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKUWUM):
+		gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V1_ID);
+		gen_psrad(x86_immediate_operand(16), REG_V0_ID);
+		gen_psrad(x86_immediate_operand(16), REG_V1_ID);
+		gen_packssdw(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKSHSS):
+		gen_sse2_record_pack_sat(8, 0x00800080);
+		gen_packsswb(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKSHUS):
+		gen_sse2_record_pack_sat(8, 0);
+		gen_packuswb(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKSWSS):
+		gen_sse2_record_pack_sat(16, 0x00008000);
+		gen_packssdw(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VPKUHUS):
+		// PACKUSWB takes signed inputs, clamp to 0xff first
+		gen_sse2_record_pack_sat(8, 0);
+		gen_sse2_vconst(REG_V2_ID, 0x00ff00ff);
+		gen_movdqa(REG_V0_ID, REG_V3_ID);
+		gen_psubusw(REG_V2_ID, REG_V3_ID);
+		gen_psubw(REG_V3_ID, REG_V0_ID);
+		gen_movdqa(REG_V1_ID, REG_V3_ID);
+		gen_psubusw(REG_V2_ID, REG_V3_ID);
+		gen_psubw(REG_V3_ID, REG_V1_ID);
+		gen_packuswb(REG_V1_ID, REG_V0_ID);
+		break;
+	default:
+		abort();
+	}
+	// Swap the halfwords of each word back to AltiVec element order
+	gen_pshuflhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+	gen_pshufhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vupkhsb, vupkhsh, vupklsb, vupklsh
+bool powerpc_jit::gen_sse2_vunpack(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	switch (mnemo) {
+	case PPC_I(VUPKHSB):
+		gen_pshuflhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+		gen_punpcklbw(REG_V0_ID, REG_V0_ID);
+		gen_psraw(x86_immediate_operand(8), REG_V0_ID);
+		break;
+	case PPC_I(VUPKLSB):
+		gen_pshufhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+		gen_punpckhbw(REG_V0_ID, REG_V0_ID);
+		gen_psraw(x86_immediate_operand(8), REG_V0_ID);
+		break;
+	case PPC_I(VUPKHSH):
+		gen_pshuflhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+		gen_punpcklwd(REG_V0_ID, REG_V0_ID);
+		gen_psrad(x86_immediate_operand(16), REG_V0_ID);
+		break;
+	case PPC_I(VUPKLSH):
+		gen_pshufhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+		gen_punpckhwd(REG_V0_ID, REG_V0_ID);
+		gen_psrad(x86_immediate_operand(16), REG_V0_ID);
+		break;
+	default:
+		abort();
+	}
 	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
 	return true;
 }
+
+// vmul[eo][su][bh]
+bool powerpc_jit::gen_sse2_vmul(int mnemo, int vD, int vA, int vB)
+{
+	// NOTE: even elements live in the upper half of each x86 word
+	// (bytes) or dword (halfwords)
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	switch (mnemo) {
+	case PPC_I(VMULOUB):
+	case PPC_I(VMULOSB):
+		gen_psllw(x86_immediate_operand(8), REG_V0_ID);
+		gen_psllw(x86_immediate_operand(8), REG_V1_ID);
+		// fall-through
+	case PPC_I(VMULEUB):
+	case PPC_I(VMULESB):
+		if (mnemo == PPC_I(VMULEUB) || mnemo == PPC_I(VMULOUB)) {
+			gen_psrlw(x86_immediate_operand(8), REG_V0_ID);
+			gen_psrlw(x86_immediate_operand(8), REG_V1_ID);
+		}
+		else {
+			gen_psraw(x86_immediate_operand(8), REG_V0_ID);
+			gen_psraw(x86_immediate_operand(8), REG_V1_ID);
+		}
+		gen_pmullw(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VMULOSH):
+		gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V1_ID);
+		// fall-through
+	case PPC_I(VMULESH):
+		gen_psrld(x86_immediate_operand(16), REG_V0_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V1_ID);
+		gen_pmaddwd(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VMULEUH):
+	case PPC_I(VMULOUH):
+		gen_movdqa(REG_V0_ID, REG_V2_ID);
+		gen_pmullw(REG_V1_ID, REG_V0_ID);
+		gen_pmulhuw(REG_V1_ID, REG_V2_ID);
+		if (mnemo == PPC_I(VMULEUH)) {
+			gen_psrld(x86_immediate_operand(16), REG_V0_ID);
+			gen_psrld(x86_immediate_operand(16), REG_V2_ID);
+			gen_pslld(x86_immediate_operand(16), REG_V2_ID);
+		}
+		else {
+			gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+			gen_psrld(x86_immediate_operand(16), REG_V0_ID);
+			gen_pslld(x86_immediate_operand(16), REG_V2_ID);
+		}
+		gen_por(REG_V2_ID, REG_V0_ID);
+		break;
+	default:
+		abort();
+	}
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vmladduhm
+bool powerpc_jit::gen_sse2_vmladduhm(int mnemo, int vD, int vA, int vB, int vC)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_pmullw(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_paddw(x86_memory_operand(xPPC_VR(vC), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vmsumubm, vmsummbm, vmsumshm, vmsumuhm
+bool powerpc_jit::gen_sse2_vmsum(int mnemo, int vD, int vA, int vB, int vC)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	switch (mnemo) {
+	case PPC_I(VMSUMUBM):
+	case PPC_I(VMSUMMBM):
+		// Widen even and odd bytes to halfwords, vB is always unsigned
+		gen_movdqa(REG_V0_ID, REG_V2_ID);
+		gen_movdqa(REG_V1_ID, REG_V3_ID);
+		gen_psllw(x86_immediate_operand(8), REG_V2_ID);
+		gen_psllw(x86_immediate_operand(8), REG_V3_ID);
+		if (mnemo == PPC_I(VMSUMMBM)) {
+			gen_psraw(x86_immediate_operand(8), REG_V0_ID);
+			gen_psraw(x86_immediate_operand(8), REG_V2_ID);
+		}
+		else {
+			gen_psrlw(x86_immediate_operand(8), REG_V0_ID);
+			gen_psrlw(x86_immediate_operand(8), REG_V2_ID);
+		}
+		gen_psrlw(x86_immediate_operand(8), REG_V1_ID);
+		gen_psrlw(x86_immediate_operand(8), REG_V3_ID);
+		gen_pmaddwd(REG_V1_ID, REG_V0_ID);
+		gen_pmaddwd(REG_V3_ID, REG_V2_ID);
+		gen_paddd(REG_V2_ID, REG_V0_ID);
+		break;
+	case PPC_I(VMSUMSHM):
+		gen_pmaddwd(REG_V1_ID, REG_V0_ID);
+		break;
+	case PPC_I(VMSUMUHM):
+		// PMADDWD is signed, add back (sign(a) ? b : 0) + (sign(b) ? a : 0)
+		// shifted into the upper halfword of each product
+		gen_movdqa(REG_V0_ID, REG_V2_ID);
+		gen_movdqa(REG_V1_ID, REG_V3_ID);
+		gen_psraw(x86_immediate_operand(15), REG_V2_ID);
+		gen_psraw(x86_immediate_operand(15), REG_V3_ID);
+		gen_pand(REG_V1_ID, REG_V2_ID);
+		gen_pand(REG_V0_ID, REG_V3_ID);
+		gen_paddw(REG_V3_ID, REG_V2_ID);
+		gen_pmaddwd(REG_V1_ID, REG_V0_ID);
+		gen_sse2_vconst(REG_V3_ID, 0x00010001);
+		gen_pmaddwd(REG_V3_ID, REG_V2_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V2_ID);
+		gen_paddd(REG_V2_ID, REG_V0_ID);
+		break;
+	default:
+		abort();
+	}
+	gen_paddd(x86_memory_operand(xPPC_VR(vC), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vsum4ubs, vsum4sbs, vsum4shs
+bool powerpc_jit::gen_sse2_vsum4(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	if (mnemo != PPC_I(VSUM4SHS)) {
+		gen_movdqa(REG_V0_ID, REG_V1_ID);
+		gen_psllw(x86_immediate_operand(8), REG_V1_ID);
+		if (mnemo == PPC_I(VSUM4SBS)) {
+			gen_psraw(x86_immediate_operand(8), REG_V0_ID);
+			gen_psraw(x86_immediate_operand(8), REG_V1_ID);
+		}
+		else {
+			gen_psrlw(x86_immediate_operand(8), REG_V0_ID);
+			gen_psrlw(x86_immediate_operand(8), REG_V1_ID);
+		}
+		gen_paddw(REG_V1_ID, REG_V0_ID);
+	}
+	gen_sse2_vconst(REG_V1_ID, 0x00010001);
+	gen_pmaddwd(REG_V1_ID, REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	if (mnemo == PPC_I(VSUM4UBS))
+		gen_sse2_adduws();
+	else
+		gen_sse2_addsws(false);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vsl, vsr
+bool powerpc_jit::gen_sse2_vshift(int mnemo, int vD, int vA, int vB)
+{
+	// Shift the little endian view of the 128-bit quantity by quadwords,
+	// then carry the bits crossing the middle over
+	const int N = ev_mixed::byte_element(15);
+	gen_mov_zx_8_32(x86_memory_operand(xPPC_VR(vB) + N, REG_CPU_ID), REG_T0_ID);
+	gen_and_32(x86_immediate_operand(7), REG_T0_ID);
+	gen_movd_lx(REG_T0_ID, REG_V2_ID);
+	gen_neg_32(REG_T0_ID);
+	gen_add_32(x86_immediate_operand(64), REG_T0_ID);
+	gen_movd_lx(REG_T0_ID, REG_V3_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V1_ID);
+	if (mnemo == PPC_I(VSL)) {
+		gen_psllq(REG_V2_ID, REG_V0_ID);
+		gen_psrlq(REG_V3_ID, REG_V1_ID);
+		gen_pslldq(x86_immediate_operand(8), REG_V1_ID);
+	}
+	else {
+		gen_psrlq(REG_V2_ID, REG_V0_ID);
+		gen_psllq(REG_V3_ID, REG_V1_ID);
+		gen_psrldq(x86_immediate_operand(8), REG_V1_ID);
+	}
+	gen_por(REG_V1_ID, REG_V0_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), REG_V0_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vcfsx, vcfux
+bool powerpc_jit::gen_sse2_vcfx(int mnemo, int vD, int UIMM, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	if (mnemo == PPC_I(VCFUX)) {
+		// Convert both halfwords exactly, the final add rounds once
+		gen_movdqa(REG_V0_ID, REG_V1_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V0_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V1_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V1_ID);
+		gen_cvtdq2ps(REG_V0_ID, REG_V0_ID);
+		gen_cvtdq2ps(REG_V1_ID, REG_V1_ID);
+		gen_sse2_vconst(REG_V2_ID, 0x47800000);						// 65536.0f
+		gen_mulps(REG_V2_ID, REG_V0_ID);
+		gen_addps(REG_V1_ID, REG_V0_ID);
+	}
+	else
+		gen_cvtdq2ps(REG_V0_ID, REG_V0_ID);
+	if (UIMM) {
+		gen_sse2_vconst(REG_V2_ID, (127 - UIMM) << 23);				// 2^-UIMM
+		gen_mulps(REG_V2_ID, REG_V0_ID);
+	}
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vctsxs
+bool powerpc_jit::gen_sse2_vctsxs(int mnemo, int vD, int UIMM, int vB)
+{
+	gen_movaps(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	if (UIMM) {
+		gen_sse2_vconst(REG_V2_ID, (127 + UIMM) << 23);				// 2^UIMM
+		gen_mulps(REG_V2_ID, REG_V0_ID);
+	}
+	// CVTTPS2DQ yields 0x80000000 when out of range, flip it for
+	// positive overflows and clear NaNs
+	gen_sse2_vconst(REG_V2_ID, 0x4f000000);							// 2^31
+	gen_cmpps(X86_SSE_CC_LE, REG_V0_ID, REG_V2_ID);
+	gen_movaps(REG_V0_ID, REG_V1_ID);
+	gen_cmpps(X86_SSE_CC_EQ, REG_V0_ID, REG_V1_ID);
+	gen_cvttps2dq(REG_V0_ID, REG_V3_ID);
+	gen_pxor(REG_V2_ID, REG_V3_ID);
+	gen_pand(REG_V1_ID, REG_V3_ID);
+	gen_movdqa(REG_V3_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	gen_sse2_vconst(REG_V1_ID, 0xcf000000);							// -2^31
+	gen_cmpps(X86_SSE_CC_LT, REG_V1_ID, REG_V0_ID);
+	gen_por(REG_V2_ID, REG_V0_ID);
+	gen_sse2_record_sat(REG_V0_ID);
+	return true;
+}
+
+// vctuxs
+bool powerpc_jit::gen_sse2_vctuxs(int mnemo, int vD, int UIMM, int vB)
+{
+	gen_movaps(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	if (UIMM) {
+		gen_sse2_vconst(REG_V2_ID, (127 + UIMM) << 23);				// 2^UIMM
+		gen_mulps(REG_V2_ID, REG_V0_ID);
+	}
+	// Values that truncate to a negative integer saturate to zero,
+	// MAXPS also maps NaNs to zero
+	gen_sse2_vconst(REG_V1_ID, 0xbf800000);							// -1.0f
+	gen_movaps(REG_V0_ID, REG_V3_ID);
+	gen_cmpps(X86_SSE_CC_LE, REG_V1_ID, REG_V3_ID);
+	gen_xorps(REG_V1_ID, REG_V1_ID);
+	gen_maxps(REG_V1_ID, REG_V0_ID);
+	gen_sse2_vconst(REG_V1_ID, 0x4f800000);							// 2^32
+	gen_cmpps(X86_SSE_CC_LE, REG_V0_ID, REG_V1_ID);
+	gen_movaps(REG_V1_ID, REG_V2_ID);
+	gen_por(REG_V3_ID, REG_V2_ID);
+	gen_sse2_record_sat(REG_V2_ID);
+
+	// Convert values above 2^31 with the sign bit set separately
+	gen_sse2_vconst(REG_V2_ID, 0x4f000000);							// 2^31
+	gen_movaps(REG_V2_ID, REG_V3_ID);
+	gen_cmpps(X86_SSE_CC_LE, REG_V0_ID, REG_V3_ID);
+	gen_pand(REG_V3_ID, REG_V2_ID);
+	gen_subps(REG_V2_ID, REG_V0_ID);
+	gen_cvttps2dq(REG_V0_ID, REG_V0_ID);
+	gen_pslld(x86_immediate_operand(31), REG_V3_ID);
+	gen_pxor(REG_V3_ID, REG_V0_ID);
+	gen_por(REG_V1_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+/*
+ *	SSSE3 optimizations
+ */
+
+uintptr powerpc_jit::gen_ssse3_vswap_mask(void)
+{
+	// We must get the following bytes in memory
+	// 0x3 0x2 0x1 0x0 0x7 0x6 0x5 0x4 0xb 0xa 0x9 0x8 0xf 0xe 0xd 0xc
+	static uintptr control_mask = 0;
+	if (control_mask == 0) {
+		static const uint8 value[16] = {
+			0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04,
+			0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c
+		};
+		control_mask = (uintptr)copy_data(value, sizeof(value));
+		assert(control_mask <= 0xffffffff);
+	}
+	return control_mask;
+}
+
+// lvx, lvxl
+bool powerpc_jit::gen_ssse3_lvx(int mnemo, int vD, int rA, int rB)
+{
+	gen_mov_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), REG_T0_ID);
+	if (rA != 0)
+		gen_add_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), REG_T0_ID);
+	gen_and_32(x86_immediate_operand(-16), REG_T0_ID);
+
+	x86_memory_operand vswapmask(gen_ssse3_vswap_mask(), X86_NOREG);
+	gen_movdqa(x86_memory_operand(0, REG_T0_ID), REG_V0_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, vswapmask, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// stvx, stvxl
+bool powerpc_jit::gen_ssse3_stvx(int mnemo, int vS, int rA, int rB)
+{
+	gen_mov_32(x86_memory_operand(xPPC_GPR(rB), REG_CPU_ID), REG_T0_ID);
+	if (rA != 0)
+		gen_add_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), REG_T0_ID);
+	gen_and_32(x86_immediate_operand(-16), REG_T0_ID);
+
+	x86_memory_operand vswapmask(gen_ssse3_vswap_mask(), X86_NOREG);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vS), REG_CPU_ID), REG_V0_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, vswapmask, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(0, REG_T0_ID));
+	return true;
+}
+
+#if NATIVE_MEMORY_ACCESS
+// Compute the host address of rA|0 + d into T1
+void powerpc_jit::gen_ssse3_multiple_ea(int rA, int32 d)
+{
+	if (rA == 0)
+		gen_mov_32(x86_immediate_operand(d), REG_T1_ID);
+	else {
+		gen_mov_32(x86_memory_operand(xPPC_GPR(rA), REG_CPU_ID), REG_T1_ID);
+		if (d)
+			gen_add_32(x86_immediate_operand(d), REG_T1_ID);
+	}
+	gen_lea_32(x86_memory_operand((uint32)VMBaseDiff, REG_T1_ID), REG_T1_ID);
+}
+
+// lmw, lswi
+//
+// Words are moved 16 bytes at a time into consecutive gpr[] slots,
+// byte-swapped with pshufb. Registers wrap around from r31 to r0
+bool powerpc_jit::gen_ssse3_load_multiple(int mnemo, int rD, int rA, int32 d, int nb)
+{
+	gen_ssse3_multiple_ea(rA, d);
+	x86_memory_operand vswapmask(gen_ssse3_vswap_mask(), X86_NOREG);
+	int r = rD, ad = 0;
+	for (int n = nb / 4; n > 0; r = (r + 1) & 31, ad += 4, n--) {
+		if (n >= 4 && r <= 28) {
+			gen_movdqu(x86_memory_operand(ad, REG_T1_ID), REG_V0_ID);
+			gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, vswapmask, REG_V0_ID);
+			gen_movdqu(REG_V0_ID, x86_memory_operand(xPPC_GPR(r), REG_CPU_ID));
+			r += 3, ad += 12, n -= 3;
+			continue;
+		}
+#if defined(__x86_64__)
+		if (n >= 2 && r <= 30) {
+			gen_mov_64(x86_memory_operand(ad, REG_T1_ID), REG_T0_ID);
+			gen_bswap_64(REG_T0_ID);
+			gen_rol_64(x86_immediate_operand(32), REG_T0_ID);
+			gen_mov_64(REG_T0_ID, x86_memory_operand(xPPC_GPR(r), REG_CPU_ID));
+			r += 1, ad += 4, n -= 1;
+			continue;
+		}
+#endif
+		gen_mov_32(x86_memory_operand(ad, REG_T1_ID), REG_T0_ID);
+		gen_bswap_32(REG_T0_ID);
+		gen_mov_32(REG_T0_ID, x86_memory_operand(xPPC_GPR(r), REG_CPU_ID));
+	}
+
+	// The last register of lswi is filled from the left with zeros
+	switch (nb & 3) {
+	case 0:
+		return true;
+	case 1:
+		gen_mov_zx_8_32(x86_memory_operand(ad, REG_T1_ID), REG_T0_ID);
+		gen_shl_32(x86_immediate_operand(24), REG_T0_ID);
+		break;
+	case 2:
+	case 3:
+		gen_mov_zx_16_32(x86_memory_operand(ad, REG_T1_ID), REG_T0_ID);
+		gen_rol_16(x86_immediate_operand(8), REG_T0_ID);
+		gen_shl_32(x86_immediate_operand(16), REG_T0_ID);
+		if ((nb & 3) == 3) {
+			gen_mov_zx_8_32(x86_memory_operand(ad + 2, REG_T1_ID), REG_T2_ID);
+			gen_shl_32(x86_immediate_operand(8), REG_T2_ID);
+			gen_or_32(REG_T2_ID, REG_T0_ID);
+		}
+		break;
+	}
+	gen_mov_32(REG_T0_ID, x86_memory_operand(xPPC_GPR(r), REG_CPU_ID));
+	return true;
+}
+
+// stmw, stswi
+bool powerpc_jit::gen_ssse3_store_multiple(int mnemo, int rS, int rA, int32 d, int nb)
+{
+	gen_ssse3_multiple_ea(rA, d);
+	x86_memory_operand vswapmask(gen_ssse3_vswap_mask(), X86_NOREG);
+	int r = rS, ad = 0;
+	for (int n = nb / 4; n > 0; r = (r + 1) & 31, ad += 4, n--) {
+		if (n >= 4 && r <= 28) {
+			gen_movdqu(x86_memory_operand(xPPC_GPR(r), REG_CPU_ID), REG_V0_ID);
+			gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, vswapmask, REG_V0_ID);
+			gen_movdqu(REG_V0_ID, x86_memory_operand(ad, REG_T1_ID));
+			r += 3, ad += 12, n -= 3;
+			continue;
+		}
+#if defined(__x86_64__)
+		if (n >= 2 && r <= 30) {
+			gen_mov_64(x86_memory_operand(xPPC_GPR(r), REG_CPU_ID), REG_T0_ID);
+			gen_rol_64(x86_immediate_operand(32), REG_T0_ID);
+			gen_bswap_64(REG_T0_ID);
+			gen_mov_64(REG_T0_ID, x86_memory_operand(ad, REG_T1_ID));
+			r += 1, ad += 4, n -= 1;
+			continue;
+		}
+#endif
+		gen_mov_32(x86_memory_operand(xPPC_GPR(r), REG_CPU_ID), REG_T0_ID);
+		gen_bswap_32(REG_T0_ID);
+		gen_mov_32(REG_T0_ID, x86_memory_operand(ad, REG_T1_ID));
+	}
+
+	// Remaining bytes come from the left of the last register
+	if (nb & 3) {
+		gen_mov_32(x86_memory_operand(xPPC_GPR(r), REG_CPU_ID), REG_T0_ID);
+		gen_bswap_32(REG_T0_ID);
+		if (nb & 2) {
+			gen_mov_16(REG_T0_ID, x86_memory_operand(ad, REG_T1_ID));
+			gen_shr_32(x86_immediate_operand(16), REG_T0_ID);
+			ad += 2;
+		}
+		if (nb & 1)
+			gen_mov_8(REG_T0_ID, x86_memory_operand(ad, REG_T1_ID));
+	}
+	return true;
+}
+#endif
+
+// vperm
+bool powerpc_jit::gen_ssse3_vperm(int mnemo, int vD, int vA, int vB, int vC)
+{
+	static uintptr zero_mask = 0;
+	if (zero_mask == 0) {
+		static const uint8 value[16] = {
+			0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+			0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+		};
+		zero_mask = (uintptr)copy_data(value, sizeof(value));
+		assert(zero_mask <= 0xffffffff);
+	}
+
+	static uintptr index_mask = 0;
+	if (index_mask == 0) {
+		static const uint8 value[16] = {
+			0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f,
+			0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f
+		};
+		index_mask = (uintptr)copy_data(value, sizeof(value));
+		assert(index_mask <= 0xffffffff);
+	};
+
+	/*
+	 * PROP_IMSB(T) = T.index|most significant bit of T.index (T.bit0 = T.bit3)
+	 * --> used to handle one vector at a time
+	 *
+	 * T.A = PSHUFB(PROP_IMSB(vC & IndexMask), vA);
+	 * T.B = PSHUFB(PROP_IMSB(vC & IndexMaxk) ^ ZeroMask, vB);
+	 * vD = T.A | T.B
+	 */
+	x86_memory_operand swap_mask(gen_ssse3_vswap_mask(), X86_NOREG);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vC), REG_CPU_ID), REG_V2_ID);
+	gen_movdqa(swap_mask, REG_V3_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_pand(x86_memory_operand(index_mask, X86_NOREG), REG_V2_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V0_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V2_ID);
+	gen_movdqa(REG_V2_ID, REG_V1_ID);
+	gen_psllq(x86_immediate_operand(3), REG_V2_ID);
+	gen_pand(x86_memory_operand(zero_mask, X86_NOREG), REG_V2_ID);
+	gen_por(REG_V2_ID, REG_V1_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V2_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V1_ID, REG_V0_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V2_ID);
+	gen_pxor(x86_memory_operand(zero_mask, X86_NOREG), REG_V1_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V1_ID, REG_V2_ID);
+	gen_por(REG_V2_ID, REG_V0_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V3_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vslo, vsro
+bool powerpc_jit::gen_ssse3_vshift_octet(int mnemo, int vD, int vA, int vB)
+{
+	// PSHUFB clears the bytes whose index has its sign bit set, so the
+	// shifted-in zeroes come for free on the little endian view of vA
+	static uintptr index_mask[2] = { 0, 0 };
+	if (index_mask[0] == 0) {
+		static const uint8 value[2][16] = {
+			{ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+			  0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f },
+			{ 0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77,
+			  0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f }
+		};
+		for (int i = 0; i < 2; i++) {
+			index_mask[i] = (uintptr)copy_data(value[i], sizeof(value[i]));
+			assert(index_mask[i] <= 0xffffffff);
+		}
+	}
+
+	const int N = ev_mixed::byte_element(15);
+	const bool left = mnemo == PPC_I(VSLO);
+	gen_mov_zx_8_32(x86_memory_operand(xPPC_VR(vB) + N, REG_CPU_ID), REG_T0_ID);
+	gen_shr_32(x86_immediate_operand(3), REG_T0_ID);
+	gen_and_32(x86_immediate_operand(15), REG_T0_ID);
+	gen_movd_lx(REG_T0_ID, REG_V1_ID);
+	gen_pxor(REG_V2_ID, REG_V2_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V2_ID, REG_V1_ID);	// splat the shift count
+	gen_movdqa(x86_memory_operand(index_mask[left ? 0 : 1], X86_NOREG), REG_V2_ID);
+	if (left)
+		gen_psubb(REG_V1_ID, REG_V2_ID);
+	else
+		gen_paddb(REG_V1_ID, REG_V2_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_insn(X86_INSN_SSE_3P, X86_SSSE3_PSHUFB, REG_V2_ID, REG_V0_ID);
+	gen_pshufd(x86_immediate_operand(0x1b), REG_V0_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+/*
+ *	SSE4.1 optimizations
+ */
+
+// vpkswus, vpkuwus
+bool powerpc_jit::gen_sse41_vpack(int mnemo, int vD, int vA, int vB)
+{
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_sse2_record_pack_sat(16, 0);
+	if (mnemo == PPC_I(VPKUWUS)) {
+		// PACKUSDW takes signed inputs, clamp to 0xffff first
+		gen_sse2_vconst(REG_V2_ID, 0x0000ffff);
+		gen_insn(X86_INSN_SSE_3P, X86_SSE41_PMINUD, REG_V2_ID, REG_V0_ID);
+		gen_insn(X86_INSN_SSE_3P, X86_SSE41_PMINUD, REG_V2_ID, REG_V1_ID);
+	}
+	gen_insn(X86_INSN_SSE_3P, X86_SSE41_PACKUSDW, REG_V1_ID, REG_V0_ID);
+	gen_pshuflhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+	gen_pshufhw(x86_immediate_operand(0xb1), REG_V0_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vrfim, vrfip, vrfiz
+bool powerpc_jit::gen_sse41_vrfi(int mnemo, int vD, int vA, int vB)
+{
+	// Option holds the ROUNDPS mode, with the precision exception masked
+	gen_roundps(x86_immediate_operand(jit_info[mnemo]->o.value), x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V0_ID);
+	gen_movaps(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+/*
+ *	AVX2 optimizations
+ */
+
+// vslw, vsrw, vsraw
+bool powerpc_jit::gen_avx2_vshw(int mnemo, int vD, int vA, int vB)
+{
+	gen_sse2_vconst(REG_V1_ID, 31);
+	gen_pand(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	switch (mnemo) {
+	case PPC_I(VSLW):	gen_vpsllvd(REG_V1_ID, REG_V0_ID, REG_V0_ID); break;
+	case PPC_I(VSRW):	gen_vpsrlvd(REG_V1_ID, REG_V0_ID, REG_V0_ID); break;
+	case PPC_I(VSRAW):	gen_vpsravd(REG_V1_ID, REG_V0_ID, REG_V0_ID); break;
+	default:			abort();
+	}
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vrlw
+bool powerpc_jit::gen_avx2_vrlw(int mnemo, int vD, int vA, int vB)
+{
+	// Shift counts of 32 yield zero
+	gen_sse2_vconst(REG_V1_ID, 31);
+	gen_pand(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_sse2_vconst(REG_V2_ID, 32);
+	gen_psubd(REG_V1_ID, REG_V2_ID);
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_vpsrlvd(REG_V2_ID, REG_V0_ID, REG_V2_ID);
+	gen_vpsllvd(REG_V1_ID, REG_V0_ID, REG_V0_ID);
+	gen_por(REG_V2_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+
+// vslh, vsrh, vsrah
+bool powerpc_jit::gen_avx2_vshh(int mnemo, int vD, int vA, int vB)
+{
+	// There are no per-halfword variable shifts, shift each half of
+	// the dwords separately and discard the bits crossing over
+	gen_movdqa(x86_memory_operand(xPPC_VR(vB), REG_CPU_ID), REG_V1_ID);
+	gen_movdqa(REG_V1_ID, REG_V2_ID);
+	gen_psrld(x86_immediate_operand(16), REG_V2_ID);
+	gen_sse2_vconst(REG_V3_ID, 15);
+	gen_pand(REG_V3_ID, REG_V1_ID);										// %v1 = low halfword counts
+	gen_pand(REG_V3_ID, REG_V2_ID);										// %v2 = high halfword counts
+	gen_movdqa(x86_memory_operand(xPPC_VR(vA), REG_CPU_ID), REG_V0_ID);
+	gen_movdqa(REG_V0_ID, REG_V3_ID);
+	switch (mnemo) {
+	case PPC_I(VSLH):
+		gen_psrld(x86_immediate_operand(16), REG_V3_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V3_ID);
+		gen_vpsllvd(REG_V2_ID, REG_V3_ID, REG_V3_ID);
+		gen_vpsllvd(REG_V1_ID, REG_V0_ID, REG_V0_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V0_ID);
+		break;
+	case PPC_I(VSRH):
+		gen_vpsrlvd(REG_V2_ID, REG_V3_ID, REG_V3_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V3_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V3_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V0_ID);
+		gen_vpsrlvd(REG_V1_ID, REG_V0_ID, REG_V0_ID);
+		break;
+	case PPC_I(VSRAH):
+		gen_vpsravd(REG_V2_ID, REG_V3_ID, REG_V3_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V3_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V3_ID);
+		gen_pslld(x86_immediate_operand(16), REG_V0_ID);
+		gen_vpsravd(REG_V1_ID, REG_V0_ID, REG_V0_ID);
+		gen_psrld(x86_immediate_operand(16), REG_V0_ID);
+		break;
+	default:
+		abort();
+	}
+	gen_por(REG_V3_ID, REG_V0_ID);
+	gen_movdqa(REG_V0_ID, x86_memory_operand(xPPC_VR(vD), REG_CPU_ID));
+	return true;
+}
+#endif
+
+#if PPC_ENABLE_NATIVE_JIT
+/*
+ *	Native x86-64 code generator
+ *
+ *	PowerPC registers are allocated to caller-saved host registers
+ *	that no dyngen op relies on across instructions. T0-T2 are used
+ *	as scratch registers. Every cached register is written back, and
+ *	the cache emptied, prior to any code generated by dyngen since
+ *	ops and helpers may clobber caller-saved registers.
+ *
+ *	FPRs are likewise kept in SSE2 registers and floating-point
+ *	arithmetic is done with scalar SSE2 instructions. As with the
+ *	dyngen floating-point ops, this requires FPSCR exception bits not
+ *	to be tracked for each instruction.
+ */
+
+const int powerpc_jit::native_reg_ids[NATIVE_REGS] = {
+	X86_EAX, X86_ECX, X86_EDX, X86_ESI, X86_EDI,
+	X86_R8D, X86_R9D, X86_R10D, X86_R11D
+};
+
+#define xPPC_XER_SO		xPPC_FIELD(xer().so)
+#define xPPC_XER_CA		xPPC_FIELD(xer().ca)
+#define xPPC_NATIVE(R)	((R) == NATIVE_CR ? xPPC_CR : xPPC_GPR(R))
+#define xPPC_FPR(N)		xPPC_FIELD(fpr(N))
+
+// 8-bit view of a native register, e.g. %sil for %esi
+#define NATIVE_REG8(R)	(X86_AL + ((R) - X86_EAX))
+
+// SSE2 register caching FPRs, after the xmm0 and xmm1 scratch registers
+#define NATIVE_FPR_ID(N)	(X86_XMM0 + 2 + (N))
+
+void powerpc_jit::gen_native_start(void)
+{
+	for (int i = 0; i < NATIVE_REGS; i++) {
+		native_regs[i].ppc = NATIVE_NONE;
+		native_regs[i].dirty = false;
+		native_regs[i].age = 0;
+	}
+	for (int i = 0; i <= NATIVE_CA; i++)
+		native_map[i] = NATIVE_NONE;
+	for (int i = 0; i < NATIVE_FPRS; i++) {
+		native_fprs[i].ppc = NATIVE_NONE;
+		native_fprs[i].dirty = false;
+		native_fprs[i].age = 0;
+	}
+	for (int i = 0; i < 32; i++)
+		native_fpr_map[i] = NATIVE_NONE;
+	native_age = 0;
+	native_locked = 0;
+	native_fpr_locked = 0;
+	native_cr.crf = -1;
+	native_known = native_lazy = 0;
+	native_forget_loads();
+	native_scan_count = 0;
+}
+
+void powerpc_jit::native_spill(int n)
+{
+	native_reg_t & reg = native_regs[n];
+	if (reg.ppc == NATIVE_NONE)
+		return;
+	if (reg.dirty) {
+		if (reg.ppc == NATIVE_CA)
+			gen_mov_8(NATIVE_REG8(native_reg_ids[n]), x86_memory_operand(xPPC_XER_CA, REG_CPU_ID));
+		else
+			gen_mov_32(native_reg_ids[n], x86_memory_operand(xPPC_NATIVE(reg.ppc), REG_CPU_ID));
+	}
+	native_map[reg.ppc] = NATIVE_NONE;
+	reg.ppc = NATIVE_NONE;
+	reg.dirty = false;
+}
+
+// Take host register N for exclusive use by the current instruction
+void powerpc_jit::native_reserve(int n)
+{
+	native_spill(n);
+	native_locked |= 1 << n;
+}
+
+void powerpc_jit::gen_native_flush(void)
+{
+	gen_native_commit_cr();
+	for (int r = 0; r < 32; r++) {
+		if (native_lazy & (1 << r))
+			gen_mov_32(x86_immediate_operand(native_value[r]), x86_memory_operand(xPPC_GPR(r), REG_CPU_ID));
+	}
+	for (int i = 0; i < NATIVE_REGS; i++)
+		native_spill(i);
+	for (int i = 0; i < NATIVE_FPRS; i++)
+		native_fpr_spill(i);
+	native_locked = 0;
+	native_fpr_locked = 0;
+
+	// Code that follows may change any register or memory location
+	native_known = native_lazy = 0;
+	native_forget_loads();
+}
+
+int powerpc_jit::native_alloc(int r, bool load, bool dirty)
+{
+	int n = native_map[r];
+	if (n == NATIVE_NONE) {
+		// Pick a free register, or the least recently used one that
+		// is not an operand of the current instruction
+		uint32 oldest = 0xffffffff;
+		for (int i = 0; i < NATIVE_REGS; i++) {
+			if (native_locked & (1 << i))
+				continue;
+			if (native_regs[i].ppc == NATIVE_NONE) {
+				n = i;
+				break;
+			}
+			if (native_regs[i].age < oldest) {
+				oldest = native_regs[i].age;
+				n = i;
+			}
+		}
+		assert(n != NATIVE_NONE);
+		native_spill(n);
+		native_regs[n].ppc = r;
+		native_map[r] = n;
+		if (load) {
+			if (r < NATIVE_CR && (native_lazy & (1 << r))) {
+				gen_mov_32(x86_immediate_operand(native_value[r]), native_reg_ids[n]);
+				native_lazy &= ~(1 << r);
+				dirty = true;
+			}
+			else if (r == NATIVE_CA)
+				gen_mov_zx_8_32(x86_memory_operand(xPPC_XER_CA, REG_CPU_ID), native_reg_ids[n]);
+			else
+				gen_mov_32(x86_memory_operand(xPPC_NATIVE(r), REG_CPU_ID), native_reg_ids[n]);
+		}
+	}
+	native_regs[n].age = ++native_age;
+	if (dirty)
+		native_regs[n].dirty = true;
+	if (!load && r < NATIVE_CR)
+		native_forget(r);
+	native_locked |= 1 << n;
+	return native_reg_ids[n];
+}
+
+void powerpc_jit::native_fpr_spill(int n)
+{
+	native_reg_t & reg = native_fprs[n];
+	if (reg.ppc == NATIVE_NONE)
+		return;
+	if (reg.dirty)
+		gen_movq_xq(NATIVE_FPR_ID(n), x86_memory_operand(xPPC_FPR(reg.ppc), REG_CPU_ID));
+	native_fpr_map[reg.ppc] = NATIVE_NONE;
+	reg.ppc = NATIVE_NONE;
+	reg.dirty = false;
+}
+
+int powerpc_jit::native_fpr_alloc(int r, bool load, bool dirty)
+{
+	int n = native_fpr_map[r];
+	if (n == NATIVE_NONE) {
+		uint32 oldest = 0xffffffff;
+		for (int i = 0; i < NATIVE_FPRS; i++) {
+			if (native_fpr_locked & (1 << i))
+				continue;
+			if (native_fprs[i].ppc == NATIVE_NONE) {
+				n = i;
+				break;
+			}
+			if (native_fprs[i].age < oldest) {
+				oldest = native_fprs[i].age;
+				n = i;
+			}
+		}
+		assert(n != NATIVE_NONE);
+		native_fpr_spill(n);
+		native_fprs[n].ppc = r;
+		native_fpr_map[r] = n;
+		if (load)
+			gen_movq_qx(x86_memory_operand(xPPC_FPR(r), REG_CPU_ID), NATIVE_FPR_ID(n));
+	}
+	native_fprs[n].age = ++native_age;
+	if (dirty)
+		native_fprs[n].dirty = true;
+	native_fpr_locked |= 1 << n;
+	return NATIVE_FPR_ID(n);
+}
+
+// Set a GPR to a known value, it is written back only when used
+void powerpc_jit::native_set_const(int r, uint32 value)
+{
+	native_forget(r);
+	const int n = native_map[r];
+	if (n != NATIVE_NONE) {
+		native_map[r] = NATIVE_NONE;
+		native_regs[n].ppc = NATIVE_NONE;
+		native_regs[n].dirty = false;
+	}
+	native_known |= 1 << r;
+	native_lazy |= 1 << r;
+	native_value[r] = value;
+}
+
+// The value of a GPR is about to change
+void powerpc_jit::native_forget(int r)
+{
+	native_known &= ~(1 << r);
+	native_lazy &= ~(1 << r);
+	for (int i = 0; i < NATIVE_LOADS; i++) {
+		if (native_loads[i].base == r || native_loads[i].value == r)
+			native_loads[i].base = NATIVE_NONE;
+	}
+}
+
+void powerpc_jit::native_forget_loads(void)
+{
+	for (int i = 0; i < NATIVE_LOADS; i++)
+		native_loads[i].base = NATIVE_NONE;
+	native_next_load = 0;
+}
+
+// Return the GPR holding the word at base + offset, if any
+int powerpc_jit::native_find_load(int base, int32 offset)
+{
+	for (int i = 0; i < NATIVE_LOADS; i++) {
+		if (native_loads[i].base == base && native_loads[i].offset == offset)
+			return native_loads[i].value;
+	}
+	return NATIVE_NONE;
+}
+
+void powerpc_jit::native_record_load(int base, int32 offset, int value)
+{
+	if (!native_optimizer || base == value)
+		return;
+	int i;
+	for (i = 0; i < NATIVE_LOADS; i++) {
+		if (native_loads[i].base == base && native_loads[i].offset == offset)
+			break;
+	}
+	if (i == NATIVE_LOADS) {
+		i = native_next_load;
+		native_next_load = (native_next_load + 1) % NATIVE_LOADS;
+	}
+	native_loads[i].base = base;
+	native_loads[i].offset = offset;
+	native_loads[i].value = value;
+}
+
+// Find instructions whose only effect is to write a GPR that is
+// written again before being read. All registers are live at the end
+// of the scanned code and before instructions that are not handled
+// natively, since dyngen code may read any of them
+void powerpc_jit::gen_native_prepass(uint32 pc, int count, const int *mnemos, const uint32 *opcodes)
+{
+	assert(count <= NATIVE_SCAN_MAX);
+	uint32 live = 0xffffffff;
+	uint64 dead = 0;
+	for (int i = count - 1; i >= 0; i--) {
+		const native_info_t *ni = native_info[mnemos[i]];
+		const uint32 opcode = opcodes[i];
+		const int flags = ni->flags;
+		if (ni->handler == &powerpc_jit::gen_native_not_available ||
+			((flags & NATIVE_OE) && OE_field::test(opcode)) ||
+			((flags & NATIVE_RC) && Rc_field::test(opcode))) {
+			live = 0xffffffff;
+			continue;
+		}
+		const int rA = rA_field::extract(opcode);
+		uint32 defs = 0, uses = 0;
+		if (flags & NATIVE_DEF_RD)
+			defs |= 1 << rD_field::extract(opcode);
+		if (flags & NATIVE_DEF_RA)
+			defs |= 1 << rA;
+		if ((flags & NATIVE_USE_RA) || ((flags & NATIVE_USE_RA0) && rA != 0))
+			uses |= 1 << rA;
+		if (flags & NATIVE_USE_RB)
+			uses |= 1 << rB_field::extract(opcode);
+		if (flags & NATIVE_USE_RS)
+			uses |= 1 << rS_field::extract(opcode);
+		const bool side_effects = (flags & (NATIVE_DEF_CR0 | NATIVE_DEF_CRFD | NATIVE_DEF_CA | NATIVE_DEF_MEM | NATIVE_DEF_FPR))
+			|| ((flags & NATIVE_DEF_RC) && Rc_field::test(opcode))
+			|| ((flags & NATIVE_DEF_RD) && (flags & NATIVE_DEF_RA));
+		if (!side_effects && defs && !(defs & live)) {
+			dead |= (uint64)1 << i;
+			continue;
+		}
+		live = (live & ~defs) | uses;
+	}
+	native_scan_pc = pc;
+	native_scan_count = count;
+	native_dead_mask = dead;
+}
+
+bool powerpc_jit::native_dead(uint32 pc) const
+{
+	const uint32 i = (pc - native_scan_pc) / 4;
+	return i < (uint32)native_scan_count && (native_dead_mask & ((uint64)1 << i));
+}
+
+bool powerpc_jit::gen_native(int mnemo, uint32 opcode)
+{
+	const native_info_t *ni = native_info[mnemo];
+	if (native_cr.crf >= 0) {
+		// A pending CR field update that this instruction overwrites
+		// is dead. Otherwise, compute it while its operands are live
+		int crf = -1;
+		if (ni->flags & NATIVE_DEF_CRFD)
+			crf = crfD_field::extract(opcode);
+		else if ((ni->flags & NATIVE_DEF_CR0) || ((ni->flags & NATIVE_DEF_RC) && Rc_field::test(opcode)))
+			crf = 0;
+		if (crf == native_cr.crf)
+			native_cr.crf = -1;
+		else {
+			bool clobbered = false;
+			if (ni->flags & NATIVE_DEF_RD) {
+				const int r = rD_field::extract(opcode);
+				clobbered |= (r == native_cr.lhs || r == native_cr.rhs);
+			}
+			if (ni->flags & NATIVE_DEF_RA) {
+				const int r = rA_field::extract(opcode);
+				clobbered |= (r == native_cr.lhs || r == native_cr.rhs);
+			}
+			if (clobbered)
+				gen_native_commit_cr();
+		}
+	}
+	native_locked = 0;
+	native_fpr_locked = 0;
+	return (this->*(ni->handler))(mnemo, opcode);
+}
+
+bool powerpc_jit::gen_native_not_available(int mnemo, uint32 opcode)
+{
+	return false;
+}
+
+// Record CRF from host condition codes, T0-T2 are clobbered
+void powerpc_jit::gen_native_record_cr(int crf, int cc_lt, int cc_gt)
+{
+	const int shift = 28 - 4 * crf;
+	gen_mov_32(x86_immediate_operand(standalone_CR_EQ_field::mask()), REG_T0_ID);
+	gen_mov_32(x86_immediate_operand(standalone_CR_LT_field::mask()), REG_T1_ID);
+	gen_mov_32(x86_immediate_operand(standalone_CR_GT_field::mask()), REG_T2_ID);
+	gen_cmov_32(cc_lt, REG_T1_ID, REG_T0_ID);
+	gen_cmov_32(cc_gt, REG_T2_ID, REG_T0_ID);
+	gen_mov_zx_8_32(x86_memory_operand(xPPC_XER_SO, REG_CPU_ID), REG_T1_ID);
+	gen_or_32(REG_T1_ID, REG_T0_ID);
+	if (shift)
+		gen_shl_32(x86_immediate_operand(shift), REG_T0_ID);
+	const int cr = native_alloc(NATIVE_CR, true, true);
+	gen_and_32(x86_immediate_operand(~(0xf << shift)), cr);
+	gen_or_32(REG_T0_ID, cr);
+}
+
+// Defer the update of CRF from the comparison of lhs to rhs, or imm
+void powerpc_jit::gen_native_defer_cr(int crf, int lhs, int rhs, uint32 imm, bool is_signed)
+{
+	if (native_cr.crf >= 0 && native_cr.crf != crf)
+		gen_native_commit_cr();
+	native_cr.crf = crf;
+	native_cr.lhs = lhs;
+	native_cr.rhs = rhs;
+	native_cr.imm = imm;
+	native_cr.is_signed = is_signed;
+}
+
+// Compute the pending CR field update, T0-T2 are clobbered
+void powerpc_jit::gen_native_commit_cr(void)
+{
+	const int crf = native_cr.crf;
+	if (crf < 0)
+		return;
+	native_cr.crf = -1;
+	const int a = native_use(native_cr.lhs);
+	if (native_cr.rhs != NATIVE_NONE)
+		gen_cmp_32(native_use(native_cr.rhs), a);
+	else if (native_cr.imm == 0)
+		gen_test_32(a, a);
+	else
+		gen_cmp_32(x86_immediate_operand(native_cr.imm), a);
+	if (native_cr.is_signed)
+		gen_native_record_cr(crf, X86_CC_L, X86_CC_G);
+	else
+		gen_native_record_cr(crf, X86_CC_B, X86_CC_A);
+}
+
+// addi, addis
+bool powerpc_jit::gen_native_addi(int mnemo, uint32 opcode)
+{
+	const int rA = rA_field::extract(opcode);
+	const int rD = rD_field::extract(opcode);
+	const uint32 value = ((uint32)(int32)(int16)SIMM_field::extract(opcode)) << native_info[mnemo]->option;
+	if (rA == 0) {			// li rD,value
+		if (native_optimizer)
+			native_set_const(rD, value);
+		else
+			gen_mov_32(x86_immediate_operand(value), native_def(rD));
+		return true;
+	}
+	if (native_is_const(rA)) {
+		native_set_const(rD, native_value[rA] + value);
+		return true;
+	}
+	const int a = native_use(rA);
+	if (rA == rD)
+		gen_add_32(x86_immediate_operand(value), native_def(rD));
+	else
+		gen_lea_32(x86_memory_operand(value, a), native_def(rD));
+	return true;
+}
+
+// add, subf, mullw, neg, mulli
+bool powerpc_jit::gen_native_arith(int mnemo, uint32 opcode)
+{
+	if (mnemo != PPC_I(MULLI) && OE_field::test(opcode))
+		return false;
+
+	const int rA = rA_field::extract(opcode);
+	const int rB = rB_field::extract(opcode);
+	const bool record = mnemo != PPC_I(MULLI) && Rc_field::test(opcode);
+	if (native_is_const(rA) && (mnemo == PPC_I(MULLI) || mnemo == PPC_I(NEG) || native_is_const(rB))) {
+		const uint32 a = native_value[rA];
+		const uint32 b = native_value[rB];
+		uint32 v;
+		switch (mnemo) {
+		case PPC_I(ADD):	v = a + b;		break;
+		case PPC_I(SUBF):	v = b - a;		break;
+		case PPC_I(MULLW):	v = a * b;		break;
+		case PPC_I(NEG):	v = -a;			break;
+		case PPC_I(MULLI):	v = a * (int32)(int16)SIMM_field::extract(opcode); break;
+		default:			abort();
+		}
+		native_set_const(rD_field::extract(opcode), v);
+		if (record)
+			gen_native_defer_cr0(rD_field::extract(opcode));
+		return true;
+	}
+
+	const int a = native_use(rA);
+	switch (mnemo) {
+	case PPC_I(ADD):
+		gen_mov_32(a, REG_T0_ID);
+		gen_add_32(native_use(rB_field::extract(opcode)), REG_T0_ID);
+		break;
+	case PPC_I(SUBF):
+		gen_mov_32(native_use(rB_field::extract(opcode)), REG_T0_ID);
+		gen_sub_32(a, REG_T0_ID);
+		break;
+	case PPC_I(MULLW):
+		gen_mov_32(a, REG_T0_ID);
+		gen_imul_32(native_use(rB_field::extract(opcode)), REG_T0_ID);
+		break;
+	case PPC_I(NEG):
+		gen_mov_32(a, REG_T0_ID);
+		gen_neg_32(REG_T0_ID);
+		break;
+	case PPC_I(MULLI):
+		gen_mov_32(a, REG_T0_ID);
+		gen_imul_32(x86_immediate_operand((int16)SIMM_field::extract(opcode)), REG_T0_ID);
+		break;
+	default:
+		abort();
+	}
+	const int rD = rD_field::extract(opcode);
+	gen_mov_32(REG_T0_ID, native_def(rD));
+	if (record)
+		gen_native_defer_cr0(rD);
+	return true;
+}
+
+// addc, adde, addme, addze, subfc, subfe, subfme, subfze, addic, addic., subfic
+bool powerpc_jit::gen_native_carry(int mnemo, uint32 opcode)
+{
+	const bool immediate = (mnemo == PPC_I(ADDIC) || mnemo == PPC_I(ADDIC_) || mnemo == PPC_I(SUBFIC));
+	if (!immediate && OE_field::test(opcode))
+		return false;
+
+	// XER[CA] is the host carry flag for additions, and its complement
+	// for subtractions. Extended forms bring CA into the carry flag
+	// with BT first
+	const int a = native_use(rA_field::extract(opcode));
+	const int32 simm = (int16)SIMM_field::extract(opcode);
+	int ca = -1;
+	int cc = X86_CC_B;
+	switch (mnemo) {
+	case PPC_I(ADDC):
+		gen_mov_32(a, REG_T0_ID);
+		gen_add_32(native_use(rB_field::extract(opcode)), REG_T0_ID);
+		break;
+	case PPC_I(ADDIC):
+	case PPC_I(ADDIC_):
+		gen_mov_32(a, REG_T0_ID);
+		gen_add_32(x86_immediate_operand(simm), REG_T0_ID);
+		break;
+	case PPC_I(SUBFC):
+		gen_mov_32(native_use(rB_field::extract(opcode)), REG_T0_ID);
+		gen_sub_32(a, REG_T0_ID);
+		cc = X86_CC_AE;
+		break;
+	case PPC_I(SUBFIC):
+		gen_mov_32(x86_immediate_operand(simm), REG_T0_ID);
+		gen_sub_32(a, REG_T0_ID);
+		cc = X86_CC_AE;
+		break;
+	case PPC_I(ADDE): {
+		const int b = native_use(rB_field::extract(opcode));
+		ca = native_alloc(NATIVE_CA, true, true);
+		gen_mov_32(a, REG_T0_ID);
+		gen_bt_32(x86_immediate_operand(0), ca);
+		gen_adc_32(b, REG_T0_ID);
+		break;
+	}
+	case PPC_I(SUBFE): {
+		const int b = native_use(rB_field::extract(opcode));
+		ca = native_alloc(NATIVE_CA, true, true);
+		gen_mov_32(b, REG_T0_ID);
+		gen_bt_32(x86_immediate_operand(0), ca);
+		gen_cmc();
+		gen_sbb_32(a, REG_T0_ID);
+		cc = X86_CC_AE;
+		break;
+	}
+	case PPC_I(ADDME):
+	case PPC_I(ADDZE):
+	case PPC_I(SUBFME):
+	case PPC_I(SUBFZE):
+		ca = native_alloc(NATIVE_CA, true, true);
+		gen_mov_32(a, REG_T0_ID);
+		if (mnemo == PPC_I(SUBFME) || mnemo == PPC_I(SUBFZE))
+			gen_not_32(REG_T0_ID);
+		gen_bt_32(x86_immediate_operand(0), ca);
+		if (mnemo == PPC_I(ADDME) || mnemo == PPC_I(SUBFME))
+			gen_adc_32(x86_immediate_operand(-1), REG_T0_ID);
+		else
+			gen_adc_32(x86_immediate_operand(0), REG_T0_ID);
+		break;
+	default:
+		abort();
+	}
+	if (ca < 0)
+		ca = native_alloc(NATIVE_CA, false, true);
+	gen_setcc(cc, NATIVE_REG8(ca));
+	gen_mov_zx_8_32(NATIVE_REG8(ca), ca);
+
+	const int rD = rD_field::extract(opcode);
+	gen_mov_32(REG_T0_ID, native_def(rD));
+	if (mnemo == PPC_I(ADDIC_) || (!immediate && Rc_field::test(opcode)))
+		gen_native_defer_cr0(rD);
+	return true;
+}
+
+// and, andc, nand, or, orc, nor, xor, eqv
+bool powerpc_jit::gen_native_logical(int mnemo, uint32 opcode)
+{
+	const int rS = rS_field::extract(opcode);
+	const int rB = rB_field::extract(opcode);
+	const int rA = rA_field::extract(opcode);
+	if (native_is_const(rS) && native_is_const(rB)) {
+		const uint32 s = native_value[rS];
+		const uint32 b = native_value[rB];
+		uint32 v;
+		switch (mnemo) {
+		case PPC_I(AND):	v = s & b;		break;
+		case PPC_I(ANDC):	v = s & ~b;		break;
+		case PPC_I(NAND):	v = ~(s & b);	break;
+		case PPC_I(OR):		v = s | b;		break;
+		case PPC_I(ORC):	v = s | ~b;		break;
+		case PPC_I(NOR):	v = ~(s | b);	break;
+		case PPC_I(XOR):	v = s ^ b;		break;
+		case PPC_I(EQV):	v = ~(s ^ b);	break;
+		default:			abort();
+		}
+		native_set_const(rA, v);
+		if (Rc_field::test(opcode))
+			gen_native_defer_cr0(rA);
+		return true;
+	}
+	const int s = native_use(rS);
+	gen_mov_32(s, REG_T0_ID);
+	if (mnemo != PPC_I(OR) || rS != rB) {		// Not MR case
+		int b = native_use(rB);
+		if (mnemo == PPC_I(ANDC) || mnemo == PPC_I(ORC)) {
+			gen_mov_32(b, REG_T1_ID);
+			gen_not_32(REG_T1_ID);
+			b = REG_T1_ID;
+		}
+		switch (native_info[mnemo]->option) {
+		case X86_AND: gen_and_32(b, REG_T0_ID); break;
+		case X86_OR:  gen_or_32(b, REG_T0_ID);  break;
+		case X86_XOR: gen_xor_32(b, REG_T0_ID); break;
+		default: abort();
+		}
+		if (mnemo == PPC_I(NAND) || mnemo == PPC_I(NOR) || mnemo == PPC_I(EQV))
+			gen_not_32(REG_T0_ID);
+	}
+	gen_mov_32(REG_T0_ID, native_def(rA));
+	if (Rc_field::test(opcode))
+		gen_native_defer_cr0(rA);
+	return true;
+}
+
+// andi., andis., ori, oris, xori, xoris
+bool powerpc_jit::gen_native_logical_im(int mnemo, uint32 opcode)
+{
+	const int rS = rS_field::extract(opcode);
+	const int rA = rA_field::extract(opcode);
+	uint32 value = UIMM_field::extract(opcode);
+	if (mnemo == PPC_I(ANDIS) || mnemo == PPC_I(ORIS) || mnemo == PPC_I(XORIS))
+		value <<= 16;
+	const bool record = (mnemo == PPC_I(ANDI) || mnemo == PPC_I(ANDIS));
+	if (value == 0 && !record && rA == rS)		// nop
+		return true;
+
+	if (native_is_const(rS)) {
+		uint32 v = native_value[rS];
+		switch (native_info[mnemo]->option) {
+		case X86_AND: v &= value; break;
+		case X86_OR:  v |= value; break;
+		case X86_XOR: v ^= value; break;
+		default: abort();
+		}
+		native_set_const(rA, v);
+		if (record)
+			gen_native_defer_cr0(rA);
+		return true;
+	}
+	gen_mov_32(native_use(rS), REG_T0_ID);
+	switch (native_info[mnemo]->option) {
+	case X86_AND: gen_and_32(x86_immediate_operand(value), REG_T0_ID); break;
+	case X86_OR:  gen_or_32(x86_immediate_operand(value), REG_T0_ID);  break;
+	case X86_XOR: gen_xor_32(x86_immediate_operand(value), REG_T0_ID); break;
+	default: abort();
+	}
+	gen_mov_32(REG_T0_ID, native_def(rA));
+	if (record)
+		gen_native_defer_cr0(rA);
+	return true;
+}
+
+// extsb, extsh
+bool powerpc_jit::gen_native_extend(int mnemo, uint32 opcode)
+{
+	const int rS = rS_field::extract(opcode);
+	if (native_is_const(rS)) {
+		const uint32 v = native_info[mnemo]->option == 1 ? (int32)(int8)native_value[rS] : (int32)(int16)native_value[rS];
+		const int rA = rA_field::extract(opcode);
+		native_set_const(rA, v);
+		if (Rc_field::test(opcode))
+			gen_native_defer_cr0(rA);
+		return true;
+	}
+	gen_mov_32(native_use(rS), REG_T0_ID);
+	if (native_info[mnemo]->option == 1)
+		gen_mov_sx_8_32(REG_T0_ID, REG_T0_ID);
+	else
+		gen_mov_sx_16_32(REG_T0_ID, REG_T0_ID);
+	const int rA = rA_field::extract(opcode);
+	gen_mov_32(REG_T0_ID, native_def(rA));
+	if (Rc_field::test(opcode))
+		gen_native_defer_cr0(rA);
+	return true;
+}
+
+// rlwinm
+bool powerpc_jit::gen_native_rlwinm(int mnemo, uint32 opcode)
+{
+	const int SH = SH_field::extract(opcode);
+	const uint32 m = mask_operand::compute(MB_field::extract(opcode), ME_field::extract(opcode));
+	const int rS = rS_field::extract(opcode);
+	if (native_is_const(rS)) {
+		const uint32 v = native_value[rS];
+		const int rA = rA_field::extract(opcode);
+		native_set_const(rA, (SH ? (v << SH) | (v >> (32 - SH)) : v) & m);
+		if (Rc_field::test(opcode))
+			gen_native_defer_cr0(rA);
+		return true;
+	}
+	gen_mov_32(native_use(rS), REG_T0_ID);
+	if (SH)
+		gen_rol_32(x86_immediate_operand(SH), REG_T0_ID);
+	if (m != 0xffffffff)
+		gen_and_32(x86_immediate_operand(m), REG_T0_ID);
+	const int rA = rA_field::extract(opcode);
+	gen_mov_32(REG_T0_ID, native_def(rA));
+	if (Rc_field::test(opcode))
+		gen_native_defer_cr0(rA);
+	return true;
+}
+
+// cmp, cmpi, cmpl, cmpli
+bool powerpc_jit::gen_native_compare(int mnemo, uint32 opcode)
+{
+	const int crfD = crfD_field::extract(opcode);
+	const int rA = rA_field::extract(opcode);
+	const bool is_signed = native_info[mnemo]->option;
+	switch (mnemo) {
+	case PPC_I(CMP):
+	case PPC_I(CMPL):
+		gen_native_defer_cr(crfD, rA, rB_field::extract(opcode), 0, is_signed);
+		break;
+	case PPC_I(CMPI):
+		gen_native_defer_cr(crfD, rA, NATIVE_NONE, (int16)SIMM_field::extract(opcode), is_signed);
+		break;
+	case PPC_I(CMPLI):
+		gen_native_defer_cr(crfD, rA, NATIVE_NONE, UIMM_field::extract(opcode), is_signed);
+		break;
+	default:
+		abort();
+	}
+	return true;
+}
+
+// mfcr
+bool powerpc_jit::gen_native_mfcr(int mnemo, uint32 opcode)
+{
+	gen_native_commit_cr();
+	const int cr = native_use(NATIVE_CR);
+	gen_mov_32(cr, native_def(rD_field::extract(opcode)));
+	return true;
+}
+
+// mtcrf
+bool powerpc_jit::gen_native_mtcrf(int mnemo, uint32 opcode)
+{
+	const uint32 crm = CRM_field::extract(opcode);
+	uint32 m = 0;
+	for (int i = 0; i < 8; i++) {
+		if (crm & (1 << i))
+			m |= 0xf << (4 * i);
+	}
+	if (m == 0)
+		return true;
+	// A pending update of another CR field is not affected
+	if (native_cr.crf >= 0 && (m & (0xf << (28 - 4 * native_cr.crf))))
+		native_cr.crf = -1;
+	const int s = native_use(rS_field::extract(opcode));
+	if (m == 0xffffffff) {
+		gen_mov_32(s, native_def(NATIVE_CR));
+		return true;
+	}
+	gen_mov_32(s, REG_T0_ID);
+	gen_and_32(x86_immediate_operand(m), REG_T0_ID);
+	const int cr = native_alloc(NATIVE_CR, true, true);
+	gen_and_32(x86_immediate_operand(~m), cr);
+	gen_or_32(REG_T0_ID, cr);
+	return true;
+}
+
+#if PPC_ENABLE_FPU_EXCEPTIONS == 0
+// Round the double in SSE2 register R to single precision
+void powerpc_jit::gen_native_fp_round(int r)
+{
+	gen_cvtsd2ss(r, r);
+	gen_cvtss2sd(r, r);
+}
+
+// fadd, fsub, fmul, fdiv and their single-precision forms
+bool powerpc_jit::gen_native_fp_arith(int mnemo, uint32 opcode)
+{
+	if (Rc_field::test(opcode))
+		return false;
+	const int option = native_info[mnemo]->option;
+	const int op = option & 0xff;
+	const int frB = (op == X86_SSE_MUL) ? frC_field::extract(opcode) : frB_field::extract(opcode);
+	gen_movapd(native_fpr_use(frA_field::extract(opcode)), X86_XMM0);
+	const int b = native_fpr_use(frB);
+	switch (op) {
+	case X86_SSE_ADD: gen_addsd(b, X86_XMM0); break;
+	case X86_SSE_SUB: gen_subsd(b, X86_XMM0); break;
+	case X86_SSE_MUL: gen_mulsd(b, X86_XMM0); break;
+	case X86_SSE_DIV: gen_divsd(b, X86_XMM0); break;
+	}
+	if (option & 0x200)
+		gen_native_fp_round(X86_XMM0);
+	gen_movapd(X86_XMM0, native_fpr_def(frD_field::extract(opcode)));
+	return true;
+}
+
+// fmadd, fmsub, fnmadd, fnmsub and their single-precision forms
+//
+// The product is rounded before the addition, as in the dyngen ops.
+// Negative forms negate the rounded result, so they do not depend on
+// the rounding mode
+bool powerpc_jit::gen_native_fp_madd(int mnemo, uint32 opcode)
+{
+	if (Rc_field::test(opcode))
+		return false;
+	const int option = native_info[mnemo]->option;
+	gen_movapd(native_fpr_use(frA_field::extract(opcode)), X86_XMM0);
+	gen_mulsd(native_fpr_use(frC_field::extract(opcode)), X86_XMM0);
+	const int b = native_fpr_use(frB_field::extract(opcode));
+	if ((option & 0xff) == X86_SSE_ADD)
+		gen_addsd(b, X86_XMM0);
+	else
+		gen_subsd(b, X86_XMM0);
+	if (option & 0x200)
+		gen_native_fp_round(X86_XMM0);
+	if (option & 0x100) {
+		gen_pcmpeqd(X86_XMM1, X86_XMM1);
+		gen_psllq(x86_immediate_operand(63), X86_XMM1);
+		gen_xorpd(X86_XMM1, X86_XMM0);
+	}
+	gen_movapd(X86_XMM0, native_fpr_def(frD_field::extract(opcode)));
+	return true;
+}
+
+// fmr, fneg, fabs, fnabs
+bool powerpc_jit::gen_native_fp_move(int mnemo, uint32 opcode)
+{
+	if (Rc_field::test(opcode))
+		return false;
+	const int op = native_info[mnemo]->option & 0xff;
+	const int frB = frB_field::extract(opcode);
+	const int frD = frD_field::extract(opcode);
+	if (op == 0) {
+		if (frD != frB)
+			gen_movapd(native_fpr_use(frB), native_fpr_def(frD));
+		return true;
+	}
+
+	// Operate on the sign bit, fabs clears it with andnpd
+	gen_pcmpeqd(X86_XMM1, X86_XMM1);
+	gen_psllq(x86_immediate_operand(63), X86_XMM1);
+	const int b = native_fpr_use(frB);
+	switch (op) {
+	case X86_SSE_XOR:
+		gen_xorpd(b, X86_XMM1);
+		break;
+	case X86_SSE_ANDN:
+		gen_andnpd(b, X86_XMM1);
+		break;
+	case X86_SSE_OR:
+		gen_orpd(b, X86_XMM1);
+		break;
+	}
+	gen_movapd(X86_XMM1, native_fpr_def(frD));
+	return true;
+}
+#endif
+
+#if NATIVE_MEMORY_ACCESS
+// Compute effective address into T1, and its host address into T2
+void powerpc_jit::gen_native_ea(uint32 opcode, bool indexed, bool update)
+{
+	const int rA = rA_field::extract(opcode);
+	const int rB = rB_field::extract(opcode);
+	const int32 d = (int16)d_field::extract(opcode);
+	const bool no_base = (rA == 0 && !update);
+	if ((no_base || native_is_const(rA)) && (!indexed || native_is_const(rB))) {
+		const uint32 base = no_base ? 0 : native_value[rA];
+		gen_mov_32(x86_immediate_operand(base + (indexed ? native_value[rB] : d)), REG_T1_ID);
+	}
+	else if (no_base)
+		gen_mov_32(native_use(rB), REG_T1_ID);
+	else {
+		const int a = native_use(rA);
+		if (indexed)
+			gen_lea_32(x86_memory_operand(0, a, native_use(rB)), REG_T1_ID);
+		else
+			gen_lea_32(x86_memory_operand(d, a), REG_T1_ID);
+	}
+	gen_lea_32(x86_memory_operand((uint32)VMBaseDiff, REG_T1_ID), REG_T2_ID);
+}
+
+// lbz, lhz, lha, lwz and their update/indexed forms
+bool powerpc_jit::gen_native_load(int mnemo, uint32 opcode)
+{
+	const int option = native_info[mnemo]->option;
+	const int size = option & 0xf;
+	const bool update = option & 0x20;
+	const bool indexed = option & 0x40;
+	const int rA = rA_field::extract(opcode);
+	const int rD = rD_field::extract(opcode);
+	const int32 offset = (int16)d_field::extract(opcode);
+
+	// Reuse the word last loaded from, or stored to, the same slot
+	const bool cacheable = native_optimizer && size == 4 && !indexed && !update && rA != 0;
+	if (cacheable) {
+		const int r = native_find_load(rA, offset);
+		if (r != NATIVE_NONE) {
+			if (r == rD)
+				return true;
+			if (native_is_const(r))
+				native_set_const(rD, native_value[r]);
+			else {
+				const int s = native_use(r);
+				gen_mov_32(s, native_def(rD));
+			}
+			return true;
+		}
+	}
+
+	gen_native_ea(opcode, indexed, update);
+	const x86_memory_operand mem(0, REG_T2_ID);
+	const int d = native_def(rD);
+	switch (size) {
+	case 1:
+		gen_mov_zx_8_32(mem, d);
+		break;
+	case 2:
+		gen_mov_zx_16_32(mem, d);
+		gen_rol_16(x86_immediate_operand(8), d);
+		if (option & 0x10)
+			gen_mov_sx_16_32(d, d);
+		break;
+	case 4:
+		gen_mov_32(mem, d);
+		gen_bswap_32(d);
+		break;
+	}
+
+	if (update)
+		gen_mov_32(REG_T1_ID, native_def(rA));
+	else if (cacheable)
+		native_record_load(rA, offset, rD);
+	return true;
+}
+
+// stb, sth, stw and their update/indexed forms
+bool powerpc_jit::gen_native_store(int mnemo, uint32 opcode)
+{
+	const int option = native_info[mnemo]->option;
+	const int size = option & 0xf;
+	const bool update = option & 0x20;
+	const bool indexed = option & 0x40;
+	const int rA = rA_field::extract(opcode);
+	const int rS = rS_field::extract(opcode);
+	gen_native_ea(opcode, indexed, update);
+
+	// Any slot may be overwritten, except that this one now holds rS
+	native_forget_loads();
+	if (size == 4 && !indexed && !update && rA != 0)
+		native_record_load(rA, (int16)d_field::extract(opcode), rS);
+
+	const x86_memory_operand mem(0, REG_T2_ID);
+	gen_mov_32(native_use(rS), REG_T0_ID);
+	switch (size) {
+	case 1:
+		gen_mov_8(REG_T0_ID, mem);
+		break;
+	case 2:
+		gen_rol_16(x86_immediate_operand(8), REG_T0_ID);
+		gen_mov_16(REG_T0_ID, mem);
+		break;
+	case 4:
+		gen_bswap_32(REG_T0_ID);
+		gen_mov_32(REG_T0_ID, mem);
+		break;
+	}
+
+	if (update)
+		gen_mov_32(REG_T1_ID, native_def(rA));
+	return true;
+}
+
+// lfd and its update/indexed forms
+bool powerpc_jit::gen_native_load_fpr(int mnemo, uint32 opcode)
+{
+	const int option = native_info[mnemo]->option;
+	gen_native_ea(opcode, option & 0x40, option & 0x20);
+	gen_mov_64(x86_memory_operand(0, REG_T2_ID), REG_T0_ID);
+	gen_bswap_64(REG_T0_ID);
+	gen_movq_qx(REG_T0_ID, native_fpr_def(frD_field::extract(opcode)));
+	if (option & 0x20)
+		gen_mov_32(REG_T1_ID, native_def(rA_field::extract(opcode)));
+	return true;
+}
+
+// stfd and its update/indexed forms
+bool powerpc_jit::gen_native_store_fpr(int mnemo, uint32 opcode)
+{
+	const int option = native_info[mnemo]->option;
+	gen_native_ea(opcode, option & 0x40, option & 0x20);
+	native_forget_loads();
+	gen_movq_xq(native_fpr_use(frS_field::extract(opcode)), REG_T0_ID);
+	gen_bswap_64(REG_T0_ID);
+	gen_mov_64(REG_T0_ID, x86_memory_operand(0, REG_T2_ID));
+	if (option & 0x20)
+		gen_mov_32(REG_T1_ID, native_def(rA_field::extract(opcode)));
+	return true;
+}
+
+#if KPX_MAX_CPUS == 1
+#define xPPC_RESERVE_VALID	xPPC_FIELD(regs().reserve_valid)
+#define xPPC_RESERVE_ADDR	xPPC_FIELD(regs().reserve_addr)
+#define xPPC_RESERVE_DATA	xPPC_FIELD(regs().reserve_data)
+
+// lwarx
+bool powerpc_jit::gen_native_lwarx(int mnemo, uint32 opcode)
+{
+	gen_native_ea(opcode, true, false);
+	gen_mov_32(x86_memory_operand(0, REG_T2_ID), REG_T0_ID);
+	gen_bswap_32(REG_T0_ID);
+	gen_mov_32(x86_immediate_operand(1), x86_memory_operand(xPPC_RESERVE_VALID, REG_CPU_ID));
+	gen_mov_32(REG_T1_ID, x86_memory_operand(xPPC_RESERVE_ADDR, REG_CPU_ID));
+	gen_mov_32(REG_T0_ID, x86_memory_operand(xPPC_RESERVE_DATA, REG_CPU_ID));
+	gen_mov_32(REG_T0_ID, native_def(rD_field::extract(opcode)));
+	return true;
+}
+
+// stwcx.
+//
+// The store succeeds if the reservation is held for the same address
+// and memory still holds the word lwarx read, which cmpxchg checks and
+// updates at once. There is no helper call on any path. Without other
+// emulated CPUs to race with, the bus lock is not worth its cost
+bool powerpc_jit::gen_native_stwcx(int mnemo, uint32 opcode)
+{
+	// stwcx. writes CR0, any other pending field is computed first
+	gen_native_commit_cr();
+	gen_native_ea(opcode, true, false);
+	gen_mov_32(native_use(rS_field::extract(opcode)), REG_T0_ID);
+	gen_bswap_32(REG_T0_ID);
+	native_forget_loads();
+
+	// cmpxchg compares against %eax, which is the first native register
+	assert(native_reg_ids[0] == X86_EAX);
+	native_reserve(0);
+
+	// ZF is clear on both failure paths, and set by cmpxchg on success
+	gen_cmp_32(x86_immediate_operand(1), x86_memory_operand(xPPC_RESERVE_VALID, REG_CPU_ID));
+	gen_jcc_offset(X86_CC_NE, x86_immediate_operand(0));
+	uint8 *no_reservation = code_ptr();
+	gen_cmp_32(x86_memory_operand(xPPC_RESERVE_ADDR, REG_CPU_ID), REG_T1_ID);
+	gen_jcc_offset(X86_CC_NE, x86_immediate_operand(0));
+	uint8 *other_address = code_ptr();
+	gen_mov_32(x86_memory_operand(xPPC_RESERVE_DATA, REG_CPU_ID), X86_EAX);
+	gen_bswap_32(X86_EAX);
+	gen_cmpxchg_32(REG_T0_ID, x86_memory_operand(0, REG_T2_ID));
+	((int32 *)no_reservation)[-1] = code_ptr() - no_reservation;
+	((int32 *)other_address)[-1] = code_ptr() - other_address;
+
+	// Record CR0 = 0b00 || EQ || SO, the reservation is lost either way
+	gen_setcc(X86_CC_Z, REG_T0_ID);
+	gen_mov_32(x86_immediate_operand(0), x86_memory_operand(xPPC_RESERVE_VALID, REG_CPU_ID));
+	gen_mov_zx_8_32(REG_T0_ID, REG_T0_ID);
+	gen_mov_zx_8_32(x86_memory_operand(xPPC_XER_SO, REG_CPU_ID), REG_T1_ID);
+	gen_lea_32(x86_memory_operand(0, REG_T1_ID, REG_T0_ID, 2), REG_T0_ID);
+	gen_shl_32(x86_immediate_operand(28), REG_T0_ID);
+	const int cr = native_alloc(NATIVE_CR, true, true);
+	gen_and_32(x86_immediate_operand(0x0fffffff), cr);
+	gen_or_32(REG_T0_ID, cr);
+	return true;
+}
+#endif
+#endif
 #endif
@@ -38,6 +38,32 @@ struct powerpc_jit
 	bool gen_vector_3(int mnemo, int vD, int vA, int vB, int vC);
 	bool gen_vector_compare(int mnemo, int vD, int vA, int vB, bool Rc);
 
+	// Load/store multiple and string immediate, nb bytes from rA|0 + d
+	bool gen_multiple(int mnemo, int r, int rA, int32 d, int nb);
+
+#if PPC_ENABLE_NATIVE_JIT
+	// Native x86-64 code generator, selected at runtime
+	bool use_native_codegen(void) const		{ return native_codegen; }
+	void set_native_codegen(bool enable)	{ native_codegen = enable; }
+
+	// Host register cache management
+	void gen_native_start(void);
+	void gen_native_flush(void);
+
+	// Generate native code for one instruction, return false if not handled
+	bool gen_native(int mnemo, uint32 opcode);
+
+	// Block-level optimizations: constant propagation, redundant load
+	// removal, and elimination of instructions whose result is dead
+	bool use_native_optimizer(void) const	{ return native_optimizer; }
+	void set_native_optimizer(bool enable)	{ native_optimizer = enable; }
+
+	// Liveness pre-pass over the straight-line code starting at pc
+	static const int NATIVE_SCAN_MAX = 64;
+	void gen_native_prepass(uint32 pc, int count, const int *mnemos, const uint32 *opcodes);
+	bool native_dead(uint32 pc) const;
+#endif
+
 private:
 	// Mid-level code generator info
 	typedef bool (powerpc_jit::*gen_handler_t)(int, bool);
@@ -96,10 +122,185 @@ private:
 	bool gen_sse2_vspltb(int mnemo, int vD, int UIMM, int vB);
 	bool gen_sse2_vsplth(int mnemo, int vD, int UIMM, int vB);
 	bool gen_sse2_vspltw(int mnemo, int vD, int UIMM, int vB);
+	void gen_sse2_vconst(int vR, uint32 value);
+	void gen_sse2_record_sat(int vM);
+	void gen_sse2_record_sat_diff(int vR, int vS);
+	void gen_sse2_record_pack_sat(int shift, uint32 bias);
+	void gen_sse2_adduws(void);
+	void gen_sse2_addsws(bool sub);
+	bool gen_sse2_arith_sat(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_arith_uw(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_arith_sw(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vaddcuw(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vsubcuw(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vnor(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vcmpgtu(int mnemo, int vD, int vA, int vB, bool Rc);
+	bool gen_sse2_vavg(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vmaxmin(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vmaxuh(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vminuh(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vmerge(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vpack(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vunpack(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vmul(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vmladduhm(int mnemo, int vD, int vA, int vB, int vC);
+	bool gen_sse2_vmsum(int mnemo, int vD, int vA, int vB, int vC);
+	bool gen_sse2_vsum4(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vshift(int mnemo, int vD, int vA, int vB);
+	bool gen_sse2_vcfx(int mnemo, int vD, int UIMM, int vB);
+	bool gen_sse2_vctsxs(int mnemo, int vD, int UIMM, int vB);
+	bool gen_sse2_vctuxs(int mnemo, int vD, int UIMM, int vB);
 	uintptr gen_ssse3_vswap_mask(void);
 	bool gen_ssse3_lvx(int mnemo, int vD, int rA, int rB);
 	bool gen_ssse3_stvx(int mnemo, int vS, int rA, int rB);
 	bool gen_ssse3_vperm(int mnemo, int vD, int vA, int vB, int vC);
+	bool gen_ssse3_vshift_octet(int mnemo, int vD, int vA, int vB);
+	void gen_ssse3_multiple_ea(int rA, int32 d);
+	bool gen_ssse3_load_multiple(int mnemo, int rD, int rA, int32 d, int nb);
+	bool gen_ssse3_store_multiple(int mnemo, int rS, int rA, int32 d, int nb);
+	bool gen_sse41_vpack(int mnemo, int vD, int vA, int vB);
+	bool gen_sse41_vrfi(int mnemo, int vD, int vA, int vB);
+	bool gen_avx2_vshw(int mnemo, int vD, int vA, int vB);
+	bool gen_avx2_vshh(int mnemo, int vD, int vA, int vB);
+	bool gen_avx2_vrlw(int mnemo, int vD, int vA, int vB);
+#endif
+
+#if PPC_ENABLE_NATIVE_JIT
+	bool native_codegen;
+	bool native_optimizer;
+
+	// Native code generator info
+	typedef bool (powerpc_jit::*native_handler_t)(int, uint32);
+	struct native_info_t {
+		int mnemo;
+		native_handler_t handler;
+		int option;
+		int flags;					// registers read and written, see below
+	};
+	enum {
+		NATIVE_DEF_RD	= 1 << 0,	// writes rD
+		NATIVE_DEF_RA	= 1 << 1,	// writes rA
+		NATIVE_DEF_CR0	= 1 << 2,	// writes CR0
+		NATIVE_DEF_RC	= 1 << 3,	// writes CR0 if Rc is set
+		NATIVE_DEF_CRFD	= 1 << 4,	// writes CR field crfD
+		NATIVE_DEF_CA	= 1 << 5,	// writes XER[CA]
+		NATIVE_DEF_MEM	= 1 << 6,	// writes memory
+		NATIVE_USE_RA	= 1 << 7,	// reads rA
+		NATIVE_USE_RA0	= 1 << 8,	// reads rA, unless it is 0
+		NATIVE_USE_RB	= 1 << 9,	// reads rB
+		NATIVE_USE_RS	= 1 << 10,	// reads rS
+		NATIVE_OE		= 1 << 11,	// not handled if OE is set
+		NATIVE_RC		= 1 << 12,	// not handled if Rc is set
+		NATIVE_DEF_FPR	= 1 << 13	// writes an FPR
+	};
+	static const native_info_t *native_info[];
+
+	// Host register cache. PowerPC GPRs, the whole CR and XER[CA] are
+	// kept in caller-saved host registers until the next block exit or
+	// call to a generic handler, where dirty registers are written back
+	enum {
+		NATIVE_CR		= 32,		// CR pseudo register number
+		NATIVE_CA		= 33,		// XER[CA] pseudo register number
+		NATIVE_NONE		= -1,		// no PowerPC register cached
+		NATIVE_REGS		= 9			// number of host registers
+	};
+	struct native_reg_t {
+		int ppc;					// cached PowerPC register
+		bool dirty;					// needs a write back
+		uint32 age;					// last use, for LRU replacement
+	};
+	static const int native_reg_ids[NATIVE_REGS];
+	native_reg_t native_regs[NATIVE_REGS];
+	int native_map[NATIVE_CA + 1];
+	uint32 native_age;
+	uint32 native_locked;
+
+	// Pending CR field update. The last compare, or record form, only
+	// remembers its operands. CR bits are computed when the CR is read,
+	// an operand is about to change, or cached registers are flushed.
+	// The update is dropped if the same field is written again before
+	// that
+	struct native_cr_t {
+		int crf;					// CR field, or -1 if none pending
+		int lhs, rhs;				// PowerPC GPRs, rhs is NATIVE_NONE for imm
+		uint32 imm;
+		bool is_signed;
+	};
+	native_cr_t native_cr;
+
+	// Known GPR values. Lazy ones are not in a host register and not
+	// written back yet, they are materialized on use or flush
+	uint32 native_known;
+	uint32 native_lazy;
+	uint32 native_value[32];
+
+	// Word slots last loaded or stored, as base register + offset, and
+	// the GPR that still holds their value
+	static const int NATIVE_LOADS = 4;
+	struct native_load_t {
+		int base;					// NATIVE_NONE if the entry is free
+		int32 offset;
+		int value;
+	};
+	native_load_t native_loads[NATIVE_LOADS];
+	int native_next_load;
+
+	// FPRs are cached the same way in SSE2 registers, except for xmm0
+	// and xmm1 that are left as scratch registers
+	enum {
+		NATIVE_FPRS		= 14		// number of host SSE2 registers
+	};
+	native_reg_t native_fprs[NATIVE_FPRS];
+	int native_fpr_map[32];
+	uint32 native_fpr_locked;
+
+	// Instructions found dead by the pre-pass, from native_scan_pc
+	uint32 native_scan_pc;
+	int native_scan_count;
+	uint64 native_dead_mask;
+
+	int native_alloc(int r, bool load, bool dirty);
+	int native_use(int r)	{ return native_alloc(r, true, false); }
+	int native_def(int r)	{ return native_alloc(r, false, true); }
+	void native_spill(int n);
+	void native_reserve(int n);
+	int native_fpr_alloc(int r, bool load, bool dirty);
+	int native_fpr_use(int r)	{ return native_fpr_alloc(r, true, false); }
+	int native_fpr_def(int r)	{ return native_fpr_alloc(r, false, true); }
+	void native_fpr_spill(int n);
+	bool native_is_const(int r) const	{ return native_optimizer && (native_known & (1 << r)); }
+	void native_set_const(int r, uint32 value);
+	void native_forget(int r);
+	void native_forget_loads(void);
+	int native_find_load(int base, int32 offset);
+	void native_record_load(int base, int32 offset, int value);
+	void gen_native_ea(uint32 opcode, bool indexed, bool update);
+	void gen_native_record_cr(int crf, int cc_lt, int cc_gt);
+	void gen_native_defer_cr(int crf, int lhs, int rhs, uint32 imm, bool is_signed);
+	void gen_native_defer_cr0(int r)		{ gen_native_defer_cr(0, r, NATIVE_NONE, 0, true); }
+	void gen_native_commit_cr(void);
+
+	bool gen_native_not_available(int mnemo, uint32 opcode);
+	bool gen_native_addi(int mnemo, uint32 opcode);
+	bool gen_native_arith(int mnemo, uint32 opcode);
+	bool gen_native_carry(int mnemo, uint32 opcode);
+	bool gen_native_logical(int mnemo, uint32 opcode);
+	bool gen_native_logical_im(int mnemo, uint32 opcode);
+	bool gen_native_extend(int mnemo, uint32 opcode);
+	bool gen_native_rlwinm(int mnemo, uint32 opcode);
+	bool gen_native_compare(int mnemo, uint32 opcode);
+	bool gen_native_mfcr(int mnemo, uint32 opcode);
+	bool gen_native_mtcrf(int mnemo, uint32 opcode);
+	bool gen_native_load(int mnemo, uint32 opcode);
+	bool gen_native_store(int mnemo, uint32 opcode);
+	bool gen_native_lwarx(int mnemo, uint32 opcode);
+	bool gen_native_stwcx(int mnemo, uint32 opcode);
+	void gen_native_fp_round(int r);
+	bool gen_native_fp_arith(int mnemo, uint32 opcode);
+	bool gen_native_fp_madd(int mnemo, uint32 opcode);
+	bool gen_native_fp_move(int mnemo, uint32 opcode);
+	bool gen_native_load_fpr(int mnemo, uint32 opcode);
+	bool gen_native_store_fpr(int mnemo, uint32 opcode);
 #endif
 };
 
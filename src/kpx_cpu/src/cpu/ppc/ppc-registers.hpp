@@ -111,6 +111,7 @@ class powerpc_xer_register
 	uint8 ov;
 	uint8 ca;
 	uint8 byte_count;
+	friend class powerpc_jit;
 public:
 	powerpc_xer_register();
 	void set(uint32 xer);
@@ -241,6 +242,7 @@ struct powerpc_registers
 #if KPX_MAX_CPUS == 1
 	uint32 reserve_valid;
 	uint32 reserve_addr;
+	uint32 reserve_data;		// Word loaded by lwarx, checked by stwcx.
 #else
 	static uint32 reserve_valid;
 	static uint32 reserve_addr;
@@ -22,6 +22,7 @@
 #include "cpu/ppc/ppc-cpu.hpp"
 #include "cpu/ppc/ppc-instructions.hpp"
 #include "cpu/ppc/ppc-operands.hpp"
+#include "utils/utils-cpuinfo.hpp"
 
 #if PPC_ENABLE_JIT
 #include "cpu/jit/dyngen-exec.h"
@@ -32,6 +33,22 @@
 #endif
 
 #include <stdio.h>
+#include <algorithm>
+
+#if PPC_PERSISTENT_JIT_CACHE
+#include <unistd.h>
+#include <sys/stat.h>
+#include "vm_alloc.h"
+#endif
+
+#if PPC_PERF_JIT_MAP
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
 
 #define DEBUG 1
 #include "debug.h"
@@ -44,6 +61,9 @@
 // Define to enable const branches optimization
 #define FOLLOW_CONST_JUMPS 1
 
+// Define to resolve indirect branches through per-site and return caches
+#define INDIRECT_BRANCH_CACHE 1
+
 // FIXME: define ROM areas
 static inline bool is_read_only_memory(uintptr addr)
 {
@@ -126,7 +146,7 @@ static void disasm_translation(uint32 src_addr, uint32 src_len,
 
 #if PPC_ENABLE_JIT
 powerpc_cpu::block_info *
-powerpc_cpu::compile_block(uint32 entry_point)
+powerpc_cpu::compile_block(uint32 entry_point, bool trace)
 {
 #if DEBUG
 	bool disasm = false;
@@ -134,6 +154,15 @@ powerpc_cpu::compile_block(uint32 entry_point)
 	const bool disasm = false;
 #endif
 
+#if PPC_PERSISTENT_JIT_CACHE
+	// Reuse the block loaded from the translation cache file, if any
+	if (!trace && !use_profiler() && !saved_blocks.empty()) {
+		block_info *bi = restore_block(entry_point);
+		if (bi)
+			return bi;
+	}
+#endif
+
 #if PPC_PROFILE_COMPILE_TIME
 	compile_count++;
 	clock_t start_time = clock();
@@ -145,11 +174,73 @@ powerpc_cpu::compile_block(uint32 entry_point)
   again:
 	block_info *bi = my_block_cache.new_blockinfo();
 	bi->init(entry_point);
+#if PPC_TRACE_JIT
+	// Count executions of new blocks until they are retranslated as traces
+	bi->count = trace ? 0 : TRACE_THRESHOLD;
+	bi->entry_point = dg.gen_start(entry_point, trace ? 0 : (uintptr)bi);
+#if PPC_PERSISTENT_JIT_CACHE
+	if (!trace)
+		record_self_ref(bi, block_info::SELF_REF_COUNTER, bi->entry_point, (uintptr)bi);
+#endif
+#else
 	bi->entry_point = dg.gen_start(entry_point);
+#endif
+#if PPC_RUNTIME_PROFILER
+	// Count executions of the entry point, whatever translation runs it
+	profile_block *pb = NULL;
+	if (profiling) {
+		pb = &profile_blocks[entry_point];
+		dg.gen_mov_ad_A0_im((uintptr)&pb->count);
+		dg.gen_inc_64_A0();
+#if PPC_PERSISTENT_JIT_CACHE
+		// Counters are not relocated, don't save the block
+		bi->self_refs[block_info::SELF_REF_COUNTER] = block_info::BROKEN_REF;
+#endif
+	}
+#endif
+#if PPC_ENABLE_NATIVE_JIT
+	dg.gen_native_start();
+	if (dg.use_native_codegen() && dg.use_native_optimizer()) {
+		// Decode the straight-line code of the block ahead, up to the
+		// first branch, to find dead register writes
+		int mnemos[powerpc_jit::NATIVE_SCAN_MAX];
+		uint32 opcodes[powerpc_jit::NATIVE_SCAN_MAX];
+		int count = 0;
+		while (count < powerpc_jit::NATIVE_SCAN_MAX) {
+			opcodes[count] = vm_read_memory_4(entry_point + 4 * count);
+			const instr_info_t *ii = decode(opcodes[count]);
+			mnemos[count++] = ii->mnemo;
+			if (ii->cflow & CFLOW_END_BLOCK)
+				break;
+		}
+		dg.gen_native_prepass(entry_point, count, mnemos, opcodes);
+	}
+#endif
 
 	// Direct block chaining support variables
 	bool use_direct_block_chaining = false;
 
+#if INDIRECT_BRANCH_CACHE
+	// Kind of indirect branch ending the block
+	enum { JUMP_NEXT, JUMP_INDIRECT, JUMP_RETURN };
+	int jump_kind = JUMP_NEXT;
+#endif
+
+#if PPC_TRACE_JIT
+	// Side exits of the trace, generated after the block epilogue, and
+	// guest code ranges translated so far
+	static const int MAX_TRACE_EXITS = 8;
+	static const int MAX_TRACE_RANGES = 16;
+	struct {
+		uint8 *jmp_addr;
+		uint32 pc;
+	} trace_exits[MAX_TRACE_EXITS];
+	uint32 trace_ranges[MAX_TRACE_RANGES][2];
+	int trace_exit_count = 0;
+	int trace_range_count = 0;
+	uint32 trace_range_start = entry_point;
+#endif
+
 	int compile_status;
 	uint32 dpc = entry_point - 4;
 	uint32 min_pc, max_pc;
@@ -168,6 +259,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 
 #if PPC_FLIGHT_RECORDER
 		if (is_logging()) {
+#if PPC_ENABLE_NATIVE_JIT
+			dg.gen_native_flush();
+#endif
 			typedef void (*func_t)(dyngen_cpu_base, uint32, uint32);
 			func_t func = (func_t)nv_mem_fun((execute_pmf)&powerpc_cpu::do_record_step).ptr();
 			dg.gen_invoke_CPU_im_im(func, dpc, opcode);
@@ -186,6 +280,16 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		};
 		operands_t op;
 
+#if PPC_ENABLE_NATIVE_JIT
+		// Try the native code generator first. Otherwise, write back
+		// cached registers prior to the dyngen code path
+		if (dg.use_native_codegen()) {
+			if (dg.native_dead(dpc) || dg.gen_native(ii->mnemo, opcode))
+				goto done_native;
+			dg.gen_native_flush();
+		}
+#endif
+
 		switch (ii->mnemo) {
 		case PPC_I(LBZ):		// Load Byte and Zero
 			op.mem.size = 1;
@@ -453,6 +557,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		case PPC_I(STMW):		// Store Multiple Word
 		{
 			const int rA = rA_field::extract(opcode);
+			const int rD = rD_field::extract(opcode);
+			if (dg.gen_multiple(ii->mnemo, rD, rA, operand_D::get(this, opcode), 4 * (32 - rD)))
+				break;
 			if (rA == 0)
 				dg.gen_mov_32_T0_im(operand_D::get(this, opcode));
 			else {
@@ -465,6 +572,14 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			}
 			break;
 		}
+		case PPC_I(LSWI):		// Load String Word Immediate
+		case PPC_I(STSWI):		// Store String Word Immediate
+		{
+			const int nb = NB_field::extract(opcode);
+			if (!dg.gen_multiple(ii->mnemo, rD_field::extract(opcode), rA_field::extract(opcode), 0, nb ? nb : 32))
+				goto do_generic;
+			break;
+		}
 #if KPX_MAX_CPUS == 1
 		case PPC_I(STWCX):		// Store Word Conditional Indexed
 		case PPC_I(LWARX):		// Load Word and Reserve Indexed
@@ -499,12 +614,43 @@ powerpc_cpu::compile_block(uint32 entry_point)
 				if (LK_field::test(opcode)) {
 					const uint32 npc = dpc + 4;
 					dg.gen_store_im_LR(npc);
+#if INDIRECT_BRANCH_CACHE
+					gen_push_return(bi);
+#endif
 				}
 				if (AA_field::test(opcode))
 					dpc = 0;
 				op.jmp.target = ((dpc + operand_BD::get(this, opcode)) & -4);
 				goto do_const_jump;
 			}
+#if PPC_TRACE_JIT
+			// Follow the statically predicted side of conditional branches in traces
+			if (trace && !LK_field::test(opcode) &&
+				trace_exit_count < MAX_TRACE_EXITS && trace_range_count < MAX_TRACE_RANGES) {
+				const uint32 tpc = ((AA_field::test(opcode) ? 0 : dpc) + operand_BD::get(this, opcode)) & -4;
+				const uint32 npc = dpc + 4;
+
+				// Backward branches are predicted taken, the y bit reverses the prediction
+				bool taken = tpc <= dpc;
+				if (bo & 1)
+					taken = !taken;
+				const uint32 xpc = taken ? tpc : npc;
+
+				// Don't translate the same code twice, i.e. stop at loops
+				bool follow = !(xpc >= trace_range_start && xpc <= dpc);
+				for (int i = 0; follow && i < trace_range_count; i++) {
+					if (xpc >= trace_ranges[i][0] && xpc <= trace_ranges[i][1])
+						follow = false;
+				}
+				if (follow) {
+					trace_exits[trace_exit_count].jmp_addr = dg.gen_bc_exit(bo, BI_field::extract(opcode), taken);
+					trace_exits[trace_exit_count].pc = taken ? npc : tpc;
+					trace_exit_count++;
+					op.jmp.target = xpc;
+					goto do_const_jump;
+				}
+			}
+#endif
 #endif
 			const uint32 tpc = ((AA_field::test(opcode) ? 0 : dpc) + operand_BD::get(this, opcode)) & -4;
 			const uint32 npc = dpc + 4;
@@ -519,28 +665,47 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			}
 #endif
 
-			if (LK_field::test(opcode))
+			if (LK_field::test(opcode)) {
 				dg.gen_store_im_LR(npc);
+#if INDIRECT_BRANCH_CACHE
+				gen_push_return(bi);
+#endif
+			}
 
 			dg.gen_bc(bo, BI_field::extract(opcode), tpc, npc, use_direct_block_chaining);
 			break;
 		}
 		case PPC_I(BCCTR):		// Branch Conditional to Count Register
-			dg.gen_load_T0_CTR_aligned();
-			goto do_branch;
 		case PPC_I(BCLR):		// Branch Conditional to Link Register
-			dg.gen_load_T0_LR_aligned();
-			goto do_branch;
 		{
-		  do_branch:
 			const int bo = BO_field::extract(opcode);
-			const int bi = BI_field::extract(opcode);
+			const int crb = BI_field::extract(opcode);
 
-			const uint32 npc = dpc + 4;
+#if INDIRECT_BRANCH_CACHE
+			// The return block is pushed through A0, i.e. T0, so do it
+			// before loading the branch target
 			if (LK_field::test(opcode))
+				gen_push_return(bi);
+#endif
+			if (ii->mnemo == PPC_I(BCCTR))
+				dg.gen_load_T0_CTR_aligned();
+			else
+				dg.gen_load_T0_LR_aligned();
+
+			const uint32 npc = dpc + 4;
+			if (LK_field::test(opcode)) {
 				dg.gen_store_im_LR(npc);
+#if INDIRECT_BRANCH_CACHE
+				jump_kind = JUMP_INDIRECT;
+			}
+			else if (ii->mnemo == PPC_I(BCLR))
+				jump_kind = JUMP_RETURN;
+			else {
+				jump_kind = JUMP_INDIRECT;
+#endif
+			}
 
-			dg.gen_bc(bo, bi, (uint32)-1, npc, use_direct_block_chaining);
+			dg.gen_bc(bo, crb, (uint32)-1, npc, use_direct_block_chaining);
 			break;
 		}
 		case PPC_I(B):			// Branch
@@ -548,6 +713,16 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		{
 #if FOLLOW_CONST_JUMPS
 		  do_const_jump:
+			if (dpc > max_pc)
+				max_pc = dpc;
+#if PPC_TRACE_JIT
+			if (trace && trace_range_count < MAX_TRACE_RANGES) {
+				trace_ranges[trace_range_count][0] = trace_range_start;
+				trace_ranges[trace_range_count][1] = dpc;
+				trace_range_count++;
+			}
+			trace_range_start = op.jmp.target;
+#endif
 			sync_pc = dpc = op.jmp.target - 4;
 			sync_pc_offset = 0;
 			if (dpc < min_pc)
@@ -562,8 +737,12 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			tpc = (tpc + operand_LI::get(this, opcode)) & -4;
 
 			const uint32 npc = dpc + 4;
-			if (LK_field::test(opcode))
+			if (LK_field::test(opcode)) {
 				dg.gen_store_im_LR(npc);
+#if INDIRECT_BRANCH_CACHE
+				gen_push_return(bi);
+#endif
+			}
 #if FOLLOW_CONST_JUMPS
 			else {
 				op.jmp.target = tpc;
@@ -1312,7 +1491,7 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			}
 			dg.gen_store_FD_FPR(frD_field::extract(opcode));
 			if (Rc_field::test(opcode))
-				dg.gen_record_cr1();
+				gen_record_cr1();
 			break;
 		}
 		case PPC_I(FADD):		// Floating Add (Double-Precision)
@@ -1341,7 +1520,7 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			}
 			dg.gen_store_FD_FPR(frD_field::extract(opcode));
 			if (Rc_field::test(opcode))
-				dg.gen_record_cr1();
+				gen_record_cr1();
 			break;
 		}
 		case PPC_I(FMADD):		// Floating Multiply-Add (Double-Precision)
@@ -1368,7 +1547,7 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			}
 			dg.gen_store_FD_FPR(frD_field::extract(opcode));
 			if (Rc_field::test(opcode))
-				dg.gen_record_cr1();
+				gen_record_cr1();
 			break;
 		}
 #endif
@@ -1391,6 +1570,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		case PPC_I(VCMPGTSB):
 		case PPC_I(VCMPGTSH):
 		case PPC_I(VCMPGTSW):
+		case PPC_I(VCMPGTUB):
+		case PPC_I(VCMPGTUH):
+		case PPC_I(VCMPGTUW):
 		{
 			const int vD = vD_field::extract(opcode);
 			const int vA = vA_field::extract(opcode);
@@ -1420,6 +1602,75 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		case PPC_I(VXOR):
 		case PPC_I(VREFP):
 		case PPC_I(VRSQRTEFP):
+		case PPC_I(VADDCUW):
+		case PPC_I(VADDSBS):
+		case PPC_I(VADDSHS):
+		case PPC_I(VADDSWS):
+		case PPC_I(VADDUBS):
+		case PPC_I(VADDUHS):
+		case PPC_I(VADDUWS):
+		case PPC_I(VAVGSB):
+		case PPC_I(VAVGSH):
+		case PPC_I(VAVGSW):
+		case PPC_I(VAVGUW):
+		case PPC_I(VMAXSB):
+		case PPC_I(VMAXSW):
+		case PPC_I(VMAXUH):
+		case PPC_I(VMAXUW):
+		case PPC_I(VMINSB):
+		case PPC_I(VMINSW):
+		case PPC_I(VMINUH):
+		case PPC_I(VMINUW):
+		case PPC_I(VMRGHB):
+		case PPC_I(VMRGHH):
+		case PPC_I(VMRGHW):
+		case PPC_I(VMRGLB):
+		case PPC_I(VMRGLH):
+		case PPC_I(VMRGLW):
+		case PPC_I(VMULESB):
+		case PPC_I(VMULESH):
+		case PPC_I(VMULEUB):
+		case PPC_I(VMULEUH):
+		case PPC_I(VMULOSB):
+		case PPC_I(VMULOSH):
+		case PPC_I(VMULOUB):
+		case PPC_I(VMULOUH):
+		case PPC_I(VPKSHSS):
+		case PPC_I(VPKSHUS):
+		case PPC_I(VPKSWSS):
+		case PPC_I(VPKSWUS):
+		case PPC_I(VPKUHUM):
+		case PPC_I(VPKUHUS):
+		case PPC_I(VPKUWUM):
+		case PPC_I(VPKUWUS):
+		case PPC_I(VRFIM):
+		case PPC_I(VRFIP):
+		case PPC_I(VRFIZ):
+		case PPC_I(VRLW):
+		case PPC_I(VSL):
+		case PPC_I(VSLH):
+		case PPC_I(VSLO):
+		case PPC_I(VSLW):
+		case PPC_I(VSR):
+		case PPC_I(VSRAH):
+		case PPC_I(VSRAW):
+		case PPC_I(VSRH):
+		case PPC_I(VSRO):
+		case PPC_I(VSRW):
+		case PPC_I(VSUBCUW):
+		case PPC_I(VSUBSBS):
+		case PPC_I(VSUBSHS):
+		case PPC_I(VSUBSWS):
+		case PPC_I(VSUBUBS):
+		case PPC_I(VSUBUHS):
+		case PPC_I(VSUBUWS):
+		case PPC_I(VSUM4SBS):
+		case PPC_I(VSUM4SHS):
+		case PPC_I(VSUM4UBS):
+		case PPC_I(VUPKHSB):
+		case PPC_I(VUPKHSH):
+		case PPC_I(VUPKLSB):
+		case PPC_I(VUPKLSH):
 		{
 			const int vD = vD_field::extract(opcode);
 			const int vA = vA_field::extract(opcode);
@@ -1432,6 +1683,11 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		case PPC_I(VPERM):
 		case PPC_I(VMADDFP):
 		case PPC_I(VNMSUBFP):
+		case PPC_I(VMLADDUHM):
+		case PPC_I(VMSUMMBM):
+		case PPC_I(VMSUMSHM):
+		case PPC_I(VMSUMUBM):
+		case PPC_I(VMSUMUHM):
 		{
 			const int vD = vD_field::extract(opcode);
 			const int vA = vA_field::extract(opcode);
@@ -1476,6 +1732,10 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		case PPC_I(VSPLTB):
 		case PPC_I(VSPLTH):
 		case PPC_I(VSPLTW):
+		case PPC_I(VCFSX):
+		case PPC_I(VCFUX):
+		case PPC_I(VCTSXS):
+		case PPC_I(VCTUXS):
 		{
 			const int vD = vD_field::extract(opcode);
 			const int UIMM = vUIMM_field::extract(opcode);
@@ -1518,6 +1778,12 @@ powerpc_cpu::compile_block(uint32 entry_point)
 					dg.gen_set_PC_im(dpc);
 				}
 				sync_pc_offset += 4;
+#if PPC_RUNTIME_PROFILER
+				if (profiling) {
+					dg.gen_mov_ad_A0_im((uintptr)&profile_fallbacks[std::min((int)ii->mnemo, (int)PPC_I(MAX))]);
+					dg.gen_inc_64_A0();
+				}
+#endif
 				dg.gen_invoke_CPU_im(func, opcode);
 				compile_status = COMPILE_CODE_OK; // could generate code, though a call to handler
 				break;
@@ -1525,12 +1791,19 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			done_compile = cg_context.done_compile;
 		}
 		}
+#if PPC_ENABLE_NATIVE_JIT
+	  done_native:
+#endif
 		if (dg.full_translation_cache()) {
-			// Invalidate cache and start again
-			invalidate_cache();
+			// Recycle the oldest region and start again
+			my_block_cache.delete_blockinfo(bi);
+			flush_translation_region();
 			goto again;
 		}
 	}
+#if PPC_ENABLE_NATIVE_JIT
+	dg.gen_native_flush();
+#endif
 	// Do nothing if block has special epilogue code generated already
 	assert(compile_status != COMPILE_FAILURE);
 	if (compile_status != COMPILE_EPILOGUE_OK) {
@@ -1538,12 +1811,36 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		// there are pending spcflags, i.e. get out of this block
 		if (!use_direct_block_chaining) {
 			// TODO: optimize this to a direct jump to pregenerated code?
+#if PPC_RUNTIME_PROFILER && INDIRECT_BRANCH_CACHE
+			if (profiling && jump_kind != JUMP_NEXT) {
+				const int event = jump_kind == JUMP_RETURN ? PROFILE_RETURN : PROFILE_INDIRECT;
+				dg.gen_mov_ad_A0_im((uintptr)&profile_events[event]);
+				dg.gen_inc_64_A0();
+			}
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+			uint8 *p = dg.code_ptr();
+			dg.gen_mov_ad_A0_im((uintptr)bi);
+			record_self_ref(bi, 0, p, (uintptr)bi);
+#else
 			dg.gen_mov_ad_A0_im((uintptr)bi);
+#endif
+#if INDIRECT_BRANCH_CACHE
+			if (jump_kind == JUMP_RETURN)
+				dg.gen_jump_return_A0();
+			else if (jump_kind == JUMP_INDIRECT)
+				dg.gen_jump_indirect_A0();
+			else
+#endif
 			dg.gen_jump_next_A0();
 		}
 		dg.gen_exec_return();
 	}
 	bi->end_pc = dpc;
+#if PPC_RUNTIME_PROFILER
+	if (pb)
+		pb->end_pc = dpc;
+#endif
 	if (dpc < min_pc)
 		min_pc = dpc;
 	else if (dpc > max_pc)
@@ -1560,6 +1857,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			if (bi->li[i].jmp_pc != block_info::INVALID_PC) {
 				uint8 *p = dg.gen_align(16);
 				dg.gen_mov_ad_A0_im(((uintptr)bi) | i);
+#if PPC_PERSISTENT_JIT_CACHE
+				record_self_ref(bi, i, p, ((uintptr)bi) | i);
+#endif
 				dg.gen_invoke_CPU_A0_ret_A0(func);
 				dg.gen_jmp_A0();
 				assert(dg.jmp_addr[i] != NULL);
@@ -1571,9 +1871,19 @@ powerpc_cpu::compile_block(uint32 entry_point)
 	}
 #endif
 
+#if PPC_TRACE_JIT
+	// Generate trace side exits
+	for (int i = 0; i < trace_exit_count; i++)
+		dg_set_jmp_target_noflush(trace_exits[i].jmp_addr, dg.gen_side_exit(trace_exits[i].pc));
+#endif
+
 	bi->size = dg.code_ptr() - bi->entry_point;
 	if (disasm)
 		disasm_translation(entry_point, dpc - entry_point + 4, bi->entry_point, bi->size);
+#if PPC_PERF_JIT_MAP
+	if (perf_map_file || perf_dump_fd >= 0)
+		perf_map_block(bi, trace);
+#endif
 
 	dg.gen_end();
 	my_block_cache.add_to_cl_list(bi);
@@ -1583,7 +1893,744 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		my_block_cache.add_to_active_list(bi);
 #if PPC_PROFILE_COMPILE_TIME
 	compile_time += (clock() - start_time);
+	compile_size += bi->size;
+#endif
+	return bi;
+}
+
+void powerpc_cpu::gen_push_return(block_info *bi)
+{
+	// The returning block will look for its target in this block_info
+	powerpc_jit & dg = codegen;
+#if PPC_PERSISTENT_JIT_CACHE
+	// Only one call per block can be relocated
+	const bool first_call = bi->self_refs[block_info::SELF_REF_CALL] == block_info::INVALID_REF;
+	uint8 *p = dg.code_ptr();
+	dg.gen_mov_ad_A0_im((uintptr)bi);
+	record_self_ref(bi, block_info::SELF_REF_CALL, p, (uintptr)bi);
+	if (!first_call)
+		bi->self_refs[block_info::SELF_REF_CALL] = block_info::BROKEN_REF;
+#else
+	dg.gen_mov_ad_A0_im((uintptr)bi);
+#endif
+	dg.gen_push_return_A0();
+}
+
+void powerpc_cpu::gen_record_cr1()
+{
+	// Pending host FP exceptions have to be folded into the FPSCR first
+	typedef void (*func_t)(dyngen_cpu_base);
+	func_t func = (func_t)nv_mem_fun(&powerpc_cpu::record_cr1).ptr();
+	codegen.gen_invoke_CPU(func);
+}
+#endif
+
+
+/**
+ *		Host profiler support
+ *
+ *		Each translated block is described as a function of its own
+ *		to the Linux perf tool. The map file is read by perf report as
+ *		is. The jitdump file also holds a copy of the generated code,
+ *		and is advertised through a mapping of it that perf record
+ *		sees, for use with perf inject --jit.
+ **/
+
+#if PPC_PERF_JIT_MAP
+// jitdump file format, from tools/perf/util/jitdump.h
+static const uint32 JITDUMP_MAGIC = 0x4a695444;	// 'JiTD'
+static const uint32 JITDUMP_VERSION = 1;
+static const uint32 JIT_CODE_LOAD = 0;
+
+struct jitdump_header {
+	uint32 magic;
+	uint32 version;
+	uint32 total_size;
+	uint32 elf_mach;
+	uint32 pad1;
+	uint32 pid;
+	uint64 timestamp;
+	uint64 flags;
+};
+
+struct jitdump_code_load {
+	uint32 id;
+	uint32 total_size;
+	uint64 timestamp;
+	uint32 pid;
+	uint32 tid;
+	uint64 vma;
+	uint64 code_addr;
+	uint64 code_size;
+	uint64 code_index;
+};
+
+// perf record -k mono matches samples against this clock
+static uint64 jitdump_timestamp(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool powerpc_cpu::enable_perf_map(int modes)
+{
+#if PPC_ASYNC_JIT
+	jit_state_locker lock(this);
+#endif
+	disable_perf_map();
+	char filename[64];
+	if (modes & PERF_MAP) {
+		sprintf(filename, "/tmp/perf-%d.map", (int)getpid());
+		if ((perf_map_file = fopen(filename, "w")) == NULL) {
+			fprintf(stderr, "WARNING: could not create %s\n", filename);
+			return false;
+		}
+		setvbuf(perf_map_file, NULL, _IOLBF, 0);
+	}
+	if (modes & PERF_JITDUMP) {
+		sprintf(filename, "/tmp/jit-%d.dump", (int)getpid());
+		if ((perf_dump_fd = open(filename, O_CREAT | O_TRUNC | O_RDWR, 0644)) < 0) {
+			fprintf(stderr, "WARNING: could not create %s\n", filename);
+			disable_perf_map();
+			return false;
+		}
+		perf_dump_marker = mmap(NULL, getpagesize(), PROT_READ | PROT_EXEC, MAP_PRIVATE, perf_dump_fd, 0);
+		if (perf_dump_marker == MAP_FAILED) {
+			fprintf(stderr, "WARNING: could not map %s\n", filename);
+			perf_dump_marker = NULL;
+			disable_perf_map();
+			return false;
+		}
+		jitdump_header h;
+		memset(&h, 0, sizeof(h));
+		h.magic = JITDUMP_MAGIC;
+		h.version = JITDUMP_VERSION;
+		h.total_size = sizeof(h);
+#if defined(__x86_64__)
+		h.elf_mach = EM_X86_64;
+#elif defined(__i386__)
+		h.elf_mach = EM_386;
+#elif defined(__powerpc__)
+		h.elf_mach = EM_PPC;
+#endif
+		h.pid = getpid();
+		h.timestamp = jitdump_timestamp();
+		write(perf_dump_fd, &h, sizeof(h));
+	}
+	return true;
+}
+
+void powerpc_cpu::disable_perf_map()
+{
+	if (perf_map_file) {
+		fclose(perf_map_file);
+		perf_map_file = NULL;
+	}
+	if (perf_dump_marker) {
+		munmap(perf_dump_marker, getpagesize());
+		perf_dump_marker = NULL;
+	}
+	if (perf_dump_fd >= 0) {
+		close(perf_dump_fd);
+		perf_dump_fd = -1;
+	}
+}
+
+// Find the name of the function holding pc in the traceback table
+// that compilers append to PowerPC functions, if any. The result is
+// cached for the next blocks of the same function
+bool powerpc_cpu::perf_function_name(uint32 pc)
+{
+	if (pc - perf_name_start < perf_name_end - perf_name_start)
+		return perf_name[0] != 0;
+
+	// Only look at memory the guest code may be found in
+	uint32 limit = pc + 0x4000;
+#ifdef SHEEPSHAVER
+	if (pc - ROMBase < ROM_AREA_SIZE)
+		limit = std::min(limit, (uint32)(ROMBase + ROM_AREA_SIZE));
+	else if (pc - RAMBase < RAMSize)
+		limit = std::min(limit, (uint32)(RAMBase + RAMSize));
+	else
+		return false;
+#else
+	return false;
+#endif
+
+	perf_name[0] = 0;
+	perf_name_start = pc;
+	perf_name_end = limit;
+	for (uint32 tb = pc; tb + 16 <= limit; tb += 4) {
+		// A zero word, then version 0 with has_tboff and name_present set
+		if (vm_read_memory_4(tb) != 0)
+			continue;
+		const uint32 flags = vm_read_memory_4(tb + 4);
+		if ((flags >> 24) != 0 || (flags & 0x2000) == 0 || (flags & 0x40) == 0)
+			continue;
+		const uint32 parms = vm_read_memory_4(tb + 8);
+		uint32 p = tb + 12;
+		if (parms & 0xfffe)				// fixedparms, floatparms
+			p += 4;
+		const uint32 tb_offset = vm_read_memory_4(p);
+		p += 4;
+		if (flags & 0x80)				// int_hndl
+			p += 4;
+		if (flags & 0x800) {			// has_ctl
+			const uint32 count = vm_read_memory_4(p);
+			if (count > 16)
+				continue;
+			p += 4 + 4 * count;
+		}
+		if (p + 2 > limit || (tb_offset & 3) != 0 || tb_offset > tb - pc + 0x10000)
+			continue;
+		const uint32 start = tb - tb_offset;
+		const uint32 length = vm_read_memory_2(p);
+		if (length == 0 || length > 255 || p + 2 + length > limit)
+			continue;
+		perf_name_end = tb;
+		if (pc < start)
+			return false;
+		uint32 n;
+		for (n = 0; n < length && n < sizeof(perf_name) - 1; n++) {
+			const uint8 c = vm_read_memory_1(p + 2 + n);
+			if (c < 0x20 || c > 0x7e)
+				break;
+			perf_name[n] = c;
+		}
+		perf_name[n] = 0;
+		if (n < length && n < sizeof(perf_name) - 1) {
+			perf_name[0] = 0;
+			return false;
+		}
+		perf_name_start = start;
+		return true;
+	}
+	return false;
+}
+
+void powerpc_cpu::perf_map_block(block_info *bi, bool trace)
+{
+	char name[128];
+	int n = sprintf(name, "ppc %08x%s", (uint32)bi->pc, trace ? " trace" : "");
+	if (perf_function_name(bi->pc))
+		sprintf(name + n, " [%s+%#x]", perf_name, (uint32)bi->pc - perf_name_start);
+
+	if (perf_map_file)
+		fprintf(perf_map_file, "%lx %x %s\n", (unsigned long)bi->entry_point, bi->size, name);
+
+	if (perf_dump_fd >= 0) {
+		const uint32 name_size = strlen(name) + 1;
+		jitdump_code_load r;
+		r.id = JIT_CODE_LOAD;
+		r.total_size = sizeof(r) + name_size + bi->size;
+		r.timestamp = jitdump_timestamp();
+		r.pid = getpid();
+		r.tid = syscall(SYS_gettid);
+		r.vma = r.code_addr = (uintptr)bi->entry_point;
+		r.code_size = bi->size;
+		r.code_index = perf_dump_index++;
+		write(perf_dump_fd, &r, sizeof(r));
+		write(perf_dump_fd, name, name_size);
+		write(perf_dump_fd, bi->entry_point, bi->size);
+	}
+}
+#endif
+
+
+/**
+ *		Runtime profiler
+ *
+ *		Blocks translated while the profiler is enabled count their
+ *		executions in the prologue, and calls to generic handlers and
+ *		indirect branches before they are made. The dump is a tab
+ *		separated text file with one record per line, blocks and
+ *		generic calls sorted by decreasing counts:
+ *
+ *		event	<name>	<count>
+ *		block	<pc>	<end pc>	<count>	[<function>+<offset>]
+ *		generic	<mnemonic>	<count>
+ **/
+
+#if PPC_RUNTIME_PROFILER
+void powerpc_cpu::reset_profile()
+{
+	profile_blocks.clear();
+	memset(profile_fallbacks, 0, sizeof(profile_fallbacks));
+	memset(profile_events, 0, sizeof(profile_events));
+}
+
+void powerpc_cpu::enable_profiler(bool enable)
+{
+#if PPC_ASYNC_JIT
+	jit_state_locker lock(this);
+#endif
+	if (profiling == enable)
+		return;
+
+	// Counts are kept after the profiler is disabled, for a last dump
+	if (enable)
+		reset_profile();
+	profiling = enable;
+
+	// Retranslate blocks with or without counters
+	if (use_jit)
+		invalidate_cache();
+}
+
+template< class T >
+struct profile_count_greater {
+	bool operator()(const std::pair<uint64, T> & a, const std::pair<uint64, T> & b) const
+		{ return a.first > b.first || (a.first == b.first && a.second < b.second); }
+};
+
+bool powerpc_cpu::dump_profile(const char *filename)
+{
+#if PPC_ASYNC_JIT
+	jit_state_locker lock(this);
+#endif
+	FILE *fp = fopen(filename, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "WARNING: could not write profile to %s\n", filename);
+		return false;
+	}
+
+	static const char * const event_names[PROFILE_MAX] = {
+		"dispatch", "chain", "indirect", "indirect_miss",
+		"return", "return_miss", "interrupt", "execute_68k"
+	};
+	std::vector< std::pair<uint64, uint32> > blocks;
+	uint64 block_count = 0;
+	std::map<uint32, profile_block>::const_iterator it;
+	for (it = profile_blocks.begin(); it != profile_blocks.end(); ++it) {
+		if (it->second.count) {
+			blocks.push_back(std::make_pair(it->second.count, it->first));
+			block_count += it->second.count;
+		}
+	}
+	fprintf(fp, "event\tblock\t%llu\n", (unsigned long long)block_count);
+	for (int i = 0; i < PROFILE_MAX; i++)
+		fprintf(fp, "event\t%s\t%llu\n", event_names[i], (unsigned long long)profile_events[i]);
+
+	std::sort(blocks.begin(), blocks.end(), profile_count_greater<uint32>());
+	for (size_t i = 0; i < blocks.size(); i++) {
+		const uint32 pc = blocks[i].second;
+		fprintf(fp, "block\t%08x\t%08x\t%llu", pc, profile_blocks[pc].end_pc,
+				(unsigned long long)blocks[i].first);
+#if PPC_PERF_JIT_MAP
+		if (perf_function_name(pc))
+			fprintf(fp, "\t%s+%#x", perf_name, pc - perf_name_start);
+#endif
+		fprintf(fp, "\n");
+	}
+
+	// Name generic calls after the first decoder entry of each mnemonic
+	const char *names[PPC_I(MAX) + 1];
+	for (int i = 0; i <= PPC_I(MAX); i++)
+		names[i] = NULL;
+	for (size_t i = 0; i < ii_table.size(); i++) {
+		const int mnemo = std::min((int)ii_table[i].mnemo, (int)PPC_I(MAX));
+		if (names[mnemo] == NULL && ii_table[i].name[0])
+			names[mnemo] = ii_table[i].name;
+	}
+	std::vector< std::pair<uint64, int> > fallbacks;
+	for (int i = 0; i <= PPC_I(MAX); i++) {
+		if (profile_fallbacks[i])
+			fallbacks.push_back(std::make_pair(profile_fallbacks[i], i));
+	}
+	std::sort(fallbacks.begin(), fallbacks.end(), profile_count_greater<int>());
+	for (size_t i = 0; i < fallbacks.size(); i++) {
+		const int mnemo = fallbacks[i].second;
+		fprintf(fp, "generic\t%s\t%llu\n", names[mnemo] ? names[mnemo] : "unknown",
+				(unsigned long long)fallbacks[i].first);
+	}
+
+	fclose(fp);
+	return true;
+}
 #endif
+
+
+/**
+ *		Persistent translation cache
+ *
+ *		The file holds a raw copy of the translation cache, the constants
+ *		pool and a description of every block. Generated code refers to
+ *		helpers and constants by absolute address and these are not
+ *		relocated, so it is only reused by the same non-PIE executable
+ *		with the cache at PPC_PERSISTENT_JIT_CACHE_ADDRESS. The code image
+ *		starts at a page aligned file offset and is mapped back copy on
+ *		write. block_info addresses embedded in the code are relocated
+ *		and chained jumps are reset to their resolver when the file is
+ *		written. Blocks are checked against the guest code when they are
+ *		first looked up.
+ **/
+
+#if PPC_PERSISTENT_JIT_CACHE
+struct translation_cache_header {
+	char		magic[8];
+	char		build[24];
+	uint64		text_anchor;		// Addresses within this executable
+	uint64		data_anchor;
+	uint64		cache_base;
+	uint32		cache_size;
+	uint32		config;
+	uint32		code_start;			// Offsets from cache base
+	uint32		code_end;
+	uint32		data_start;
+	uint32		data_end;
+	uint32		block_count;
+	uint32		block_info_size;
+	uint32		block_epoch;		// Side exit caches in the file are older
+};
+
+static const char translation_cache_magic[8] = { 'P', 'P', 'C', 'T', 'C', '0', '0', '4' };
+
+// File offset of the code image, a multiple of the page size of all hosts
+static const uint32 translation_cache_image_offset = 64 * 1024;
+
+static uint32 translation_cache_checksum(uint32 start, uint32 end)
+{
+	// FNV-1a over the guest code bytes
+	const uint8 *p = vm_do_get_real_address(start);
+	uint32 sum = 2166136261U;
+	for (uint32 n = end - start; n > 0; n--)
+		sum = (sum ^ *p++) * 16777619U;
+	return sum;
+}
+
+static void translation_cache_init_header(translation_cache_header & h)
+{
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, translation_cache_magic, sizeof(h.magic));
+	strncpy(h.build, __DATE__ " " __TIME__, sizeof(h.build) - 1);
+	h.text_anchor = (uintptr)&translation_cache_checksum;
+	h.data_anchor = (uintptr)&translation_cache_magic[0];
+}
+
+uint32 powerpc_cpu::translation_cache_config()
+{
+	uint32 config = 0;
+#if PPC_ENABLE_NATIVE_JIT
+	if (codegen.use_native_codegen())
+		config |= 1;
+	if (codegen.use_native_codegen() && codegen.use_native_optimizer())
+		config |= 8;
+#endif
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+	config |= 2;
+#endif
+#if PPC_TRACE_JIT
+	config |= 4;
+#endif
+	// Code generation depends on host CPU features
+	if (cpuinfo_check_sse2())
+		config |= 1 << 8;
+	if (cpuinfo_check_sse3())
+		config |= 1 << 9;
+	if (cpuinfo_check_ssse3())
+		config |= 1 << 10;
+	if (cpuinfo_check_sse4_1())
+		config |= 1 << 11;
+	if (cpuinfo_check_avx2())
+		config |= 1 << 12;
+	return config;
+}
+
+void powerpc_cpu::record_self_ref(block_info *bi, int n, uint8 *start, uintptr value)
+{
+	// Locate the block_info address operand in the code just generated
+	for (uint8 *p = start; p + sizeof(uintptr) <= codegen.code_ptr(); p++) {
+		if (*(uintptr *)p == value) {
+			bi->self_refs[n] = p - bi->entry_point;
+			return;
+		}
+	}
+	bi->self_refs[n] = block_info::BROKEN_REF;
+}
+
+struct saved_block_collector {
+	typedef powerpc_cpu::block_info block_info;
+	typedef powerpc_cpu::saved_block_info saved_block_info;
+	std::vector<saved_block_info> & blocks;
+	uint8 * cache_base;
+
+	saved_block_collector(std::vector<saved_block_info> & blocks_init, uint8 *base)
+		: blocks(blocks_init), cache_base(base)
+		{ }
+
+	void operator()(block_info *bi);
+};
+
+void saved_block_collector::operator()(block_info *bi)
+{
+	saved_block_info sbi;
+	memset(&sbi, 0, sizeof(sbi));
+	for (int i = 0; i < block_info::MAX_SELF_REFS; i++) {
+		if (bi->self_refs[i] == block_info::BROKEN_REF)
+			return;
+		sbi.self_refs[i] = bi->self_refs[i];
+	}
+	sbi.pc = bi->pc;
+	sbi.end_pc = bi->end_pc;
+	sbi.min_pc = bi->min_pc;
+	sbi.max_pc = bi->max_pc;
+	sbi.entry_offset = bi->entry_point - cache_base;
+	sbi.size = bi->size;
+	sbi.checksum = translation_cache_checksum(bi->min_pc, bi->max_pc + 4);
+	for (int i = 0; i < block_info::MAX_TARGETS; i++) {
+		sbi.li[i].jmp_pc = block_info::INVALID_PC;
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+		block_info::link_info * const li = &bi->li[i];
+		if (li->jmp_pc != block_info::INVALID_PC) {
+			// Unchain the block so that the image does not depend on
+			// where other blocks are; they are linked again on demand
+			dg_set_jmp_target(li->jmp_addr, li->jmp_resolve_addr);
+			li->jmp_target = NULL;
+			sbi.li[i].jmp_pc = li->jmp_pc;
+			sbi.li[i].jmp_offset = li->jmp_addr - bi->entry_point;
+			sbi.li[i].jmp_resolve_offset = li->jmp_resolve_addr - bi->entry_point;
+		}
+#endif
+	}
+	blocks.push_back(sbi);
+}
+
+static bool map_translation_cache_image(FILE *fp, uint8 *base, const translation_cache_header & h)
+{
+#ifdef HAVE_MMAP_VM
+	// Map whole pages up to the end of code, copy on write. The prologue
+	// is part of the first page and was checked to be the same
+	const uint32 page_size = vm_get_page_size();
+	const uint32 image_end = (h.code_end + page_size - 1) & -page_size;
+	if (translation_cache_image_offset % page_size != 0 || image_end > h.data_start)
+		return false;
+
+	// Pages past the end of file would fault when executed
+	struct stat st;
+	if (fstat(fileno(fp), &st) < 0 || st.st_size < (off_t)(translation_cache_image_offset + h.code_end))
+		return false;
+	void *image = mmap(base, image_end, PROT_READ | PROT_WRITE | PROT_EXEC,
+					   MAP_PRIVATE | MAP_FIXED, fileno(fp), translation_cache_image_offset);
+	return image == base;
+#else
+	return false;
+#endif
+}
+
+bool powerpc_cpu::save_translation_cache(const char *filename)
+{
+#if PPC_ASYNC_JIT
+	jit_state_locker lock(this);
+#endif
+	if (!use_jit)
+		return false;
+
+	uint8 * const base = codegen.cache_base();
+	if (base != (uint8 *)PPC_PERSISTENT_JIT_CACHE_ADDRESS) {
+		fprintf(stderr, "WARNING: translation cache not at %p, not saved\n", (void *)PPC_PERSISTENT_JIT_CACHE_ADDRESS);
+		return false;
+	}
+
+	// Constants that did not fit into the translation cache are not saved
+	if (codegen.has_external_data()) {
+		fprintf(stderr, "WARNING: constants pool overflow, translation cache not saved\n");
+		return false;
+	}
+
+	std::vector<saved_block_info> blocks;
+	saved_block_collector collector(blocks, base);
+	my_block_cache.for_each(collector);
+
+	// Keep blocks loaded from a previous run that were not used yet
+	for (size_t i = 0; i < saved_blocks.size(); i++) {
+		if (saved_blocks[i].size)
+			blocks.push_back(saved_blocks[i]);
+	}
+	std::sort(blocks.begin(), blocks.end());
+
+	// Blocks from older regions may lie past the current code pointer
+	uint8 *code_end = codegen.code_ptr();
+	for (size_t i = 0; i < blocks.size(); i++) {
+		uint8 *block_end = base + blocks[i].entry_offset + blocks[i].size;
+		if (block_end > code_end)
+			code_end = block_end;
+	}
+
+	translation_cache_header h;
+	translation_cache_init_header(h);
+	h.cache_base = (uintptr)base;
+	h.cache_size = codegen.get_cache_size();
+	h.config = translation_cache_config();
+	h.code_start = codegen.code_start_ptr() - base;
+	h.code_end = code_end - base;
+	h.data_start = codegen.data_start_ptr() - base;
+	h.data_end = codegen.data_ptr() - base;
+	h.block_count = blocks.size();
+	h.block_info_size = sizeof(saved_block_info);
+	h.block_epoch = block_epoch;
+
+	// The file may be mapped by this or another process, replace it
+	// instead of writing over it
+	char tmp_filename[PATH_MAX];
+	snprintf(tmp_filename, sizeof(tmp_filename), "%s.%d", filename, (int)getpid());
+	FILE *fp = fopen(tmp_filename, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "WARNING: could not create translation cache %s\n", tmp_filename);
+		return false;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, fp) == 1
+		&& fseek(fp, translation_cache_image_offset, SEEK_SET) == 0
+		&& fwrite(base, h.code_end, 1, fp) == 1
+		&& (h.data_end == h.data_start || fwrite(base + h.data_start, h.data_end - h.data_start, 1, fp) == 1)
+		&& (blocks.empty() || fwrite(&blocks[0], sizeof(saved_block_info), blocks.size(), fp) == blocks.size());
+	if (fclose(fp) != 0)
+		ok = false;
+	if (!ok || rename(tmp_filename, filename) != 0) {
+		fprintf(stderr, "WARNING: could not write translation cache %s\n", filename);
+		remove(tmp_filename);
+		return false;
+	}
+	D(bug("Saved %d blocks to translation cache %s\n", h.block_count, filename));
+	return true;
+}
+
+bool powerpc_cpu::load_translation_cache(const char *filename)
+{
+#if PPC_ASYNC_JIT
+	jit_state_locker lock(this);
+#endif
+	if (!use_jit)
+		return false;
+
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return false;
+
+	uint8 * const base = codegen.cache_base();
+	translation_cache_header h, ref;
+	translation_cache_init_header(ref);
+	const char *error = NULL;
+	std::vector<uint8> prologue, pool;
+	if (fread(&h, sizeof(h), 1, fp) != 1
+		|| memcmp(h.magic, ref.magic, sizeof(h.magic)) != 0
+		|| h.block_info_size != sizeof(saved_block_info))
+		error = "invalid file";
+	else if (memcmp(h.build, ref.build, sizeof(h.build)) != 0
+			 || h.text_anchor != ref.text_anchor
+			 || h.data_anchor != ref.data_anchor
+			 || h.config != translation_cache_config())
+		error = "different executable or configuration";
+	else if (base != (uint8 *)PPC_PERSISTENT_JIT_CACHE_ADDRESS
+			 || h.cache_base != (uintptr)base
+			 || h.cache_size != codegen.get_cache_size()
+			 || h.code_start != (uint32)(codegen.code_start_ptr() - base)
+			 || h.data_start != (uint32)(codegen.data_start_ptr() - base)
+			 || h.code_end < h.code_start
+			 || h.data_end < (uint32)(codegen.data_ptr() - base)
+			 || h.data_end > h.cache_size)
+		error = "translation cache mapped differently";
+	else if (codegen.code_ptr() != codegen.code_start_ptr())
+		error = "blocks already translated";
+	else {
+		// The prologue and constants generated so far must match
+		prologue.resize(h.code_start);
+		pool.resize(h.data_end - h.data_start);
+		if (fseek(fp, translation_cache_image_offset, SEEK_SET) != 0
+			|| fread(&prologue[0], h.code_start, 1, fp) != 1
+			|| memcmp(&prologue[0], base, h.code_start) != 0)
+			error = "different prologue";
+		else if (!map_translation_cache_image(fp, base, h)
+				 && fread(base + h.code_start, h.code_end - h.code_start, 1, fp) != 1)
+			error = "truncated file";
+		else if (fseek(fp, translation_cache_image_offset + h.code_end, SEEK_SET) != 0
+				 || (!pool.empty() && fread(&pool[0], pool.size(), 1, fp) != 1))
+			error = "truncated file";
+		else if (codegen.data_ptr() > codegen.data_start_ptr()
+				 && memcmp(&pool[0], codegen.data_start_ptr(), codegen.data_ptr() - codegen.data_start_ptr()) != 0)
+			error = "different constants pool";
+		else {
+			saved_blocks.resize(h.block_count);
+			if (h.block_count && fread(&saved_blocks[0], sizeof(saved_block_info), h.block_count, fp) != h.block_count)
+				error = "truncated file";
+			else if (!codegen.restore_image(base + h.code_end, base + h.data_end))
+				error = "translation cache overflow";
+		}
+	}
+	fclose(fp);
+
+	if (error) {
+		// Nothing was committed to the translation cache yet
+		fprintf(stderr, "WARNING: ignoring translation cache %s (%s)\n", filename, error);
+		saved_blocks.clear();
+		return false;
+	}
+
+	if (!pool.empty())
+		memcpy(codegen.data_start_ptr(), &pool[0], pool.size());
+	flush_icache_range((unsigned long)(base + h.code_start), (unsigned long)(base + h.code_end));
+
+	// Start past the saved epoch so that side exits look their target up again
+	block_epoch = h.block_epoch;
+	invalidate_branch_caches();
+	D(bug("Loaded %d blocks from translation cache %s\n", h.block_count, filename));
+	return true;
+}
+
+powerpc_cpu::block_info *
+powerpc_cpu::restore_block(uint32 entry)
+{
+	saved_block_info key;
+	key.pc = entry;
+	std::vector<saved_block_info>::iterator it = std::lower_bound(saved_blocks.begin(), saved_blocks.end(), key);
+	if (it == saved_blocks.end() || it->pc != entry || it->size == 0)
+		return NULL;
+
+	// Blocks are used at most once, a zero size marks the entry as consumed
+	saved_block_info & sbi = *it;
+	const uint32 size = sbi.size;
+	sbi.size = 0;
+	if (translation_cache_checksum(sbi.min_pc, sbi.max_pc + 4) != sbi.checksum)
+		return NULL;
+
+	block_info *bi = my_block_cache.new_blockinfo();
+	bi->init(entry);
+	bi->entry_point = codegen.cache_base() + sbi.entry_offset;
+	bi->end_pc = sbi.end_pc;
+	bi->min_pc = sbi.min_pc;
+	bi->max_pc = sbi.max_pc;
+	bi->size = size;
+#if PPC_TRACE_JIT
+	bi->count = TRACE_THRESHOLD;
+#endif
+	for (int i = 0; i < block_info::MAX_SELF_REFS; i++) {
+		bi->self_refs[i] = sbi.self_refs[i];
+		if (sbi.self_refs[i] != block_info::INVALID_REF) {
+			// Relocate block_info address, the low bits hold the target index
+			uintptr *p = (uintptr *)(bi->entry_point + sbi.self_refs[i]);
+			*p = ((uintptr)bi) | (*p & 3);
+		}
+	}
+	for (int i = 0; i < block_info::MAX_TARGETS; i++) {
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+		bi->li[i].jmp_pc = sbi.li[i].jmp_pc;
+		if (sbi.li[i].jmp_pc != block_info::INVALID_PC) {
+			bi->li[i].jmp_addr = bi->entry_point + sbi.li[i].jmp_offset;
+			bi->li[i].jmp_resolve_addr = bi->entry_point + sbi.li[i].jmp_resolve_offset;
+		}
+#endif
+	}
+	flush_icache_range((unsigned long)bi->entry_point, (unsigned long)(bi->entry_point + size));
+#if PPC_PERF_JIT_MAP
+	if (perf_map_file || perf_dump_fd >= 0)
+		perf_map_block(bi, false);
+#endif
+
+	my_block_cache.add_to_cl_list(bi);
+	if (is_read_only_memory(bi->pc))
+		my_block_cache.add_to_dormant_list(bi);
+	else
+		my_block_cache.add_to_active_list(bi);
 	return bi;
 }
 #endif
@@ -37,10 +37,11 @@ enum {
 };
 
 
+// Host threads raise flags concurrently with the CPU thread clearing
+// them, so updates are lock-free atomic read-modify-writes
 class basic_spcflags
 {
-	uint32 mask;
-	SpinLock *spin;
+	volatile uint32 mask;
 
 public:
 
@@ -55,16 +56,21 @@ public:
 		{ return (mask & v); }
 
 	void init(uint32 v)
-		{ spin = new SpinLock; spin->Lock(); mask = v; spin->Unlock(); }
+		{ mask = v; }
 
 	uint32 get() const
 		{ return mask; }
 
 	void set(uint32 v)
-		{ spin->Lock(); mask |= v; spin->Unlock(); }
+		{ atomic_set_mask(&mask, v); }
 
 	void clear(uint32 v)
-		{ spin->Lock(); mask &= ~v; spin->Unlock(); }
+		{ atomic_clear_mask(&mask, v); }
+
+	// Raise flags unless they are all pending already, returns true if
+	// this call did post at least one of them
+	bool post(uint32 v)
+		{ return (mask & v) != v && (atomic_set_mask(&mask, v) & v) != v; }
 };
 
 
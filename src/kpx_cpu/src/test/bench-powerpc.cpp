@@ -0,0 +1,944 @@
+/*
+ *  bench-powerpc.cpp - PowerPC emulation benchmarks
+ *
+ *  Kheperix (C) 2003-2005 Gwenole Beauchesne
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  Runs a set of small guest kernels through each execution engine
+ *  (interpreter, predecode cache with plain or threaded dispatch, dyngen
+ *  JIT translating inline or in a worker thread, and native JIT) and
+ *  reports guest MIPS, time spent translating, and the size of translated code
+ *  per guest instruction. Every kernel result is checked against a C
+ *  model so that a fast but broken engine does not go unnoticed.
+ *
+ *  Usage: bench-powerpc [--mode=interp,decode,threaded,jit,async,native,optimize]
+ *                       [--runs=N] [--scale=N] [kernel...]
+ */
+
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h> // ntohl(), htonl()
+#include <sys/time.h>
+
+#include "sysdeps.h"
+#include "vm_alloc.h"
+#include "cpu/ppc/ppc-cpu.hpp"
+#include "cpu/ppc/ppc-instructions.hpp"
+
+// Partial PowerPC runtime assembler from GNU lightning
+#undef  _I
+#define _I(X)			((uint32)(X))
+#undef  _UL
+#define _UL(X)			((uint32)(X))
+#undef  _MASK
+#define _MASK(N)		((uint32)((1<<(N)))-1)
+#undef  _ck_s
+#define _ck_s(W,I)		(_UL(I) & _MASK(W))
+#undef  _ck_u
+#define _ck_u(W,I)    	(_UL(I) & _MASK(W))
+#undef  _u1
+#define _u1(I)          _ck_u( 1,I)
+#undef  _u5
+#define _u5(I)          _ck_u( 5,I)
+#undef  _u6
+#define _u6(I)          _ck_u( 6,I)
+#undef  _u10
+#define _u10(I)         _ck_u(10,I)
+#undef  _u11
+#define _u11(I)			_ck_u(11,I)
+#undef  _s16
+#define _s16(I)         _ck_s(16,I)
+
+#undef  _D
+#define _D(   OP,RD,RA,         DD )  	_I((_u6(OP)<<26)|(_u5(RD)<<21)|(_u5(RA)<<16)|                _s16(DD)                          )
+#undef  _X
+#define _X(   OP,RD,RA,RB,   XO,RC )  	_I((_u6(OP)<<26)|(_u5(RD)<<21)|(_u5(RA)<<16)|( _u5(RB)<<11)|              (_u10(XO)<<1)|_u1(RC))
+#undef  _M
+#define _M(   OP,RS,RA,SH,MB,ME,RC )  	_I((_u6(OP)<<26)|(_u5(RS)<<21)|(_u5(RA)<<16)|( _u5(SH)<<11)|(_u5(MB)<< 6)|( _u5(ME)<<1)|_u1(RC))
+#undef  _VX
+#define _VX(  OP,VD,VA,VB,   XO    )	_I((_u6(OP)<<26)|(_u5(VD)<<21)|(_u5(VA)<<16)|( _u5(VB)<<11)|               _u11(XO)            )
+#undef  _A
+#define _A(   OP,FD,FA,FB,FC,XO,RC )	_I((_u6(OP)<<26)|(_u5(FD)<<21)|(_u5(FA)<<16)|( _u5(FB)<<11)|(_u5(FC)<< 6)|( _u5(XO)<<1)|_u1(RC))
+
+// Branch options
+enum {
+	BO_TRUE		= 12,	// Branch if condition true
+	BO_FALSE	= 4,	// Branch if condition false
+	BO_DNZ		= 16,	// Decrement CTR, branch if CTR != 0
+	BO_ALWAYS	= 20,
+};
+
+// CR0 bits
+enum {
+	CR0_LT		= 0,
+	CR0_GT		= 1,
+	CR0_EQ		= 2,
+};
+
+// Wrappers when building from SheepShaver tree
+#ifdef SHEEPSHAVER
+uintptr ROMBase = 0x40800000;
+uintptr RAMBase = 0;
+uint32 RAMSize = 0;
+int64 TimebaseSpeed = 25000000;	// Default:  25 MHz
+uint32 PVR = 0x000c0000;		// Default: 7400 (with AltiVec)
+
+bool PrefsFindBool(const char *name)
+{
+	return false;
+}
+
+uint64 GetTicks_usec(void)
+{
+	return clock();
+}
+
+void HandleInterrupt(powerpc_registers *)
+{
+}
+
+#if PPC_ENABLE_JIT && PPC_REENTRANT_JIT
+void init_emul_op_trampolines(basic_dyngen & dg)
+{
+}
+#endif
+#endif
+
+
+/**
+ *		Guest code assembler
+ **/
+
+class powerpc_assembler
+{
+	uint32 *code_p;
+
+	void emit(uint32 insn)
+		{ *code_p++ = htonl(insn); }
+
+	static uint32 guest_addr(const void *p)
+		{ return (uint32)(uintptr)p; }
+
+public:
+	powerpc_assembler(uint32 *start) : code_p(start) { }
+	uint32 *here() const { return code_p; }
+
+	// Integer
+	void li(int rD, int16 v)					{ emit(_D(14,rD,0,v)); }
+	void lis(int rD, int16 v)					{ emit(_D(15,rD,0,v)); }
+	void addi(int rD, int rA, int16 v)			{ emit(_D(14,rD,rA,v)); }
+	void ori(int rA, int rS, uint16 v)			{ emit(_D(24,rS,rA,v)); }
+	void cmpwi(int rA, int16 v)					{ emit(_D(11,0,rA,v)); }
+	void add(int rD, int rA, int rB)			{ emit(_X(31,rD,rA,rB,266,0)); }
+	void subf(int rD, int rA, int rB)			{ emit(_X(31,rD,rA,rB,40,0)); }
+	void mullw(int rD, int rA, int rB)			{ emit(_X(31,rD,rA,rB,235,0)); }
+	void xor_(int rA, int rS, int rB)			{ emit(_X(31,rS,rA,rB,316,0)); }
+	void rlwinm(int rA, int rS, int sh, int mb, int me, int rc = 0)
+		{ emit(_M(21,rS,rA,sh,mb,me,rc)); }
+	void nop()									{ emit(0x60000000); }
+
+	// Load a 32-bit constant or a guest address
+	void li32(int rD, uint32 v)					{ lis(rD, v >> 16); ori(rD, rD, v & 0xffff); }
+	void la(int rD, const void *p)				{ li32(rD, guest_addr(p)); }
+
+	// Memory
+	void lbzu(int rD, int16 d, int rA)			{ emit(_D(35,rD,rA,d)); }
+	void stbu(int rS, int16 d, int rA)			{ emit(_D(39,rS,rA,d)); }
+	void lwz(int rD, int16 d, int rA)			{ emit(_D(32,rD,rA,d)); }
+	void lwzu(int rD, int16 d, int rA)			{ emit(_D(33,rD,rA,d)); }
+	void stw(int rS, int16 d, int rA)			{ emit(_D(36,rS,rA,d)); }
+	void stwu(int rS, int16 d, int rA)			{ emit(_D(37,rS,rA,d)); }
+	void lwarx(int rD, int rA, int rB)			{ emit(_X(31,rD,rA,rB,20,0)); }
+	void stwcx(int rS, int rA, int rB)			{ emit(_X(31,rS,rA,rB,150,1)); }
+	void sync()									{ emit(_X(31,0,0,0,598,0)); }
+	void isync()								{ emit(0x4c00012c); }
+
+	// Floating-point
+	void lfd(int fD, int16 d, int rA)			{ emit(_D(50,fD,rA,d)); }
+	void lfdu(int fD, int16 d, int rA)			{ emit(_D(51,fD,rA,d)); }
+	void stfd(int fS, int16 d, int rA)			{ emit(_D(54,fS,rA,d)); }
+	void fmadd(int fD, int fA, int fC, int fB)	{ emit(_A(63,fD,fA,fB,fC,29,0)); }
+
+	// AltiVec
+	void lvx(int vD, int rA, int rB)			{ emit(_X(31,vD,rA,rB,103,0)); }
+	void stvx(int vS, int rA, int rB)			{ emit(_X(31,vS,rA,rB,231,0)); }
+	void vavgub(int vD, int vA, int vB)			{ emit(_VX(4,vD,vA,vB,1026)); }
+
+	// Special purpose registers
+	void mtctr(int rS)							{ emit(_X(31,rS,9,0,467,0)); }
+	void mflr(int rD)							{ emit(_X(31,rD,8,0,339,0)); }
+	void mtlr(int rS)							{ emit(_X(31,rS,8,0,467,0)); }
+
+	// Branches, to a known target or to be resolved later
+	void b(const uint32 *target, int lk = 0)
+		{ emit(_I((18 << 26) | ((guest_addr(target) - guest_addr(code_p)) & 0x03fffffc) | lk)); }
+	void bl(const uint32 *target)				{ b(target, 1); }
+	void bc(int bo, int bi, const uint32 *target)
+		{ emit(_D(16,bo,bi,(guest_addr(target) - guest_addr(code_p)) & 0xfffc)); }
+	void bdnz(const uint32 *target)				{ bc(BO_DNZ, 0, target); }
+	uint32 *b_fwd()								{ uint32 *p = code_p; emit(_I(18 << 26)); return p; }
+	uint32 *bc_fwd(int bo, int bi)				{ uint32 *p = code_p; emit(_D(16,bo,bi,0)); return p; }
+	void resolve(uint32 *insn)
+	{
+		const uint32 opcode = ntohl(*insn);
+		const uint32 mask = (opcode >> 26) == 18 ? 0x03fffffc : 0xfffc;
+		*insn = htonl(opcode | ((guest_addr(code_p) - guest_addr(insn)) & mask));
+	}
+	void blr()									{ emit(0x4e800020); }
+	void bctrl()								{ emit(0x4e800421); }
+
+	// Leave the emulator
+	void ret()									{ emit(_D(6,0,0,0)); }
+};
+
+
+/**
+ *		Benchmark kernels
+ *
+ *		Each kernel assembles its code, starting with the entry point,
+ *		and returns the number of guest instructions one run executes. The data area
+ *		is reset before each run and checked after it.
+ **/
+
+static const uint32 CODE_SIZE = 64 * 1024;
+static const uint32 DATA_SIZE = 1024 * 1024;
+
+struct bench_kernel
+{
+	const char *name;
+	const char *description;
+	uint64 (*build)(powerpc_assembler & a, uint8 *data, int scale);
+	void (*reset)(uint8 *data, int scale);
+	bool (*check)(const uint32 *gpr, const uint8 *data, int scale);
+};
+
+static uint32 guest_count(const uint32 *start, const uint32 *end)
+{
+	return end - start;
+}
+
+static void no_reset(uint8 *data, int scale)
+{
+}
+
+// Integer ALU loop: add, xor, rotate and multiply chains
+static const uint32 INTEGER_ITERS = 1000000;
+
+static uint32 integer_result(int scale)
+{
+	uint32 r3 = 0, r6 = 0x12345678, r7 = 0x9e3779b9;
+	for (uint32 i = 0; i < INTEGER_ITERS * scale; i++) {
+		r3 += r6;
+		r6 ^= r3;
+		r6 = (r6 << 7) | (r6 >> 25);
+		uint32 r8 = r3 * r7;
+		r3 = r8 - r6;
+	}
+	return r3;
+}
+
+static uint64 integer_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	uint32 *code = a.here();
+	a.li(3, 0);
+	a.li32(6, 0x12345678);
+	a.li32(7, 0x9e3779b9);
+	a.li32(9, INTEGER_ITERS * scale);
+	a.mtctr(9);
+	uint32 *loop = a.here();
+	a.add(3, 3, 6);
+	a.xor_(6, 6, 3);
+	a.rlwinm(6, 6, 7, 0, 31);
+	a.mullw(8, 3, 7);
+	a.subf(3, 6, 8);
+	a.bdnz(loop);
+	uint32 *end = a.here();
+	a.ret();
+	return guest_count(code, loop) + (uint64)INTEGER_ITERS * scale * guest_count(loop, end) + 1;
+}
+
+static bool integer_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	return gpr[3] == integer_result(scale);
+}
+
+// Word copy, unrolled four times with update forms
+static const uint32 MEMCPY_SIZE = 64 * 1024;
+static const uint32 MEMCPY_REPEAT = 256;
+
+static uint64 memcpy_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	const uint8 *src = data, *dst = data + MEMCPY_SIZE;
+	uint32 *code = a.here();
+	a.li(12, MEMCPY_REPEAT * scale);
+	uint32 *outer = a.here();
+	a.la(4, src - 4);
+	a.la(5, dst - 4);
+	a.li(9, MEMCPY_SIZE / 16);
+	a.mtctr(9);
+	uint32 *loop = a.here();
+	a.lwz(8, 4, 4);
+	a.lwz(9, 8, 4);
+	a.lwz(10, 12, 4);
+	a.lwzu(11, 16, 4);
+	a.stw(8, 4, 5);
+	a.stw(9, 8, 5);
+	a.stw(10, 12, 5);
+	a.stwu(11, 16, 5);
+	a.bdnz(loop);
+	uint32 *tail = a.here();
+	a.addi(12, 12, -1);
+	a.cmpwi(12, 0);
+	a.bc(BO_FALSE, CR0_EQ, outer);
+	uint32 *end = a.here();
+	a.ret();
+	const uint64 outer_count = guest_count(outer, loop) + (uint64)(MEMCPY_SIZE / 16) * guest_count(loop, tail) + guest_count(tail, end);
+	return guest_count(code, outer) + MEMCPY_REPEAT * scale * outer_count + 1;
+}
+
+static void memcpy_reset(uint8 *data, int scale)
+{
+	for (uint32 i = 0; i < MEMCPY_SIZE; i++) {
+		data[i] = i * 7 + (i >> 8);
+		data[MEMCPY_SIZE + i] = 0;
+	}
+}
+
+static bool memcpy_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	return memcmp(data, data + MEMCPY_SIZE, MEMCPY_SIZE) == 0;
+}
+
+// Overlapping byte move towards higher addresses, hence backwards
+static const uint32 MEMMOVE_SIZE = 16 * 1024;
+static const uint32 MEMMOVE_REPEAT = 128;
+
+static uint64 memmove_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	uint32 *code = a.here();
+	a.li(12, MEMMOVE_REPEAT * scale);
+	uint32 *outer = a.here();
+	a.la(4, data + MEMMOVE_SIZE);
+	a.la(5, data + MEMMOVE_SIZE + 1);
+	a.li(9, MEMMOVE_SIZE);
+	a.mtctr(9);
+	uint32 *loop = a.here();
+	a.lbzu(8, -1, 4);
+	a.stbu(8, -1, 5);
+	a.bdnz(loop);
+	uint32 *tail = a.here();
+	a.addi(12, 12, -1);
+	a.cmpwi(12, 0);
+	a.bc(BO_FALSE, CR0_EQ, outer);
+	uint32 *end = a.here();
+	a.ret();
+	const uint64 outer_count = guest_count(outer, loop) + (uint64)MEMMOVE_SIZE * guest_count(loop, tail) + guest_count(tail, end);
+	return guest_count(code, outer) + MEMMOVE_REPEAT * scale * outer_count + 1;
+}
+
+static void memmove_reset(uint8 *data, int scale)
+{
+	for (uint32 i = 0; i <= MEMMOVE_SIZE; i++)
+		data[i] = i ^ (i >> 7);
+}
+
+static bool memmove_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	std::vector<uint8> ref(MEMMOVE_SIZE + 1);
+	memmove_reset(&ref[0], scale);
+	for (uint32 i = 0; i < MEMMOVE_REPEAT * scale; i++)
+		memmove(&ref[1], &ref[0], MEMMOVE_SIZE);
+	return memcmp(&ref[0], data, MEMMOVE_SIZE + 1) == 0;
+}
+
+// Double precision dot product. Elements are small integers so that
+// the sum is exact and does not depend on the rounding of fmadd
+static const uint32 FPDOT_SIZE = 4096;
+static const uint32 FPDOT_REPEAT = 512;
+
+static double fpdot_a(uint32 i) { return (double)((int)(i % 7) - 3); }
+static double fpdot_b(uint32 i) { return (double)((int)(i % 5) - 2); }
+
+static void fpdot_store(uint8 *p, double v)
+{
+	union { double d; uint64 i; } x;
+	x.d = v;
+	for (int i = 7; i >= 0; i--, x.i >>= 8)
+		p[i] = x.i;
+}
+
+static double fpdot_load(const uint8 *p)
+{
+	union { double d; uint64 i; } x;
+	x.i = 0;
+	for (int i = 0; i < 8; i++)
+		x.i = (x.i << 8) | p[i];
+	return x.d;
+}
+
+static uint64 fpdot_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	const uint8 *va = data, *vb = data + FPDOT_SIZE * 8, *result = vb + FPDOT_SIZE * 8;
+	uint32 *code = a.here();
+	a.li(12, FPDOT_REPEAT * scale);
+	a.la(4, result);
+	a.lfd(0, 0, 4);
+	uint32 *outer = a.here();
+	a.la(4, va - 8);
+	a.la(5, vb - 8);
+	a.li(9, FPDOT_SIZE);
+	a.mtctr(9);
+	uint32 *loop = a.here();
+	a.lfdu(1, 8, 4);
+	a.lfdu(2, 8, 5);
+	a.fmadd(0, 1, 2, 0);
+	a.bdnz(loop);
+	uint32 *tail = a.here();
+	a.addi(12, 12, -1);
+	a.cmpwi(12, 0);
+	a.bc(BO_FALSE, CR0_EQ, outer);
+	uint32 *done = a.here();
+	a.la(4, result);
+	a.stfd(0, 0, 4);
+	uint32 *end = a.here();
+	a.ret();
+	const uint64 outer_count = guest_count(outer, loop) + (uint64)FPDOT_SIZE * guest_count(loop, tail) + guest_count(tail, done);
+	return guest_count(code, outer) + FPDOT_REPEAT * scale * outer_count + guest_count(done, end) + 1;
+}
+
+static void fpdot_reset(uint8 *data, int scale)
+{
+	for (uint32 i = 0; i < FPDOT_SIZE; i++) {
+		fpdot_store(data + i * 8, fpdot_a(i));
+		fpdot_store(data + (FPDOT_SIZE + i) * 8, fpdot_b(i));
+	}
+	fpdot_store(data + FPDOT_SIZE * 16, 0.0);
+}
+
+static bool fpdot_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	double sum = 0.0;
+	for (uint32 i = 0; i < FPDOT_SIZE; i++)
+		sum += fpdot_a(i) * fpdot_b(i);
+	return fpdot_load(data + FPDOT_SIZE * 16) == sum * (FPDOT_REPEAT * scale);
+}
+
+// AltiVec blend of two images: 16 pixels averaged per vector
+static const uint32 ALTIVEC_SIZE = 64 * 1024;
+static const uint32 ALTIVEC_REPEAT = 256;
+
+static uint64 altivec_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	const uint8 *va = data, *vb = va + ALTIVEC_SIZE, *vd = vb + ALTIVEC_SIZE;
+	uint32 *code = a.here();
+	a.li(12, ALTIVEC_REPEAT * scale);
+	uint32 *outer = a.here();
+	a.la(4, va);
+	a.la(5, vb);
+	a.la(6, vd);
+	a.li(9, ALTIVEC_SIZE / 16);
+	a.mtctr(9);
+	uint32 *loop = a.here();
+	a.lvx(1, 0, 4);
+	a.lvx(2, 0, 5);
+	a.vavgub(3, 1, 2);
+	a.stvx(3, 0, 6);
+	a.addi(4, 4, 16);
+	a.addi(5, 5, 16);
+	a.addi(6, 6, 16);
+	a.bdnz(loop);
+	uint32 *tail = a.here();
+	a.addi(12, 12, -1);
+	a.cmpwi(12, 0);
+	a.bc(BO_FALSE, CR0_EQ, outer);
+	uint32 *end = a.here();
+	a.ret();
+	const uint64 outer_count = guest_count(outer, loop) + (uint64)(ALTIVEC_SIZE / 16) * guest_count(loop, tail) + guest_count(tail, end);
+	return guest_count(code, outer) + ALTIVEC_REPEAT * scale * outer_count + 1;
+}
+
+static void altivec_reset(uint8 *data, int scale)
+{
+	for (uint32 i = 0; i < ALTIVEC_SIZE; i++) {
+		data[i] = i * 13;
+		data[ALTIVEC_SIZE + i] = (i >> 4) * 29 + i;
+		data[2 * ALTIVEC_SIZE + i] = 0;
+	}
+}
+
+static bool altivec_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	for (uint32 i = 0; i < ALTIVEC_SIZE; i++) {
+		if (data[2 * ALTIVEC_SIZE + i] != ((data[i] + data[ALTIVEC_SIZE + i] + 1) >> 1))
+			return false;
+	}
+	return true;
+}
+
+// Data dependent branches on the top bits of an LCG, both arms of
+// each diamond have the same length
+static const uint32 BRANCH_ITERS = 1000000;
+static const uint32 LCG_MUL = 1664525;
+static const uint32 LCG_ADD = 1013904223;
+
+static void branch_result(int scale, uint32 & r10, uint32 & r11)
+{
+	uint32 r3 = 1;
+	r10 = r11 = 0;
+	for (uint32 i = 0; i < BRANCH_ITERS * scale; i++) {
+		r3 = r3 * LCG_MUL + LCG_ADD;
+		if (r3 & 0x80000000)
+			r10 += 1;
+		else
+			r11 += 1;
+		if (r3 & 0x40000000)
+			r11 += 5;
+		else
+			r10 += 3;
+	}
+}
+
+static uint64 branch_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	uint32 *code = a.here();
+	a.li(3, 1);
+	a.li32(7, LCG_MUL);
+	a.li32(8, LCG_ADD);
+	a.li(10, 0);
+	a.li(11, 0);
+	a.li32(9, BRANCH_ITERS * scale);
+	a.mtctr(9);
+	uint32 *loop = a.here();
+	a.mullw(3, 3, 7);
+	a.add(3, 3, 8);
+	a.rlwinm(9, 3, 0, 0, 0, 1);
+	uint32 *l1 = a.bc_fwd(BO_TRUE, CR0_EQ);
+	a.addi(10, 10, 1);
+	uint32 *l2 = a.b_fwd();
+	a.resolve(l1);
+	a.addi(11, 11, 1);
+	a.nop();
+	a.resolve(l2);
+	a.rlwinm(9, 3, 0, 1, 1, 1);
+	uint32 *l3 = a.bc_fwd(BO_FALSE, CR0_EQ);
+	a.addi(10, 10, 3);
+	uint32 *l4 = a.b_fwd();
+	a.resolve(l3);
+	a.addi(11, 11, 5);
+	a.nop();
+	a.resolve(l4);
+	a.bdnz(loop);
+	uint32 *end = a.here();
+	a.ret();
+	// Either arm of a diamond skips two of its five instructions
+	return guest_count(code, loop) + (uint64)BRANCH_ITERS * scale * (guest_count(loop, end) - 4) + 1;
+}
+
+static bool branch_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	uint32 r10, r11;
+	branch_result(scale, r10, r11);
+	return gpr[10] == r10 && gpr[11] == r11;
+}
+
+// Call chains: a function with a stack frame calls a leaf through bl,
+// which calls another one through bctrl
+static const uint32 CALLS_ITERS = 500000;
+
+static uint64 calls_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	uint32 *skip = a.b_fwd();
+	uint32 *f3 = a.here();
+	a.addi(3, 3, 3);
+	a.blr();
+	uint32 *f2 = a.here();
+	a.mflr(12);
+	a.bctrl();
+	a.mtlr(12);
+	a.addi(3, 3, 2);
+	a.blr();
+	uint32 *f1 = a.here();
+	a.mflr(0);
+	a.stwu(1, -16, 1);
+	a.stw(0, 20, 1);
+	a.bl(f2);
+	a.addi(3, 3, 1);
+	a.lwz(0, 20, 1);
+	a.addi(1, 1, 16);
+	a.mtlr(0);
+	a.blr();
+	uint32 *entry = a.here();
+	a.resolve(skip);
+	a.li(3, 0);
+	a.la(1, data + DATA_SIZE - 64);
+	a.la(9, f3);
+	a.mtctr(9);
+	a.li32(14, CALLS_ITERS * scale);
+	uint32 *loop = a.here();
+	a.bl(f1);
+	a.addi(14, 14, -1);
+	a.cmpwi(14, 0);
+	a.bc(BO_FALSE, CR0_EQ, loop);
+	uint32 *end = a.here();
+	a.ret();
+
+	const uint64 iter_count = guest_count(loop, end) + guest_count(f1, entry) + guest_count(f2, f1) + guest_count(f3, f2);
+	return 1 + guest_count(entry, loop) + (uint64)CALLS_ITERS * scale * iter_count + 1;
+}
+
+static bool calls_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	return gpr[3] == 6 * CALLS_ITERS * scale;
+}
+
+// Uncontended spinlock acquire and release
+static const uint32 SPINLOCK_ITERS = 1000000;
+
+static uint64 spinlock_build(powerpc_assembler & a, uint8 *data, int scale)
+{
+	uint32 *code = a.here();
+	a.la(4, data);
+	a.li(9, 1);
+	a.li(10, 0);
+	a.li(3, 0);
+	a.li32(11, SPINLOCK_ITERS * scale);
+	a.mtctr(11);
+	uint32 *loop = a.here();
+	a.lwarx(8, 0, 4);
+	a.cmpwi(8, 0);
+	a.bc(BO_FALSE, CR0_EQ, loop);
+	a.stwcx(9, 0, 4);
+	a.bc(BO_FALSE, CR0_EQ, loop);
+	a.isync();
+	a.addi(3, 3, 1);
+	a.sync();
+	a.stw(10, 0, 4);
+	a.bdnz(loop);
+	uint32 *end = a.here();
+	a.ret();
+	return guest_count(code, loop) + (uint64)SPINLOCK_ITERS * scale * guest_count(loop, end) + 1;
+}
+
+static void spinlock_reset(uint8 *data, int scale)
+{
+	memset(data, 0, 4);
+}
+
+static bool spinlock_check(const uint32 *gpr, const uint8 *data, int scale)
+{
+	return gpr[3] == SPINLOCK_ITERS * scale && data[0] == 0 && data[3] == 0;
+}
+
+static const bench_kernel kernels[] = {
+	{ "integer",	"integer ALU loop",				integer_build,	no_reset,		integer_check	},
+	{ "memcpy",		"unrolled word copy",			memcpy_build,	memcpy_reset,	memcpy_check	},
+	{ "memmove",	"overlapping byte move",		memmove_build,	memmove_reset,	memmove_check	},
+	{ "fpdot",		"double dot product",			fpdot_build,	fpdot_reset,	fpdot_check		},
+	{ "altivec",	"vector average blit",			altivec_build,	altivec_reset,	altivec_check	},
+	{ "branch",		"data dependent branches",		branch_build,	no_reset,		branch_check	},
+	{ "calls",		"call and return chains",		calls_build,	no_reset,		calls_check		},
+	{ "spinlock",	"lwarx/stwcx. lock",			spinlock_build,	spinlock_reset,	spinlock_check	},
+};
+
+static const int n_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+
+/**
+ *		Execution engines
+ **/
+
+enum {
+	MODE_INTERP,
+	MODE_DECODE,
+	MODE_THREADED,
+	MODE_JIT,
+	MODE_ASYNC,
+	MODE_NATIVE,
+	MODE_OPTIMIZE,
+	MODE_MAX
+};
+
+static const char *mode_names[MODE_MAX] = {
+	"interp", "decode", "threaded", "jit", "async", "native", "optimize"
+};
+
+static bool mode_supported(int mode)
+{
+	switch (mode) {
+	case MODE_INTERP:
+		return true;
+	case MODE_DECODE:
+		return PPC_DECODE_CACHE;
+	case MODE_THREADED:
+		return PPC_THREADED_INTERPRETER;
+	case MODE_JIT:
+		return PPC_ENABLE_JIT;
+	case MODE_ASYNC:
+		return PPC_ASYNC_JIT;
+	case MODE_NATIVE:
+	case MODE_OPTIMIZE:
+#if PPC_ENABLE_NATIVE_JIT
+		return true;
+#endif
+		break;
+	}
+	return false;
+}
+
+struct powerpc_bench_cpu
+	: public powerpc_cpu
+{
+	powerpc_bench_cpu(int mode);
+	void init_decoder();
+	void execute_return(uint32 opcode);
+	void flush_cache();
+	uint32 get_gpr(int i) const			{ return gpr(i); }
+};
+
+powerpc_bench_cpu::powerpc_bench_cpu(int mode)
+#ifndef SHEEPSHAVER
+	: powerpc_cpu(NULL)
+#endif
+{
+	init_decoder();
+	if (mode == MODE_INTERP)
+		enable_decode_cache(false);
+	if (mode == MODE_DECODE)
+		enable_threaded_code(false);
+#if PPC_ENABLE_JIT
+	if (mode >= MODE_JIT)
+		enable_jit();
+#endif
+#if PPC_ASYNC_JIT
+	if (mode == MODE_ASYNC)
+		enable_async_jit();
+#endif
+#if PPC_ENABLE_NATIVE_JIT
+	if (mode >= MODE_NATIVE)
+		enable_native_jit();
+	if (mode == MODE_OPTIMIZE)
+		enable_jit_optimizer();
+#endif
+}
+
+void powerpc_bench_cpu::execute_return(uint32 opcode)
+{
+	spcflags().set(SPCFLAG_CPU_EXEC_RETURN);
+}
+
+void powerpc_bench_cpu::init_decoder()
+{
+	static const instr_info_t return_ii_table[] = {
+		{ "return",
+		  (execute_pmf)&powerpc_bench_cpu::execute_return,
+		  PPC_I(MAX),
+		  D_form, 6, 0, CFLOW_JUMP
+		}
+	};
+
+	const int ii_count = sizeof(return_ii_table)/sizeof(return_ii_table[0]);
+
+	for (int i = 0; i < ii_count; i++) {
+		const instr_info_t * ii = &return_ii_table[i];
+		init_decoder_entry(ii);
+	}
+}
+
+void powerpc_bench_cpu::flush_cache()
+{
+	// Start each kernel from a cold cache. The interpreter never
+	// consumes the exec return request, so drop it here
+	invalidate_cache();
+	spcflags().clear(SPCFLAG_JIT_EXEC_RETURN);
+}
+
+
+/**
+ *		Benchmark driver
+ **/
+
+static double get_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static bool run_kernel(powerpc_bench_cpu *cpu, int mode, const bench_kernel *k,
+					   uint32 *code, uint8 *data, int scale, int runs)
+{
+	powerpc_assembler a(code);
+	const uint64 n_insns = k->build(a, data, scale);
+	cpu->flush_cache();
+
+#if PPC_PROFILE_COMPILE_TIME
+	const uint32 count0 = cpu->get_compile_count();
+	const clock_t time0 = cpu->get_compile_time();
+	const uint32 size0 = cpu->get_compile_size();
+#endif
+
+	// The first run is cold and includes translation, report the best one
+	bool ok = true;
+	double best = 0.0;
+	for (int i = 0; i < runs; i++) {
+		k->reset(data, scale);
+		const double start = get_time();
+		cpu->execute((uintptr)code);
+		const double elapsed = get_time() - start;
+		if (i == 0 || elapsed < best)
+			best = elapsed;
+		uint32 gpr[32];
+		for (int r = 0; r < 32; r++)
+			gpr[r] = cpu->get_gpr(r);
+		if (!k->check(gpr, data, scale))
+			ok = false;
+	}
+
+	printf("%-10s %-9s %8.1f %9.2f", k->name, mode_names[mode], n_insns / 1e6, n_insns / best / 1e6);
+#if PPC_PROFILE_COMPILE_TIME
+	const uint32 blocks = cpu->get_compile_count() - count0;
+	const double xlate_ms = (cpu->get_compile_time() - time0) * 1000.0 / CLOCKS_PER_SEC;
+	const uint32 bytes = cpu->get_compile_size() - size0;
+	const uint32 code_insns = guest_count(code, a.here());
+	printf(" %9.3f %7d %10.1f", xlate_ms, blocks, (double)bytes / code_insns);
+#else
+	printf(" %9s %7s %10s", "-", "-", "-");
+#endif
+	printf("  %s\n", ok ? "ok" : "FAIL");
+	fflush(stdout);
+	return ok;
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [--mode=MODE[,MODE...]] [--runs=N] [--scale=N] [KERNEL...]\n", prog);
+	printf("\nModes:");
+	for (int i = 0; i < MODE_MAX; i++) {
+		if (mode_supported(i))
+			printf(" %s", mode_names[i]);
+	}
+	printf("\n\nKernels:\n");
+	for (int i = 0; i < n_kernels; i++)
+		printf("  %-10s %s\n", kernels[i].name, kernels[i].description);
+}
+
+static bool parse_modes(const char *arg, bool *modes)
+{
+	while (*arg) {
+		const char *end = strchr(arg, ',');
+		const size_t len = end ? end - arg : strlen(arg);
+		int mode;
+		for (mode = 0; mode < MODE_MAX; mode++) {
+			if (strlen(mode_names[mode]) == len && strncmp(arg, mode_names[mode], len) == 0)
+				break;
+		}
+		if (mode == MODE_MAX || !mode_supported(mode)) {
+			fprintf(stderr, "ERROR: unsupported mode '%.*s'\n", (int)len, arg);
+			return false;
+		}
+		modes[mode] = true;
+		arg += len;
+		if (*arg == ',')
+			arg++;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	bool modes[MODE_MAX] = { false, };
+	bool selected[n_kernels] = { false, };
+	bool any_mode = false, any_kernel = false;
+	int runs = 5, scale = 1;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strncmp(arg, "--mode=", 7) == 0) {
+			if (!parse_modes(arg + 7, modes))
+				return EXIT_FAILURE;
+			any_mode = true;
+		}
+		else if (strncmp(arg, "--runs=", 7) == 0)
+			runs = atoi(arg + 7);
+		else if (strncmp(arg, "--scale=", 8) == 0)
+			scale = atoi(arg + 8);
+		else if (strcmp(arg, "--help") == 0) {
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		}
+		else {
+			int k;
+			for (k = 0; k < n_kernels; k++) {
+				if (strcmp(arg, kernels[k].name) == 0)
+					break;
+			}
+			if (k == n_kernels) {
+				fprintf(stderr, "ERROR: unknown kernel '%s'\n", arg);
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			selected[k] = any_kernel = true;
+		}
+	}
+	if (runs < 1 || scale < 1) {
+		fprintf(stderr, "ERROR: runs and scale must be positive\n");
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; i < MODE_MAX; i++) {
+		if (!any_mode)
+			modes[i] = mode_supported(i);
+	}
+	for (int k = 0; k < n_kernels; k++) {
+		if (!any_kernel)
+			selected[k] = true;
+	}
+
+	// Initialize VM system (predecode cache uses vm_acquire())
+	vm_init();
+
+	// Guest code and data must be addressable with 32 bits
+	uint8 *area = (uint8 *)vm_acquire(CODE_SIZE + DATA_SIZE, VM_MAP_DEFAULT | VM_MAP_32BIT);
+	if (area == VM_MAP_FAILED) {
+		fprintf(stderr, "ERROR: could not allocate guest memory\n");
+		return EXIT_FAILURE;
+	}
+	uint32 *code = (uint32 *)area;
+	uint8 *data = area + CODE_SIZE;
+
+	printf("%-10s %-9s %8s %9s %9s %7s %10s\n",
+		   "kernel", "mode", "Minsns", "MIPS", "xlate ms", "blocks", "bytes/insn");
+
+	bool ok = true;
+	for (int mode = 0; mode < MODE_MAX; mode++) {
+		if (!modes[mode])
+			continue;
+		// The CPU is not destroyed so that compile statistics are
+		// not printed in the middle of the results
+		powerpc_bench_cpu *cpu = new powerpc_bench_cpu(mode);
+		for (int k = 0; k < n_kernels; k++) {
+			if (selected[k] && !run_kernel(cpu, mode, &kernels[k], code, data, scale, runs))
+				ok = false;
+		}
+	}
+
+	vm_release(area, CODE_SIZE + DATA_SIZE);
+	vm_exit();
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -85,6 +85,7 @@ typedef uintptr_t uintptr;
 #if EMU_KHEPERIX
 #define TEST_FPU_OPS	1
 #define TEST_VMX_OPS	1
+#define TEST_BLOCK_CACHE	1
 #endif
 
 // Define units to skip during testing
@@ -198,6 +199,8 @@ static void inline ppc_flush_icache_range(uint32 *start_p, uint32 length)
 // Wrappers when building from SheepShaver tree
 #ifdef SHEEPSHAVER
 uint32 ROMBase = 0x40800000;
+uintptr RAMBase = 0;
+uint32 RAMSize = 0;
 int64 TimebaseSpeed = 25000000;	// Default:  25 MHz
 uint32 PVR = 0x000c0000;		// Default: 7400 (with AltiVec)
 
@@ -801,6 +804,8 @@ private:
 	void test_vector_load(void);
 	void test_vector_load_for_shift(void);
 	void test_vector_arith(void);
+
+	void test_block_cache(void);
 };
 
 powerpc_test_cpu::powerpc_test_cpu()
@@ -1563,6 +1568,76 @@ void powerpc_test_cpu::test_cr_logical(void)
 #endif
 }
 
+#if TEST_BLOCK_CACHE
+// Minimal block descriptor for page_block_cache<> tests
+struct test_block_info
+{
+	uintptr pc, end_pc, min_pc, max_pc;
+	void invalidate() { }
+};
+
+typedef page_block_cache< test_block_info, lazy_allocator > test_block_cache_t;
+
+static void test_add_block(test_block_cache_t & bc, uint32 pc, uint32 end_pc, uint32 min_pc, uint32 max_pc)
+{
+	test_block_info *bi = bc.new_blockinfo();
+	bi->pc = pc;
+	bi->end_pc = end_pc;
+	bi->min_pc = min_pc;
+	bi->max_pc = max_pc;
+	bc.add_to_cl_list(bi);
+	bc.add_to_active_list(bi);
+}
+#endif
+
+void powerpc_test_cpu::test_block_cache(void)
+{
+#if TEST_BLOCK_CACHE
+	test_block_cache_t bc;
+
+	// Second-level tables cover 4 MB, pages 0x3ff and 0x400 are in different ones
+	test_add_block(bc, 0x003ff000, 0x003ff010, 0x003ff000, 0x003ff010);
+	test_add_block(bc, 0x003ffff8, 0x00400008, 0x003ffff8, 0x00400008);
+	test_add_block(bc, 0x00400100, 0x00400110, 0x00400100, 0x00400110);
+	test_add_block(bc, 0x00401000, 0x00401010, 0x00401000, 0x00401010);
+	test_add_block(bc, 0x03000000, 0x03000010, 0x03000000, 0x03000010);
+	// Block starting far away but branching back into page 0x400
+	test_add_block(bc, 0x04000000, 0x04000010, 0x00400200, 0x04000010);
+
+	static const struct {
+		uint32 start, end;
+		uint32 pc[6];
+		bool present[6];
+	} steps[] = {
+		// Tail of a block crossing a page and L2 boundary
+		{ 0x00400000, 0x00400004,
+		  { 0x003ff000, 0x003ffff8, 0x00400100, 0x00401000, 0x03000000, 0x04000000 },
+		  { true, false, true, true, true, true } },
+		// Several pages across the L2 boundary, plus a spanning block
+		{ 0x003ff800, 0x00401004,
+		  { 0x003ff000, 0x003ffff8, 0x00400100, 0x00401000, 0x03000000, 0x04000000 },
+		  { true, false, false, false, true, false } },
+		// Unallocated second-level tables in between
+		{ 0x00800000, 0x03000004,
+		  { 0x003ff000, 0x003ffff8, 0x00400100, 0x00401000, 0x03000000, 0x04000000 },
+		  { true, false, false, false, false, false } },
+	};
+
+	for (uint32 i = 0; i < sizeof(steps)/sizeof(steps[0]); i++) {
+		bc.clear_range(steps[i].start, steps[i].end);
+		for (int j = 0; j < 6; j++) {
+			tests++;
+			bool present = bc.find(steps[i].pc[j]) != NULL;
+			if (present != steps[i].present[j]) {
+				printf("FAIL: block cache, clear_range(%08x, %08x) %s %08x\n",
+					   steps[i].start, steps[i].end, present ? "kept" : "dropped", steps[i].pc[j]);
+				errors++;
+			}
+		}
+	}
+#endif
+}
+
 // Template-generated vector values
 const powerpc_test_cpu::vector_value_t powerpc_test_cpu::vector_values[] = {
 	{'w',{0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00}},
@@ -2153,6 +2228,11 @@ bool powerpc_test_cpu::test(void)
 	tests = errors = 0;
 	init_cr = init_xer = 0;
 
+	// Basic block cache tests
+#if TEST_BLOCK_CACHE
+	test_block_cache();
+#endif
+
 	// Execution ALU tests
 #if TEST_ALU_OPS
 	test_add();
@@ -35,7 +35,17 @@ enum {
 	HWCAP_I386_SSSE3		= 1 << 9,
 	HWCAP_I386_SSE4_1		= 1 << 19,
 	HWCAP_I386_SSE4_2		= 1 << 20,
-	HWCAP_I386_ECX_FLAGS	= (HWCAP_I386_SSE3|HWCAP_I386_SSSE3|HWCAP_I386_SSE4_1|HWCAP_I386_SSE4_2)
+	HWCAP_I386_ECX_FLAGS	= (HWCAP_I386_SSE3|HWCAP_I386_SSSE3|HWCAP_I386_SSE4_1|HWCAP_I386_SSE4_2),
+	HWCAP_I386_OSXSAVE		= 1 << 27,
+	HWCAP_I386_AVX			= 1 << 28
+};
+
+// x86 extended CPU features, CPUID(7).EBX
+static uint32 x86_cpu_ext_features = 0;
+
+enum {
+	HWCAP_I386_AVX2			= 1 << 5,
+	HWCAP_I386_EXT_FLAGS	= (HWCAP_I386_AVX2)
 };
 
 // Determine x86 CPU features
@@ -69,6 +79,7 @@ static void init_x86_cpu_features(void)
 #endif
 	if (fl1 == 0)
 		return;
+	const unsigned int max_level = fl1;
 
 	/* Invoke CPUID(1), return %edx; caller can examine bits to
 	   determine what's supported.  */
@@ -79,6 +90,30 @@ static void init_x86_cpu_features(void)
 #endif
 
 	x86_cpu_features = (fl1 & HWCAP_I386_ECX_FLAGS) | (fl2 & HWCAP_I386_EDX_FLAGS);
+
+	/* AVX state must also be enabled by the OS, check XCR0 has both
+	   the SSE and AVX bits set before looking at CPUID(7).  */
+	if ((fl1 & (HWCAP_I386_OSXSAVE|HWCAP_I386_AVX)) != (HWCAP_I386_OSXSAVE|HWCAP_I386_AVX))
+		return;
+	unsigned int xcr0, xcr0_hi;
+	__asm__ (".byte 0x0f, 0x01, 0xd0" : "=a" (xcr0), "=d" (xcr0_hi) : "c" (0));
+	if ((xcr0 & 6) != 6)
+		return;
+
+	/* Invoke CPUID(7,0), return %ebx.  %ebx may be the PIC register,
+	   swap it with a scratch register around cpuid.  */
+	if (max_level < 7)
+		return;
+	unsigned int fl3;
+#ifdef __x86_64__
+	__asm__ ("xchgq %%rbx,%q1 ; cpuid ; xchgq %%rbx,%q1"
+			 : "=a" (fl1), "=&r" (fl2), "=c" (fl3) : "0" (7), "2" (0) : "rdx", "cc");
+#else
+	__asm__ ("xchgl %%ebx,%1 ; cpuid ; xchgl %%ebx,%1"
+			 : "=a" (fl1), "=&r" (fl2), "=c" (fl3) : "0" (7), "2" (0) : "edx", "cc");
+#endif
+
+	x86_cpu_ext_features = fl2 & HWCAP_I386_EXT_FLAGS;
 #endif
 }
 
@@ -130,6 +165,12 @@ bool cpuinfo_check_sse4_2(void)
 	return x86_cpu_features & HWCAP_I386_SSE4_2;
 }
 
+// Check for x86 feature AVX2
+bool cpuinfo_check_avx2(void)
+{
+	return x86_cpu_ext_features & HWCAP_I386_AVX2;
+}
+
 // PowerPC CPU features
 static uint32 ppc_cpu_features = 0;
 
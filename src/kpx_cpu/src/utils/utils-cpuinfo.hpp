@@ -45,6 +45,9 @@ extern bool cpuinfo_check_sse4_1(void);
 // Check for x86 feature SSE4_2
 extern bool cpuinfo_check_sse4_2(void);
 
+// Check for x86 feature AVX2
+extern bool cpuinfo_check_avx2(void);
+
 // Check for ppc feature VMX (Altivec)
 extern bool cpuinfo_check_altivec(void);
 
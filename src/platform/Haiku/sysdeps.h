@@ -76,7 +76,9 @@
 # define PPC_CHECK_INTERRUPTS 1
 # define PPC_DECODE_CACHE 1
 # define PPC_FLIGHT_RECORDER 1
-# define PPC_PROFILE_COMPILE_TIME 0
+# ifndef PPC_PROFILE_COMPILE_TIME
+#  define PPC_PROFILE_COMPILE_TIME 0
+# endif
 # define PPC_PROFILE_GENERIC_CALLS 0
 # define PPC_PROFILE_REGS_USE 0
 # define PPC_ENABLE_FPU_EXCEPTIONS 0
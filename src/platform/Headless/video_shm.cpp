@@ -0,0 +1,551 @@
+/*
+ *  video_shm.cpp - Headless video driver, exports the frame buffer in POSIX shared memory
+ *
+ *  SheepShear, 2012 Alexander von Gluck
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  NOTES:
+ *    No window system is involved: MacOS draws into a frame buffer that
+ *    lives in a shared memory object (see video_shm.h for its layout), and
+ *    capture processes map it to read frames without any copy. Damage is
+ *    only computed while a reader is attached. There is no input, and the
+ *    MacOS cursor is drawn into the frame buffer.
+ */
+
+
+#include "sysdeps.h"
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "main.h"
+#include "adb.h"
+#include "prefs.h"
+#include "user_strings.h"
+#include "video.h"
+#include "video_defs.h"
+#include "video_blit.h"
+#include "event_loop.h"
+#include "video_shm.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+#ifndef MAP_32BIT
+#define MAP_32BIT 0
+#endif
+
+
+// Constants
+const int VIDEO_REFRESH_HZ = 60;
+const int VIDEO_REFRESH_DELAY = 1000000 / VIDEO_REFRESH_HZ;
+const int MAX_RECTS = VIDEO_SHM_RECTS_BATCH;	// Damage rectangles per frame
+
+// Global variables
+static int32 frame_skip;
+static event_source *redraw_timer = NULL;	// Display refresh timer
+
+static char *shm_name = NULL;				// Name of the shared memory object
+static video_shm_header *shm_header = NULL;	// Start of the shared memory object
+static uint32 shm_size;						// Size of the shared memory object
+static uint8 *the_buffer = NULL;			// Pointer to Mac frame buffer, in the shared memory object
+static uint8 *the_buffer_copy = NULL;		// Copy of Mac frame buffer, for damage detection
+
+// Spinlocks
+SpinLock* gDisplayLock;		// Guards the current mode and the damage ring
+
+
+// Prototypes
+static void redraw_func(void *arg);
+
+
+/*
+ *  Utility functions
+ */
+
+// Map video_mode depth ID to numerical depth value
+static inline int depth_of_video_mode(int mode)
+{
+	switch (mode) {
+	case APPLE_1_BIT: return 1;
+	case APPLE_2_BIT: return 2;
+	case APPLE_4_BIT: return 4;
+	case APPLE_8_BIT: return 8;
+	case APPLE_16_BIT: return 16;
+	case APPLE_32_BIT: return 32;
+	default: abort();
+	}
+}
+
+// Map video_mode depth ID to shared memory pixel format
+static inline uint32 format_of_video_mode(int mode)
+{
+	switch (mode) {
+	case APPLE_16_BIT: return VIDEO_SHM_XRGB1555_BE;
+	case APPLE_32_BIT: return VIDEO_SHM_XRGB8888_BE;
+	default: return VIDEO_SHM_INDEXED;
+	}
+}
+
+// Round size up to host pages
+static inline uint32 page_extend(uint32 size)
+{
+	const uint32 page_mask = getpagesize() - 1;
+	return (size + page_mask) & ~page_mask;
+}
+
+// Publish the current mode and palette, gDisplayLock must be held
+static void update_shm_mode(void)
+{
+	VideoInfo const & mode = VModes[cur_mode];
+	video_shm_header *h = shm_header;
+
+	h->seq++;
+	__sync_synchronize();
+	h->width = mode.viXsize;
+	h->height = mode.viYsize;
+	h->bytes_per_row = mode.viRowBytes;
+	h->depth = depth_of_video_mode(mode.viAppleMode);
+	h->format = format_of_video_mode(mode.viAppleMode);
+	for (int i = 0; i < 256; i++) {
+		h->palette[i][0] = mac_pal[i].red;
+		h->palette[i][1] = mac_pal[i].green;
+		h->palette[i][2] = mac_pal[i].blue;
+		h->palette[i][3] = 0;
+	}
+	__sync_synchronize();
+	h->seq++;
+}
+
+
+/*
+ *  Shared memory frame buffer
+ */
+
+// Create and map the shared memory object, large enough for all modes
+static bool open_shm(void)
+{
+	uint32 buffer_size = 0;
+	for (VideoInfo *p = VModes; p->viType != DISPLAY_INVALID; p++) {
+		if (p->viRowBytes * p->viYsize > buffer_size)
+			buffer_size = p->viRowBytes * p->viYsize;
+	}
+	buffer_size = page_extend(buffer_size);
+	const uint32 header_size = page_extend(sizeof(video_shm_header));
+	shm_size = header_size + buffer_size;
+
+	const char *name = PrefsFindString("shmname");
+	if (name == NULL)
+		name = "/sheepshear";
+	shm_name = strdup(name);
+
+	// Never take over the object of another instance
+	int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		if (errno == EEXIST) {
+			char str[256];
+			snprintf(str, sizeof(str), GetString(STR_SHM_VIDEO_EXISTS_ERR), shm_name);
+			ErrorAlert(str);
+			return false;
+		}
+		goto error;
+	}
+	if (ftruncate(fd, shm_size) < 0) {
+		close(fd);
+		shm_unlink(shm_name);
+		goto error;
+	}
+
+	// MacOS must be able to address the frame buffer
+	shm_header = (video_shm_header *)mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_32BIT, fd, 0);
+	close(fd);
+	if (shm_header == (video_shm_header *)MAP_FAILED) {
+		shm_header = NULL;
+		shm_unlink(shm_name);
+		goto error;
+	}
+	if (sizeof(void *) == 8 && (uintptr)shm_header + shm_size - 1 > 0xffffffff) {
+		munmap(shm_header, shm_size);
+		shm_header = NULL;
+		shm_unlink(shm_name);
+		errno = ENOMEM;
+		goto error;
+	}
+	D(bug("shared memory frame buffer %s at %p, %d bytes\n", shm_name, shm_header, shm_size));
+
+	the_buffer = (uint8 *)shm_header + header_size;
+	the_buffer_copy = (uint8 *)calloc(buffer_size, 1);
+	if (the_buffer_copy == NULL)
+		return false;
+	screen_base = Host2MacAddr(the_buffer);
+
+	// The object is zero-filled, readers wait for the magic
+	shm_header->version = VIDEO_SHM_VERSION;
+	shm_header->header_size = header_size;
+	shm_header->buffer_size = buffer_size;
+	update_shm_mode();
+	__sync_synchronize();
+	shm_header->magic = VIDEO_SHM_MAGIC;
+	return true;
+
+error:
+	char str[256];
+	snprintf(str, sizeof(str), GetString(STR_SHM_VIDEO_ERR), shm_name, strerror(errno));
+	ErrorAlert(str);
+	return false;
+}
+
+// Unmap and remove the shared memory object
+static void close_shm(void)
+{
+	if (shm_header) {
+		munmap(shm_header, shm_size);
+		shm_header = NULL;
+		shm_unlink(shm_name);
+	}
+	the_buffer = NULL;
+	if (the_buffer_copy) {
+		free(the_buffer_copy);
+		the_buffer_copy = NULL;
+	}
+	if (shm_name) {
+		free(shm_name);
+		shm_name = NULL;
+	}
+}
+
+
+/*
+ *  Initialization
+ */
+
+// Find mode in list of supported modes
+static int find_mode(uint32 apple_mode, uint32 apple_id)
+{
+	for (VideoInfo *p = VModes; p->viType != DISPLAY_INVALID; p++) {
+		if (p->viAppleID == apple_id && p->viAppleMode == apple_mode)
+			return p - VModes;
+	}
+	return -1;
+}
+
+// Add mode to list of supported modes
+static void add_mode(VideoInfo *&p, uint32 x, uint32 y, uint32 apple_mode, uint32 apple_id)
+{
+	p->viType = DISPLAY_WINDOW;
+	p->viXsize = x;
+	p->viYsize = y;
+	p->viRowBytes = TrivialBytesPerRow(p->viXsize, apple_mode);
+	p->viAppleMode = apple_mode;
+	p->viAppleID = apple_id;
+	p++;
+}
+
+bool
+PlatformVideo::DeviceInit(void)
+{
+	gDisplayLock = new SpinLock;
+
+	// Read frame skip prefs
+	frame_skip = PrefsFindInt32("frameskip");
+	if (frame_skip == 0)
+		frame_skip = 1;
+
+	// Init variables
+	private_data = NULL;
+	video_activated = true;
+	display_type = DISPLAY_WINDOW;
+
+	// Get screen mode from preferences ("shm/<width>/<height>", other
+	// prefixes are accepted so that window mode prefs keep working)
+	const char *mode_str = PrefsFindString("screen");
+	int default_width = 0, default_height = 0;
+	if (mode_str && sscanf(mode_str, "%*[a-z]/%d/%d", &default_width, &default_height) != 2)
+		mode_str = NULL;
+	if (mode_str && (default_width < 640 || default_height < 480)) {
+		D(bug("Invalid screen mode specified, defaulting to old modes selection\n"));
+		mode_str = NULL;
+	}
+
+	// Construct video mode table, all depths are available
+	uint32 window_modes = PrefsFindInt32("windowmodes");
+	if (window_modes == 0)
+		window_modes = 3;	// Allow at least 640x480 and 800x600 modes
+
+	VideoInfo *p = VModes;
+	for (int d = APPLE_1_BIT; d <= APPLE_32_BIT; d++) {
+		if (mode_str) {
+			if (default_width > 640 && default_height > 480)
+				add_mode(p, 640, 480, d, APPLE_W_640x480);
+			if (default_width > 800 && default_height > 600)
+				add_mode(p, 800, 600, d, APPLE_W_800x600);
+			add_mode(p, default_width, default_height, d, APPLE_CUSTOM);
+		} else {
+			if (window_modes & 1)
+				add_mode(p, 640, 480, d, APPLE_W_640x480);
+			if (window_modes & 2)
+				add_mode(p, 800, 600, d, APPLE_W_800x600);
+		}
+	}
+	p->viType = DISPLAY_INVALID;	// End marker
+	p->viRowBytes = 0;
+	p->viXsize = p->viYsize = 0;
+	p->viAppleMode = 0;
+	p->viAppleID = 0;
+
+	// Find default mode (the requested size, or the first one, in millions of colors)
+	cur_mode = mode_str ? find_mode(APPLE_32_BIT, APPLE_CUSTOM) : -1;
+	if (cur_mode == -1) {
+		for (p = VModes; p->viType != DISPLAY_INVALID; p++) {
+			if (p->viAppleMode == APPLE_32_BIT) {
+				cur_mode = p - VModes;
+				break;
+			}
+		}
+	}
+	assert(cur_mode != -1);
+
+#if DEBUG
+	D(bug("Available video modes:\n"));
+	for (p = VModes; p->viType != DISPLAY_INVALID; p++) {
+		int bits = depth_of_video_mode(p->viAppleMode);
+		D(bug(" %dx%d (ID %02x), %d colors\n", p->viXsize, p->viYsize, p->viAppleID, 1 << bits));
+	}
+#endif
+
+	// Create frame buffer
+	if (!open_shm()) {
+		close_shm();
+		return false;
+	}
+	gADBInput->SetRelMouseMode(false);
+
+	// Start periodic refresh
+	redraw_timer = EventLoopAddTimer(redraw_func, NULL);
+	if (redraw_timer)
+		EventLoopSetPeriod(redraw_timer, VIDEO_REFRESH_DELAY);
+	D(bug("Redraw events installed\n"));
+	return true;
+}
+
+
+/*
+ *  Deinitialization
+ */
+
+void
+PlatformVideo::DeviceShutdown(void)
+{
+	// Stop redraw events
+	if (redraw_timer) {
+		EventLoopRemove(redraw_timer);
+		redraw_timer = NULL;
+	}
+
+	// Remove frame buffer
+	close_shm();
+
+	// Destroy spinlocks
+	delete gDisplayLock;
+}
+
+
+/*
+ *  Install Native QuickDraw acceleration hooks
+ */
+void
+PlatformVideo::InstallAccel(void)
+{
+	// Install acceleration hooks
+	if (PrefsFindBool("gfxaccel")) {
+		D(bug("Video: Installing acceleration hooks\n"));
+		uint32 base;
+
+		SheepVar bitblt_hook_info(sizeof(accl_hook_info));
+		base = bitblt_hook_info.addr();
+		WriteMacInt32(base + 0, NativeTVECT(NATIVE_NQD_BITBLT_HOOK));
+		WriteMacInt32(base + 4, NativeTVECT(NATIVE_NQD_SYNC_HOOK));
+		WriteMacInt32(base + 8, ACCL_BITBLT);
+		NQDMisc(6, bitblt_hook_info.addr());
+
+		SheepVar fillrect_hook_info(sizeof(accl_hook_info));
+		base = fillrect_hook_info.addr();
+		WriteMacInt32(base + 0, NativeTVECT(NATIVE_NQD_FILLRECT_HOOK));
+		WriteMacInt32(base + 4, NativeTVECT(NATIVE_NQD_SYNC_HOOK));
+		WriteMacInt32(base + 8, ACCL_FILLRECT);
+		NQDMisc(6, fillrect_hook_info.addr());
+
+		for (int op = 0; op < 8; op++) {
+			switch (op) {
+				case ACCL_BITBLT:
+				case ACCL_FILLRECT:
+					continue;
+			}
+			SheepVar unknown_hook_info(sizeof(accl_hook_info));
+			base = unknown_hook_info.addr();
+			WriteMacInt32(base + 0, NativeTVECT(NATIVE_NQD_UNKNOWN_HOOK));
+			WriteMacInt32(base + 4, NativeTVECT(NATIVE_NQD_SYNC_HOOK));
+			WriteMacInt32(base + 8, op);
+			NQDMisc(6, unknown_hook_info.addr());
+		}
+	}
+}
+
+
+/*
+ *  Close screen in full-screen mode
+ */
+
+void
+PlatformVideo::DeviceQuitFullScreen(void)
+{
+	// There is no full-screen mode
+}
+
+
+/*
+ *  Video VBL interrupt
+ */
+void
+PlatformVideo::DeviceInterrupt(void)
+{
+	// Execute video VBL
+	if (private_data != NULL && private_data->interruptsEnabled)
+		VSLDoInterruptService(private_data->vslServiceID);
+}
+
+
+/*
+ *  Change video mode
+ */
+int16
+PlatformVideo::ModeChange(VidLocals *csSave, uint32 ParamPtr)
+{
+	/* return if no mode change */
+	if ((csSave->saveData == ReadMacInt32(ParamPtr + csData))
+	    && (csSave->saveMode == ReadMacInt16(ParamPtr + csMode)))
+		return noErr;
+
+	/* first find video mode in table */
+	for (int i=0; VModes[i].viType != DISPLAY_INVALID; i++) {
+		if ((ReadMacInt16(ParamPtr + csMode) == VModes[i].viAppleMode) &&
+		    (ReadMacInt32(ParamPtr + csData) == VModes[i].viAppleID)) {
+			csSave->saveMode = ReadMacInt16(ParamPtr + csMode);
+			csSave->saveData = ReadMacInt32(ParamPtr + csData);
+			csSave->savePage = ReadMacInt16(ParamPtr + csPage);
+
+			// The frame buffer fits all modes, only its layout changes
+			DisableInterrupt();
+			gDisplayLock->Lock();
+			cur_mode = i;
+			memset(the_buffer, 0, VModes[cur_mode].viRowBytes * VModes[cur_mode].viYsize);
+			memset(the_buffer_copy, 0, VModes[cur_mode].viRowBytes * VModes[cur_mode].viYsize);
+			update_shm_mode();
+			gDisplayLock->Unlock();
+
+			WriteMacInt32(ParamPtr + csBaseAddr, screen_base);
+			csSave->saveBaseAddr=screen_base;
+			csSave->saveData=VModes[cur_mode].viAppleID;/* First mode ... */
+			csSave->saveMode=VModes[cur_mode].viAppleMode;
+
+			EnableInterrupt();
+			return noErr;
+		}
+	}
+	return paramErr;
+}
+
+
+/*
+ *  Set color palette
+ */
+
+void video_set_palette(void)
+{
+	gDisplayLock->Lock();
+	update_shm_mode();
+	gDisplayLock->Unlock();
+}
+
+
+/*
+ *  Can we set the MacOS cursor image into the window?
+ */
+
+bool video_can_change_cursor(void)
+{
+	// No, readers get the cursor drawn by MacOS
+	return false;
+}
+
+
+/*
+ *  Set cursor image for window
+ */
+
+void video_set_cursor(void)
+{
+}
+
+
+/*
+ *  Display refresh, run VIDEO_REFRESH_HZ times per second by the event loop
+ */
+
+static void redraw_func(void *arg)
+{
+	static int tick_counter = 0;
+	if (++tick_counter < frame_skip)
+		return;
+	tick_counter = 0;
+
+	// Nobody is watching
+	if (shm_header->readers == 0)
+		return;
+
+	// Compare with the previous frame and append the changed areas to the ring
+	gDisplayLock->Lock();
+	ScreenDamageRect rects[MAX_RECTS];
+	VideoInfo const & mode = VModes[cur_mode];
+	const int n_rects = Screen_damage(the_buffer_copy, the_buffer, mode.viXsize, mode.viYsize, mode.viRowBytes, depth_of_video_mode(mode.viAppleMode), rects, MAX_RECTS);
+	if (n_rects) {
+		const uint32 head = shm_header->rects_head;
+		for (int i = 0; i < n_rects; i++) {
+			video_shm_rect & r = shm_header->rects[(head + i) % VIDEO_SHM_RECTS];
+			r.x = rects[i].x;
+			r.y = rects[i].y;
+			r.w = rects[i].w;
+			r.h = rects[i].h;
+		}
+		__sync_synchronize();
+		shm_header->rects_head = head + n_rects;
+		shm_header->frame++;
+	}
+	gDisplayLock->Unlock();
+}
+
+
+/*
+ *  Record dirty area from NQD
+ */
+
+void video_set_dirty_area(int x, int y, int w, int h)
+{
+	// Damage is found by comparing frames
+}
@@ -0,0 +1,96 @@
+/*
+ *  video_shm.h - Layout of the shared memory frame buffer of the headless video driver
+ *
+ *  SheepShear, 2012 Alexander von Gluck
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIDEO_SHM_H
+#define VIDEO_SHM_H
+
+/*
+ *  The POSIX shared memory object named by the "shmname" pref starts with
+ *  a video_shm_header, the Mac frame buffer follows at header_size bytes.
+ *  MacOS draws straight into it, so pixels are in Mac format: big-endian,
+ *  1/2/4/8 bit indexed through palette[], 16 bit xRGB 1555 or 32 bit
+ *  xRGB 8888.
+ *
+ *  The mode fields and the palette are guarded by seq, which is odd while
+ *  they change: readers retry when seq was odd or changed across their
+ *  read. A new seq also means the whole frame must be fetched again.
+ *
+ *  While readers is non-zero (readers increment it atomically when they
+ *  attach and decrement it when they leave) the emulator compares each
+ *  refreshed frame with the previous one, appends at most
+ *  VIDEO_SHM_RECTS_BATCH changed rectangles to rects[] and increments
+ *  frame. rects_head counts every rectangle ever appended, rectangle n is
+ *  rects[n % VIDEO_SHM_RECTS]. The rectangles are written before
+ *  rects_head moves past them, and the next batch may already overwrite
+ *  older slots while a reader copies them. A reader that has seen up to
+ *  rectangle tail therefore:
+ *    1. reads head = rects_head, then issues a read barrier;
+ *    2. copies rectangles tail to head - 1;
+ *    3. issues a read barrier and reads rects_head again as head2;
+ *    4. keeps the copies only if head2 - tail <= VIDEO_SHM_RECTS
+ *       - VIDEO_SHM_RECTS_BATCH (unsigned, rects_head wraps around),
+ *       otherwise fetches the whole frame;
+ *    5. continues from tail = head.
+ *
+ *  This header is plain C so that capture tools can include it.
+ */
+
+#include <stdint.h>
+
+#define VIDEO_SHM_MAGIC		0x53484642	/* 'SHFB' */
+#define VIDEO_SHM_VERSION	1
+#define VIDEO_SHM_RECTS		256			/* Size of the damage ring */
+#define VIDEO_SHM_RECTS_BATCH	32		/* Most rects appended per frame */
+
+/* Pixel formats */
+enum {
+	VIDEO_SHM_INDEXED,			/* depth 1, 2, 4 or 8, through palette[] */
+	VIDEO_SHM_XRGB1555_BE,		/* depth 16 */
+	VIDEO_SHM_XRGB8888_BE		/* depth 32 */
+};
+
+/* Changed area of the frame buffer, in pixels */
+struct video_shm_rect {
+	uint16_t x, y;
+	uint16_t w, h;
+};
+
+struct video_shm_header {
+	uint32_t magic;				/* VIDEO_SHM_MAGIC */
+	uint32_t version;			/* VIDEO_SHM_VERSION */
+	uint32_t header_size;		/* Offset of the frame buffer in the segment */
+	uint32_t buffer_size;		/* Size of the frame buffer (largest mode) */
+	volatile uint32_t readers;	/* Number of attached readers */
+
+	/* Current mode, guarded by seq */
+	volatile uint32_t seq;
+	uint32_t width, height;
+	uint32_t bytes_per_row;
+	uint32_t depth;				/* Bits per pixel */
+	uint32_t format;			/* VIDEO_SHM_* pixel format */
+	uint8_t palette[256][4];	/* Red, green, blue, unused */
+
+	/* Damage ring */
+	volatile uint32_t frame;	/* Incremented after each batch of rects */
+	volatile uint32_t rects_head;
+	struct video_shm_rect rects[VIDEO_SHM_RECTS];
+};
+
+#endif /* VIDEO_SHM_H */
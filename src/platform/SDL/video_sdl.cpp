@@ -1125,6 +1125,11 @@ PlatformVideo::DeviceInit(void)
 	mouse_wheel_mode = PrefsFindInt32("mousewheelmode");
 	mouse_wheel_lines = PrefsFindInt32("mousewheellines");
 
+#ifdef ENABLE_VOSF
+	// Start frame buffer conversion threads
+	Screen_blit_threads_init(PrefsFindInt32("blitthreads"));
+#endif
+
 	// Get screen mode from preferences
 	migrate_screen_prefs();
 	const char *mode_str = NULL;
@@ -1326,6 +1331,11 @@ PlatformVideo::DeviceShutdown(void)
 	for (i = VideoMonitors.begin(); i != end; ++i)
 		dynamic_cast<SDL_monitor_desc *>(*i)->video_close();
 
+#ifdef ENABLE_VOSF
+	// Stop frame buffer conversion threads
+	Screen_blit_threads_exit();
+#endif
+
 	// Destroy locks
 	if (frame_buffer_lock)
 		SDL_DestroyMutex(frame_buffer_lock);
@@ -1939,201 +1949,40 @@ static void handle_events(void)
 
 // Static display update (fixed frame rate, but incremental)
 static void update_display_static(driver_base *drv)
-{
-	// Incremental update code
-	int wide = 0, high = 0, x1, x2, y1, y2, i, j;
-	const VIDEO_MODE &mode = drv->mode;
-	int bytes_per_row = VIDEO_MODE_ROW_BYTES;
-	uint8 *p, *p2;
-
-	// Check for first line from top and first line from bottom that have changed
-	y1 = 0;
-	for (j=0; j<VIDEO_MODE_Y; j++) {
-		if (memcmp(&the_buffer[j * bytes_per_row], &the_buffer_copy[j * bytes_per_row], bytes_per_row)) {
-			y1 = j;
-			break;
-		}
-	}
-	y2 = y1 - 1;
-	for (j=VIDEO_MODE_Y-1; j>=y1; j--) {
-		if (memcmp(&the_buffer[j * bytes_per_row], &the_buffer_copy[j * bytes_per_row], bytes_per_row)) {
-			y2 = j;
-			break;
-		}
-	}
-	high = y2 - y1 + 1;
-
-	// Check for first column from left and first column from right that have changed
-	if (high) {
-		if ((int)VIDEO_MODE_DEPTH < VIDEO_DEPTH_8BIT) {
-			const int src_bytes_per_row = bytes_per_row;
-			const int dst_bytes_per_row = drv->s->pitch;
-			const int pixels_per_byte = VIDEO_MODE_X / src_bytes_per_row;
-
-			x1 = VIDEO_MODE_X / pixels_per_byte;
-			for (j = y1; j <= y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				for (i = 0; i < x1; i++) {
-					if (*p != *p2) {
-						x1 = i;
-						break;
-					}
-					p++; p2++;
-				}
-			}
-			x2 = x1;
-			for (j = y1; j <= y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				p += bytes_per_row;
-				p2 += bytes_per_row;
-				for (i = (VIDEO_MODE_X / pixels_per_byte); i > x2; i--) {
-					p--; p2--;
-					if (*p != *p2) {
-						x2 = i;
-						break;
-					}
-				}
-			}
-			x1 *= pixels_per_byte;
-			x2 *= pixels_per_byte;
-			wide = (x2 - x1 + pixels_per_byte - 1) & -pixels_per_byte;
-
-			// Update copy of the_buffer
-			if (high && wide) {
-
-				// Lock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_LockSurface(drv->s);
-
-				// Blit to screen surface
-				int si = y1 * src_bytes_per_row + (x1 / pixels_per_byte);
-				int di = y1 * dst_bytes_per_row + x1;
-				for (j = y1; j <= y2; j++) {
-					memcpy(the_buffer_copy + si, the_buffer + si, wide / pixels_per_byte);
-					Screen_blit((uint8 *)drv->s->pixels + di, the_buffer + si, wide / pixels_per_byte);
-					si += src_bytes_per_row;
-					di += dst_bytes_per_row;
-				}
-
-				// Unlock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_UnlockSurface(drv->s);
-
-				// Refresh display
-				SDL_UpdateRect(drv->s, x1, y1, wide, high);
-			}
-
-		} else {
-			const int bytes_per_pixel = VIDEO_MODE_ROW_BYTES / VIDEO_MODE_X;
-			const int dst_bytes_per_row = drv->s->pitch;
-
-			x1 = VIDEO_MODE_X;
-			for (j=y1; j<=y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				for (i=0; i<x1*bytes_per_pixel; i++) {
-					if (*p != *p2) {
-						x1 = i / bytes_per_pixel;
-						break;
-					}
-					p++; p2++;
-				}
-			}
-			x2 = x1;
-			for (j=y1; j<=y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				p += bytes_per_row;
-				p2 += bytes_per_row;
-				for (i=VIDEO_MODE_X*bytes_per_pixel; i>x2*bytes_per_pixel; i--) {
-					p--;
-					p2--;
-					if (*p != *p2) {
-						x2 = i / bytes_per_pixel;
-						break;
-					}
-				}
-			}
-			wide = x2 - x1;
-
-			// Update copy of the_buffer
-			if (high && wide) {
-
-				// Lock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_LockSurface(drv->s);
-
-				// Blit to screen surface
-				for (j=y1; j<=y2; j++) {
-					i = j * bytes_per_row + x1 * bytes_per_pixel;
-					int dst_i = j * dst_bytes_per_row + x1 * bytes_per_pixel;
-					memcpy(the_buffer_copy + i, the_buffer + i, bytes_per_pixel * wide);
-					Screen_blit((uint8 *)drv->s->pixels + dst_i, the_buffer + i, bytes_per_pixel * wide);
-				}
-
-				// Unlock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_UnlockSurface(drv->s);
-
-				// Refresh display
-				SDL_UpdateRect(drv->s, x1, y1, wide, high);
-			}
-		}
-	}
-}
-
-// Static display update (fixed frame rate, bounding boxes based)
-// XXX use NQD bounding boxes to help detect dirty areas?
-static void update_display_static_bbox(driver_base *drv)
 {
 	const VIDEO_MODE &mode = drv->mode;
 
-	// Allocate bounding boxes for SDL_UpdateRects()
-	const int N_PIXELS = 64;
-	const int n_x_boxes = (VIDEO_MODE_X + N_PIXELS - 1) / N_PIXELS;
-	const int n_y_boxes = (VIDEO_MODE_Y + N_PIXELS - 1) / N_PIXELS;
-	SDL_Rect *boxes = (SDL_Rect *)alloca(sizeof(SDL_Rect) * n_x_boxes * n_y_boxes);
-	int nr_boxes = 0;
+	// Find changed tiles, the_buffer_copy is updated with them
+	const int MAX_RECTS = 32;
+	ScreenDamageRect rects[MAX_RECTS];
+	const int mac_depth = mac_depth_of_video_depth(VIDEO_MODE_DEPTH);
+	const int n_rects = Screen_damage(the_buffer_copy, the_buffer, VIDEO_MODE_X, VIDEO_MODE_Y, VIDEO_MODE_ROW_BYTES, mac_depth, rects, MAX_RECTS);
+	if (n_rects == 0)
+		return;
 
 	// Lock surface, if required
 	if (SDL_MUSTLOCK(drv->s))
 		SDL_LockSurface(drv->s);
 
-	// Update the surface from Mac screen
-	const int bytes_per_row = VIDEO_MODE_ROW_BYTES;
-	const int bytes_per_pixel = bytes_per_row / VIDEO_MODE_X;
+	// Blit to screen surface
+	const int src_bytes_per_row = VIDEO_MODE_ROW_BYTES;
 	const int dst_bytes_per_row = drv->s->pitch;
-	int x, y;
-	for (y = 0; y < VIDEO_MODE_Y; y += N_PIXELS) {
-		int h = N_PIXELS;
-		if (h > VIDEO_MODE_Y - y)
-			h = VIDEO_MODE_Y - y;
-		for (x = 0; x < VIDEO_MODE_X; x += N_PIXELS) {
-			int w = N_PIXELS;
-			if (w > VIDEO_MODE_X - x)
-				w = VIDEO_MODE_X - x;
-			const int xs = w * bytes_per_pixel;
-			const int xb = x * bytes_per_pixel;
-			bool dirty = false;
-			for (int j = y; j < (y + h); j++) {
-				const int yb = j * bytes_per_row;
-				const int dst_yb = j * dst_bytes_per_row;
-				if (memcmp(&the_buffer[yb + xb], &the_buffer_copy[yb + xb], xs) != 0) {
-					memcpy(&the_buffer_copy[yb + xb], &the_buffer[yb + xb], xs);
-					Screen_blit((uint8 *)drv->s->pixels + dst_yb + xb, the_buffer + yb + xb, xs);
-					dirty = true;
-				}
-			}
-			if (dirty) {
-				boxes[nr_boxes].x = x;
-				boxes[nr_boxes].y = y;
-				boxes[nr_boxes].w = w;
-				boxes[nr_boxes].h = h;
-				nr_boxes++;
-			}
+	const int dst_bytes_per_pixel = bytes_per_pixel(sdl_depth_of_video_depth(VIDEO_MODE_DEPTH));
+	SDL_Rect boxes[MAX_RECTS];
+	for (int i = 0; i < n_rects; i++) {
+		const ScreenDamageRect & r = rects[i];
+		const int length = r.w * mac_depth / 8;
+		int si = r.y * src_bytes_per_row + r.x * mac_depth / 8;
+		int di = r.y * dst_bytes_per_row + r.x * dst_bytes_per_pixel;
+		for (int j = 0; j < r.h; j++) {
+			Screen_blit((uint8 *)drv->s->pixels + di, the_buffer_copy + si, length);
+			si += src_bytes_per_row;
+			di += dst_bytes_per_row;
 		}
+		boxes[i].x = r.x;
+		boxes[i].y = r.y;
+		boxes[i].w = r.w;
+		boxes[i].h = r.h;
 	}
 
 	// Unlock surface, if required
@@ -2141,8 +1990,7 @@ static void update_display_static_bbox(driver_base *drv)
 		SDL_UnlockSurface(drv->s);
 
 	// Refresh display
-	if (nr_boxes)
-		SDL_UpdateRects(drv->s, nr_boxes, boxes);
+	SDL_UpdateRects(drv->s, n_rects, boxes);
 }
 
 
@@ -2206,7 +2054,7 @@ static void video_refresh_dga_vosf(void)
 	static int tick_counter = 0;
 	if (++tick_counter >= frame_skip) {
 		tick_counter = 0;
-		if (mainBuffer.dirty) {
+		if (video_vosf_dirty()) {
 			LOCK_VOSF;
 			update_display_dga_vosf(static_cast<driver_fullscreen *>(drv));
 			UNLOCK_VOSF;
@@ -2224,7 +2072,7 @@ static void video_refresh_window_vosf(void)
 	static int tick_counter = 0;
 	if (++tick_counter >= frame_skip) {
 		tick_counter = 0;
-		if (mainBuffer.dirty) {
+		if (video_vosf_dirty()) {
 			LOCK_VOSF;
 			update_display_window_vosf(static_cast<driver_window *>(drv));
 			UNLOCK_VOSF;
@@ -2242,11 +2090,7 @@ static void video_refresh_window_static(void)
 	static int tick_counter = 0;
 	if (++tick_counter >= frame_skip) {
 		tick_counter = 0;
-		const VIDEO_MODE &mode = drv->mode;
-		if ((int)VIDEO_MODE_DEPTH >= VIDEO_DEPTH_8BIT)
-			update_display_static_bbox(drv);
-		else
-			update_display_static(drv);
+		update_display_static(drv);
 	}
 }
 
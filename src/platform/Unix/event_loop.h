@@ -0,0 +1,59 @@
+/*
+ *  event_loop.h - Host event loop (timers and file descriptors)
+ *
+ *  SheepShear, 2012 Alexander von Gluck
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+/*
+ *  All periodic host work (60Hz tick, Time Manager deadline, NVRAM
+ *  watchdog, display refresh) runs as callbacks of one event thread,
+ *  backed by epoll and timerfd on Linux and poll() elsewhere. Callbacks
+ *  run on that thread only and must not block for long.
+ */
+
+typedef void (*event_func)(void *arg);
+struct event_source;
+
+extern bool EventLoopInit(void);
+extern void EventLoopExit(void);
+
+// Create an unarmed timer, or a source firing while fd is readable
+extern event_source *EventLoopAddTimer(event_func func, void *arg);
+extern event_source *EventLoopAddFd(int fd, event_func func, void *arg);
+
+// Remove a source, waits for its callback to return unless called from it
+extern void EventLoopRemove(event_source *s);
+
+// Arm timer to fire every usec microseconds, from now on
+extern void EventLoopSetPeriod(event_source *s, uint32 usec);
+
+// Arm timer to fire every usec microseconds, first at the given GetTicks_usec() time
+extern void EventLoopSetPeriodAt(event_source *s, uint32 usec, uint64 first);
+
+// Arm timer to fire once at the given timer_current_time() based time
+extern void EventLoopSetDeadline(event_source *s, const tm_time_t &when);
+
+// Disarm timer
+extern void EventLoopCancel(event_source *s);
+
+// Return true if called from an event callback
+extern bool EventLoopCurrent(void);
+
+#endif /* EVENT_LOOP_H */
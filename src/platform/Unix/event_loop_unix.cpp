@@ -0,0 +1,516 @@
+/*
+ *  event_loop_unix.cpp - Host event loop, Unix implementation
+ *
+ *  SheepShear, 2012 Alexander von Gluck
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "prefs.h"
+#include "timer.h"
+#include "event_loop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+// Linux has epoll and timerfd, other systems use poll() and a pipe
+#if defined(__linux__) && defined(HAVE_CLOCK_GETTIME)
+#define USE_EPOLL 1
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#else
+#define USE_EPOLL 0
+#endif
+
+#define DEBUG 0
+#include "debug.h"
+
+
+// Event source
+struct event_source {
+	event_func func;		// Callback
+	void *arg;				// Callback argument
+	int fd;					// Watched descriptor (timerfd for Linux timers)
+	bool is_timer;
+#if !USE_EPOLL
+	uint64 next;			// Next expiry in GetTicks_usec() time, 0 = disarmed
+	uint32 period;			// Period in usec, 0 = one-shot
+#endif
+	event_source *next_source;
+};
+
+static pthread_t loop_thread;
+static bool loop_thread_active = false;
+static volatile bool loop_thread_cancel;
+static pthread_mutex_t loop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t loop_idle_cond = PTHREAD_COND_INITIALIZER;
+static event_source *sources = NULL;		// List of sources, guarded by loop_lock
+static event_source *running = NULL;		// Source whose callback is executing
+static int wake_fd[2] = { -1, -1 };			// Loop wakeup (eventfd on Linux, else pipe)
+#if USE_EPOLL
+static int epoll_fd = -1;
+#endif
+
+
+// Return true if called from the event thread itself
+static inline bool on_loop_thread(void)
+{
+	return loop_thread_active && pthread_equal(pthread_self(), loop_thread);
+}
+
+// Check that s is still a live source (loop_lock held)
+static bool source_alive(event_source *s)
+{
+	for (event_source *p = sources; p; p = p->next_source)
+		if (p == s)
+			return true;
+	return false;
+}
+
+// Run callback of source s (loop_lock held, dropped during the call)
+static void dispatch(event_source *s)
+{
+	running = s;
+	pthread_mutex_unlock(&loop_lock);
+	s->func(s->arg);
+	pthread_mutex_lock(&loop_lock);
+	running = NULL;
+	pthread_cond_broadcast(&loop_idle_cond);
+}
+
+// Kick event thread out of its wait
+static void wake_loop(void)
+{
+#if USE_EPOLL
+	uint64 one = 1;
+	write(wake_fd[1], &one, sizeof(one));
+#else
+	char c = 0;
+	write(wake_fd[1], &c, 1);
+#endif
+}
+
+static void drain_wake_fd(void)
+{
+	char buf[64];
+	while (read(wake_fd[0], buf, sizeof(buf)) > 0)
+		;
+}
+
+
+/*
+ *  Event thread
+ */
+
+#if USE_EPOLL
+static void *loop_func(void *arg)
+{
+	const int MAX_EVENTS = 16;
+	struct epoll_event events[MAX_EVENTS];
+
+	while (!loop_thread_cancel) {
+		int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		pthread_mutex_lock(&loop_lock);
+		for (int i = 0; i < n && !loop_thread_cancel; i++) {
+			event_source *s = (event_source *)events[i].data.ptr;
+			if (s == NULL) {
+				drain_wake_fd();
+				continue;
+			}
+			if (!source_alive(s))
+				continue;
+
+			// Consume expirations, nothing to read if the timer was re-armed meanwhile
+			if (s->is_timer) {
+				uint64 expirations;
+				if (read(s->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+					continue;
+			}
+			dispatch(s);
+		}
+		pthread_mutex_unlock(&loop_lock);
+	}
+	return NULL;
+}
+#else
+static void *loop_func(void *arg)
+{
+	std::vector<struct pollfd> pfds;
+	std::vector<event_source *> psrc;
+
+	pthread_mutex_lock(&loop_lock);
+	while (!loop_thread_cancel) {
+
+		// Collect descriptors and the nearest timer expiry
+		pfds.clear();
+		psrc.clear();
+		struct pollfd wake = { wake_fd[0], POLLIN, 0 };
+		pfds.push_back(wake);
+		psrc.push_back(NULL);
+		uint64 next = 0;
+		for (event_source *s = sources; s; s = s->next_source) {
+			if (s->is_timer) {
+				if (s->next && (next == 0 || s->next < next))
+					next = s->next;
+			} else {
+				struct pollfd p = { s->fd, POLLIN, 0 };
+				pfds.push_back(p);
+				psrc.push_back(s);
+			}
+		}
+		int timeout = -1;
+		if (next) {
+			uint64 now = GetTicks_usec();
+			timeout = next > now ? (int)((next - now + 999) / 1000) : 0;
+		}
+		pthread_mutex_unlock(&loop_lock);
+
+		int n = poll(&pfds[0], pfds.size(), timeout);
+
+		pthread_mutex_lock(&loop_lock);
+		if (n < 0 && errno != EINTR)
+			break;
+		if (n > 0 && (pfds[0].revents & POLLIN))
+			drain_wake_fd();
+
+		// Run readable descriptors
+		for (size_t i = 1; n > 0 && i < pfds.size() && !loop_thread_cancel; i++)
+			if ((pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) && source_alive(psrc[i]))
+				dispatch(psrc[i]);
+
+		// Run expired timers, rescanning as callbacks may change the list
+		uint64 now = GetTicks_usec();
+		bool again;
+		do {
+			again = false;
+			for (event_source *s = sources; s && !loop_thread_cancel; s = s->next_source) {
+				if (s->is_timer && s->next && s->next <= now) {
+					if (s->period) {
+						s->next += s->period;
+						if (s->next <= now)		// Lagging behind, skip missed periods in phase
+							s->next += ((now - s->next) / s->period + 1) * s->period;
+					} else
+						s->next = 0;
+					dispatch(s);
+					again = true;
+					break;
+				}
+			}
+		} while (again);
+	}
+	pthread_mutex_unlock(&loop_lock);
+	return NULL;
+}
+
+// Convert timer_current_time() based time to GetTicks_usec() time
+static uint64 tm_time_usec(const tm_time_t &t)
+{
+#if defined(HAVE_CLOCK_GETTIME) || defined(__MACH__)
+	return (uint64)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+#else
+	return (uint64)t.tv_sec * 1000000 + t.tv_usec;
+#endif
+}
+#endif
+
+
+/*
+ *  Pin event thread to host CPU
+ */
+
+static void pin_loop_thread(int cpu)
+{
+	if (cpu < 0)
+		return;
+#if USE_EPOLL
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	int err = pthread_setaffinity_np(loop_thread, sizeof(set), &set);
+	if (err != 0) {
+		fprintf(stderr, "WARNING: Cannot pin event loop to CPU %d (%s)\n", cpu, strerror(err));
+		return;
+	}
+	D(bug("Event loop pinned to CPU %d\n", cpu));
+#else
+	fprintf(stderr, "WARNING: Pinning the event loop is not supported on this system\n");
+#endif
+}
+
+
+/*
+ *  Initialization
+ */
+
+bool EventLoopInit(void)
+{
+#if USE_EPOLL
+	epoll_fd = epoll_create(16);
+	if (epoll_fd < 0)
+		return false;
+	wake_fd[0] = wake_fd[1] = eventfd(0, EFD_NONBLOCK);
+	if (wake_fd[0] < 0)
+		return false;
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd[0], &ev) < 0)
+		return false;
+#else
+	if (pipe(wake_fd) < 0)
+		return false;
+	fcntl(wake_fd[0], F_SETFL, O_NONBLOCK);
+	fcntl(wake_fd[1], F_SETFL, O_NONBLOCK);
+#endif
+
+	loop_thread_cancel = false;
+	if (pthread_create(&loop_thread, NULL, loop_func, NULL) != 0)
+		return false;
+	loop_thread_active = true;
+	D(bug("Event loop thread installed (%ld)\n", loop_thread));
+
+	pin_loop_thread(PrefsFindInt32("eventcpu"));
+	return true;
+}
+
+
+/*
+ *  Deinitialization
+ */
+
+void EventLoopExit(void)
+{
+	if (loop_thread_active) {
+		loop_thread_cancel = true;
+		wake_loop();
+		pthread_join(loop_thread, NULL);
+		loop_thread_active = false;
+	}
+
+	while (sources)
+		EventLoopRemove(sources);
+
+#if USE_EPOLL
+	if (epoll_fd >= 0) {
+		close(epoll_fd);
+		epoll_fd = -1;
+	}
+	if (wake_fd[0] >= 0)
+		close(wake_fd[0]);
+#else
+	if (wake_fd[0] >= 0) {
+		close(wake_fd[0]);
+		close(wake_fd[1]);
+	}
+#endif
+	wake_fd[0] = wake_fd[1] = -1;
+}
+
+
+/*
+ *  Add event sources
+ */
+
+static event_source *add_source(event_source *s)
+{
+#if USE_EPOLL
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = s;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->fd, &ev) < 0) {
+		if (s->is_timer)
+			close(s->fd);
+		delete s;
+		return NULL;
+	}
+#endif
+	pthread_mutex_lock(&loop_lock);
+	s->next_source = sources;
+	sources = s;
+	pthread_mutex_unlock(&loop_lock);
+#if !USE_EPOLL
+	wake_loop();
+#endif
+	return s;
+}
+
+event_source *EventLoopAddTimer(event_func func, void *arg)
+{
+	event_source *s = new event_source;
+	s->func = func;
+	s->arg = arg;
+	s->is_timer = true;
+#if USE_EPOLL
+	s->fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK);
+	if (s->fd < 0) {
+		delete s;
+		return NULL;
+	}
+#else
+	s->fd = -1;
+	s->next = 0;
+	s->period = 0;
+#endif
+	return add_source(s);
+}
+
+event_source *EventLoopAddFd(int fd, event_func func, void *arg)
+{
+	event_source *s = new event_source;
+	s->func = func;
+	s->arg = arg;
+	s->is_timer = false;
+	s->fd = fd;
+#if !USE_EPOLL
+	s->next = 0;
+	s->period = 0;
+#endif
+	return add_source(s);
+}
+
+
+/*
+ *  Remove event source
+ */
+
+void EventLoopRemove(event_source *s)
+{
+	if (s == NULL)
+		return;
+
+	pthread_mutex_lock(&loop_lock);
+	for (event_source **p = &sources; *p; p = &(*p)->next_source) {
+		if (*p == s) {
+			*p = s->next_source;
+			break;
+		}
+	}
+#if USE_EPOLL
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+#endif
+	if (!on_loop_thread()) {
+		while (running == s)
+			pthread_cond_wait(&loop_idle_cond, &loop_lock);
+	}
+	pthread_mutex_unlock(&loop_lock);
+
+#if USE_EPOLL
+	if (s->is_timer)
+		close(s->fd);
+#else
+	wake_loop();
+#endif
+	delete s;
+}
+
+
+/*
+ *  Arm and disarm timers
+ */
+
+void EventLoopSetPeriod(event_source *s, uint32 usec)
+{
+#if USE_EPOLL
+	struct itimerspec its;
+	its.it_value.tv_sec = its.it_interval.tv_sec = usec / 1000000;
+	its.it_value.tv_nsec = its.it_interval.tv_nsec = (usec % 1000000) * 1000;
+	timerfd_settime(s->fd, 0, &its, NULL);
+#else
+	pthread_mutex_lock(&loop_lock);
+	s->period = usec;
+	s->next = usec ? GetTicks_usec() + usec : 0;
+	pthread_mutex_unlock(&loop_lock);
+	if (!on_loop_thread())
+		wake_loop();
+#endif
+}
+
+void EventLoopSetPeriodAt(event_source *s, uint32 usec, uint64 first)
+{
+#if USE_EPOLL
+	struct itimerspec its;
+	its.it_interval.tv_sec = usec / 1000000;
+	its.it_interval.tv_nsec = (usec % 1000000) * 1000;
+	its.it_value.tv_sec = first / 1000000;
+	its.it_value.tv_nsec = (first % 1000000) * 1000;
+	timerfd_settime(s->fd, TFD_TIMER_ABSTIME, &its, NULL);
+#else
+	pthread_mutex_lock(&loop_lock);
+	s->period = usec;
+	s->next = first;
+	pthread_mutex_unlock(&loop_lock);
+	if (!on_loop_thread())
+		wake_loop();
+#endif
+}
+
+void EventLoopSetDeadline(event_source *s, const tm_time_t &when)
+{
+#if USE_EPOLL
+	struct itimerspec its;
+	memset(&its.it_interval, 0, sizeof(its.it_interval));
+	its.it_value = when;
+	if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+		its.it_value.tv_nsec = 1;		// Zero would disarm the timer
+	timerfd_settime(s->fd, TFD_TIMER_ABSTIME, &its, NULL);
+#else
+	pthread_mutex_lock(&loop_lock);
+	s->period = 0;
+	s->next = tm_time_usec(when);
+	if (s->next == 0)
+		s->next = 1;
+	pthread_mutex_unlock(&loop_lock);
+	if (!on_loop_thread())
+		wake_loop();
+#endif
+}
+
+void EventLoopCancel(event_source *s)
+{
+#if USE_EPOLL
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	timerfd_settime(s->fd, 0, &its, NULL);
+#else
+	pthread_mutex_lock(&loop_lock);
+	s->next = 0;
+	s->period = 0;
+	pthread_mutex_unlock(&loop_lock);
+#endif
+}
+
+
+/*
+ *  Check for event thread
+ */
+
+bool EventLoopCurrent(void)
+{
+	return on_loop_thread();
+}
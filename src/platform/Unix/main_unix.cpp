@@ -114,6 +114,7 @@
 #include "sigsegv.h"
 #include "sigregs.h"
 #include "rpc.h"
+#include "event_loop.h"
 
 #define DEBUG 1
 #include "debug.h"
@@ -127,7 +128,7 @@
 #include <SDL.h>
 #endif
 
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 #include <X11/Xlib.h>
 #endif
 
@@ -192,12 +193,8 @@ int64 TimebaseSpeed;	// Timebase clock speed (Hz)
 uint8 *RAMBaseHost;		// Base address of Mac RAM (host address space)
 uint8 *ROMBaseHost;		// Base address of Mac ROM (host address space)
 
-// Global spinlocks
-SpinLock* gAtomicLock;		// Atomic function spinlocks
-SpinLock* gIdleLock;		// Timer idle spinlock
-
 // Global variables
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 char *x_display_name = NULL;				// X11 display name
 Display *x_display = NULL;					// X11 display handle
 #endif
@@ -214,12 +211,18 @@ static EmulatorData *emulator_data;
 
 static uint8 last_xpram[XPRAM_SIZE];		// Buffer for monitoring XPRAM changes
 
-static bool nvram_thread_active = false;	// Flag: NVRAM watchdog installed
-static volatile bool nvram_thread_cancel;	// Flag: Cancel NVRAM thread
-static pthread_t nvram_thread;				// NVRAM watchdog
-static bool tick_thread_active = false;		// Flag: MacOS thread installed
-static volatile bool tick_thread_cancel;	// Flag: Cancel 60Hz thread
-static pthread_t tick_thread;				// 60Hz thread
+static bool event_loop_active = false;		// Flag: Host event loop running
+static event_source *nvram_timer = NULL;	// NVRAM watchdog
+static const uint32 TICK_USEC = 16625;		// 60Hz tick period
+static const uint32 TICK_IDLE_USEC = 60 * TICK_USEC;	// Tick period while MacOS idles
+static event_source *tick_timer = NULL;		// 60Hz tick
+static bool tickless_idle = false;			// Flag: Stop 60Hz tick while MacOS idles
+static pthread_mutex_t tick_lock = PTHREAD_MUTEX_INITIALIZER;	// Guards tick idle state
+static bool tick_idle = false;				// Flag: MacOS sleeps in idle_wait()
+static bool tick_slow = false;				// Flag: Tick period stretched to TICK_IDLE_USEC
+static uint64 tick_idle_start;				// Time MacOS went to sleep
+static uint64 tick_base;					// Tick phase, ticks fire TICK_USEC apart from it
+static uint64 tick_last;					// Time of the last tick accounted in Ticks
 static pthread_t emul_thread;				// MacOS thread
 
 static bool ready_for_signals = false;		// Handler installed, signals can be sent
@@ -252,8 +255,8 @@ static bool kernel_data_init(void);
 static bool shm_map_address(int kernel_area, uint32 addr);
 static void Quit(void);
 static void *emul_func(void *arg);
-static void *nvram_func(void *arg);
-static void *tick_func(void *arg);
+static void nvram_func(void *arg);
+static void tick_func(void *arg);
 #if defined(__powerpc__) /* Native PowerPC */
 extern "C" void sigusr2_handler_init(int sig, siginfo_t *sip, void *scp);
 extern "C" void sigusr2_handler(int sig, siginfo_t *sip, void *scp);
@@ -300,29 +303,17 @@ uintptr SignalStackBase(void)
  */
 int atomic_add(int *var, int v)
 {
-	gAtomicLock->Lock();
-	int ret = *var;
-	*var += v;
-	gAtomicLock->Unlock();
-	return ret;
+	return atomic_fetch_add(var, v);
 }
 
 int atomic_and(int *var, int v)
 {
-	gAtomicLock->Lock();
-	int ret = *var;
-	*var &= v;
-	gAtomicLock->Unlock();
-	return ret;
+	return atomic_clear_mask(var, ~v);
 }
 
 int atomic_or(int *var, int v)
 {
-	gAtomicLock->Lock();
-	int ret = *var;
-	*var |= v;
-	gAtomicLock->Unlock();
-	return ret;
+	return atomic_set_mask(var, v);
 }
 
 
@@ -347,25 +338,6 @@ static inline int vm_mac_release(uint32 addr, uint32 size)
 }
 
 
-/*
- * Init global spinlocks
- */
-static void
-create_spinlocks()
-{
-	gAtomicLock = new SpinLock;
-	gIdleLock = new SpinLock;
-}
-
-
-static void
-destroy_spinlocks()
-{
-	delete gAtomicLock;
-	delete gIdleLock;
-}
-
-
 /*
  *  Main program
  */
@@ -748,7 +720,7 @@ int main(int argc, char **argv)
 	for (int i=1; i<argc; i++) {
 		if (strcmp(argv[i], "--help") == 0) {
 			usage(argv[0]);
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 		} else if (strcmp(argv[i], "--display") == 0) {
 			i++;
 			if (i < argc)
@@ -802,9 +774,6 @@ int main(int argc, char **argv)
 	}
 #endif
 
-	// Create global spinlocks
-	create_spinlocks();
-
 	// Read preferences
 	PrefsInit(vmdir, argc, argv);
 
@@ -822,7 +791,7 @@ int main(int argc, char **argv)
 		goto quit;
 #endif
 
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 	// Open display
 	x_display = XOpenDisplay(x_display_name);
 	if (x_display == NULL) {
@@ -984,6 +953,14 @@ int main(int argc, char **argv)
 	if (!load_mac_rom())
 		goto quit;
 
+	// Start host event loop, the Time Manager and video need it
+	if (!EventLoopInit()) {
+		sprintf(str, GetString(STR_EVENT_LOOP_ERR), strerror(errno));
+		ErrorAlert(str);
+		goto quit;
+	}
+	event_loop_active = true;
+
 	// Initialize everything
 	if (!InitAll(vmdir))
 		goto quit;
@@ -995,16 +972,19 @@ int main(int argc, char **argv)
 #endif
 	vm_protect(ROMBaseHost, ROM_AREA_SIZE, VM_PAGE_READ | VM_PAGE_EXECUTE);
 
-	// Start 60Hz thread
-	tick_thread_cancel = false;
-	tick_thread_active = (pthread_create(&tick_thread, NULL, tick_func, NULL) == 0);
-	D(bug("Tick thread installed (%ld)\n", tick_thread));
+	// Start 60Hz tick
+	tickless_idle = PrefsFindBool("tickless");
+	tick_timer = EventLoopAddTimer(tick_func, NULL);
+	if (tick_timer) {
+		tick_base = tick_last = GetTicks_usec();
+		EventLoopSetPeriodAt(tick_timer, TICK_USEC, tick_base + TICK_USEC);
+	}
 
-	// Start NVRAM watchdog thread
+	// Start NVRAM watchdog
 	memcpy(last_xpram, XPRAM, XPRAM_SIZE);
-	nvram_thread_cancel = false;
-	nvram_thread_active = (pthread_create(&nvram_thread, NULL, nvram_func, NULL) == 0);
-	D(bug("NVRAM thread installed (%ld)\n", nvram_thread));
+	nvram_timer = EventLoopAddTimer(nvram_func, NULL);
+	if (nvram_timer)
+		EventLoopSetPeriod(nvram_timer, 60000000);
 
 #if defined(__powerpc__) /* Native PowerPC */
 	// Install SIGILL handler
@@ -1058,19 +1038,13 @@ static void Quit(void)
 	exit_emul_ppc();
 #endif
 
-	// Stop 60Hz thread
-	if (tick_thread_active) {
-		tick_thread_cancel = true;
-		pthread_cancel(tick_thread);
-		pthread_join(tick_thread, NULL);
-	}
+	// Stop 60Hz tick
+	EventLoopRemove(tick_timer);
+	tick_timer = NULL;
 
-	// Stop NVRAM watchdog thread
-	if (nvram_thread_active) {
-		nvram_thread_cancel = true;
-		pthread_cancel(nvram_thread);
-		pthread_join(nvram_thread, NULL);
-	}
+	// Stop NVRAM watchdog
+	EventLoopRemove(nvram_timer);
+	nvram_timer = NULL;
 
 #if defined(__powerpc__) /* Native PowerPC */
 	// Uninstall SIGSEGV and SIGBUS handlers
@@ -1096,6 +1070,10 @@ static void Quit(void)
 	// Deinitialize everything
 	ExitAll();
 
+	// Stop host event loop
+	if (event_loop_active)
+		EventLoopExit();
+
 	// Delete SheepShaver globals
 	SheepMem::Exit();
 
@@ -1121,9 +1099,6 @@ static void Quit(void)
 	if (zero_fd > 0)
 		close(zero_fd);
 
-	// Delete global spinlocks
-	destroy_spinlocks();
-
 	// Exit system routines
 	SysExit();
 
@@ -1136,7 +1111,7 @@ static void Quit(void)
 #endif
 
 	// Close X11 server connection
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 	if (x_display)
 		XCloseDisplay(x_display);
 #endif
@@ -1308,7 +1283,7 @@ void MakeExecutable(int dummy, uint32 start, uint32 length)
 
 
 /*
- *  NVRAM watchdog thread (saves NVRAM every minute)
+ *  NVRAM watchdog (saves NVRAM every minute)
  */
 static void nvram_watchdog(void)
 {
@@ -1319,98 +1294,150 @@ static void nvram_watchdog(void)
 }
 
 
-static void *nvram_func(void *arg)
+static void nvram_func(void *arg)
 {
-	while (!nvram_thread_cancel) {
-		for (int i=0; i<60 && !nvram_thread_cancel; i++)
-			Delay_usec(999999);		// Only wait 1 second so we quit promptly when nvram_thread_cancel becomes true
-		nvram_watchdog();
-	}
-	return NULL;
+	nvram_watchdog();
 }
 
 
 /*
- *  60Hz thread (really 60.15Hz)
+ *  60Hz tick (really 60.15Hz), missed ticks are coalesced by the event loop
  */
-static void *tick_func(void *arg)
+
+// Return time of the last tick boundary at or before t
+static inline uint64 tick_boundary(uint64 t)
+{
+	return t - (t - tick_base) % TICK_USEC;
+}
+
+static void tick_func(void *arg)
 {
-	int tick_counter = 0;
-	uint64 start = GetTicks_usec();
-	int64 ticks = 0;
-	uint64 next = GetTicks_usec();
-
-	while (!tick_thread_cancel) {
-
-		// Wait
-		next += 16625;
-		int64 delay = next - GetTicks_usec();
-		if (delay > 0)
-			Delay_usec(delay);
-		else if (delay < -16625)
-			next = GetTicks_usec();
-		ticks++;
+	static int tick_counter = 0;
 
 #if defined(__powerpc__) /* Native PowerPC */
-		// Did we crash?
-		if (emul_thread_fatal) {
+	// Did we crash?
+	if (emul_thread_fatal) {
 
-			// Yes, dump registers
-			sigregs *r = &sigsegv_regs;
-			char str[256];
-			if (crash_reason == NULL)
-				crash_reason = "SIGSEGV";
-			sprintf(str, "%s\n"
-				"   pc %08lx     lr %08lx    ctr %08lx    msr %08lx\n"
-				"  xer %08lx     cr %08lx  \n"
-				"   r0 %08lx     r1 %08lx     r2 %08lx     r3 %08lx\n"
-				"   r4 %08lx     r5 %08lx     r6 %08lx     r7 %08lx\n"
-				"   r8 %08lx     r9 %08lx    r10 %08lx    r11 %08lx\n"
-				"  r12 %08lx    r13 %08lx    r14 %08lx    r15 %08lx\n"
-				"  r16 %08lx    r17 %08lx    r18 %08lx    r19 %08lx\n"
-				"  r20 %08lx    r21 %08lx    r22 %08lx    r23 %08lx\n"
-				"  r24 %08lx    r25 %08lx    r26 %08lx    r27 %08lx\n"
-				"  r28 %08lx    r29 %08lx    r30 %08lx    r31 %08lx\n",
-				crash_reason,
-				r->nip, r->link, r->ctr, r->msr,
-				r->xer, r->ccr,
-				r->gpr[0], r->gpr[1], r->gpr[2], r->gpr[3],
-				r->gpr[4], r->gpr[5], r->gpr[6], r->gpr[7],
-				r->gpr[8], r->gpr[9], r->gpr[10], r->gpr[11],
-				r->gpr[12], r->gpr[13], r->gpr[14], r->gpr[15],
-				r->gpr[16], r->gpr[17], r->gpr[18], r->gpr[19],
-				r->gpr[20], r->gpr[21], r->gpr[22], r->gpr[23],
-				r->gpr[24], r->gpr[25], r->gpr[26], r->gpr[27],
-				r->gpr[28], r->gpr[29], r->gpr[30], r->gpr[31]);
-			printf(str);
-			gMacVideo->DeviceQuitFullScreen();
+		// Yes, dump registers
+		sigregs *r = &sigsegv_regs;
+		char str[256];
+		if (crash_reason == NULL)
+			crash_reason = "SIGSEGV";
+		sprintf(str, "%s\n"
+			"   pc %08lx     lr %08lx    ctr %08lx    msr %08lx\n"
+			"  xer %08lx     cr %08lx  \n"
+			"   r0 %08lx     r1 %08lx     r2 %08lx     r3 %08lx\n"
+			"   r4 %08lx     r5 %08lx     r6 %08lx     r7 %08lx\n"
+			"   r8 %08lx     r9 %08lx    r10 %08lx    r11 %08lx\n"
+			"  r12 %08lx    r13 %08lx    r14 %08lx    r15 %08lx\n"
+			"  r16 %08lx    r17 %08lx    r18 %08lx    r19 %08lx\n"
+			"  r20 %08lx    r21 %08lx    r22 %08lx    r23 %08lx\n"
+			"  r24 %08lx    r25 %08lx    r26 %08lx    r27 %08lx\n"
+			"  r28 %08lx    r29 %08lx    r30 %08lx    r31 %08lx\n",
+			crash_reason,
+			r->nip, r->link, r->ctr, r->msr,
+			r->xer, r->ccr,
+			r->gpr[0], r->gpr[1], r->gpr[2], r->gpr[3],
+			r->gpr[4], r->gpr[5], r->gpr[6], r->gpr[7],
+			r->gpr[8], r->gpr[9], r->gpr[10], r->gpr[11],
+			r->gpr[12], r->gpr[13], r->gpr[14], r->gpr[15],
+			r->gpr[16], r->gpr[17], r->gpr[18], r->gpr[19],
+			r->gpr[20], r->gpr[21], r->gpr[22], r->gpr[23],
+			r->gpr[24], r->gpr[25], r->gpr[26], r->gpr[27],
+			r->gpr[28], r->gpr[29], r->gpr[30], r->gpr[31]);
+		printf(str);
+		gMacVideo->DeviceQuitFullScreen();
 
 #ifdef ENABLE_MON
-			// Start up mon in real-mode
-			printf("Welcome to the sheep factory.\n");
-			char *arg[4] = {"mon", "-m", "-r", NULL};
-			mon(3, arg);
+		// Start up mon in real-mode
+		printf("Welcome to the sheep factory.\n");
+		char *arg[4] = {"mon", "-m", "-r", NULL};
+		mon(3, arg);
 #endif
-			return NULL;
-		}
+		EventLoopCancel(tick_timer);
+		return;
+	}
 #endif
 
-		// Pseudo Mac 1Hz interrupt, update local time
-		if (++tick_counter > 60) {
-			tick_counter = 0;
-			WriteMacInt32(0x20c, TimerDateTime());
+	// Don't wake MacOS up from idle_wait(), tick_idle_leave() catches up.
+	// After one tick of sleep, only wake it up once a second
+	pthread_mutex_lock(&tick_lock);
+	if (tick_idle) {
+		if (!tick_slow) {
+			uint64 now = GetTicks_usec();
+			if (now - tick_idle_start > TICK_USEC) {
+				tick_slow = true;
+				EventLoopSetPeriodAt(tick_timer, TICK_IDLE_USEC, tick_boundary(now) + TICK_IDLE_USEC);
+			}
+			pthread_mutex_unlock(&tick_lock);
+			return;
 		}
-
-		// Trigger 60Hz interrupt
-		if (ReadMacInt32(XLM_IRQ_NEST) == 0) {
-			SetInterruptFlag(INTFLAG_VIA);
-			TriggerInterrupt();
+	} else {
+		// Skip a tick tick_idle_leave() already accounted for
+		uint64 tick = tick_boundary(GetTicks_usec());
+		if (tick == tick_last) {
+			pthread_mutex_unlock(&tick_lock);
+			return;
 		}
+		tick_last = tick;
 	}
+	pthread_mutex_unlock(&tick_lock);
 
-	uint64 end = GetTicks_usec();
-	D(bug("%lld ticks in %lld usec = %f ticks/sec\n", ticks, end - start, ticks * 1000000.0 / (end - start)));
-	return NULL;
+	// Pseudo Mac 1Hz interrupt, update local time
+	if (++tick_counter > 60) {
+		tick_counter = 0;
+		WriteMacInt32(0x20c, TimerDateTime());
+	}
+
+	// Trigger 60Hz interrupt
+	if (ReadMacInt32(XLM_IRQ_NEST) == 0) {
+		SetInterruptFlag(INTFLAG_VIA);
+		TriggerInterrupt();
+	}
+}
+
+
+/*
+ *  Tickless idle, called by idle_wait() from the emulator thread: while
+ *  it sleeps, VBL interrupts don't wake it, and past one tick of sleep
+ *  the tick timer only fires once a second. Time Manager deadlines and
+ *  device events still wake it through their own event sources. On
+ *  wakeup, the tick goes back to 60Hz in phase, and Ticks and the clock
+ *  catch up.
+ */
+void tick_idle_enter(void)
+{
+	if (!tickless_idle || tick_timer == NULL)
+		return;
+	pthread_mutex_lock(&tick_lock);
+	tick_idle = true;
+	tick_idle_start = GetTicks_usec();
+	pthread_mutex_unlock(&tick_lock);
+}
+
+void tick_idle_leave(void)
+{
+	if (!tick_idle)
+		return;
+	pthread_mutex_lock(&tick_lock);
+	tick_idle = false;
+	uint64 tick = tick_boundary(GetTicks_usec());
+	if (tick_slow) {
+		tick_slow = false;
+		EventLoopSetPeriodAt(tick_timer, TICK_USEC, tick + TICK_USEC);
+	}
+
+	// Account for the VBL interrupts skipped since the last one MacOS
+	// saw, a pending one counts itself
+	uint32 missed = (tick - tick_last) / TICK_USEC;
+	tick_last = tick;
+	pthread_mutex_unlock(&tick_lock);
+	if (missed && (InterruptFlags & INTFLAG_VIA))
+		missed--;
+	if (missed) {
+		WriteMacInt32(0x16a, ReadMacInt32(0x16a) + missed);	// Ticks
+		WriteMacInt32(0x20c, TimerDateTime());					// Time
+	}
 }
 
 
@@ -1545,7 +1572,9 @@ volatile uint32 InterruptFlags = 0;
 
 void SetInterruptFlag(uint32 flag)
 {
-	atomic_or((int *)&InterruptFlags, flag);
+	// Sources already pending need no further bus-locked update
+	if ((InterruptFlags & flag) != flag)
+		atomic_or((int *)&InterruptFlags, flag);
 }
 
 void ClearInterruptFlag(uint32 flag)
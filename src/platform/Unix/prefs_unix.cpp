@@ -41,6 +41,15 @@ prefs_desc platform_prefs_items[] = {
 	{"ignoresegv", TYPE_BOOLEAN, false,    "ignore illegal memory accesses"},
 #endif
 	{"idlewait", TYPE_BOOLEAN, false,      "sleep when idle"},
+	{"tickless", TYPE_BOOLEAN, false,      "stop 60Hz interrupts while sleeping when idle"},
+	{"eventcpu", TYPE_INT32, false,        "host CPU to pin the event loop thread to (-1 = any)"},
+	{"blitthreads", TYPE_INT32, false,     "number of threads converting the frame buffer (0 = auto)"},
+#ifdef USE_HEADLESS_VIDEO
+	{"shmname", TYPE_STRING, false,        "name of the shared memory object exporting the frame buffer"},
+#endif
+#ifdef __linux__
+	{"vosfwp", TYPE_BOOLEAN, false,        "let the kernel track frame buffer writes (userfaultfd) instead of SIGSEGV"},
+#endif
 	{NULL, TYPE_END, false, NULL} // End of list
 };
 
@@ -118,6 +127,15 @@ void AddPlatformPrefsDefaults(void)
 	PrefsReplaceString("extfs", "/");
 	PrefsReplaceInt32("mousewheelmode", 1);
 	PrefsReplaceInt32("mousewheellines", 3);
+	PrefsReplaceInt32("eventcpu", -1);
+	PrefsReplaceInt32("blitthreads", 0);
+#ifdef USE_HEADLESS_VIDEO
+	PrefsReplaceString("shmname", "/sheepshear");
+#endif
+	PrefsReplaceBool("tickless", true);
+#ifdef __linux__
+	PrefsReplaceBool("vosfwp", true);
+#endif
 #ifdef __linux__
 	if (access("/dev/sound/dsp", F_OK) == 0) {
 		PrefsReplaceString("dsp", "/dev/sound/dsp");
@@ -122,7 +122,9 @@
 #define PPC_CHECK_INTERRUPTS 1
 #define PPC_DECODE_CACHE 1
 #define PPC_FLIGHT_RECORDER 1
+#ifndef PPC_PROFILE_COMPILE_TIME
 #define PPC_PROFILE_COMPILE_TIME 0
+#endif
 #define PPC_PROFILE_GENERIC_CALLS 0
 #define PPC_PROFILE_REGS_USE 0
 #define PPC_ENABLE_FPU_EXCEPTIONS 0
@@ -247,13 +249,10 @@ typedef struct timeval tm_time_t;
 #define IBM_FLOAT_FORMAT 3
 #define C4X_FLOAT_FORMAT 4
 
-// High-precision timing
-#if defined(HAVE_PTHREADS) && defined(HAVE_CLOCK_NANOSLEEP)
-#define PRECISE_TIMING 1
-#define PRECISE_TIMING_POSIX 1
-#elif defined(HAVE_PTHREADS) && defined(__MACH__)
+// High-precision timing, Time Manager deadlines are host event loop timers
+#if defined(HAVE_PTHREADS)
 #define PRECISE_TIMING 1
-#define PRECISE_TIMING_MACH 1
+#define PRECISE_TIMING_EVENT 1
 #endif
 
 // Timing functions
@@ -0,0 +1,190 @@
+/*
+ *  bench-blit.cpp - Framebuffer blitter benchmarks
+ *
+ *  SheepShear, 2012 Alexander von Gluck
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  Runs every pixel format converter of video_blit.cpp, in its generic
+ *  version and in each vector variant the host CPU supports, over a
+ *  1024x768 frame and reports the throughput in MB/s of source pixels.
+ *  Vector variants are first checked against the generic version on
+ *  misaligned buffers and odd lengths.
+ *
+ *  Usage: bench-blit [--runs=N] [format...]
+ */
+
+#include <vector>
+#include <string.h>
+#include <sys/time.h>
+
+// Pull in the blitters, they are private to video_blit.cpp
+#include "video_blit.cpp"
+
+#ifndef VIDEO_BLIT_SIMD
+int main(void)
+{
+	printf("No vector blitters for this host\n");
+	return 0;
+}
+#else
+
+static const uint32 FRAME_SIZE = 1024 * 768 * 4;
+static const uint32 MAX_EXPANSION = 32;	// 1-bit to 32-bit pixels
+
+static double get_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Source depth, in bits per pixel, deduced from the function name
+static int source_depth(Screen_blit_simd_info const & b)
+{
+	if (strncmp(b.name, "Expand_", 7) == 0)
+		return b.name[7] - '0';
+	return 0;
+}
+
+// ExpandMap repeats every (1 << depth) entries, see video_set_palette()
+static void init_expand_map(int depth)
+{
+	const int n = (depth > 0 && depth < 8) ? (1 << depth) : 256;
+	for (int i = 0; i < 256; i++) {
+		int c = i & (n - 1);
+		ExpandMap[i] = 0x01000193 * (c + 1) ^ (c << 11);
+	}
+}
+
+static bool check_blitter(Screen_blit_func ref, Screen_blit_func func, const uint8 *src)
+{
+	static uint8 dst_ref[4096 * MAX_EXPANSION + 64];
+	static uint8 dst[4096 * MAX_EXPANSION + 64];
+	static const uint32 lengths[] = { 0, 1, 2, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 100, 1000, 4096 };
+	for (int ofs = 0; ofs < 4; ofs += 2) {
+		for (unsigned i = 0; i < sizeof(lengths)/sizeof(lengths[0]); i++) {
+			const uint32 len = lengths[i];
+			memset(dst_ref, 0x5a, sizeof(dst_ref));
+			memset(dst, 0x5a, sizeof(dst));
+			ref(dst_ref + 1 + ofs, src + ofs, len);
+			func(dst + 1 + ofs, src + ofs, len);
+			if (memcmp(dst_ref, dst, sizeof(dst)) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+static double bench_blitter(Screen_blit_func func, uint8 *dst, const uint8 *src, uint32 length, int runs)
+{
+	double best = 1e9;
+	for (int r = 0; r < runs; r++) {
+		double t0 = get_time();
+		for (int i = 0; i < 10; i++)
+			func(dst, src, length);
+		double t = (get_time() - t0) / 10;
+		if (t < best)
+			best = t;
+	}
+	return length / best / (1024.0 * 1024.0);
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [--runs=N] [FORMAT...]\n", prog);
+	printf("\nFormats:");
+	for (unsigned i = 0; i < sizeof(Screen_blitters_simd)/sizeof(Screen_blitters_simd[0]); i++)
+		printf(" %s", Screen_blitters_simd[i].name);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int runs = 5;
+	std::vector<const char *> formats;
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (strncmp(arg, "--runs=", 7) == 0)
+			runs = atoi(arg + 7);
+		else if (strcmp(arg, "--help") == 0) {
+			usage(argv[0]);
+			return 0;
+		}
+		else
+			formats.push_back(arg);
+	}
+	if (runs <= 0) {
+		fprintf(stderr, "ERROR: runs must be positive\n");
+		return 1;
+	}
+
+	uint8 *src = (uint8 *)malloc(FRAME_SIZE + 64);
+	uint8 *dst = (uint8 *)malloc(FRAME_SIZE * MAX_EXPANSION + 64);
+	if (src == NULL || dst == NULL) {
+		fprintf(stderr, "ERROR: could not allocate frame buffers\n");
+		return 1;
+	}
+	uint32 seed = 1;
+	for (uint32 i = 0; i < FRAME_SIZE + 64; i++) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = seed >> 16;
+	}
+	memset(dst, 0, FRAME_SIZE * MAX_EXPANSION + 64);
+
+	static const char * const tier_names[] = { "generic", "sse2", "ssse3", "avx2" };
+	const bool tier_ok[] = { true, cpuinfo_check_sse2(), cpuinfo_check_ssse3(), cpuinfo_check_avx2() };
+
+	printf("%-16s %-8s %10s %8s\n", "format", "variant", "MB/s", "speedup");
+	int errors = 0;
+	for (unsigned i = 0; i < sizeof(Screen_blitters_simd)/sizeof(Screen_blitters_simd[0]); i++) {
+		Screen_blit_simd_info const & b = Screen_blitters_simd[i];
+		if (!formats.empty()) {
+			bool found = false;
+			for (unsigned j = 0; j < formats.size(); j++)
+				if (strcmp(formats[j], b.name) == 0)
+					found = true;
+			if (!found)
+				continue;
+		}
+
+		// Expanders read fewer source bytes for the same number of pixels
+		const int depth = source_depth(b);
+		const uint32 length = depth ? FRAME_SIZE / 32 * depth : FRAME_SIZE;
+		init_expand_map(depth);
+
+		const Screen_blit_func funcs[] = { b.handler, b.handler_sse2, b.handler_ssse3, b.handler_avx2 };
+		double base = 0;
+		for (int t = 0; t < 4; t++) {
+			if (funcs[t] == NULL || !tier_ok[t])
+				continue;
+			bool ok = (t == 0) || check_blitter(b.handler, funcs[t], src);
+			double mbs = bench_blitter(funcs[t], dst, src, length, runs);
+			if (t == 0)
+				base = mbs;
+			printf("%-16s %-8s %10.1f %7.2fx  %s\n", b.name, tier_names[t], mbs, mbs / base, ok ? "ok" : "FAIL");
+			if (!ok)
+				errors++;
+		}
+	}
+
+	free(dst);
+	free(src);
+	return errors ? 1 : 0;
+}
+
+#endif
@@ -26,6 +26,11 @@
 
 #include <errno.h>
 #include <semaphore.h>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 
 #define DEBUG 0
@@ -331,27 +336,74 @@ void Delay_usec(uint32 usec)
 
 
 /*
- *  Suspend emulator thread, virtual CPU in idle mode
+ *  Idle state of the emulator thread, shared lock-free with the event
+ *  threads: the CPU thread parks on IDLE_SLEEPING and whoever posts an
+ *  event swaps in IDLE_WAKEUP, waking it only when it really sleeps
  */
-extern SpinLock* gIdleLock;
+enum {
+	IDLE_RUNNING = 0,	// Emulator thread executing
+	IDLE_SLEEPING,		// Emulator thread parked in idle_wait()
+	IDLE_WAKEUP			// Event posted, next idle_wait() returns at once
+};
+
+static volatile int idle_state = IDLE_RUNNING;
+
+// Tickless idle (main_unix.cpp)
+extern void tick_idle_enter(void);
+extern void tick_idle_leave(void);
+
+#if defined(__linux__)
+static inline void idle_block(void)
+{
+	while (idle_state == IDLE_SLEEPING)
+		syscall(SYS_futex, &idle_state, FUTEX_WAIT_PRIVATE, IDLE_SLEEPING, NULL, NULL, 0);
+}
+
+static inline void idle_unblock(void)
+{
+	syscall(SYS_futex, &idle_state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#else
 static sem_t idle_sem;
 static int idle_sem_ok = -1;
 
+static inline void idle_block(void)
+{
+	if (idle_sem_ok > 0) {
+		while (sem_wait(&idle_sem) < 0 && errno == EINTR)
+			;
+	} else {
+		// Fallback: sleep 10 ms
+		Delay_usec(10000);
+	}
+}
+
+static inline void idle_unblock(void)
+{
+	if (idle_sem_ok > 0)
+		sem_post(&idle_sem);
+}
+#endif
+
+
+/*
+ *  Suspend emulator thread, virtual CPU in idle mode
+ */
+
 void idle_wait(void)
 {
-	gIdleLock->Lock();
+#if !defined(__linux__)
 	if (idle_sem_ok < 0)
 		idle_sem_ok = (sem_init(&idle_sem, 0, 0) == 0);
-	if (idle_sem_ok > 0) {
-		idle_sem_ok++;
-		gIdleLock->Unlock();
-		sem_wait(&idle_sem);
-		return;
-	}
-	gIdleLock->Unlock();
+#endif
 
-	// Fallback: sleep 10 ms
-	Delay_usec(10000);
+	// An event posted since the last wait cancels the sleep
+	if (atomic_cmp_set(&idle_state, IDLE_RUNNING, IDLE_SLEEPING)) {
+		tick_idle_enter();
+		idle_block();
+		tick_idle_leave();
+	}
+	idle_state = IDLE_RUNNING;
 }
 
 
@@ -361,12 +413,9 @@ void idle_wait(void)
 
 void idle_resume(void)
 {
-	gIdleLock->Lock();
-	if (idle_sem_ok > 1) {
-		idle_sem_ok--;
-		gIdleLock->Unlock();
-		sem_post(&idle_sem);
+	// Coalesce with a wakeup that is still pending
+	if (idle_state == IDLE_WAKEUP)
 		return;
-	}
-	gIdleLock->Unlock();
+	if (atomic_swap(&idle_state, IDLE_WAKEUP) == IDLE_SLEEPING)
+		idle_unblock();
 }
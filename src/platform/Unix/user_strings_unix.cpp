@@ -82,6 +82,9 @@ user_string_def platform_strings[] = {
 	{STR_MOUSEWHEELLINES_CTRL, "Lines To Scroll"},
 	{STR_SUSPEND_WINDOW_TITLE, "SheepShear suspended. Press Space to reactivate."},
 	{STR_VOSF_INIT_ERR, "Cannot initialize Video on SEGV signals."},
+	{STR_EVENT_LOOP_ERR, "Cannot start host event loop (%s)."},
+	{STR_SHM_VIDEO_ERR, "Cannot create shared memory frame buffer %s (%s)."},
+	{STR_SHM_VIDEO_EXISTS_ERR, "Shared memory frame buffer %s already exists. Another SheepShear may be using it, choose a different name with the \"shmname\" option, or remove it if it was left over by a crash."},
 
 	{STR_OPEN_WINDOW_ERR, "Cannot open Mac window."},
 	{STR_WINDOW_TITLE_GRABBED, "SheepShear (mouse grabbed, press Ctrl-F5 to release)"},
@@ -40,6 +40,9 @@ enum {
 	STR_NO_XVISUAL_ERR,
 	STR_UNSUPP_DEPTH_ERR,
 	STR_VOSF_INIT_ERR,
+	STR_EVENT_LOOP_ERR,
+	STR_SHM_VIDEO_ERR,
+	STR_SHM_VIDEO_EXISTS_ERR,
 
 	STR_PROC_CPUINFO_WARN,
 	STR_BLOCKING_NET_SOCKET_WARN,
@@ -24,6 +24,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEBUG 0
+#include "debug.h"
 
 // Format of the target visual
 static VisualFormat visualFormat;
@@ -31,6 +36,40 @@ static VisualFormat visualFormat;
 // This holds the pixels values of the palette colors for 8->16/32-bit expansion
 uint32 ExpandMap[256];
 
+// Vector variants of the blitters are built for x86 hosts, with the
+// instruction set enabled per function and chosen at run-time
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define VIDEO_BLIT_SIMD 1
+#endif
+
+#ifdef VIDEO_BLIT_SIMD
+#include <immintrin.h>
+#include "utils/utils-cpuinfo.hpp"
+
+#define VIDEO_BLIT_TARGET(isa) __attribute__((target(isa)))
+
+// Vectors of 64-bit words, FB_BLIT_4() applies to them unchanged
+typedef uint64 fb_vec128 __attribute__((vector_size(16)));
+typedef uint64 fb_vec128_u __attribute__((vector_size(16), aligned(1), may_alias));
+typedef uint64 fb_vec256 __attribute__((vector_size(32)));
+typedef uint64 fb_vec256_u __attribute__((vector_size(32), aligned(1), may_alias));
+
+// pshufb control for a byte permutation repeated on each 32-bit word
+#define FB_SHUFFLE_ZERO 0x80
+#define FB_SHUFFLE_BYTE(i, a) ((char)((a) == FB_SHUFFLE_ZERO ? (a) : (i) + (a)))
+#define FB_SHUFFLE_WORD(i, a, b, c, d) \
+	FB_SHUFFLE_BYTE(i, a), FB_SHUFFLE_BYTE(i, b), FB_SHUFFLE_BYTE(i, c), FB_SHUFFLE_BYTE(i, d)
+#define FB_SHUFFLE_MASK_1(a, b, c, d) \
+	_mm_setr_epi8(FB_SHUFFLE_WORD(0, a, b, c, d), FB_SHUFFLE_WORD(4, a, b, c, d), \
+				  FB_SHUFFLE_WORD(8, a, b, c, d), FB_SHUFFLE_WORD(12, a, b, c, d))
+#define FB_SHUFFLE_MASK(pattern) FB_SHUFFLE_MASK_1(pattern)
+
+#define FB_CONCAT_1(a, b) a ## b
+#define FB_CONCAT(a, b) FB_CONCAT_1(a, b)
+#define FB_SIMD_NAME(suffix) FB_CONCAT(FB_FUNC_NAME, suffix)
+#endif
+
 // Mark video_blit.h for specialization
 #define DEFINE_VIDEO_BLITTERS 1
 
@@ -64,6 +103,10 @@ static void Blit_Copy_Raw(uint8 * dest, const uint8 * source, uint32 length)
 	(dst =	(((src) >> 8) & UVAL64(0x00ff00ff00ff00ff)) | \
 			(((src) & UVAL64(0x00ff00ff00ff00ff)) << 8))
 
+#ifndef WORDS_BIGENDIAN
+#define FB_BLIT_SHUFFLE 1, 0, 3, 2
+#endif
+
 #define	FB_DEPTH 15
 #include "video_blit.h"
 
@@ -243,6 +286,10 @@ static void Blit_Copy_Raw(uint8 * dest, const uint8 * source, uint32 length)
 			(((src) & UVAL64(0x0000ff000000ff00)) <<  8) | \
 			(((src) & UVAL64(0x000000ff000000ff)) << 24))
 
+#ifndef WORDS_BIGENDIAN
+#define FB_BLIT_SHUFFLE 3, 2, 1, 0
+#endif
+
 #define FB_DEPTH 24
 #include "video_blit.h"
 
@@ -298,6 +345,10 @@ static void Blit_Copy_Raw(uint8 * dest, const uint8 * source, uint32 length)
 #define FB_BLIT_4(dst, src) \
 	(dst = ((src) & UVAL64(0x00ff00ff00ff00ff)) | (((src) & UVAL64(0x0000ff000000ff00)) << 16))
 
+#ifndef WORDS_BIGENDIAN
+#define FB_BLIT_SHUFFLE 0, FB_SHUFFLE_ZERO, 2, 1
+#endif
+
 #define FB_DEPTH 24
 #include "video_blit.h"
 
@@ -441,6 +492,237 @@ static void Blit_Expand_8_To_32(uint8 * dest, const uint8 * p, uint32 length)
 		*q++ = ExpandMap[*p++];
 }
 
+/* -------------------------------------------------------------------------- */
+/* --- Vectorized 1/2/4/8-bit indexed mode expansion                      --- */
+/* -------------------------------------------------------------------------- */
+
+#ifdef VIDEO_BLIT_SIMD
+
+// Note: the pshufb lookups only read the first 16 ExpandMap entries and
+// rely on ExpandMap repeating every (1 << mac_depth) entries, as the
+// palette setup code makes sure of
+
+// Expand 2 bytes of 1-bit pixels into 16 bytes of 0x00/0xff
+static inline __m128i VIDEO_BLIT_TARGET("sse2") expand_1_bit(const uint8 * p)
+{
+	const __m128i bits = _mm_set1_epi64x(UVAL64(0x0102040810204080));
+	__m128i c = _mm_cvtsi32_si128(p[0] | (p[1] << 8));
+	c = _mm_unpacklo_epi8(c, c);
+	c = _mm_unpacklo_epi16(c, c);
+	c = _mm_unpacklo_epi32(c, c);
+	return _mm_cmpeq_epi8(_mm_and_si128(c, bits), bits);
+}
+
+// Split 16 bytes of 2-bit pixels into 64 pixel indices
+static inline void VIDEO_BLIT_TARGET("sse2") expand_2_bit(const uint8 * p, __m128i v[4])
+{
+	const __m128i mask = _mm_set1_epi8(3);
+	__m128i c = _mm_loadu_si128((const __m128i *)p);
+	__m128i p0 = _mm_and_si128(_mm_srli_epi16(c, 6), mask);
+	__m128i p1 = _mm_and_si128(_mm_srli_epi16(c, 4), mask);
+	__m128i p2 = _mm_and_si128(_mm_srli_epi16(c, 2), mask);
+	__m128i p3 = _mm_and_si128(c, mask);
+	__m128i lo01 = _mm_unpacklo_epi8(p0, p1), hi01 = _mm_unpackhi_epi8(p0, p1);
+	__m128i lo23 = _mm_unpacklo_epi8(p2, p3), hi23 = _mm_unpackhi_epi8(p2, p3);
+	v[0] = _mm_unpacklo_epi16(lo01, lo23);
+	v[1] = _mm_unpackhi_epi16(lo01, lo23);
+	v[2] = _mm_unpacklo_epi16(hi01, hi23);
+	v[3] = _mm_unpackhi_epi16(hi01, hi23);
+}
+
+// Split 16 bytes of 4-bit pixels into 32 pixel indices
+static inline void VIDEO_BLIT_TARGET("sse2") expand_4_bit(const uint8 * p, __m128i v[2])
+{
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	__m128i c = _mm_loadu_si128((const __m128i *)p);
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(c, 4), mask);
+	__m128i lo = _mm_and_si128(c, mask);
+	v[0] = _mm_unpacklo_epi8(hi, lo);
+	v[1] = _mm_unpackhi_epi8(hi, lo);
+}
+
+// Byte planes of the first 16 ExpandMap entries, for pshufb lookups
+static inline void VIDEO_BLIT_TARGET("ssse3") expand_map_planes(__m128i t[4])
+{
+	uint8 planes[4][16];
+	for (int i = 0; i < 16; i++) {
+		planes[0][i] = ExpandMap[i];
+		planes[1][i] = ExpandMap[i] >> 8;
+		planes[2][i] = ExpandMap[i] >> 16;
+		planes[3][i] = ExpandMap[i] >> 24;
+	}
+	for (int i = 0; i < 4; i++)
+		t[i] = _mm_loadu_si128((const __m128i *)planes[i]);
+}
+
+// Look up 16 pixel indices, write 16 16-bit pixels
+static inline void VIDEO_BLIT_TARGET("ssse3") lookup_16(uint8 * dest, __m128i idx, const __m128i t[4])
+{
+	__m128i b0 = _mm_shuffle_epi8(t[0], idx);
+	__m128i b1 = _mm_shuffle_epi8(t[1], idx);
+	_mm_storeu_si128((__m128i *)dest + 0, _mm_unpacklo_epi8(b0, b1));
+	_mm_storeu_si128((__m128i *)dest + 1, _mm_unpackhi_epi8(b0, b1));
+}
+
+// Look up 16 pixel indices, write 16 32-bit pixels
+static inline void VIDEO_BLIT_TARGET("ssse3") lookup_32(uint8 * dest, __m128i idx, const __m128i t[4])
+{
+	__m128i b0 = _mm_shuffle_epi8(t[0], idx);
+	__m128i b1 = _mm_shuffle_epi8(t[1], idx);
+	__m128i b2 = _mm_shuffle_epi8(t[2], idx);
+	__m128i b3 = _mm_shuffle_epi8(t[3], idx);
+	__m128i lo01 = _mm_unpacklo_epi8(b0, b1), hi01 = _mm_unpackhi_epi8(b0, b1);
+	__m128i lo23 = _mm_unpacklo_epi8(b2, b3), hi23 = _mm_unpackhi_epi8(b2, b3);
+	_mm_storeu_si128((__m128i *)dest + 0, _mm_unpacklo_epi16(lo01, lo23));
+	_mm_storeu_si128((__m128i *)dest + 1, _mm_unpackhi_epi16(lo01, lo23));
+	_mm_storeu_si128((__m128i *)dest + 2, _mm_unpacklo_epi16(hi01, hi23));
+	_mm_storeu_si128((__m128i *)dest + 3, _mm_unpackhi_epi16(hi01, hi23));
+}
+
+static void VIDEO_BLIT_TARGET("sse2") Blit_Expand_1_To_8_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m128i one = _mm_set1_epi8(1);
+	for (uint32 n = length / 2; n > 0; n--) {
+		__m128i m = expand_1_bit(p);
+		_mm_storeu_si128((__m128i *)dest, _mm_and_si128(m, one));
+		dest += 16; p += 2;
+	}
+	Blit_Expand_1_To_8(dest, p, length % 2);
+}
+
+static void VIDEO_BLIT_TARGET("sse2") Blit_Expand_2_To_8_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m128i v[4];
+		expand_2_bit(p, v);
+		for (int i = 0; i < 4; i++)
+			_mm_storeu_si128((__m128i *)dest + i, v[i]);
+		dest += 64; p += 16;
+	}
+	Blit_Expand_2_To_8(dest, p, length % 16);
+}
+
+static void VIDEO_BLIT_TARGET("sse2") Blit_Expand_4_To_8_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m128i v[2];
+		expand_4_bit(p, v);
+		_mm_storeu_si128((__m128i *)dest + 0, v[0]);
+		_mm_storeu_si128((__m128i *)dest + 1, v[1]);
+		dest += 32; p += 16;
+	}
+	Blit_Expand_4_To_8(dest, p, length % 16);
+}
+
+static void VIDEO_BLIT_TARGET("sse2") Blit_Expand_1_To_16_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	for (uint32 n = length / 2; n > 0; n--) {
+		__m128i m = expand_1_bit(p);
+		_mm_storeu_si128((__m128i *)dest + 0, _mm_unpacklo_epi8(m, m));
+		_mm_storeu_si128((__m128i *)dest + 1, _mm_unpackhi_epi8(m, m));
+		dest += 32; p += 2;
+	}
+	Blit_Expand_1_To_16(dest, p, length % 2);
+}
+
+static void VIDEO_BLIT_TARGET("ssse3") Blit_Expand_2_To_16_SSSE3(uint8 * dest, const uint8 * p, uint32 length)
+{
+	__m128i t[4];
+	expand_map_planes(t);
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m128i v[4];
+		expand_2_bit(p, v);
+		for (int i = 0; i < 4; i++)
+			lookup_16(dest + 32 * i, v[i], t);
+		dest += 128; p += 16;
+	}
+	Blit_Expand_2_To_16(dest, p, length % 16);
+}
+
+static void VIDEO_BLIT_TARGET("ssse3") Blit_Expand_4_To_16_SSSE3(uint8 * dest, const uint8 * p, uint32 length)
+{
+	__m128i t[4];
+	expand_map_planes(t);
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m128i v[2];
+		expand_4_bit(p, v);
+		lookup_16(dest, v[0], t);
+		lookup_16(dest + 32, v[1], t);
+		dest += 64; p += 16;
+	}
+	Blit_Expand_4_To_16(dest, p, length % 16);
+}
+
+static void VIDEO_BLIT_TARGET("sse2") Blit_Expand_1_To_32_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	for (uint32 n = length / 2; n > 0; n--) {
+		__m128i m = expand_1_bit(p);
+		__m128i lo = _mm_unpacklo_epi8(m, m), hi = _mm_unpackhi_epi8(m, m);
+		_mm_storeu_si128((__m128i *)dest + 0, _mm_unpacklo_epi16(lo, lo));
+		_mm_storeu_si128((__m128i *)dest + 1, _mm_unpackhi_epi16(lo, lo));
+		_mm_storeu_si128((__m128i *)dest + 2, _mm_unpacklo_epi16(hi, hi));
+		_mm_storeu_si128((__m128i *)dest + 3, _mm_unpackhi_epi16(hi, hi));
+		dest += 64; p += 2;
+	}
+	Blit_Expand_1_To_32(dest, p, length % 2);
+}
+
+static void VIDEO_BLIT_TARGET("ssse3") Blit_Expand_2_To_32_SSSE3(uint8 * dest, const uint8 * p, uint32 length)
+{
+	__m128i t[4];
+	expand_map_planes(t);
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m128i v[4];
+		expand_2_bit(p, v);
+		for (int i = 0; i < 4; i++)
+			lookup_32(dest + 64 * i, v[i], t);
+		dest += 256; p += 16;
+	}
+	Blit_Expand_2_To_32(dest, p, length % 16);
+}
+
+static void VIDEO_BLIT_TARGET("ssse3") Blit_Expand_4_To_32_SSSE3(uint8 * dest, const uint8 * p, uint32 length)
+{
+	__m128i t[4];
+	expand_map_planes(t);
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m128i v[2];
+		expand_4_bit(p, v);
+		lookup_32(dest, v[0], t);
+		lookup_32(dest + 64, v[1], t);
+		dest += 128; p += 16;
+	}
+	Blit_Expand_4_To_32(dest, p, length % 16);
+}
+
+// 8-bit pixels index the whole ExpandMap, use AVX2 gathers
+static void VIDEO_BLIT_TARGET("avx2") Blit_Expand_8_To_16_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m256i mask = _mm256_set1_epi32(0xffff);
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m256i i0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+		__m256i i1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p + 8)));
+		__m256i c0 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)ExpandMap, i0, 4), mask);
+		__m256i c1 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)ExpandMap, i1, 4), mask);
+		__m256i c = _mm256_permute4x64_epi64(_mm256_packus_epi32(c0, c1), 0xd8);
+		_mm256_storeu_si256((__m256i *)dest, c);
+		dest += 32; p += 16;
+	}
+	Blit_Expand_8_To_16(dest, p, length % 16);
+}
+
+static void VIDEO_BLIT_TARGET("avx2") Blit_Expand_8_To_32_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	for (uint32 n = length / 8; n > 0; n--) {
+		__m256i i0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+		_mm256_storeu_si256((__m256i *)dest, _mm256_i32gather_epi32((const int *)ExpandMap, i0, 4));
+		dest += 32; p += 8;
+	}
+	Blit_Expand_8_To_32(dest, p, length % 8);
+}
+
+#endif
+
 /* -------------------------------------------------------------------------- */
 /* --- Blitters to the host frame buffer, or XImage buffer                --- */
 /* -------------------------------------------------------------------------- */
@@ -488,6 +770,59 @@ static Screen_blit_func_info Screen_blitters[] = {
 	{ 32, 0xff00, 0xff0000, 0xff000000, Blit_Copy_Raw   , Blit_Copy_Raw     }   // OK
 };
 
+#ifdef VIDEO_BLIT_SIMD
+// Structure used to match the vector variants of a blit function
+struct Screen_blit_simd_info {
+	Screen_blit_func	handler;		// Generic function
+	Screen_blit_func	handler_sse2;	// SSE2 variant
+	Screen_blit_func	handler_ssse3;	// SSSE3 variant
+	Screen_blit_func	handler_avx2;	// AVX2 variant
+	const char *		name;
+};
+
+// Table of blit functions with vector variants
+static Screen_blit_simd_info Screen_blitters_simd[] = {
+	{ Blit_RGB555_NBO    , Blit_RGB555_NBO_SSE2    , Blit_RGB555_NBO_SSSE3    , Blit_RGB555_NBO_AVX2    , "RGB555_NBO" },
+	{ Blit_BGR555_NBO    , Blit_BGR555_NBO_SSE2    , NULL                     , Blit_BGR555_NBO_AVX2    , "BGR555_NBO" },
+	{ Blit_BGR555_OBO    , Blit_BGR555_OBO_SSE2    , NULL                     , Blit_BGR555_OBO_AVX2    , "BGR555_OBO" },
+	{ Blit_RGB565_NBO    , Blit_RGB565_NBO_SSE2    , NULL                     , Blit_RGB565_NBO_AVX2    , "RGB565_NBO" },
+	{ Blit_RGB565_OBO    , Blit_RGB565_OBO_SSE2    , NULL                     , Blit_RGB565_OBO_AVX2    , "RGB565_OBO" },
+	{ Blit_RGB888_NBO    , Blit_RGB888_NBO_SSE2    , Blit_RGB888_NBO_SSSE3    , Blit_RGB888_NBO_AVX2    , "RGB888_NBO" },
+	{ Blit_BGR888_NBO    , Blit_BGR888_NBO_SSE2    , Blit_BGR888_NBO_SSSE3    , Blit_BGR888_NBO_AVX2    , "BGR888_NBO" },
+	{ Blit_BGR888_OBO    , Blit_BGR888_OBO_SSE2    , NULL                     , Blit_BGR888_OBO_AVX2    , "BGR888_OBO" },
+	{ Blit_Expand_1_To_8 , Blit_Expand_1_To_8_SSE2 , NULL                     , NULL                    , "Expand_1_To_8" },
+	{ Blit_Expand_2_To_8 , Blit_Expand_2_To_8_SSE2 , NULL                     , NULL                    , "Expand_2_To_8" },
+	{ Blit_Expand_4_To_8 , Blit_Expand_4_To_8_SSE2 , NULL                     , NULL                    , "Expand_4_To_8" },
+	{ Blit_Expand_1_To_16, Blit_Expand_1_To_16_SSE2, NULL                     , NULL                    , "Expand_1_To_16" },
+	{ Blit_Expand_2_To_16, NULL                    , Blit_Expand_2_To_16_SSSE3, NULL                    , "Expand_2_To_16" },
+	{ Blit_Expand_4_To_16, NULL                    , Blit_Expand_4_To_16_SSSE3, NULL                    , "Expand_4_To_16" },
+	{ Blit_Expand_8_To_16, NULL                    , NULL                     , Blit_Expand_8_To_16_AVX2, "Expand_8_To_16" },
+	{ Blit_Expand_1_To_32, Blit_Expand_1_To_32_SSE2, NULL                     , NULL                    , "Expand_1_To_32" },
+	{ Blit_Expand_2_To_32, NULL                    , Blit_Expand_2_To_32_SSSE3, NULL                    , "Expand_2_To_32" },
+	{ Blit_Expand_4_To_32, NULL                    , Blit_Expand_4_To_32_SSSE3, NULL                    , "Expand_4_To_32" },
+	{ Blit_Expand_8_To_32, NULL                    , NULL                     , Blit_Expand_8_To_32_AVX2, "Expand_8_To_32" }
+};
+
+// Return the fastest variant of blit function the host CPU supports
+static Screen_blit_func Screen_blit_simd(Screen_blit_func handler)
+{
+	const int blitters_count = sizeof(Screen_blitters_simd)/sizeof(Screen_blitters_simd[0]);
+	for (int i = 0; i < blitters_count; i++) {
+		Screen_blit_simd_info const & b = Screen_blitters_simd[i];
+		if (b.handler != handler)
+			continue;
+		if (b.handler_avx2 && cpuinfo_check_avx2())
+			return b.handler_avx2;
+		if (b.handler_ssse3 && cpuinfo_check_ssse3())
+			return b.handler_ssse3;
+		if (b.handler_sse2 && cpuinfo_check_sse2())
+			return b.handler_sse2;
+		break;
+	}
+	return handler;
+}
+#endif
+
 // Initialize the framebuffer update function
 // Returns FALSE, if the function was to be reduced to a simple memcpy()
 // --> In that case, VOSF is not necessary
@@ -575,6 +910,10 @@ bool Screen_blitter_init(VisualFormat const & visual_format, bool native_byte_or
 				visualFormat.Rshift, visualFormat.Gshift, visualFormat.Bshift);
 			abort();
 		}
+
+#ifdef VIDEO_BLIT_SIMD
+		Screen_blit = Screen_blit_simd(Screen_blit);
+#endif
 	}
 #else
 	// The UAE memory handlers will blit correctly
@@ -586,3 +925,354 @@ bool Screen_blitter_init(VisualFormat const & visual_format, bool native_byte_or
 	// --> In that case, we return FALSE
 	return (Screen_blit != Blit_Copy_Raw);
 }
+
+
+/* -------------------------------------------------------------------------- */
+/* --- Conversion of row ranges, spread over blit threads                 --- */
+/* -------------------------------------------------------------------------- */
+
+// Below that many bytes, waking up the blit threads costs more than it saves
+const uint32 BLIT_THREADS_MIN_BYTES = 256 * 1024;
+
+// Conversion job, split in equal parts between the caller and blit threads
+struct Screen_blit_job {
+	uint8 *				dest;
+	int					dest_bytes_per_row;
+	const uint8 *		source;
+	int					source_bytes_per_row;
+	int					row_bytes;
+	ScreenRows const *	ranges;
+	int					n_ranges;
+	int					n_rows;		// Total number of rows in ranges
+	int					n_parts;	// Number of parts the rows are split in
+};
+
+// Convert the rows of the given part of the job
+static void Screen_blit_part(Screen_blit_job const & job, int part)
+{
+	int first = (int)((int64)job.n_rows * part / job.n_parts);
+	int count = (int)((int64)job.n_rows * (part + 1) / job.n_parts) - first;
+	for (int i = 0; i < job.n_ranges && count > 0; i++) {
+		const int rows = job.ranges[i].last - job.ranges[i].first + 1;
+		if (first >= rows) {
+			first -= rows;
+			continue;
+		}
+		int y = job.ranges[i].first + first;
+		int n = rows - first;
+		if (n > count)
+			n = count;
+		count -= n;
+		first = 0;
+		uint8 *d = job.dest + y * job.dest_bytes_per_row;
+		const uint8 *s = job.source + y * job.source_bytes_per_row;
+		while (n-- > 0) {
+			Screen_blit(d, s, job.row_bytes);
+			d += job.dest_bytes_per_row;
+			s += job.source_bytes_per_row;
+		}
+	}
+}
+
+#ifdef HAVE_PTHREADS
+static int blit_threads_count = 0;					// Number of blit threads running
+static pthread_t *blit_threads = NULL;
+static pthread_mutex_t blit_threads_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t blit_threads_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t blit_threads_done = PTHREAD_COND_INITIALIZER;
+static uint32 blit_threads_generation = 0;			// Incremented for each new job
+static uint32 blit_threads_init_generation;			// Last job done before the threads started
+static int blit_threads_pending = 0;				// Number of parts not converted yet
+static bool blit_threads_quit = false;
+static Screen_blit_job blit_threads_job;
+
+static void *blit_thread_func(void *arg)
+{
+	const int part = (int)(intptr)arg;
+	uint32 generation = blit_threads_init_generation;
+	pthread_mutex_lock(&blit_threads_lock);
+	for (;;) {
+		while (generation == blit_threads_generation && !blit_threads_quit)
+			pthread_cond_wait(&blit_threads_start, &blit_threads_lock);
+		if (blit_threads_quit)
+			break;
+		generation = blit_threads_generation;
+		Screen_blit_job const job = blit_threads_job;
+		pthread_mutex_unlock(&blit_threads_lock);
+
+		Screen_blit_part(job, part);
+
+		pthread_mutex_lock(&blit_threads_lock);
+		if (--blit_threads_pending == 0)
+			pthread_cond_signal(&blit_threads_done);
+	}
+	pthread_mutex_unlock(&blit_threads_lock);
+	return NULL;
+}
+#endif
+
+// Start the threads helping Screen_blit_rows(), n_threads counts the
+// caller too, 0 selects one per host CPU (up to 4)
+void Screen_blit_threads_init(int n_threads)
+{
+#ifdef HAVE_PTHREADS
+	Screen_blit_threads_exit();
+
+	if (n_threads <= 0) {
+		long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n_threads = (n_cpus < 1) ? 1 : (n_cpus > 4) ? 4 : (int)n_cpus;
+	}
+	if (n_threads <= 1)
+		return;
+
+	blit_threads = (pthread_t *)malloc((n_threads - 1) * sizeof(pthread_t));
+	if (blit_threads == NULL)
+		return;
+	blit_threads_quit = false;
+
+	// Jobs dispatched to a previous set of threads are done, a job may
+	// be dispatched before a new thread gets to run
+	pthread_mutex_lock(&blit_threads_lock);
+	blit_threads_init_generation = blit_threads_generation;
+	pthread_mutex_unlock(&blit_threads_lock);
+	for (int i = 1; i < n_threads; i++) {
+		int error = pthread_create(&blit_threads[blit_threads_count], NULL, blit_thread_func, (void *)(intptr)i);
+		if (error != 0) {
+			fprintf(stderr, "WARNING: Cannot create blit thread (%s)\n", strerror(error));
+			break;
+		}
+		blit_threads_count++;
+	}
+	D(bug("Started %d blit threads\n", blit_threads_count));
+#endif
+}
+
+void Screen_blit_threads_exit(void)
+{
+#ifdef HAVE_PTHREADS
+	if (blit_threads == NULL)
+		return;
+	pthread_mutex_lock(&blit_threads_lock);
+	blit_threads_quit = true;
+	pthread_cond_broadcast(&blit_threads_start);
+	pthread_mutex_unlock(&blit_threads_lock);
+	for (int i = 0; i < blit_threads_count; i++)
+		pthread_join(blit_threads[i], NULL);
+	free(blit_threads);
+	blit_threads = NULL;
+	blit_threads_count = 0;
+#endif
+}
+
+// Convert row_bytes of each row in ranges with Screen_blit()
+void Screen_blit_rows(uint8 * dest, int dest_bytes_per_row, const uint8 * source, int source_bytes_per_row, int row_bytes, ScreenRows const * ranges, int n_ranges)
+{
+	Screen_blit_job job;
+	job.dest = dest;
+	job.dest_bytes_per_row = dest_bytes_per_row;
+	job.source = source;
+	job.source_bytes_per_row = source_bytes_per_row;
+	job.row_bytes = row_bytes;
+	job.ranges = ranges;
+	job.n_ranges = n_ranges;
+	job.n_rows = 0;
+	for (int i = 0; i < n_ranges; i++)
+		job.n_rows += ranges[i].last - ranges[i].first + 1;
+	job.n_parts = 1;
+
+#ifdef HAVE_PTHREADS
+	if (blit_threads_count > 0 && (uint32)job.n_rows * row_bytes >= BLIT_THREADS_MIN_BYTES) {
+		job.n_parts = blit_threads_count + 1;
+		pthread_mutex_lock(&blit_threads_lock);
+		blit_threads_job = job;
+		blit_threads_pending = blit_threads_count;
+		blit_threads_generation++;
+		pthread_cond_broadcast(&blit_threads_start);
+		pthread_mutex_unlock(&blit_threads_lock);
+
+		Screen_blit_part(job, 0);
+
+		pthread_mutex_lock(&blit_threads_lock);
+		while (blit_threads_pending > 0)
+			pthread_cond_wait(&blit_threads_done, &blit_threads_lock);
+		pthread_mutex_unlock(&blit_threads_lock);
+		return;
+	}
+#endif
+
+	Screen_blit_part(job, 0);
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* --- Damage detection against the frame buffer copy                     --- */
+/* -------------------------------------------------------------------------- */
+
+// Size of the tiles compared, in pixels
+const int DAMAGE_TILE_W = 64;
+const int DAMAGE_TILE_H = 16;
+
+// Function returning true if the two blocks differ
+typedef bool (*Screen_diff_func)(const uint8 * a, const uint8 * b, uint32 length);
+
+static bool Diff_Generic(const uint8 * a, const uint8 * b, uint32 length)
+{
+	return memcmp(a, b, length) != 0;
+}
+
+#ifdef VIDEO_BLIT_SIMD
+static bool VIDEO_BLIT_TARGET("sse2") Diff_SSE2(const uint8 * a, const uint8 * b, uint32 length)
+{
+	const __m128i zero = _mm_setzero_si128();
+	for (uint32 n = length / 64; n > 0; n--) {
+		__m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)a + 0), _mm_loadu_si128((const __m128i *)b + 0));
+		__m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)a + 1), _mm_loadu_si128((const __m128i *)b + 1));
+		__m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)a + 2), _mm_loadu_si128((const __m128i *)b + 2));
+		__m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)a + 3), _mm_loadu_si128((const __m128i *)b + 3));
+		__m128i x = _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xffff)
+			return true;
+		a += 64; b += 64;
+	}
+	for (uint32 n = (length % 64) / 16; n > 0; n--) {
+		__m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)a), _mm_loadu_si128((const __m128i *)b));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xffff)
+			return true;
+		a += 16; b += 16;
+	}
+	return (length % 16) && memcmp(a, b, length % 16) != 0;
+}
+
+static bool VIDEO_BLIT_TARGET("avx2") Diff_AVX2(const uint8 * a, const uint8 * b, uint32 length)
+{
+	for (uint32 n = length / 128; n > 0; n--) {
+		__m256i x0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a + 0), _mm256_loadu_si256((const __m256i *)b + 0));
+		__m256i x1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a + 1), _mm256_loadu_si256((const __m256i *)b + 1));
+		__m256i x2 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a + 2), _mm256_loadu_si256((const __m256i *)b + 2));
+		__m256i x3 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a + 3), _mm256_loadu_si256((const __m256i *)b + 3));
+		__m256i x = _mm256_or_si256(_mm256_or_si256(x0, x1), _mm256_or_si256(x2, x3));
+		if (!_mm256_testz_si256(x, x))
+			return true;
+		a += 128; b += 128;
+	}
+	for (uint32 n = (length % 128) / 32; n > 0; n--) {
+		__m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a), _mm256_loadu_si256((const __m256i *)b));
+		if (!_mm256_testz_si256(x, x))
+			return true;
+		a += 32; b += 32;
+	}
+	return (length % 32) && Diff_SSE2(a, b, length % 32);
+}
+#endif
+
+static Screen_diff_func Screen_diff = NULL;
+
+static void Screen_diff_init(void)
+{
+	Screen_diff = Diff_Generic;
+#ifdef VIDEO_BLIT_SIMD
+	if (cpuinfo_check_avx2())
+		Screen_diff = Diff_AVX2;
+	else if (cpuinfo_check_sse2())
+		Screen_diff = Diff_SSE2;
+#endif
+}
+
+// Compare source with its copy in DAMAGE_TILE_W x DAMAGE_TILE_H tiles,
+// update the copy of changed tiles and return the number of rectangles
+// covering them, adjacent tiles being merged. If more than max_rects
+// rectangles are needed, a single bounding box is returned
+int Screen_damage(uint8 * copy, const uint8 * source, int width, int height, int bytes_per_row, int mac_depth, ScreenDamageRect * rects, int max_rects)
+{
+	if (Screen_diff == NULL)
+		Screen_diff_init();
+
+	const int n_cols = (width + DAMAGE_TILE_W - 1) / DAMAGE_TILE_W;
+	const int tile_bytes = DAMAGE_TILE_W * mac_depth / 8;
+	const int line_bytes = (width * mac_depth + 7) / 8;
+
+	// Dirty state of the tiles in the current row of tiles
+	static uint8 *dirty = NULL;
+	static int dirty_size = 0;
+	if (n_cols > dirty_size) {
+		uint8 *p = (uint8 *)realloc(dirty, n_cols);
+		if (p == NULL)
+			return 0;
+		dirty = p;
+		dirty_size = n_cols;
+	}
+
+	int n_rects = 0;
+	int x1 = width, y1 = height, x2 = 0, y2 = 0;
+	for (int y = 0; y < height; y += DAMAGE_TILE_H) {
+		const int h = (height - y < DAMAGE_TILE_H) ? height - y : DAMAGE_TILE_H;
+
+		// Find changed tiles, whole lines are compared first as most are unchanged
+		bool any_dirty = false;
+		memset(dirty, 0, n_cols);
+		for (int j = y; j < y + h; j++) {
+			const uint8 *s = source + j * bytes_per_row;
+			const uint8 *d = copy + j * bytes_per_row;
+			if (!Screen_diff(s, d, line_bytes))
+				continue;
+			for (int i = 0, ofs = 0; i < n_cols; i++, ofs += tile_bytes) {
+				if (!dirty[i]) {
+					const int n = (line_bytes - ofs < tile_bytes) ? line_bytes - ofs : tile_bytes;
+					dirty[i] = Screen_diff(s + ofs, d + ofs, n);
+				}
+			}
+			any_dirty = true;
+		}
+		if (!any_dirty)
+			continue;
+
+		// Update copy and record runs of changed tiles
+		for (int i = 0; i < n_cols; i++) {
+			if (!dirty[i])
+				continue;
+			int n = i;
+			while (n < n_cols && dirty[n])
+				n++;
+			const int ofs = i * tile_bytes;
+			const int len = (n * tile_bytes < line_bytes ? n * tile_bytes : line_bytes) - ofs;
+			for (int j = y; j < y + h; j++)
+				memcpy(copy + j * bytes_per_row + ofs, source + j * bytes_per_row + ofs, len);
+
+			const int x = i * DAMAGE_TILE_W;
+			const int w = (n * DAMAGE_TILE_W < width ? n * DAMAGE_TILE_W : width) - x;
+			if (x < x1) x1 = x;
+			if (x + w > x2) x2 = x + w;
+			if (y < y1) y1 = y;
+			if (y + h > y2) y2 = y + h;
+			i = n;
+			if (n_rects > max_rects)
+				continue;
+
+			// Extend the rectangle of the same run in the row of tiles above
+			int k = n_rects - 1;
+			while (k >= 0 && !(rects[k].y + rects[k].h == y && rects[k].x == x && rects[k].w == w))
+				k--;
+			if (k >= 0)
+				rects[k].h += h;
+			else if (n_rects < max_rects) {
+				rects[n_rects].x = x;
+				rects[n_rects].y = y;
+				rects[n_rects].w = w;
+				rects[n_rects].h = h;
+				n_rects++;
+			}
+			else
+				n_rects = max_rects + 1;
+		}
+	}
+
+	// Too many rectangles, return the bounding box
+	if (n_rects > max_rects) {
+		rects[0].x = x1;
+		rects[0].y = y1;
+		rects[0].w = x2 - x1;
+		rects[0].h = y2 - y1;
+		n_rects = 1;
+	}
+	return n_rects;
+}
@@ -31,9 +31,24 @@ struct VisualFormat {
 	uint32	Rshift, Gshift, Bshift;	// RGB shift values
 };
 
+// Changed area of the Mac frame buffer, in pixels
+struct ScreenDamageRect {
+	int		x, y;
+	int		w, h;
+};
+
+// Range of Mac frame buffer rows, last row included
+struct ScreenRows {
+	int		first, last;
+};
+
 // Prototypes
 extern void (*Screen_blit)(uint8 * dest, const uint8 * source, uint32 length);
+extern void Screen_blit_rows(uint8 * dest, int dest_bytes_per_row, const uint8 * source, int source_bytes_per_row, int row_bytes, ScreenRows const * ranges, int n_ranges);
+extern void Screen_blit_threads_init(int n_threads);
+extern void Screen_blit_threads_exit(void);
 extern bool Screen_blitter_init(VisualFormat const & visual_format, bool native_byte_order, int mac_depth);
+extern int Screen_damage(uint8 * copy, const uint8 * source, int width, int height, int bytes_per_row, int mac_depth, ScreenDamageRect * rects, int max_rects);
 extern uint32 ExpandMap[256];
 
 // Glue for SheepShaver and BasiliskII
@@ -171,8 +186,67 @@ static void FB_FUNC_NAME(uint8 * dest, const uint8 * source, uint32 length)
 #undef DEREF_WORD_PTR
 }
 
+#ifdef VIDEO_BLIT_SIMD
+// Apply FB_BLIT_4 to every 64-bit lane of 16-byte vectors, the tail
+// goes through the scalar blitter
+static void VIDEO_BLIT_TARGET("sse2") FB_SIMD_NAME(_SSE2)(uint8 * dest, const uint8 * source, uint32 length)
+{
+	for (uint32 n = length / 16; n > 0; n--) {
+		fb_vec128 src = *(const fb_vec128_u *)source, dst;
+		FB_BLIT_4(dst, src);
+		*(fb_vec128_u *)dest = dst;
+		dest += 16; source += 16;
+	}
+	if (length % 16)
+		FB_FUNC_NAME(dest, source, length % 16);
+}
+
+#ifdef FB_BLIT_SHUFFLE
+// Pure byte permutations are a single pshufb per vector
+static void VIDEO_BLIT_TARGET("ssse3") FB_SIMD_NAME(_SSSE3)(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m128i mask = FB_SHUFFLE_MASK(FB_BLIT_SHUFFLE);
+	for (uint32 n = length / 16; n > 0; n--) {
+		__m128i v = _mm_loadu_si128((const __m128i *)source);
+		_mm_storeu_si128((__m128i *)dest, _mm_shuffle_epi8(v, mask));
+		dest += 16; source += 16;
+	}
+	if (length % 16)
+		FB_FUNC_NAME(dest, source, length % 16);
+}
+
+static void VIDEO_BLIT_TARGET("avx2") FB_SIMD_NAME(_AVX2)(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m256i mask = _mm256_broadcastsi128_si256(FB_SHUFFLE_MASK(FB_BLIT_SHUFFLE));
+	for (uint32 n = length / 32; n > 0; n--) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)source);
+		_mm256_storeu_si256((__m256i *)dest, _mm256_shuffle_epi8(v, mask));
+		dest += 32; source += 32;
+	}
+	if (length % 32)
+		FB_FUNC_NAME(dest, source, length % 32);
+}
+#else
+static void VIDEO_BLIT_TARGET("avx2") FB_SIMD_NAME(_AVX2)(uint8 * dest, const uint8 * source, uint32 length)
+{
+	for (uint32 n = length / 32; n > 0; n--) {
+		fb_vec256 src = *(const fb_vec256_u *)source, dst;
+		FB_BLIT_4(dst, src);
+		*(fb_vec256_u *)dest = dst;
+		dest += 32; source += 32;
+	}
+	if (length % 32)
+		FB_FUNC_NAME(dest, source, length % 32);
+}
+#endif
+#endif
+
 #undef FB_FUNC_NAME
 
+#ifdef FB_BLIT_SHUFFLE
+#undef FB_BLIT_SHUFFLE
+#endif
+
 #ifdef FB_BLIT_1
 #undef FB_BLIT_1
 #endif
@@ -30,6 +30,56 @@
 #include "util_windows.h"
 #endif
 
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+#if defined(__NR_userfaultfd) && defined(UFFDIO_WRITEPROTECT_MODE_WP)
+#define HAVE_VOSF_UFFD_WP 1
+#endif
+#endif
+
+#ifdef HAVE_VOSF_UFFD_WP
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY				1
+#endif
+// Linux 6.7 ABI, missing from older kernel headers
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED		(1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC			(1 << 15)
+#endif
+#ifndef PAGEMAP_SCAN
+#define PAGE_IS_WRITTEN					(1 << 1)
+#define PM_SCAN_WP_MATCHING				(1 << 0)
+#define PM_SCAN_CHECK_WPASYNC			(1 << 1)
+struct page_region {
+	uint64 start;
+	uint64 end;
+	uint64 categories;
+};
+struct pm_scan_arg {
+	uint64 size;
+	uint64 flags;
+	uint64 start;
+	uint64 end;
+	uint64 walk_end;
+	uint64 vec;
+	uint64 vec_len;
+	uint64 max_pages;
+	uint64 category_inverted;
+	uint64 category_mask;
+	uint64 category_anyof_mask;
+	uint64 return_mask;
+};
+#define PAGEMAP_SCAN					_IOWR('f', 16, struct pm_scan_arg)
+#endif
+#endif
+
 // Glue for SDL and X11 support
 #ifdef TEST_VOSF_PERFORMANCE
 #define MONITOR_INIT			/* nothing */
@@ -92,6 +142,7 @@ struct ScreenInfo {
     
 	bool dirty;					// Flag: set if the frame buffer was touched
 	bool very_dirty;			// Flag: set if the frame buffer was completely modified (e.g. colormap changes)
+	bool wp_async;				// Flag: set if the kernel tracks writes, see vosf_wp_init()
     char * dirtyPages;			// Table of flags set if page was altered
     ScreenPageInfo * pageInfo;	// Table of mappings page -> Mac scanlines
 };
@@ -225,6 +276,10 @@ const int VOSF_PROFITABLE_THRESHOLD = 16667/2;	// 60 Hz (half of the quantum)
 
 static bool video_vosf_profitable(uint32 *duration_p = NULL, uint32 *n_page_faults_p = NULL)
 {
+	// Writes don't raise signals when the kernel tracks them
+	if (mainBuffer.wp_async)
+		return true;
+
 	uint32 duration = 0;
 	uint32 n_tries = VOSF_PROFITABLE_TRIES;
 	const uint32 n_page_faults = mainBuffer.pageCount * n_tries;
@@ -263,6 +318,141 @@ static bool video_vosf_profitable(uint32 *duration_p = NULL, uint32 *n_page_faul
 }
 
 
+/*
+ *  Dirty page tracking with userfaultfd asynchronous write-protect mode
+ *  (Linux 6.7+). The kernel resolves write faults on the frame buffer by
+ *  itself and records the pages written, PAGEMAP_SCAN then returns them and
+ *  write-protects them again in one call per refresh. No SIGSEGV is raised,
+ *  and pages are already protected once harvested, so vm_protect() is not
+ *  used in this mode.
+ */
+
+#ifdef HAVE_VOSF_UFFD_WP
+static int vosf_uffd = -1;		// userfaultfd registered on the frame buffer
+static int vosf_pagemap = -1;	// /proc/self/pagemap, for PAGEMAP_SCAN
+#endif
+
+static void vosf_wp_exit(void)
+{
+#ifdef HAVE_VOSF_UFFD_WP
+	if (vosf_pagemap >= 0) {
+		close(vosf_pagemap);
+		vosf_pagemap = -1;
+	}
+	if (vosf_uffd >= 0) {
+		close(vosf_uffd);
+		vosf_uffd = -1;
+	}
+#endif
+	mainBuffer.wp_async = false;
+}
+
+// Collect pages written since the last call into dirtyPages[]
+static bool vosf_wp_harvest(void)
+{
+#ifdef HAVE_VOSF_UFFD_WP
+	const int MAX_REGIONS = 64;
+	page_region regions[MAX_REGIONS];
+	pm_scan_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.size = sizeof(arg);
+	arg.flags = PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC;
+	arg.start = mainBuffer.memStart;
+	arg.end = mainBuffer.memStart + mainBuffer.memLength;
+	arg.vec = (uintptr)regions;
+	arg.vec_len = MAX_REGIONS;
+	arg.category_mask = PAGE_IS_WRITTEN;
+	arg.return_mask = PAGE_IS_WRITTEN;
+	for (;;) {
+		int n = ioctl(vosf_pagemap, PAGEMAP_SCAN, &arg);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		for (int i = 0; i < n; i++) {
+			const int first_page = (regions[i].start - mainBuffer.memStart) >> mainBuffer.pageBits;
+			const int last_page = (regions[i].end - mainBuffer.memStart) >> mainBuffer.pageBits;
+			PFLAG_SET_RANGE(first_page, last_page);
+			mainBuffer.dirty = true;
+		}
+		if (arg.walk_end >= arg.end)
+			break;
+		arg.start = arg.walk_end;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Returns false if the kernel cannot track writes, SIGSEGV are used then
+static bool vosf_wp_init(void)
+{
+#ifdef HAVE_VOSF_UFFD_WP
+	if (!PrefsFindBool("vosfwp"))
+		return false;
+
+	// User mode faults are enough, and don't need vm.unprivileged_userfaultfd
+	vosf_uffd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+	if (vosf_uffd < 0) {
+		fprintf(stderr, "WARNING: VOSF: userfaultfd not available (%s), using SIGSEGV\n", strerror(errno));
+		return false;
+	}
+
+	struct uffdio_api api;
+	memset(&api, 0, sizeof(api));
+	api.api = UFFD_API;
+	api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+	struct uffdio_register reg;
+	reg.range.start = mainBuffer.memStart;
+	reg.range.len = mainBuffer.memLength;
+	reg.mode = UFFDIO_REGISTER_MODE_WP;
+	struct uffdio_writeprotect wp;
+	wp.range = reg.range;
+	wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+	if (ioctl(vosf_uffd, UFFDIO_API, &api) < 0
+		|| ioctl(vosf_uffd, UFFDIO_REGISTER, &reg) < 0
+		|| ioctl(vosf_uffd, UFFDIO_WRITEPROTECT, &wp) < 0) {
+		fprintf(stderr, "WARNING: VOSF: userfaultfd write-protect mode not available (%s), using SIGSEGV\n", strerror(errno));
+		vosf_wp_exit();
+		return false;
+	}
+
+	vosf_pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	mainBuffer.wp_async = true;
+	if (vosf_pagemap < 0 || !vosf_wp_harvest()) {
+		fprintf(stderr, "WARNING: VOSF: PAGEMAP_SCAN not available (%s), using SIGSEGV\n", strerror(errno));
+		vosf_wp_exit();
+		return false;
+	}
+	D(bug("VOSF: using userfaultfd write-protect mode\n"));
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Make pages read-only again after they were blitted
+static inline void vosf_protect(uintptr start, uint32 length)
+{
+	if (!mainBuffer.wp_async)
+		vm_protect((char *)start, length, VM_PAGE_READ);
+}
+
+// Return true if the frame buffer was touched since the last update
+static bool video_vosf_dirty(void)
+{
+	if (mainBuffer.wp_async) {
+		LOCK_VOSF;
+		if (!vosf_wp_harvest())
+			PFLAG_SET_ALL;
+		UNLOCK_VOSF;
+	}
+	return mainBuffer.dirty;
+}
+
+
 /*
  *  Initialize the VOSF system (mainBuffer structure, SIGSEGV handler)
  */
@@ -319,7 +509,7 @@ static bool video_vosf_init(MONITOR_INIT)
 	}
 	
 	// We can now write-protect the frame buffer
-	if (vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ) != 0)
+	if (!vosf_wp_init() && vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ) != 0)
 		return false;
 	
 	// The frame buffer is sane, i.e. there is no write to it yet
@@ -334,6 +524,7 @@ static bool video_vosf_init(MONITOR_INIT)
 
 static void video_vosf_exit(void)
 {
+	vosf_wp_exit();
 	if (mainBuffer.pageInfo) {
 		free(mainBuffer.pageInfo);
 		mainBuffer.pageInfo = NULL;
@@ -357,7 +548,8 @@ static void vosf_do_set_dirty_area(uintptr first, uintptr last)
 	for (int i = first_page; i <= last_page; i++) {
 		if (PFLAG_ISCLEAR(i)) {
 			PFLAG_SET(i);
-			vm_protect(addr, mainBuffer.pageSize, VM_PAGE_READ | VM_PAGE_WRITE);
+			if (!mainBuffer.wp_async)
+				vm_protect(addr, mainBuffer.pageSize, VM_PAGE_READ | VM_PAGE_WRITE);
 		}
 		addr += mainBuffer.pageSize;
 	}
@@ -483,6 +675,11 @@ static void update_display_window_vosf(VIDEO_DRV_WIN_INIT)
 {
 	VIDEO_MODE_INIT;
 
+	// Collect the scanlines of all dirty page runs, so that they are
+	// converted in one go by the blit threads
+	const int MAX_RANGES = 64;
+	ScreenRows ranges[MAX_RANGES];
+	int n_ranges = 0;
 	int page = 0;
 	for (;;) {
 		const unsigned first_page = find_next_page_set(page);
@@ -495,25 +692,33 @@ static void update_display_window_vosf(VIDEO_DRV_WIN_INIT)
 		// Make the dirty pages read-only again
 		const int32 offset  = first_page << mainBuffer.pageBits;
 		const uint32 length = (page - first_page) << mainBuffer.pageBits;
-		vm_protect((char *)mainBuffer.memStart + offset, length, VM_PAGE_READ);
+		vosf_protect(mainBuffer.memStart + offset, length);
 		
-		// There is at least one line to update
+		// There is at least one line to update, merge it with the previous
+		// run if they share scanlines or if there are too many runs
 		const int y1 = mainBuffer.pageInfo[first_page].top;
 		const int y2 = mainBuffer.pageInfo[page - 1].bottom;
-		const int height = y2 - y1 + 1;
-
-		// Update the_host_buffer
-		VIDEO_DRV_LOCK_PIXELS;
-		const int src_bytes_per_row = VIDEO_MODE_ROW_BYTES;
-		const int dst_bytes_per_row = VIDEO_DRV_ROW_BYTES;
-		int i1 = y1 * src_bytes_per_row, i2 = y1 * dst_bytes_per_row, j;
-		for (j = y1; j <= y2; j++) {
-			Screen_blit(the_host_buffer + i2, the_buffer + i1, src_bytes_per_row);
-			i1 += src_bytes_per_row;
-			i2 += dst_bytes_per_row;
+		if (n_ranges > 0 && (y1 <= ranges[n_ranges - 1].last + 1 || n_ranges == MAX_RANGES)) {
+			if (y2 > ranges[n_ranges - 1].last)
+				ranges[n_ranges - 1].last = y2;
+		} else {
+			ranges[n_ranges].first = y1;
+			ranges[n_ranges].last = y2;
+			n_ranges++;
 		}
-		VIDEO_DRV_UNLOCK_PIXELS;
+	}
+	mainBuffer.dirty = false;
+	if (n_ranges == 0)
+		return;
+
+	// Update the_host_buffer
+	VIDEO_DRV_LOCK_PIXELS;
+	Screen_blit_rows(the_host_buffer, VIDEO_DRV_ROW_BYTES, the_buffer, VIDEO_MODE_ROW_BYTES, VIDEO_MODE_ROW_BYTES, ranges, n_ranges);
+	VIDEO_DRV_UNLOCK_PIXELS;
 
+	for (int i = 0; i < n_ranges; i++) {
+		const int y1 = ranges[i].first;
+		const int height = ranges[i].last - y1 + 1;
 #ifdef USE_SDL_VIDEO
 		SDL_UpdateRect(drv->s, 0, y1, VIDEO_MODE_X, height);
 #else
@@ -523,7 +728,6 @@ static void update_display_window_vosf(VIDEO_DRV_WIN_INIT)
 			XPutImage(x_display, VIDEO_DRV_WINDOW, VIDEO_DRV_GC, VIDEO_DRV_IMAGE, 0, y1, 0, y1, VIDEO_MODE_X, height);
 #endif
 	}
-	mainBuffer.dirty = false;
 }
 #endif
 
@@ -549,15 +753,11 @@ static void update_display_dga_vosf(VIDEO_DRV_DGA_INIT)
 	// Full screen update requested?
 	if (mainBuffer.very_dirty) {
 		PFLAG_CLEAR_ALL;
-		vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ);
+		vosf_protect(mainBuffer.memStart, mainBuffer.memLength);
 		memcpy(the_buffer_copy, the_buffer, VIDEO_MODE_ROW_BYTES * VIDEO_MODE_Y);
 		VIDEO_DRV_LOCK_PIXELS;
-		int i1 = 0, i2 = 0;
-		for (int j = 0;  j < VIDEO_MODE_Y; j++) {
-			Screen_blit(the_host_buffer + i2, the_buffer + i1, src_bytes_per_row);
-			i1 += src_bytes_per_row;
-			i2 += scr_bytes_per_row;
-		}
+		ScreenRows all = { 0, VIDEO_MODE_Y - 1 };
+		Screen_blit_rows(the_host_buffer, scr_bytes_per_row, the_buffer, src_bytes_per_row, src_bytes_per_row, &all, 1);
 #ifdef USE_SDL_VIDEO
 		SDL_UpdateRect(drv->s, 0, 0, VIDEO_MODE_X, VIDEO_MODE_Y);
 #endif
@@ -586,7 +786,7 @@ static void update_display_dga_vosf(VIDEO_DRV_DGA_INIT)
 		// Make the dirty pages read-only again
 		const int32 offset  = first_page << mainBuffer.pageBits;
 		const uint32 length = (page - first_page) << mainBuffer.pageBits;
-		vm_protect((char *)mainBuffer.memStart + offset, length, VM_PAGE_READ);
+		vosf_protect(mainBuffer.memStart + offset, length);
 
 		// Optimized for scanlines, don't process overlapping lines again
 		int y1 = mainBuffer.pageInfo[first_page].top;
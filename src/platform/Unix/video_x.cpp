@@ -68,6 +68,7 @@
 #include "video.h"
 #include "video_defs.h"
 #include "video_blit.h"
+#include "event_loop.h"
 
 #define DEBUG 0
 #include "debug.h"
@@ -79,16 +80,17 @@ using std::sort;
 
 // Constants
 const char KEYCODE_FILE_NAME[] = DATADIR "/keycodes";
+const int VIDEO_REFRESH_HZ = 60;
+const int VIDEO_REFRESH_DELAY = 1000000 / VIDEO_REFRESH_HZ;
 static const bool hw_mac_cursor_accl = true;	// Flag: Enable MacOS to X11 copy of cursor?
 
 // Global variables
 static int32 frame_skip;
 static int16 mouse_wheel_mode;
 static int16 mouse_wheel_lines;
-static bool redraw_thread_active = false;	// Flag: Redraw thread installed
-static pthread_attr_t redraw_thread_attr;	// Redraw thread attributes
-static volatile bool redraw_thread_cancel;	// Flag: Cancel Redraw thread
-static pthread_t redraw_thread;				// Redraw thread
+static bool redraw_thread_active = false;	// Flag: Redraw events installed
+static event_source *redraw_timer = NULL;	// Display refresh timer
+static event_source *x_event_source = NULL;	// X connection watch
 
 static volatile bool thread_stop_req = false;
 static sem_t thread_stop_ack;
@@ -178,7 +180,8 @@ SpinLock* gDisplayLock;		// X Display spinlock
 
 
 // Prototypes
-static void *redraw_func(void *arg);
+static void redraw_func(void *arg);
+static void x_event_func(void *arg);
 
 
 // From main_unix.cpp
@@ -1367,6 +1370,11 @@ PlatformVideo::DeviceInit(void)
 	if (frame_skip == 0)
 		frame_skip = 1;
 
+#ifdef ENABLE_VOSF
+	// Start frame buffer conversion threads
+	Screen_blit_threads_init(PrefsFindInt32("blitthreads"));
+#endif
+
 	// Read mouse wheel prefs
 	mouse_wheel_mode = PrefsFindInt32("mousewheelmode");
 	mouse_wheel_lines = PrefsFindInt32("mousewheellines");
@@ -1652,10 +1660,12 @@ PlatformVideo::DeviceInit(void)
 		return false;
 	if (sem_init(&thread_resume_req, 0, 0) < 0)
 		return false;
-	Set_pthread_attr(&redraw_thread_attr, 0);
-	redraw_thread_cancel = false;
-	redraw_thread_active = (pthread_create(&redraw_thread, &redraw_thread_attr, redraw_func, NULL) == 0);
-	D(bug("Redraw thread installed (%ld)\n", redraw_thread));
+	redraw_timer = EventLoopAddTimer(redraw_func, NULL);
+	x_event_source = EventLoopAddFd(ConnectionNumber(x_display), x_event_func, NULL);
+	redraw_thread_active = (redraw_timer != NULL);
+	if (redraw_timer)
+		EventLoopSetPeriod(redraw_timer, VIDEO_REFRESH_DELAY);
+	D(bug("Redraw events installed\n"));
 	return true;
 }
 
@@ -1667,11 +1677,12 @@ PlatformVideo::DeviceInit(void)
 void
 PlatformVideo::DeviceShutdown(void)
 {
-	// Stop redraw thread
+	// Stop redraw events
 	if (redraw_thread_active) {
-		redraw_thread_cancel = true;
-		pthread_cancel(redraw_thread);
-		pthread_join(redraw_thread, NULL);
+		EventLoopRemove(x_event_source);
+		x_event_source = NULL;
+		EventLoopRemove(redraw_timer);
+		redraw_timer = NULL;
 		sem_destroy(&thread_stop_ack);
 		sem_destroy(&thread_resume_req);
 		redraw_thread_active = false;
@@ -1687,6 +1698,7 @@ PlatformVideo::DeviceShutdown(void)
 		// Deinitialize VOSF
 		video_vosf_exit();
 	}
+	Screen_blit_threads_exit();
 #endif
 
 	// Close window and server connection
@@ -1864,7 +1876,10 @@ PlatformVideo::DeviceQuitFullScreen(void)
 	D(bug("%s\n", __func__));
 	if (display_type == DISPLAY_SCREEN) {
 		quit_full_screen = true;
-		while (!quit_full_screen_ack) ;
+		if (EventLoopCurrent())
+			redraw_func(NULL);		// Redraw cannot run while we block its thread
+		else
+			while (!quit_full_screen_ack) ;
 	}
 }
 
@@ -2310,125 +2325,26 @@ void video_set_cursor(void)
 
 static void update_display(void)
 {
-	// Incremental update code
-	int wide = 0, high = 0, x1, x2, y1, y2, i, j;
-	int bytes_per_row = VModes[cur_mode].viRowBytes;
-	int bytes_per_pixel = VModes[cur_mode].viRowBytes / VModes[cur_mode].viXsize;
-	uint8 *p, *p2;
-
-	// Check for first line from top and first line from bottom that have changed
-	y1 = 0;
-	for (j=0; j<VModes[cur_mode].viYsize; j++) {
-		if (memcmp(&the_buffer[j * bytes_per_row], &the_buffer_copy[j * bytes_per_row], bytes_per_row)) {
-			y1 = j;
-			break;
-		}
-	}
-	y2 = y1 - 1;
-	for (j=VModes[cur_mode].viYsize-1; j>=y1; j--) {
-		if (memcmp(&the_buffer[j * bytes_per_row], &the_buffer_copy[j * bytes_per_row], bytes_per_row)) {
-			y2 = j;
-			break;
-		}
-	}
-	high = y2 - y1 + 1;
-
-	// Check for first column from left and first column from right that have changed
-	if (high) {
-		if (depth == 1) {
-			x1 = VModes[cur_mode].viXsize;
-			for (j=y1; j<=y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				for (i=0; i<(x1>>3); i++) {
-					if (*p != *p2) {
-						x1 = i << 3;
-						break;
-					}
-					p++;
-					p2++;
-				}
-			}
-			x2 = x1;
-			for (j=y1; j<=y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				p += bytes_per_row;
-				p2 += bytes_per_row;
-				for (i=(VModes[cur_mode].viXsize>>3); i>(x2>>3); i--) {
-					p--;
-					p2--;
-					if (*p != *p2) {
-						x2 = i << 3;
-						break;
-					}
-				}
-			}
-			wide = x2 - x1;
-
-			// Update copy of the_buffer
-			if (high && wide) {
-				for (j=y1; j<=y2; j++) {
-					i = j * bytes_per_row + (x1 >> 3);
-					memcpy(&the_buffer_copy[i], &the_buffer[i], wide >> 3);
-				}
-			}
-
-		} else {
-			x1 = VModes[cur_mode].viXsize;
-			for (j=y1; j<=y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				for (i=0; i<x1; i++) {
-					if (memcmp(p, p2, bytes_per_pixel)) {
-						x1 = i;
-						break;
-					}
-					p += bytes_per_pixel;
-					p2 += bytes_per_pixel;
-				}
-			}
-			x2 = x1;
-			for (j=y1; j<=y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				p += bytes_per_row;
-				p2 += bytes_per_row;
-				for (i=VModes[cur_mode].viXsize; i>x2; i--) {
-					p -= bytes_per_pixel;
-					p2 -= bytes_per_pixel;
-					if (memcmp(p, p2, bytes_per_pixel)) {
-						x2 = i;
-						break;
-					}
-				}
-			}
-			wide = x2 - x1;
-
-			// Update copy of the_buffer
-			if (high && wide) {
-				for (j=y1; j<=y2; j++) {
-					i = j * bytes_per_row + x1 * bytes_per_pixel;
-					memcpy(&the_buffer_copy[i], &the_buffer[i], bytes_per_pixel * wide);
-				}
-			}
-		}
-	}
+	// Incremental update code, copy and redraw the changed tiles only
+	const int MAX_RECTS = 32;
+	ScreenDamageRect rects[MAX_RECTS];
+	VideoInfo const & mode = VModes[cur_mode];
+	const int n_rects = Screen_damage(the_buffer_copy, the_buffer, mode.viXsize, mode.viYsize, mode.viRowBytes, depth, rects, MAX_RECTS);
 
 	// Refresh display
-	if (high && wide) {
+	if (n_rects) {
 		gDisplayLock->Lock();
-		if (have_shm)
-			XShmPutImage(x_display, the_win, the_gc, img, x1, y1, x1, y1, wide, high, 0);
-		else
-			XPutImage(x_display, the_win, the_gc, img, x1, y1, x1, y1, wide, high);
+		for (int i = 0; i < n_rects; i++) {
+			const ScreenDamageRect & r = rects[i];
+			if (have_shm)
+				XShmPutImage(x_display, the_win, the_gc, img, r.x, r.y, r.x, r.y, r.w, r.h, 0);
+			else
+				XPutImage(x_display, the_win, the_gc, img, r.x, r.y, r.x, r.y, r.w, r.h);
+		}
 		gDisplayLock->Unlock();
 	}
 }
 
-const int VIDEO_REFRESH_HZ = 60;
-const int VIDEO_REFRESH_DELAY = 1000000 / VIDEO_REFRESH_HZ;
-
 static void handle_palette_changes(void)
 {
 	gPaletteLock->Lock();
@@ -2466,133 +2382,116 @@ static void handle_palette_changes(void)
 	gPaletteLock->Unlock();
 }
 
-static void *redraw_func(void *arg)
+// Pause if requested (during video mode switches)
+static void redraw_check_pause(void)
 {
-	int fd = ConnectionNumber(x_display);
-
-	uint64 start = GetTicks_usec();
-	int64 ticks = 0;
-	uint64 next = GetTicks_usec() + VIDEO_REFRESH_DELAY;
-
-	while (!redraw_thread_cancel) {
-
-		// Pause if requested (during video mode switches)
-		if (thread_stop_req) {
-			sem_post(&thread_stop_ack);
-			sem_wait(&thread_resume_req);
-		}
-
-		int64 delay = next - GetTicks_usec();
-		if (delay < -VIDEO_REFRESH_DELAY) {
-
-			// We are lagging far behind, so we reset the delay mechanism
-			next = GetTicks_usec();
-
-		} else if (delay <= 0) {
+	if (thread_stop_req) {
+		sem_post(&thread_stop_ack);
+		sem_wait(&thread_resume_req);
+	}
+}
 
-			// Delay expired, refresh display
-			next += VIDEO_REFRESH_DELAY;
-			ticks++;
+// Display refresh, run VIDEO_REFRESH_HZ times per second by the event loop
+static void redraw_func(void *arg)
+{
+	redraw_check_pause();
 
-			// Handle X11 events
-			handle_events();
+	// Handle X11 events
+	handle_events();
 
-			// Quit DGA mode if requested
-			if (quit_full_screen) {
-				quit_full_screen = false;
-				if (display_type == DISPLAY_SCREEN) {
-					gDisplayLock->Lock();
+	// Quit DGA mode if requested
+	if (quit_full_screen) {
+		quit_full_screen = false;
+		if (display_type == DISPLAY_SCREEN) {
+			gDisplayLock->Lock();
 #if defined(ENABLE_XF86_DGA) || defined(ENABLE_FBDEV_DGA)
 #ifdef ENABLE_XF86_DGA
-					if (!is_fbdev_dga_mode)
-						XF86DGADirectVideo(x_display, screen, 0);
-#endif
-					XUngrabPointer(x_display, CurrentTime);
-					XUngrabKeyboard(x_display, CurrentTime);
-					XUnmapWindow(x_display, the_win);
-					wait_unmapped(the_win);
-					XDestroyWindow(x_display, the_win);
-#endif
-					XSync(x_display, false);
-					gDisplayLock->Unlock();
-					quit_full_screen_ack = true;
-					return NULL;
-				}
-			}
+			if (!is_fbdev_dga_mode)
+				XF86DGADirectVideo(x_display, screen, 0);
+#endif
+			XUngrabPointer(x_display, CurrentTime);
+			XUngrabKeyboard(x_display, CurrentTime);
+			XUnmapWindow(x_display, the_win);
+			wait_unmapped(the_win);
+			XDestroyWindow(x_display, the_win);
+#endif
+			XSync(x_display, false);
+			gDisplayLock->Unlock();
+			quit_full_screen_ack = true;
+
+			// Stop refreshing the closed screen
+			EventLoopCancel(redraw_timer);
+			EventLoopRemove(x_event_source);
+			x_event_source = NULL;
+			return;
+		}
+	}
 
-			// Refresh display and set cursor image in window mode
-			static int tick_counter = 0;
-			if (display_type == DISPLAY_WINDOW) {
-				tick_counter++;
-				if (tick_counter >= frame_skip) {
-					tick_counter = 0;
+	// Refresh display and set cursor image in window mode
+	static int tick_counter = 0;
+	if (display_type == DISPLAY_WINDOW) {
+		tick_counter++;
+		if (tick_counter >= frame_skip) {
+			tick_counter = 0;
 
-					// Update display
+			// Update display
 #ifdef ENABLE_VOSF
-					if (use_vosf) {
-						gDisplayLock->Lock();
-						if (mainBuffer.dirty) {
-							LOCK_VOSF;
-							update_display_window_vosf();
-							UNLOCK_VOSF;
-							XSync(x_display, false); // Let the server catch up
-						}
-						gDisplayLock->Unlock();
-					}
-					else
-#endif
-						update_display();
-
-					// Set new cursor image if it was changed
-					if (hw_mac_cursor_accl && cursor_changed) {
-						cursor_changed = false;
-						uint8 *x_data = (uint8 *)cursor_image->data;
-						uint8 *x_mask = (uint8 *)cursor_mask_image->data;
-						for (int i = 0; i < 32; i++) {
-							x_mask[i] = MacCursor[4 + i] | MacCursor[36 + i];
-							x_data[i] = MacCursor[4 + i];
-						}
-						gDisplayLock->Lock();
-						XFreeCursor(x_display, mac_cursor);
-						XPutImage(x_display, cursor_map, cursor_gc, cursor_image, 0, 0, 0, 0, 16, 16);
-						XPutImage(x_display, cursor_mask_map, cursor_mask_gc, cursor_mask_image, 0, 0, 0, 0, 16, 16);
-						mac_cursor = XCreatePixmapCursor(x_display, cursor_map, cursor_mask_map, &black, &white, MacCursor[2], MacCursor[3]);
-						XDefineCursor(x_display, the_win, mac_cursor);
-						gDisplayLock->Unlock();
-					}
+			if (use_vosf) {
+				gDisplayLock->Lock();
+				if (video_vosf_dirty()) {
+					LOCK_VOSF;
+					update_display_window_vosf();
+					UNLOCK_VOSF;
+					XSync(x_display, false); // Let the server catch up
 				}
+				gDisplayLock->Unlock();
 			}
-#ifdef ENABLE_VOSF
-			else if (use_vosf) {
-				// Update display (VOSF variant)
-				if (++tick_counter >= frame_skip) {
-					tick_counter = 0;
-					if (mainBuffer.dirty) {
-						LOCK_VOSF;
-						update_display_dga_vosf();
-						UNLOCK_VOSF;
-					}
+			else
+#endif
+				update_display();
+
+			// Set new cursor image if it was changed
+			if (hw_mac_cursor_accl && cursor_changed) {
+				cursor_changed = false;
+				uint8 *x_data = (uint8 *)cursor_image->data;
+				uint8 *x_mask = (uint8 *)cursor_mask_image->data;
+				for (int i = 0; i < 32; i++) {
+					x_mask[i] = MacCursor[4 + i] | MacCursor[36 + i];
+					x_data[i] = MacCursor[4 + i];
 				}
+				gDisplayLock->Lock();
+				XFreeCursor(x_display, mac_cursor);
+				XPutImage(x_display, cursor_map, cursor_gc, cursor_image, 0, 0, 0, 0, 16, 16);
+				XPutImage(x_display, cursor_mask_map, cursor_mask_gc, cursor_mask_image, 0, 0, 0, 0, 16, 16);
+				mac_cursor = XCreatePixmapCursor(x_display, cursor_map, cursor_mask_map, &black, &white, MacCursor[2], MacCursor[3]);
+				XDefineCursor(x_display, the_win, mac_cursor);
+				gDisplayLock->Unlock();
 			}
+		}
+	}
+#ifdef ENABLE_VOSF
+	else if (use_vosf) {
+		// Update display (VOSF variant)
+		if (++tick_counter >= frame_skip) {
+			tick_counter = 0;
+			if (video_vosf_dirty()) {
+				LOCK_VOSF;
+				update_display_dga_vosf();
+				UNLOCK_VOSF;
+			}
+		}
+	}
 #endif
 
-			// Set new palette if it was changed
-			handle_palette_changes();
-
-		} else {
+	// Set new palette if it was changed
+	handle_palette_changes();
+}
 
-			// No display refresh pending, check for X events
-			fd_set readfds;
-			FD_ZERO(&readfds);
-			FD_SET(fd, &readfds);
-			struct timeval timeout;
-			timeout.tv_sec = 0;
-			timeout.tv_usec = delay;
-			if (select(fd+1, &readfds, NULL, NULL, &timeout) > 0)
-				handle_events();
-		}
-	}
-	return NULL;
+// X events arrived on the display connection
+static void x_event_func(void *arg)
+{
+	redraw_check_pause();
+	handle_events();
 }
 
 
@@ -316,6 +316,7 @@ vm_acquire(size_t size, int options)
 }
 
 /* Allocate zero-filled memory at exactly ADDR (which must be page-aligned).
+   With VM_MAP_NOREPLACE, fail if part of the region is already mapped.
    Retuns 0 if successful, -1 on errors.  */
 
 int
@@ -348,12 +349,26 @@ vm_acquire_fixed(void * addr, size_t size, int options)
 	}
 #elif defined(HAVE_MMAP_VM)
 	int fd = zero_fd;
-	int the_map_flags = translate_map_flags(options) | map_flags | MAP_FIXED;
+	int the_map_flags = translate_map_flags(options) | map_flags;
+	if (!(options & VM_MAP_NOREPLACE))
+		the_map_flags |= MAP_FIXED;
+#ifdef MAP_FIXED_NOREPLACE
+	else
+		the_map_flags |= MAP_FIXED_NOREPLACE;
+#endif
 
-	if (mmap((caddr_t)addr, size, VM_PAGE_DEFAULT, the_map_flags, fd, 0) == (void *)MAP_FAILED) {
+	void * ret_addr = mmap((caddr_t)addr, size, VM_PAGE_DEFAULT, the_map_flags, fd, 0);
+	if (ret_addr == (void *)MAP_FAILED) {
 		bug("%s: mmap VM_MAP failed!\n", __func__);
 		return -1;
 	}
+
+	// Without MAP_FIXED, the address is only a hint
+	if (ret_addr != addr) {
+		munmap((caddr_t)ret_addr, size);
+		errno = EEXIST;
+		return -1;
+	}
 #elif defined(HAVE_WIN32_VM)
 	// Windows cannot allocate Low Memory
 	if (addr == NULL) {
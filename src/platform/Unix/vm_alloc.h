@@ -58,6 +58,7 @@ extern "C" {
 #define VM_MAP_FIXED			0x04
 #define VM_MAP_32BIT			0x08
 #define VM_MAP_WRITE_WATCH		0x10
+#define VM_MAP_NOREPLACE		0x20
 
 /* Default mapping options.  */
 #define VM_MAP_DEFAULT			(VM_MAP_PRIVATE)
@@ -100,6 +101,7 @@ extern void vm_exit(void);
 extern void * vm_acquire(size_t size, int options = VM_MAP_DEFAULT);
 
 /* Allocate zero-filled memory at exactly ADDR (which must be page-aligned).
+   With VM_MAP_NOREPLACE, fail if part of the region is already mapped.
    Returns 0 if successful, -1 on errors.  */
 
 extern int vm_acquire_fixed(void * addr, size_t size, int options = VM_MAP_DEFAULT);
@@ -74,7 +74,9 @@
 #define PPC_CHECK_INTERRUPTS 1
 #define PPC_DECODE_CACHE 1
 #define PPC_FLIGHT_RECORDER 1
+#ifndef PPC_PROFILE_COMPILE_TIME
 #define PPC_PROFILE_COMPILE_TIME 0
+#endif
 #define PPC_PROFILE_GENERIC_CALLS 0
 #define KPX_MAX_CPUS 1
 #if ENABLE_DYNGEN
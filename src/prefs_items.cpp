@@ -56,6 +56,13 @@ prefs_desc common_prefs_items[] = {
 	{"ignoresegv", TYPE_BOOLEAN, false, "ignore illegal memory accesses"},
 	{"ignoreillegal", TYPE_BOOLEAN, false, "ignore illegal instructions"},
 	{"jit", TYPE_BOOLEAN, false,        "enable JIT compiler"},
+	{"jitnative", TYPE_BOOLEAN, false,  "use native x86-64 JIT code generator"},
+	{"jitoptimize", TYPE_BOOLEAN, false, "optimize blocks in the native JIT code generator"},
+	{"jitcache", TYPE_STRING, false,    "file to save and reuse JIT translations"},
+	{"jitasync", TYPE_BOOLEAN, false,   "translate blocks in a separate thread, interpreting them meanwhile"},
+	{"jitperfmap", TYPE_BOOLEAN, false, "describe JIT translations in /tmp/perf-<pid>.map"},
+	{"jitdump", TYPE_BOOLEAN, false,    "describe JIT translations in a perf jitdump file"},
+	{"jitprofile", TYPE_STRING, false,  "file to dump the JIT execution profile to, on exit and SIGUSR1"},
 	{"jit68k", TYPE_BOOLEAN, false,     "enable 68k DR emulator"},
 	{"ppcinslog", TYPE_BOOLEAN, false,	"enable PPC instruction logging"},
 	{"keyboardtype", TYPE_INT32, false, "hardware keyboard type"},
@@ -90,6 +97,11 @@ void AddPrefsDefaults(void)
 #else
 	PrefsAddBool("jit", false);
 #endif
+	PrefsAddBool("jitnative", false);
+	PrefsAddBool("jitoptimize", true);
+	PrefsAddBool("jitasync", false);
+	PrefsAddBool("jitperfmap", false);
+	PrefsAddBool("jitdump", false);
 	PrefsAddBool("jit68k", false);
 	PrefsAddBool("ppcinslog", false);
 
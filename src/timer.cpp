@@ -24,13 +24,8 @@
 #include "main.h"
 #include "cpu_emulation.h"
 
-#ifdef PRECISE_TIMING_POSIX
-#include <pthread.h>
-#include <semaphore.h>
-#endif
-
-#ifdef PRECISE_TIMING_MACH
-#include <mach/mach.h>
+#ifdef PRECISE_TIMING_EVENT
+#include "event_loop.h"
 #endif
 
 #define DEBUG 0
@@ -67,23 +62,11 @@ static volatile tm_time_t wakeup_time = wakeup_time_max;
 static sem_id wakeup_time_sem = -1;
 static int32 timer_func(void *arg);
 #endif
-#ifdef PRECISE_TIMING_POSIX
-static pthread_t timer_thread;
-static bool timer_thread_active = false;
-static volatile bool timer_thread_cancel = false;
-static tm_time_t wakeup_time_max = { 0x7fffffff, 999999999 };
-static tm_time_t wakeup_time = wakeup_time_max;
-static pthread_mutex_t wakeup_time_lock = PTHREAD_MUTEX_INITIALIZER;
-static void *timer_func(void *arg);
-#endif
-#ifdef PRECISE_TIMING_MACH
-static clock_serv_t system_clock;
-static thread_act_t timer_thread;
-static bool timer_thread_active = false;
+#ifdef PRECISE_TIMING_EVENT
+static event_source *timer_event = NULL;	// Only touched by the emulator thread
 static tm_time_t wakeup_time_max = { 0x7fffffff, 999999999 };
 static tm_time_t wakeup_time = wakeup_time_max;
-static semaphore_t wakeup_time_sem;
-static void *timer_func(void *arg);
+static void timer_func(void *arg);
 #endif
 #endif
 
@@ -157,101 +140,14 @@ static void dequeue_tm(uint32 tm)
  *  Timer thread operations
  */
 
-#ifdef PRECISE_TIMING_POSIX
-const int SIGSUSPEND = SIGRTMIN + 6;
-const int SIGRESUME  = SIGRTMIN + 7;
-static struct sigaction sigsuspend_action;
-static struct sigaction sigresume_action;
-
-static int suspend_count = 0;
-static pthread_mutex_t suspend_count_lock = PTHREAD_MUTEX_INITIALIZER;
-static sem_t suspend_ack_sem;
-static sigset_t suspend_handler_mask;
-
-// Signal handler for suspended thread
-static void sigsuspend_handler(int sig)
-{
-	sem_post(&suspend_ack_sem);
-	sigsuspend(&suspend_handler_mask);
-}
-
-// Signal handler for resumed thread
-static void sigresume_handler(int sig)
-{
-	/* simply trigger a signal to stop clock_nanosleep() */
-}
-
-// Initialize timer thread
-static bool timer_thread_init(void)
-{
-	// Install suspend signal handler
-	sigemptyset(&sigsuspend_action.sa_mask);
-	sigaddset(&sigsuspend_action.sa_mask, SIGRESUME);
-	sigsuspend_action.sa_handler = sigsuspend_handler;
-	sigsuspend_action.sa_flags = SA_RESTART;
-#ifdef HAVE_SIGNAL_SA_RESTORER
-	sigsuspend_action.sa_restorer = NULL;
-#endif
-	if (sigaction(SIGSUSPEND, &sigsuspend_action, NULL) < 0)
-		return false;
-
-	// Install resume signal handler
-	sigemptyset(&sigresume_action.sa_mask);
-	sigresume_action.sa_handler = sigresume_handler;
-	sigresume_action.sa_flags = SA_RESTART;
-#ifdef HAVE_SIGNAL_SA_RESTORER
-	sigresume_action.sa_restorer = NULL;
-#endif
-	if (sigaction(SIGRESUME, &sigresume_action, NULL) < 0)
-		return false;
-
-	// Initialize semaphore
-	if (sem_init(&suspend_ack_sem, 0, 0) < 0)
-		return false;
-
-	// Initialize suspend_handler_mask, it excludes SIGRESUME
-	if (sigfillset(&suspend_handler_mask) != 0)
-		return false;
-	if (sigdelset(&suspend_handler_mask, SIGRESUME) != 0)
-		return false;
-
-	// Create thread in running state
-	suspend_count = 0;
-	return (pthread_create(&timer_thread, NULL, timer_func, NULL) == 0);
-}
-
-// Kill timer thread
-static void timer_thread_kill(void)
+#ifdef PRECISE_TIMING_EVENT
+// Program the event loop for the next task to be called
+static void timer_event_arm(void)
 {
-	timer_thread_cancel = true;
-#ifdef HAVE_PTHREAD_CANCEL
-	pthread_cancel(timer_thread);
-#endif
-	pthread_join(timer_thread, NULL);
-}
-
-// Suspend timer thread
-static void timer_thread_suspend(void)
-{
-	pthread_mutex_lock(&suspend_count_lock);
-	if (suspend_count == 0) {
-		suspend_count ++;
-		if (pthread_kill(timer_thread, SIGSUSPEND) == 0)
-			sem_wait(&suspend_ack_sem);
-	}
-	pthread_mutex_unlock(&suspend_count_lock);
-}
-
-// Resume timer thread
-static void timer_thread_resume(void)
-{
-	pthread_mutex_lock(&suspend_count_lock);
-	assert(suspend_count > 0);
-	if (suspend_count == 1) {
-		suspend_count = 0;
-		pthread_kill(timer_thread, SIGRESUME);
-	}
-	pthread_mutex_unlock(&suspend_count_lock);
+	if (timer_cmp_time(wakeup_time, wakeup_time_max) < 0)
+		EventLoopSetDeadline(timer_event, wakeup_time);
+	else
+		EventLoopCancel(timer_event);
 }
 #endif
 
@@ -270,16 +166,10 @@ void TimerInit(void)
 	wakeup_time_sem = create_sem(1, "Wakeup Time");
 	timer_thread = spawn_thread(timer_func, "Time Manager", B_REAL_TIME_PRIORITY, NULL);
 	resume_thread(timer_thread);
-#elif PRECISE_TIMING_MACH
-	pthread_t pthread;
-	
-	host_get_clock_service(mach_host_self(), REALTIME_CLOCK, &system_clock);
-	semaphore_create(mach_task_self(), &wakeup_time_sem, SYNC_POLICY_FIFO, 1);
-
-	pthread_create(&pthread, NULL, &timer_func, NULL);
 #endif
-#ifdef PRECISE_TIMING_POSIX
-	timer_thread_active = timer_thread_init();
+#ifdef PRECISE_TIMING_EVENT
+	wakeup_time = wakeup_time_max;
+	timer_event = EventLoopAddTimer(timer_func, NULL);
 #endif
 #endif
 }
@@ -292,24 +182,22 @@ void TimerInit(void)
 void TimerExit(void)
 {
 #if PRECISE_TIMING
+#ifdef PRECISE_TIMING_BEOS
 	// Quit timer thread
 	if (timer_thread > 0) {
-#ifdef PRECISE_TIMING_BEOS
 		status_t l;
 		thread_active = false;
 		suspend_thread(timer_thread);
 		resume_thread(timer_thread);
 		wait_for_thread(timer_thread, &l);
 		delete_sem(wakeup_time_sem);
+	}
 #endif
-#ifdef PRECISE_TIMING_MACH
-		timer_thread_active = false;
-		semaphore_destroy(mach_task_self(), wakeup_time_sem);
-#endif
-#ifdef PRECISE_TIMING_POSIX
-		timer_thread_kill();
+#ifdef PRECISE_TIMING_EVENT
+	// Remove timer event
+	EventLoopRemove(timer_event);
+	timer_event = NULL;
 #endif
-	}
 #endif
 }
 
@@ -370,14 +258,6 @@ int16 RmvTime(uint32 tm)
 #if PRECISE_TIMING_BEOS
 	while (acquire_sem(wakeup_time_sem) == B_INTERRUPTED) ;
 	suspend_thread(timer_thread);
-#endif
-#ifdef PRECISE_TIMING_MACH
-	semaphore_wait(wakeup_time_sem);
-	thread_suspend(timer_thread);
-#endif
-#if PRECISE_TIMING_POSIX
-	timer_thread_suspend();
-	pthread_mutex_lock(&wakeup_time_lock);
 #endif
 	if (ReadMacInt16(tm + qType) & 0x8000) {
 
@@ -391,6 +271,9 @@ int16 RmvTime(uint32 tm)
 			if ((ReadMacInt16(d->task + qType) & 0x8000))
 				if (timer_cmp_time(d->wakeup, wakeup_time) < 0)
 					wakeup_time = d->wakeup;
+#ifdef PRECISE_TIMING_EVENT
+		timer_event_arm();
+#endif
 #endif
 
 		// Compute remaining time
@@ -409,16 +292,6 @@ int16 RmvTime(uint32 tm)
 		get_thread_info(timer_thread, &info);
 	} while (info.state == B_THREAD_SUSPENDED);	// Sometimes, resume_thread() doesn't work (BeOS bug?)
 #endif
-#ifdef PRECISE_TIMING_MACH
-	semaphore_signal(wakeup_time_sem);
-	thread_abort(timer_thread);
-	thread_resume(timer_thread);
-#endif
-#if PRECISE_TIMING_POSIX
-	pthread_mutex_unlock(&wakeup_time_lock);
-	timer_thread_resume();
-	assert(suspend_count == 0);
-#endif
 
 	// Free descriptor
 	free_desc(desc);
@@ -487,14 +360,6 @@ int16 PrimeTime(uint32 tm, int32 time)
 #if PRECISE_TIMING_BEOS
 	while (acquire_sem(wakeup_time_sem) == B_INTERRUPTED) ;
 	suspend_thread(timer_thread);
-#endif
-#ifdef PRECISE_TIMING_MACH
-	semaphore_wait(wakeup_time_sem);
-	thread_suspend(timer_thread);
-#endif
-#if PRECISE_TIMING_POSIX
-	timer_thread_suspend();
-	pthread_mutex_lock(&wakeup_time_lock);
 #endif
 	WriteMacInt16(tm + qType, ReadMacInt16(tm + qType) | 0x8000);
 	enqueue_tm(tm);
@@ -505,6 +370,9 @@ int16 PrimeTime(uint32 tm, int32 time)
 		if ((ReadMacInt16(d->task + qType) & 0x8000))
 			if (timer_cmp_time(d->wakeup, wakeup_time) < 0)
 				wakeup_time = d->wakeup;
+#ifdef PRECISE_TIMING_EVENT
+	timer_event_arm();
+#endif
 #ifdef PRECISE_TIMING_BEOS
 	release_sem(wakeup_time_sem);
 	thread_info info;
@@ -513,16 +381,6 @@ int16 PrimeTime(uint32 tm, int32 time)
 		get_thread_info(timer_thread, &info);
 	} while (info.state == B_THREAD_SUSPENDED);	// Sometimes, resume_thread() doesn't work (BeOS bug?)
 #endif
-#ifdef PRECISE_TIMING_MACH
-	semaphore_signal(wakeup_time_sem);
-	thread_abort(timer_thread);
-	thread_resume(timer_thread);
-#endif
-#ifdef PRECISE_TIMING_POSIX
-	pthread_mutex_unlock(&wakeup_time_lock);
-	timer_thread_resume();
-	assert(suspend_count == 0);
-#endif
 #endif
 	return 0;
 }
@@ -554,50 +412,12 @@ static int32 timer_func(void *arg)
 }
 #endif
 
-#ifdef PRECISE_TIMING_MACH
-static void *timer_func(void *arg)
+#ifdef PRECISE_TIMING_EVENT
+static void timer_func(void *arg)
 {
-	timer_thread = mach_thread_self();
-	timer_thread_active = true;
-	
-	while (timer_thread_active) {
-		clock_sleep(system_clock, TIME_ABSOLUTE, wakeup_time, NULL);
-		semaphore_wait(wakeup_time_sem);
-	   
-		tm_time_t system_time;
-		
-		timer_current_time(system_time);
-		if (timer_cmp_time(wakeup_time, system_time) < 0) {
-			wakeup_time = wakeup_time_max;
-			SetInterruptFlag(INTFLAG_TIMER);
-			TriggerInterrupt();
-		}
-		semaphore_signal(wakeup_time_sem);
-	}
-	return NULL;
-}
-#endif
-
-#ifdef PRECISE_TIMING_POSIX
-static void *timer_func(void *arg)
-{
-	while (!timer_thread_cancel) {
-		// Wait until time specified by wakeup_time
-		clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &wakeup_time, NULL);
-
-		tm_time_t system_time;
-		timer_current_time(system_time);
-		if (timer_cmp_time(wakeup_time, system_time) < 0) {
-
-			// Timer expired, trigger interrupt
-			pthread_mutex_lock(&wakeup_time_lock);
-			wakeup_time = wakeup_time_max;
-			pthread_mutex_unlock(&wakeup_time_lock);
-			SetInterruptFlag(INTFLAG_TIMER);
-			TriggerInterrupt();
-		}
-	}
-	return NULL;
+	// Timer expired, trigger interrupt
+	SetInterruptFlag(INTFLAG_TIMER);
+	TriggerInterrupt();
 }
 #endif
 
@@ -642,20 +462,15 @@ void TimerInterrupt(void)
 #if PRECISE_TIMING_BEOS
 	while (acquire_sem(wakeup_time_sem) == B_INTERRUPTED) ;
 	suspend_thread(timer_thread);
-#endif
-#if PRECISE_TIMING_MACH
-	semaphore_wait(wakeup_time_sem);
-	thread_suspend(timer_thread);
-#endif
-#if PRECISE_TIMING_POSIX
-	timer_thread_suspend();
-	pthread_mutex_lock(&wakeup_time_lock);
 #endif
 	wakeup_time = wakeup_time_max;
 	for (TMDesc *d = tmDescList; d; d = d->next)
 		if ((ReadMacInt16(d->task + qType) & 0x8000))
 			if (timer_cmp_time(d->wakeup, wakeup_time) < 0)
 				wakeup_time = d->wakeup;
+#ifdef PRECISE_TIMING_EVENT
+	timer_event_arm();
+#endif
 #if PRECISE_TIMING_BEOS
 	release_sem(wakeup_time_sem);
 	thread_info info;
@@ -664,15 +479,5 @@ void TimerInterrupt(void)
 		get_thread_info(timer_thread, &info);
 	} while (info.state == B_THREAD_SUSPENDED);	// Sometimes, resume_thread() doesn't work (BeOS bug?)
 #endif
-#if PRECISE_TIMING_MACH
-	semaphore_signal(wakeup_time_sem);
-	thread_abort(timer_thread);
-	thread_resume(timer_thread);
-#endif
-#if PRECISE_TIMING_POSIX
-	pthread_mutex_unlock(&wakeup_time_lock);
-	timer_thread_resume();
-	assert(suspend_count == 0);
-#endif
 #endif
 }